@@ -0,0 +1,179 @@
+#include "benchsuite.h"
+
+#include "allocstats.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QJsonArray>
+#include <QSysInfo>
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+
+BenchSuite::BenchSuite(QString filter, int iterations, int warmup)
+    : m_filter(filter),
+      m_iterations(std::max(iterations, 1)),
+      m_warmup(std::max(warmup, 0)) { }
+
+bool BenchSuite::wants(QString name) const {
+    return m_filter.pattern().isEmpty() or m_filter.match(name).hasMatch();
+}
+
+void BenchSuite::run(QString                      name,
+                     std::function<void()> const& setup,
+                     std::function<void()> const& body,
+                     QJsonObject                  info) {
+    if (!wants(name)) return;
+
+    qInfo() << "Running" << name;
+
+    for (int i = 0; i < m_warmup; i++) {
+        if (setup) setup();
+        body();
+    }
+
+    std::vector<double> samples;
+    samples.reserve(m_iterations);
+
+    // of the last iteration; zero unless the build counts them
+    AllocationStats allocated;
+
+    for (int i = 0; i < m_iterations; i++) {
+        if (setup) setup();
+
+        auto before = allocation_stats();
+
+        auto start = std::chrono::steady_clock::now();
+        body();
+        auto end = std::chrono::steady_clock::now();
+
+        allocated = allocation_stats() - before;
+
+        samples.push_back(std::chrono::duration<double>(end - start).count());
+    }
+
+    // release whatever the last iteration kept alive
+    if (setup) setup();
+
+    std::sort(samples.begin(), samples.end());
+
+    auto mean = std::accumulate(samples.begin(), samples.end(), 0.0) /
+                samples.size();
+
+    auto median = samples[samples.size() / 2];
+
+    if (samples.size() % 2 == 0) {
+        median = (median + samples[samples.size() / 2 - 1]) / 2.0;
+    }
+
+    QJsonObject result {
+        { "iterations", (int)samples.size() },
+        { "min", samples.front() },
+        { "median", median },
+        { "mean", mean },
+        { "max", samples.back() },
+    };
+
+    if (!info.isEmpty()) result["info"] = info;
+
+    qInfo() << "  median" << median * 1000.0 << "ms";
+
+    if (allocations_counted()) {
+        result["allocations"]     = (double)allocated.count;
+        result["allocated_bytes"] = (double)allocated.bytes;
+
+        qInfo() << "  allocations" << (qint64)allocated.count << "totalling"
+                << (qint64)allocated.bytes << "bytes";
+    }
+
+    m_results[name] = result;
+}
+
+void BenchSuite::add_info(QString name, QJsonObject info) {
+    auto result = m_results[name].toObject();
+    auto merged = result["info"].toObject();
+
+    for (auto iter = info.begin(); iter != info.end(); ++iter) {
+        merged[iter.key()] = iter.value();
+    }
+
+    result["info"]  = merged;
+    m_results[name] = result;
+}
+
+QJsonObject BenchSuite::results() const {
+    return {
+        { "application", QCoreApplication::applicationName() },
+        { "version", QCoreApplication::applicationVersion() },
+        { "timestamp", QDateTime::currentDateTimeUtc().toString(Qt::ISODate) },
+        { "host", QSysInfo::machineHostName() },
+        { "cpu", QSysInfo::currentCpuArchitecture() },
+        { "iterations", m_iterations },
+        { "benchmarks", m_results },
+    };
+}
+
+int BenchSuite::compare(QJsonObject const& current,
+                        QJsonObject const& baseline,
+                        double             tolerance) {
+    auto now_list  = current["benchmarks"].toObject();
+    auto base_list = baseline["benchmarks"].toObject();
+
+    int regressions = 0;
+
+    qInfo().noquote() << QString("%1 %2 %3 %4")
+                             .arg("benchmark", -48)
+                             .arg("base ms", 12)
+                             .arg("now ms", 12)
+                             .arg("ratio", 8);
+
+    for (auto iter = now_list.begin(); iter != now_list.end(); ++iter) {
+        auto now_median = iter.value().toObject()["median"].toDouble();
+
+        if (!base_list.contains(iter.key())) {
+            qInfo().noquote() << QString("%1 %2 %3 %4")
+                                     .arg(iter.key(), -48)
+                                     .arg("-", 12)
+                                     .arg(now_median * 1000.0, 12, 'f', 3)
+                                     .arg("new", 8);
+            continue;
+        }
+
+        auto base_median =
+            base_list[iter.key()].toObject()["median"].toDouble();
+
+        auto ratio = base_median > 0 ? now_median / base_median : 1.0;
+
+        bool regressed = ratio > 1.0 + tolerance;
+
+        if (regressed) regressions++;
+
+        qInfo().noquote() << QString("%1 %2 %3 %4 %5")
+                                 .arg(iter.key(), -48)
+                                 .arg(base_median * 1000.0, 12, 'f', 3)
+                                 .arg(now_median * 1000.0, 12, 'f', 3)
+                                 .arg(ratio, 8, 'f', 3)
+                                 .arg(regressed ? "REGRESSED" : "");
+
+        // only builds that count allocations record them
+        auto base_allocs = base_list[iter.key()].toObject()["allocations"];
+        auto now_allocs  = iter.value().toObject()["allocations"];
+
+        if (base_allocs.isDouble() and now_allocs.isDouble()) {
+            qInfo().noquote() << QString("%1 %2 %3 allocations")
+                                     .arg("", -48)
+                                     .arg(base_allocs.toDouble(), 12, 'f', 0)
+                                     .arg(now_allocs.toDouble(), 12, 'f', 0);
+        }
+    }
+
+    for (auto iter = base_list.begin(); iter != base_list.end(); ++iter) {
+        if (now_list.contains(iter.key())) continue;
+        qInfo().noquote() << QString("%1 missing from this run")
+                                 .arg(iter.key(), -48);
+    }
+
+    return regressions;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <QString>
+
+#include <functional>
+#include <vector>
+
+/// Collects timings for a set of named benchmark cases and serializes them so
+/// that runs can be compared against a saved baseline.
+class BenchSuite {
+    QRegularExpression m_filter;
+    int                m_iterations;
+    int                m_warmup;
+
+    QJsonObject m_results;
+
+public:
+    BenchSuite(QString filter, int iterations, int warmup);
+
+    /// Whether a case with this name passes the user filter
+    bool wants(QString name) const;
+
+    /// Time `body`. `setup` is run before every iteration and is not timed;
+    /// use it to release state from the previous iteration. `info` is copied
+    /// into the results verbatim (sizes, counts, etc).
+    void run(QString                      name,
+             std::function<void()> const& setup,
+             std::function<void()> const& body,
+             QJsonObject                  info = {});
+
+    void add_info(QString name, QJsonObject info);
+
+    /// The full result document
+    QJsonObject results() const;
+
+    /// Print a comparison against a baseline document. Returns the number of
+    /// cases whose median got slower by more than the tolerance (fraction).
+    static int compare(QJsonObject const& current,
+                       QJsonObject const& baseline,
+                       double             tolerance);
+};
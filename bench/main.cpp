@@ -0,0 +1,832 @@
+#include "benchsuite.h"
+#include "synthetic.h"
+
+#include "bulkimporter.h"
+#include "crosssection.h"
+#include "gltfimporter.h"
+#include "importer.h"
+#include "instanceset.h"
+#include "isosurface.h"
+#include "mappediosystem.h"
+#include "meshprocessing.h"
+#include "pointplot.h"
+#include "transformtree.h"
+#include "utility.h"
+#include "xdmfimporter.h"
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDomDocument>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <array>
+#include <cmath>
+
+namespace {
+
+struct BenchContext {
+    noo::DocumentTPtr doc;
+    noo::ObjectTPtr   root;
+    ImportOptions     options;
+};
+
+QJsonObject read_json(QString path) {
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly)) {
+        qCritical() << "Unable to open baseline" << path;
+        return {};
+    }
+    return QJsonDocument::fromJson(file.readAll()).object();
+}
+
+/// Benchmarks for a scene file: the whole load, also through Assimp for
+/// formats with a native loader, the native parser alone, Assimp alone, the
+/// post-processing steps done by Assimp or in house, and our conversion
+/// alone.
+void bench_model_file(BenchSuite&         suite,
+                      BenchContext const& ctx,
+                      QString             name,
+                      QString             path,
+                      QJsonObject         info) {
+    {
+        ModelPtr keep;
+        suite.run(
+            "make_thing/" + name,
+            [&]() { keep.reset(); },
+            [&]() {
+                auto r = make_thing(0, path, ctx.doc, ctx.root, ctx.options);
+                if (auto* p = std::get_if<ModelPtr>(&r)) keep = *p;
+            },
+            info);
+    }
+
+    if (is_gltf_path(path) or is_bulk_path(path)) {
+        auto assimp_options        = ctx.options;
+        assimp_options.native_gltf = false;
+        assimp_options.native_bulk = false;
+
+        ModelPtr keep;
+        suite.run(
+            "make_thing_assimp/" + name,
+            [&]() { keep.reset(); },
+            [&]() {
+                auto r =
+                    make_thing(0, path, ctx.doc, ctx.root, assimp_options);
+                if (auto* p = std::get_if<ModelPtr>(&r)) keep = *p;
+            },
+            info);
+    }
+
+    if (is_bulk_path(path)) {
+        suite.run(
+            "native_read/" + name, {}, [&]() { load_bulk(path); }, info);
+    }
+
+    suite.run(
+        "assimp_read/" + name,
+        {},
+        [&]() {
+            Assimp::Importer importer;
+            importer.RegisterLoader(new XDMFAssimpImporter);
+            importer.ReadFile(path.toStdString(),
+                              import_postprocess_flags(ctx.options));
+        },
+        info);
+
+    {
+        auto assimp_options           = ctx.options;
+        assimp_options.native_weld    = false;
+        assimp_options.native_normals = false;
+
+        suite.run(
+            "assimp_postprocess/" + name,
+            {},
+            [&]() {
+                Assimp::Importer importer;
+                importer.RegisterLoader(new XDMFAssimpImporter);
+                importer.ReadFile(path.toStdString(),
+                                  import_postprocess_flags(assimp_options));
+            },
+            info);
+    }
+
+    auto const steps = mesh_processing(ctx.options, false);
+
+    if (suite.wants("mesh_processing/" + name)) {
+        std::unique_ptr<Assimp::Importer> importer;
+        aiScene const*                    scene = nullptr;
+
+        suite.run(
+            "mesh_processing/" + name,
+            [&]() {
+                importer = std::make_unique<Assimp::Importer>();
+                importer->RegisterLoader(new XDMFAssimpImporter);
+                scene = importer->ReadFile(
+                    path.toStdString(), import_postprocess_flags(ctx.options));
+            },
+            [&]() {
+                if (scene) process_meshes(const_cast<aiScene&>(*scene), steps);
+            },
+            info);
+    }
+
+    if (!suite.wants("importer/" + name)) return;
+
+    Assimp::Importer importer;
+    importer.RegisterLoader(new XDMFAssimpImporter);
+
+    auto* scene = importer.ReadFile(path.toStdString(),
+                                    import_postprocess_flags(ctx.options));
+
+    if (!scene) {
+        qCritical() << "Unable to load" << path << importer.GetErrorString();
+        return;
+    }
+
+    process_meshes(const_cast<aiScene&>(*scene), steps);
+
+    ModelPtr keep;
+    suite.run(
+        "importer/" + name,
+        [&]() { keep.reset(); },
+        [&]() {
+            auto r = import_ai_scene(*scene, ctx.doc, ctx.root, 0, ctx.options);
+            if (auto* p = std::get_if<ModelPtr>(&r)) keep = *p;
+        },
+        info);
+}
+
+/// Ask the kernel to forget cached pages of these files so the next read
+/// has to hit the disk. Only clean pages are dropped; no privileges needed.
+void drop_page_cache(QStringList const& files) {
+    for (auto const& f : files) {
+        int fd = ::open(f.toLocal8Bit().constData(), O_RDONLY);
+        if (fd < 0) continue;
+        ::fdatasync(fd);
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        ::close(fd);
+    }
+}
+
+/// Assimp read time with a cold and a warm page cache, through Assimp's
+/// default IO and through the mapped IO system. `files` lists everything the
+/// load touches, so the cold runs can evict all of it.
+void bench_io(BenchSuite&         suite,
+              BenchContext const& ctx,
+              QString             name,
+              QString             path,
+              QStringList         files) {
+    qint64 bytes = 0;
+    for (auto const& f : files) {
+        bytes += QFileInfo(f).size();
+    }
+
+    QJsonObject info { { "file_bytes", bytes } };
+
+    for (bool mapped : { false, true }) {
+        for (bool cold : { true, false }) {
+            auto key = QString("io/%1/%2/%3")
+                           .arg(cold ? "cold" : "warm")
+                           .arg(mapped ? "mapped" : "default")
+                           .arg(name);
+
+            std::function<void()> setup;
+
+            if (cold) setup = [&]() { drop_page_cache(files); };
+
+            suite.run(
+                key,
+                setup,
+                [&]() {
+                    Assimp::Importer importer;
+                    importer.RegisterLoader(new XDMFAssimpImporter);
+                    if (mapped) importer.SetIOHandler(new MappedIOSystem);
+                    importer.ReadFile(path.toStdString(),
+                                      import_postprocess_flags(ctx.options));
+                },
+                info);
+        }
+    }
+}
+
+void bench_scene(BenchSuite&              suite,
+                 BenchContext const&      ctx,
+                 QDir const&              dir,
+                 QString                  name,
+                 std::unique_ptr<aiScene> scene,
+                 QJsonObject              info) {
+    auto path = dir.filePath(name + ".glb");
+
+    if (auto err = write_scene(*scene, path)) {
+        qCritical() << *err;
+        return;
+    }
+
+    info["file_bytes"] = QFileInfo(path).size();
+
+    bench_model_file(suite, ctx, name, path, info);
+
+    bench_io(suite, ctx, name, path, { path });
+}
+
+template <class T>
+void bench_pack_to(BenchSuite&       suite,
+                   QString           name,
+                   QString           path,
+                   MappedFile::PType type,
+                   size_t            count) {
+    MappedFile file(path, 0);
+    file.type = type;
+    file.reset_span(count);
+
+    suite.run(
+        "pack_to/" + name,
+        {},
+        [&]() {
+            auto [data, size] = pack_to<T>(file);
+            Q_ASSERT(size > 0);
+        },
+        {
+            { "elements", (qint64)count },
+            { "bytes", (qint64)file.bytes.size() },
+        });
+}
+
+void bench_xdmf(BenchSuite&         suite,
+                BenchContext const& ctx,
+                QDir const&         dir,
+                QString             name,
+                size_t              triangles,
+                MappedFile::PType   coord_type,
+                MappedFile::PType   conn_type) {
+    auto written =
+        write_xdmf(dir.path(), name, triangles, coord_type, conn_type);
+
+    QJsonObject info {
+        { "vertices", (qint64)written.vertex_count },
+        { "triangles", (qint64)written.triangle_count },
+    };
+
+    bench_model_file(suite, ctx, name, written.xmf_path, info);
+
+    bench_io(suite,
+             ctx,
+             name,
+             written.xmf_path,
+             { written.xmf_path, written.coord_path, written.conn_path });
+
+    bench_pack_to<aiVector3D>(suite,
+                              name + "/coord",
+                              written.coord_path,
+                              coord_type,
+                              written.vertex_count * 3);
+
+    bench_pack_to<uint32_t>(suite,
+                            name + "/conn",
+                            written.conn_path,
+                            conn_type,
+                            written.triangle_count * 3);
+
+    if (!suite.wants("consume_grid/" + name) and
+        !suite.wants("consume_grid_async/" + name)) {
+        return;
+    }
+
+    QFile file(written.xmf_path);
+    file.open(QFile::ReadOnly);
+
+    QDomDocument document;
+    document.setContent(&file);
+
+    auto grid = document.documentElement()
+                    .firstChildElement("Domain")
+                    .firstChildElement("Grid");
+
+    std::unique_ptr<aiScene> scene;
+
+    suite.run(
+        "consume_grid/" + name,
+        [&]() { scene = std::make_unique<aiScene>(); },
+        [&]() {
+            XDMFImporter importer(written.xmf_path, scene.get());
+            importer.consume_grid(grid);
+        },
+        info);
+
+    // data items read ahead in a batch instead of mapped
+    suite.run(
+        "consume_grid_async/" + name,
+        [&]() { scene = std::make_unique<aiScene>(); },
+        [&]() {
+            XDMFImporter importer(
+                written.xmf_path, scene.get(), nullptr, false, {}, true);
+            importer.consume_grid(grid);
+        },
+        info);
+}
+
+/// Publishing a whole instance set, against a batch of edits to a run of
+/// instances that only dirties one page
+void bench_instances(BenchSuite&         suite,
+                     BenchContext const& ctx,
+                     size_t              count) {
+    std::array<glm::vec3, 3> positions = {
+        glm::vec3(0, 0, 0),
+        glm::vec3(1, 0, 0),
+        glm::vec3(0, 1, 0),
+    };
+
+    std::array<uint32_t, 3> indices = { 0, 1, 2 };
+
+    noo::MeshSource source;
+    source.material     = noo::create_material(ctx.doc, noo::MaterialData {});
+    source.positions    = positions;
+    source.indices      = std::as_writable_bytes(std::span(indices));
+    source.index_format = noo::Format::U32;
+    source.type         = noo::MeshSource::TRIANGLE;
+
+    std::vector<noo::MeshTPtr> meshes { noo::create_mesh(ctx.doc, source) };
+
+    QJsonObject info { { "instances", (qint64)count } };
+
+    std::unique_ptr<InstanceSet> set;
+
+    auto make_set = [&]() {
+        set.reset();
+        set =
+            std::make_unique<InstanceSet>(0, ctx.doc, ctx.root, meshes, count);
+    };
+
+    suite.run(
+        "instances/publish/" + QString::number(count),
+        make_set,
+        [&]() { set->flush(); },
+        info);
+
+    make_set();
+    set->flush();
+
+    std::vector<InstanceSet::Edit> edits(std::min<size_t>(1000, count));
+
+    for (size_t i = 0; i < edits.size(); i++) {
+        edits[i].index    = i;
+        edits[i].position = glm::vec3(i, 0, 0);
+    }
+
+    suite.run(
+        "instances/edit/" + QString::number(count),
+        {},
+        [&]() {
+            set->apply(edits);
+            set->flush();
+        },
+        info);
+}
+
+/// Streaming points into a plot: one large append, and many small appends
+/// into a full ring, each published as it would be on its own event loop
+/// turn. Divide the points by the time for the ingest rate.
+void bench_point_plot(BenchSuite&         suite,
+                      BenchContext const& ctx,
+                      size_t              count) {
+    auto glyph = make_point_glyph(ctx.doc);
+
+    std::vector<glm::vec3>   positions(count);
+    std::vector<glm::u8vec4> colors(count);
+    std::vector<float>       sizes(count);
+
+    for (size_t i = 0; i < count; i++) {
+        positions[i] = glm::vec3(i % 1000, (i / 1000) % 1000, i / 1000000);
+        colors[i]    = glm::u8vec4(i, i >> 8, i >> 16, 255);
+        sizes[i]     = 0.01f;
+    }
+
+    QJsonObject info { { "points", (qint64)count } };
+
+    std::unique_ptr<PointPlot> plot;
+
+    suite.run(
+        "points/append/" + QString::number(count),
+        [&]() {
+            plot.reset();
+            plot = std::make_unique<PointPlot>(0, ctx.doc, ctx.root, glyph, 0);
+        },
+        [&]() {
+            plot->append(positions, colors, sizes);
+            plot->flush();
+        },
+        info);
+
+    size_t const batch = 1000;
+
+    plot = std::make_unique<PointPlot>(0, ctx.doc, ctx.root, glyph, count);
+    plot->append(positions, colors, sizes);
+    plot->flush();
+
+    suite.run(
+        "points/ring/" + QString::number(count),
+        {},
+        [&]() {
+            for (size_t i = 0; i + batch <= count; i += batch) {
+                plot->append(std::span(positions).subspan(i, batch),
+                             std::span(colors).subspan(i, batch),
+                             std::span(sizes).subspan(i, batch));
+                plot->flush();
+            }
+        },
+        info);
+}
+
+/// Extracting the isosurface of a volume already read, as on every change of
+/// the iso value, at a different value each run
+void bench_isosurface(BenchSuite&         suite,
+                      BenchContext const& ctx,
+                      QString             path,
+                      size_t              nodes) {
+    auto loaded = load_scene(path, ctx.options);
+
+    auto* scene = std::get_if<LoadedScene>(&loaded);
+
+    if (!scene or !scene->volume) {
+        qWarning() << "No volume in" << path << ", skipping isosurface bench";
+        return;
+    }
+
+    auto const& volume = *scene->volume;
+
+    QJsonObject info {
+        { "nodes", (qint64)volume.node_count() },
+        { "nodes_per_axis", (qint64)nodes },
+    };
+
+    size_t round = 0;
+
+    suite.run(
+        "isosurface/extract/" + QString::number(nodes),
+        {},
+        [&]() {
+            // between a quarter and three quarters of the range
+            float t = 0.25f + 0.5f * ((round++ * 7) % 16) / 15.0f;
+            extract_isosurface(
+                volume, std::lerp(volume.min_value, volume.max_value, t));
+        },
+        info);
+}
+
+/// Sorting the isosurface of a volume into a hierarchy, as at import, and
+/// cutting it with a plane swept across it, with and without caps
+void bench_cross_section(BenchSuite&         suite,
+                         BenchContext const& ctx,
+                         QString             path,
+                         size_t              nodes) {
+    auto loaded = load_scene(path, ctx.options);
+
+    auto* scene = std::get_if<LoadedScene>(&loaded);
+
+    if (!scene or !scene->volume) {
+        qWarning() << "No volume in" << path << ", skipping section bench";
+        return;
+    }
+
+    auto surface =
+        extract_isosurface(*scene->volume, scene->volume->middle());
+
+    QJsonObject info {
+        { "triangles", (qint64)surface.indices.size() / 3 },
+        { "nodes_per_axis", (qint64)nodes },
+    };
+
+    auto const suffix = QString::number(nodes);
+
+    suite.run(
+        "section/build/" + suffix,
+        {},
+        [&]() { MeshBVH built(surface.positions, surface.indices); },
+        info);
+
+    MeshBVH bvh(surface.positions, surface.indices);
+
+    auto const bounds = bvh.bounds();
+
+    size_t round = 0;
+
+    auto next_plane = [&]() {
+        // slightly tilted, at one of 16 heights through the surface
+        float t = ((round++ * 7) % 16 + 0.5f) / 16.0f;
+        auto  p = glm::mix(bounds.min, bounds.max, t);
+        return Plane::through(p, glm::normalize(glm::vec3(0.1f, 0.2f, 1)));
+    };
+
+    for (bool cap : { false, true }) {
+        suite.run(
+            QString(cap ? "section/slice_capped/" : "section/slice/") +
+                suffix,
+            {},
+            [&]() { bvh.slice(next_plane(), glm::mat4(1), cap); },
+            info);
+    }
+}
+
+/// Bounds of a node hierarchy from scratch, against moving a few nodes and
+/// updating only what they change
+void bench_transform_tree(BenchSuite& suite, size_t count) {
+    Bounds const unit { glm::vec3(-1), glm::vec3(1) };
+
+    auto offset = [](size_t i) {
+        return glm::translate(glm::mat4(1), glm::vec3(i % 7, i % 5, i % 3));
+    };
+
+    // eight children to a node, so about as deep as a large assembly
+    auto build = [&](TransformTree& tree) {
+        tree.clear();
+        tree.add(TransformTree::none, glm::mat4(1), {});
+        for (size_t i = 1; i < count; i++) {
+            tree.add((i - 1) / 8, offset(i), unit);
+        }
+    };
+
+    QJsonObject info { { "nodes", (qint64)count } };
+
+    TransformTree tree;
+
+    suite.run(
+        "bounds/build/" + QString::number(count),
+        {},
+        [&]() {
+            build(tree);
+            tree.update();
+        },
+        info);
+
+    build(tree);
+    tree.update();
+
+    size_t round = 0;
+
+    suite.run(
+        "bounds/move/" + QString::number(count),
+        {},
+        [&]() {
+            round++;
+            for (size_t i = count - 100; i < count; i++) {
+                tree.set_local(i, offset(i + round));
+            }
+            tree.update();
+        },
+        info);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    auto app = QCoreApplication(argc, argv);
+
+    QCoreApplication::setApplicationName("PlaygroundBench");
+    QCoreApplication::setApplicationVersion("0.2");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Import benchmarks for Playground");
+    parser.addHelpOption();
+    parser.addVersionOption();
+
+    auto scale_opt = QCommandLineOption(
+        "scale", "Multiplier applied to every synthetic input size", "x", "1");
+    auto iter_opt = QCommandLineOption(
+        "iterations", "Timed iterations per benchmark", "n", "5");
+    auto warmup_opt = QCommandLineOption(
+        "warmup", "Untimed iterations per benchmark", "n", "1");
+    auto filter_opt = QCommandLineOption(
+        "filter", "Only run benchmarks matching this regex", "regex");
+    auto output_opt = QCommandLineOption(
+        "output", "Write JSON results to this file", "path");
+    auto baseline_opt = QCommandLineOption(
+        "baseline", "Compare results against a saved JSON run", "path");
+    auto tolerance_opt = QCommandLineOption(
+        "tolerance",
+        "Allowed slowdown before a benchmark counts as regressed",
+        "fraction",
+        "0.1");
+    auto dir_opt = QCommandLineOption(
+        "work-dir",
+        "Directory for generated assets (default: temporary)",
+        "path");
+
+    parser.addOptions({ scale_opt,
+                        iter_opt,
+                        warmup_opt,
+                        filter_opt,
+                        output_opt,
+                        baseline_opt,
+                        tolerance_opt,
+                        dir_opt });
+
+    auto server = noo::create_server(parser);
+
+    Q_ASSERT(server);
+
+    auto scale = std::max(parser.value(scale_opt).toDouble(), 0.001);
+
+    auto scaled = [scale](double v) { return std::max<size_t>(1, v * scale); };
+
+    QTemporaryDir temp_dir;
+    QDir          dir(parser.isSet(dir_opt) ? parser.value(dir_opt)
+                                            : temp_dir.path());
+
+    if (!dir.exists()) dir.mkpath(".");
+
+    qInfo() << "Generating assets in" << dir.path();
+
+    BenchContext ctx;
+    ctx.doc = noo::get_document(server.get());
+
+    {
+        noo::ObjectData obdata = {
+            .name = "Bench Root",
+            .tags = QStringList() << noo::names::tag_user_hidden,
+        };
+
+        ctx.root = noo::create_object(ctx.doc, obdata);
+    }
+
+    BenchSuite suite(parser.value(filter_opt),
+                     parser.value(iter_opt).toInt(),
+                     parser.value(warmup_opt).toInt());
+
+    {
+        auto count = scaled(1'000'000);
+        bench_scene(suite,
+                    ctx,
+                    dir,
+                    "soup",
+                    make_triangle_soup(count),
+                    { { "triangles", (qint64)count } });
+    }
+
+    {
+        auto depth = scaled(2'000);
+        bench_scene(suite,
+                    ctx,
+                    dir,
+                    "hierarchy",
+                    make_deep_hierarchy(depth),
+                    { { "depth", (qint64)depth } });
+    }
+
+    {
+        auto count = scaled(20'000);
+        bench_scene(suite,
+                    ctx,
+                    dir,
+                    "instanced",
+                    make_instanced_scene(count),
+                    { { "instances", (qint64)count } });
+    }
+
+    {
+        auto count = scaled(64);
+        bench_scene(suite,
+                    ctx,
+                    dir,
+                    "textured",
+                    make_texture_scene(count, 512),
+                    { { "textures", (qint64)count }, { "texture_size", 512 } });
+    }
+
+    {
+        auto tris = scaled(2'000'000);
+
+        bench_xdmf(suite,
+                   ctx,
+                   dir,
+                   "xdmf_f32",
+                   tris,
+                   MappedFile::Float32,
+                   MappedFile::Int64);
+        bench_xdmf(suite,
+                   ctx,
+                   dir,
+                   "xdmf_f64",
+                   tris,
+                   MappedFile::Float64,
+                   MappedFile::Int64);
+    }
+
+    {
+        auto written = write_partitioned_xdmf(
+            dir.path(), "xdmf_spatial_16", scaled(2'000'000), 16);
+
+        QJsonObject info {
+            { "vertices", (qint64)written.vertex_count },
+            { "triangles", (qint64)written.triangle_count },
+            { "partitions", 16 },
+        };
+
+        bench_model_file(suite, ctx, "xdmf_spatial_16", written.xmf_path, info);
+    }
+
+    {
+        // the surface grows with the square of the side, the grid with the
+        // cube
+        auto nodes = std::max<size_t>(2, scaled(512));
+
+        auto path = write_structured_xdmf(dir.path(), "xdmf_corect", nodes);
+
+        bench_model_file(suite,
+                         ctx,
+                         "xdmf_corect",
+                         path,
+                         { { "nodes_per_axis", (qint64)nodes } });
+    }
+
+    {
+        // a field over every node, so this grows with the cube of the side
+        auto nodes = std::max<size_t>(8, scaled(256));
+
+        auto path = write_volume_xdmf(dir.path(), "xdmf_volume", nodes);
+
+        bench_model_file(suite,
+                         ctx,
+                         "xdmf_volume",
+                         path,
+                         { { "nodes_per_axis", (qint64)nodes } });
+
+        bench_isosurface(suite, ctx, path, nodes);
+        bench_cross_section(suite, ctx, path, nodes);
+    }
+
+    {
+        // text formats are several times larger per triangle, so these stay
+        // smaller than the XDMF cases
+        auto tris = scaled(500'000);
+
+        std::pair<BulkFormat, QString> const formats[] = {
+            { BulkFormat::AsciiSTL, "stl_ascii" },
+            { BulkFormat::BinarySTL, "stl_binary" },
+            { BulkFormat::OBJ, "obj" },
+            { BulkFormat::AsciiPLY, "ply_ascii" },
+            { BulkFormat::BinaryPLY, "ply_binary" },
+        };
+
+        for (auto const& [format, name] : formats) {
+            auto path = write_bulk(dir.path(), name, tris, format);
+
+            bench_model_file(suite,
+                             ctx,
+                             name,
+                             path,
+                             { { "triangles", (qint64)tris },
+                               { "file_bytes", QFileInfo(path).size() } });
+        }
+    }
+
+    bench_instances(suite, ctx, scaled(100'000));
+
+    bench_point_plot(suite, ctx, std::max<size_t>(scaled(1'000'000), 1000));
+
+    bench_transform_tree(suite, std::max<size_t>(scaled(100'000), 200));
+
+    auto results = suite.results();
+
+    auto json = QJsonDocument(results).toJson();
+
+    if (parser.isSet(output_opt)) {
+        QFile out(parser.value(output_opt));
+        if (!out.open(QFile::WriteOnly | QFile::Truncate)) {
+            qCritical() << "Unable to write results to" << out.fileName();
+            return 1;
+        }
+        out.write(json);
+        qInfo() << "Results written to" << out.fileName();
+    } else {
+        QTextStream(stdout) << json;
+    }
+
+    if (parser.isSet(baseline_opt)) {
+        auto baseline = read_json(parser.value(baseline_opt));
+
+        auto regressions =
+            BenchSuite::compare(results,
+                                baseline,
+                                parser.value(tolerance_opt).toDouble());
+
+        if (regressions) {
+            qWarning() << regressions << "benchmark(s) regressed";
+            return 2;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,807 @@
+#include "synthetic.h"
+
+#include <assimp/Exporter.hpp>
+#include <assimp/material.h>
+#include <assimp/scene.h>
+
+#include <glm/geometric.hpp>
+
+#include <QBuffer>
+#include <QDir>
+#include <QFile>
+#include <QImage>
+#include <QTextStream>
+#include <QXmlStreamWriter>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+namespace {
+
+constexpr uint32_t synthetic_seed = 0x504c4159;
+
+template <class T>
+T* copy_array(std::vector<T> const& v) {
+    auto ret = new T[v.size()];
+    std::copy(v.begin(), v.end(), ret);
+    return ret;
+}
+
+aiMesh* make_mesh(std::vector<aiVector3D> const& positions,
+                  std::vector<unsigned> const&   indices,
+                  unsigned                       material) {
+    auto mesh = new aiMesh;
+
+    mesh->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+    mesh->mMaterialIndex  = material;
+
+    mesh->mNumVertices = positions.size();
+    mesh->mVertices    = copy_array(positions);
+
+    mesh->mNumFaces = indices.size() / 3;
+    mesh->mFaces    = new aiFace[mesh->mNumFaces];
+
+    for (unsigned i = 0; i < mesh->mNumFaces; i++) {
+        auto& f       = mesh->mFaces[i];
+        f.mNumIndices = 3;
+        f.mIndices    = new unsigned[3];
+        std::copy_n(indices.data() + i * 3, 3, f.mIndices);
+    }
+
+    return mesh;
+}
+
+void add_planar_uvs(aiMesh& mesh) {
+    mesh.mNumUVComponents[0] = 2;
+    mesh.mTextureCoords[0]   = new aiVector3D[mesh.mNumVertices];
+
+    for (unsigned i = 0; i < mesh.mNumVertices; i++) {
+        auto const& p             = mesh.mVertices[i];
+        mesh.mTextureCoords[0][i] = aiVector3D(p.x, p.y, 0);
+    }
+}
+
+aiMesh* make_box(unsigned material) {
+    std::vector<aiVector3D> positions;
+
+    for (int i = 0; i < 8; i++) {
+        positions.emplace_back(i & 1, (i >> 1) & 1, (i >> 2) & 1);
+    }
+
+    std::vector<unsigned> indices = {
+        0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4,
+        2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5,
+    };
+
+    return make_mesh(positions, indices, material);
+}
+
+aiMaterial* make_material(aiColor4D color) {
+    auto mat = new aiMaterial;
+    mat->AddProperty(&color, 1, AI_MATKEY_COLOR_DIFFUSE);
+    return mat;
+}
+
+aiNode* make_node(QString name, aiMatrix4x4 const& tf) {
+    auto node             = new aiNode(name.toStdString());
+    node->mTransformation = tf;
+    return node;
+}
+
+void set_children(aiNode& parent, std::vector<aiNode*> const& children) {
+    parent.mNumChildren = children.size();
+    parent.mChildren    = copy_array(children);
+    for (auto* c : children) {
+        c->mParent = &parent;
+    }
+}
+
+void set_meshes(aiNode& node, std::vector<unsigned> const& meshes) {
+    node.mNumMeshes = meshes.size();
+    node.mMeshes    = copy_array(meshes);
+}
+
+aiMatrix4x4 translation(float x, float y, float z) {
+    aiMatrix4x4 ret;
+    aiMatrix4x4::Translation(aiVector3D(x, y, z), ret);
+    return ret;
+}
+
+std::unique_ptr<aiScene> new_scene(std::vector<aiMesh*> const&     meshes,
+                                   std::vector<aiMaterial*> const& materials,
+                                   aiNode*                         root) {
+    auto scene = std::make_unique<aiScene>();
+
+    scene->mNumMeshes    = meshes.size();
+    scene->mMeshes       = copy_array(meshes);
+    scene->mNumMaterials = materials.size();
+    scene->mMaterials    = copy_array(materials);
+    scene->mRootNode     = root;
+
+    return scene;
+}
+
+QByteArray noise_png(int size, std::mt19937& rng) {
+    QImage image(size, size, QImage::Format_RGBA8888);
+
+    std::uniform_int_distribution<int> dist(0, 255);
+
+    for (int y = 0; y < size; y++) {
+        auto* line = image.scanLine(y);
+        for (int x = 0; x < size * 4; x++) {
+            line[x] = (x % 4 == 3) ? 255 : dist(rng);
+        }
+    }
+
+    QByteArray bytes;
+    QBuffer    buffer(&bytes);
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, "png");
+
+    return bytes;
+}
+
+} // namespace
+
+std::unique_ptr<aiScene> make_triangle_soup(size_t triangle_count) {
+    std::mt19937                          rng(synthetic_seed);
+    std::uniform_real_distribution<float> center(0, 1);
+    std::uniform_real_distribution<float> offset(-0.01f, 0.01f);
+
+    std::vector<aiVector3D> positions;
+    std::vector<unsigned>   indices;
+
+    positions.reserve(triangle_count * 3);
+    indices.reserve(triangle_count * 3);
+
+    for (size_t t = 0; t < triangle_count; t++) {
+        aiVector3D c(center(rng), center(rng), center(rng));
+
+        for (int v = 0; v < 3; v++) {
+            indices.push_back(positions.size());
+            positions.push_back(
+                c + aiVector3D(offset(rng), offset(rng), offset(rng)));
+        }
+    }
+
+    auto mesh = make_mesh(positions, indices, 0);
+
+    add_planar_uvs(*mesh);
+
+    mesh->mColors[0] = new aiColor4D[mesh->mNumVertices];
+    for (unsigned i = 0; i < mesh->mNumVertices; i++) {
+        auto const& p       = mesh->mVertices[i];
+        mesh->mColors[0][i] = aiColor4D(p.x, p.y, p.z, 1);
+    }
+
+    auto root = make_node("soup", aiMatrix4x4());
+    set_meshes(*root, { 0 });
+
+    return new_scene({ mesh }, { make_material(aiColor4D(1, 1, 1, 1)) }, root);
+}
+
+std::unique_ptr<aiScene> make_deep_hierarchy(size_t depth) {
+    auto root = make_node("chain_0", aiMatrix4x4());
+    set_meshes(*root, { 0 });
+
+    auto parent = root;
+
+    aiMatrix4x4 twist;
+    aiMatrix4x4::RotationY(0.05f, twist);
+
+    auto const step = translation(1.1f, 0, 0) * twist;
+
+    for (size_t i = 1; i < depth; i++) {
+        auto node = make_node(QString("chain_%1").arg(i), step);
+        set_meshes(*node, { 0 });
+        set_children(*parent, { node });
+        parent = node;
+    }
+
+    return new_scene({ make_box(0) },
+                     { make_material(aiColor4D(0.8f, 0.2f, 0.2f, 1)) },
+                     root);
+}
+
+std::unique_ptr<aiScene> make_instanced_scene(size_t instance_count) {
+    constexpr unsigned mesh_count = 4;
+
+    std::vector<aiMesh*>     meshes;
+    std::vector<aiMaterial*> materials;
+
+    for (unsigned i = 0; i < mesh_count; i++) {
+        meshes.push_back(make_box(i));
+        materials.push_back(
+            make_material(aiColor4D(i / float(mesh_count), 0.5f, 0.5f, 1)));
+    }
+
+    auto root = make_node("instances", aiMatrix4x4());
+
+    auto side = (size_t)std::ceil(std::cbrt((double)instance_count));
+
+    std::vector<aiNode*> children;
+    children.reserve(instance_count);
+
+    for (size_t i = 0; i < instance_count; i++) {
+        auto x = i % side;
+        auto y = (i / side) % side;
+        auto z = i / (side * side);
+
+        auto node = make_node(QString("instance_%1").arg(i),
+                              translation(x * 2.0f, y * 2.0f, z * 2.0f));
+        set_meshes(*node, { unsigned(i % mesh_count) });
+        children.push_back(node);
+    }
+
+    set_children(*root, children);
+
+    return new_scene(meshes, materials, root);
+}
+
+std::unique_ptr<aiScene> make_texture_scene(size_t texture_count,
+                                            int    texture_size) {
+    std::mt19937 rng(synthetic_seed);
+
+    std::vector<aiMesh*>     meshes;
+    std::vector<aiMaterial*> materials;
+    std::vector<aiTexture*>  textures;
+    std::vector<aiNode*>     children;
+
+    for (size_t i = 0; i < texture_count; i++) {
+        auto png = noise_png(texture_size, rng);
+
+        auto tex     = new aiTexture;
+        tex->mWidth  = png.size();
+        tex->mHeight = 0;
+        tex->pcData  = new aiTexel[(png.size() + sizeof(aiTexel) - 1) /
+                                  sizeof(aiTexel)];
+        std::memcpy(tex->pcData, png.constData(), png.size());
+        std::strcpy(tex->achFormatHint, "png");
+        textures.push_back(tex);
+
+        auto mat  = make_material(aiColor4D(1, 1, 1, 1));
+        auto path = aiString(QString("*%1").arg(i).toStdString());
+        mat->AddProperty(&path, AI_MATKEY_TEXTURE_DIFFUSE(0));
+        materials.push_back(mat);
+
+        auto mesh = make_mesh(
+            { { 0, 0, 0 }, { 1, 0, 0 }, { 0, 1, 0 }, { 1, 1, 0 } },
+            { 0, 1, 2, 2, 1, 3 },
+            i);
+        add_planar_uvs(*mesh);
+        meshes.push_back(mesh);
+
+        auto node = make_node(QString("quad_%1").arg(i),
+                              translation(i * 1.1f, 0, 0));
+        set_meshes(*node, { unsigned(i) });
+        children.push_back(node);
+    }
+
+    auto root = make_node("textures", aiMatrix4x4());
+    set_children(*root, children);
+
+    auto scene          = new_scene(meshes, materials, root);
+    scene->mNumTextures = textures.size();
+    scene->mTextures    = copy_array(textures);
+
+    return scene;
+}
+
+std::optional<QString> write_scene(aiScene const& scene, QString path) {
+    Assimp::Exporter exporter;
+
+    auto ret = exporter.Export(&scene, "glb2", path.toStdString());
+
+    if (ret != aiReturn_SUCCESS) {
+        return QString("Unable to export %1: %2")
+            .arg(path)
+            .arg(exporter.GetErrorString());
+    }
+
+    return std::nullopt;
+}
+
+namespace {
+
+template <class T>
+void write_values(QFile& file, std::vector<double> const& values) {
+    std::vector<T> converted(values.begin(), values.end());
+    file.write(reinterpret_cast<char const*>(converted.data()),
+               converted.size() * sizeof(T));
+}
+
+void write_typed(QString                    path,
+                 MappedFile::PType          type,
+                 std::vector<double> const& values) {
+    QFile file(path);
+    file.open(QFile::WriteOnly | QFile::Truncate);
+
+    switch (type) {
+    case MappedFile::Float32: write_values<float>(file, values); break;
+    case MappedFile::Float64: write_values<double>(file, values); break;
+    case MappedFile::Int32: write_values<int32_t>(file, values); break;
+    case MappedFile::Int64: write_values<int64_t>(file, values); break;
+    }
+}
+
+std::pair<QString, int> xdmf_type_name(MappedFile::PType type) {
+    switch (type) {
+    case MappedFile::Float32: return { "Float", 4 };
+    case MappedFile::Float64: return { "Float", 8 };
+    case MappedFile::Int32: return { "Int", 4 };
+    case MappedFile::Int64: return { "Int", 8 };
+    }
+    return { "Float", 4 };
+}
+
+void write_data_item(QXmlStreamWriter& xml,
+                     QString           name,
+                     MappedFile::PType type,
+                     size_t            count,
+                     QString           file_name) {
+    auto [type_name, precision] = xdmf_type_name(type);
+
+    xml.writeStartElement("DataItem");
+    xml.writeAttribute("Name", name);
+    xml.writeAttribute("Format", "Binary");
+    xml.writeAttribute("DataType", type_name);
+    xml.writeAttribute("Precision", QString::number(precision));
+    xml.writeAttribute("Dimensions", QString::number(count));
+    xml.writeAttribute("Seek", "0");
+    xml.writeCharacters(file_name);
+    xml.writeEndElement();
+}
+
+/// A square heightfield of about `triangle_count` triangles, as flat xyz
+/// coordinates and triangle corners
+struct Heightfield {
+    std::vector<double> coords;
+    std::vector<double> conn;
+};
+
+Heightfield make_heightfield(size_t triangle_count) {
+    // a side x side heightfield has 2 (side - 1)^2 triangles
+    auto side = std::max<size_t>(
+        2, (size_t)std::ceil(std::sqrt(triangle_count / 2.0)) + 1);
+
+    Heightfield ret;
+    ret.coords.reserve(side * side * 3);
+    ret.conn.reserve(6 * (side - 1) * (side - 1));
+
+    for (size_t y = 0; y < side; y++) {
+        for (size_t x = 0; x < side; x++) {
+            ret.coords.push_back(x / double(side));
+            ret.coords.push_back(y / double(side));
+            ret.coords.push_back(0.05 * std::sin(x * 0.1) * std::cos(y * 0.1));
+        }
+    }
+
+    for (size_t y = 0; y + 1 < side; y++) {
+        for (size_t x = 0; x + 1 < side; x++) {
+            auto a = y * side + x;
+            auto b = a + 1;
+            auto c = a + side;
+            auto d = c + 1;
+            ret.conn.insert(ret.conn.end(),
+                            { double(a), double(b), double(c) });
+            ret.conn.insert(ret.conn.end(),
+                            { double(b), double(d), double(c) });
+        }
+    }
+
+    return ret;
+}
+
+} // namespace
+
+XDMFWriteResult write_xdmf(QString           directory,
+                           QString           name,
+                           size_t            triangle_count,
+                           MappedFile::PType coord_type,
+                           MappedFile::PType conn_type) {
+    QDir dir(directory);
+
+    auto [coords, conn] = make_heightfield(triangle_count);
+
+    XDMFWriteResult ret;
+    ret.vertex_count   = coords.size() / 3;
+    ret.triangle_count = conn.size() / 3;
+
+    auto coord_name = name + "_coord.bin";
+    auto conn_name  = name + "_conn.bin";
+
+    ret.coord_path = dir.filePath(coord_name);
+    ret.conn_path  = dir.filePath(conn_name);
+    ret.xmf_path   = dir.filePath(name + ".xmf");
+
+    write_typed(ret.coord_path, coord_type, coords);
+    write_typed(ret.conn_path, conn_type, conn);
+
+    QFile file(ret.xmf_path);
+    file.open(QFile::WriteOnly | QFile::Truncate);
+
+    QXmlStreamWriter xml(&file);
+    xml.setAutoFormatting(true);
+    xml.writeStartDocument();
+    xml.writeStartElement("Xdmf");
+    xml.writeAttribute("Version", "2.0");
+    xml.writeStartElement("Domain");
+    xml.writeStartElement("Grid");
+    xml.writeAttribute("Name", name);
+    xml.writeAttribute("GridType", "Uniform");
+
+    xml.writeEmptyElement("Time");
+    xml.writeAttribute("Value", "0");
+
+    xml.writeStartElement("Topology");
+    xml.writeAttribute("TopologyType", "Triangle");
+    xml.writeAttribute("NumberOfElements",
+                       QString::number(ret.triangle_count));
+    write_data_item(xml, "Conn", conn_type, conn.size(), conn_name);
+    xml.writeEndElement();
+
+    xml.writeStartElement("Geometry");
+    xml.writeAttribute("GeometryType", "XYZ");
+    write_data_item(xml, "Coord", coord_type, coords.size(), coord_name);
+    xml.writeEndElement();
+
+    xml.writeEndElement(); // Grid
+    xml.writeEndElement(); // Domain
+    xml.writeEndElement(); // Xdmf
+    xml.writeEndDocument();
+
+    return ret;
+}
+
+XDMFWriteResult write_partitioned_xdmf(QString directory,
+                                       QString name,
+                                       size_t  triangle_count,
+                                       size_t  partitions) {
+    QDir dir(directory);
+
+    auto side = std::max<size_t>(
+        2, (size_t)std::ceil(std::sqrt(triangle_count / 2.0)) + 1);
+
+    partitions = std::clamp<size_t>(partitions, 1, side - 1);
+
+    XDMFWriteResult ret;
+    ret.vertex_count   = side * side;
+    ret.triangle_count = 2 * (side - 1) * (side - 1);
+    ret.xmf_path       = dir.filePath(name + ".xmf");
+
+    QFile file(ret.xmf_path);
+    file.open(QFile::WriteOnly | QFile::Truncate);
+
+    QXmlStreamWriter xml(&file);
+    xml.setAutoFormatting(true);
+    xml.writeStartDocument();
+    xml.writeStartElement("Xdmf");
+    xml.writeAttribute("Version", "2.0");
+    xml.writeStartElement("Domain");
+    xml.writeStartElement("Grid");
+    xml.writeAttribute("Name", name);
+    xml.writeAttribute("GridType", "Collection");
+    xml.writeAttribute("CollectionType", "Spatial");
+
+    xml.writeEmptyElement("Time");
+    xml.writeAttribute("Value", "0");
+
+    for (size_t p = 0; p < partitions; p++) {
+        // strips of rows; neighbours share their boundary row
+        auto first = (side - 1) * p / partitions;
+        auto last  = (side - 1) * (p + 1) / partitions;
+        auto rows  = last - first + 1;
+
+        std::vector<double> coords;
+        coords.reserve(rows * side * 3);
+
+        for (size_t y = first; y <= last; y++) {
+            for (size_t x = 0; x < side; x++) {
+                coords.push_back(x / double(side));
+                coords.push_back(y / double(side));
+                coords.push_back(0.05 * std::sin(x * 0.1) *
+                                 std::cos(y * 0.1));
+            }
+        }
+
+        std::vector<double> conn;
+        conn.reserve((rows - 1) * (side - 1) * 6);
+
+        for (size_t y = 0; y + 1 < rows; y++) {
+            for (size_t x = 0; x + 1 < side; x++) {
+                auto a = y * side + x;
+                auto b = a + 1;
+                auto c = a + side;
+                auto d = c + 1;
+                conn.insert(conn.end(), { double(a), double(b), double(c) });
+                conn.insert(conn.end(), { double(b), double(d), double(c) });
+            }
+        }
+
+        auto part_name  = QString("%1_p%2").arg(name).arg(p);
+        auto coord_name = part_name + "_coord.bin";
+        auto conn_name  = part_name + "_conn.bin";
+
+        write_typed(dir.filePath(coord_name), MappedFile::Float32, coords);
+        write_typed(dir.filePath(conn_name), MappedFile::Int32, conn);
+
+        xml.writeStartElement("Grid");
+        xml.writeAttribute("Name", part_name);
+        xml.writeAttribute("GridType", "Uniform");
+
+        xml.writeStartElement("Topology");
+        xml.writeAttribute("TopologyType", "Triangle");
+        xml.writeAttribute("NumberOfElements",
+                           QString::number(conn.size() / 3));
+        write_data_item(
+            xml, "Conn", MappedFile::Int32, conn.size(), conn_name);
+        xml.writeEndElement();
+
+        xml.writeStartElement("Geometry");
+        xml.writeAttribute("GeometryType", "XYZ");
+        write_data_item(
+            xml, "Coord", MappedFile::Float32, coords.size(), coord_name);
+        xml.writeEndElement();
+
+        xml.writeEndElement(); // Grid
+    }
+
+    xml.writeEndElement(); // Grid
+    xml.writeEndElement(); // Domain
+    xml.writeEndElement(); // Xdmf
+    xml.writeEndDocument();
+
+    return ret;
+}
+
+namespace {
+
+/// A grid of `nodes` cubed nodes over the unit cube, with a scalar field from
+/// `field_file` if given
+QString write_corect_xdmf(QString directory,
+                          QString name,
+                          size_t  nodes,
+                          QString field_file) {
+    auto path = QDir(directory).filePath(name + ".xmf");
+
+    QFile file(path);
+    file.open(QFile::WriteOnly | QFile::Truncate);
+
+    auto dims = QString("%1 %1 %1").arg(nodes);
+
+    QXmlStreamWriter xml(&file);
+    xml.setAutoFormatting(true);
+    xml.writeStartDocument();
+    xml.writeStartElement("Xdmf");
+    xml.writeAttribute("Version", "2.0");
+    xml.writeStartElement("Domain");
+    xml.writeStartElement("Grid");
+    xml.writeAttribute("Name", name);
+    xml.writeAttribute("GridType", "Uniform");
+
+    xml.writeEmptyElement("Topology");
+    xml.writeAttribute("TopologyType", "3DCoRectMesh");
+    xml.writeAttribute("Dimensions", dims);
+
+    xml.writeStartElement("Geometry");
+    xml.writeAttribute("GeometryType", "ORIGIN_DXDYDZ");
+
+    auto spacing = QString::number(1.0 / nodes);
+
+    for (auto values : { QString("0 0 0"),
+                         QString("%1 %1 %1").arg(spacing) }) {
+        xml.writeStartElement("DataItem");
+        xml.writeAttribute("Format", "XML");
+        xml.writeAttribute("Dimensions", "3");
+        xml.writeCharacters(values);
+        xml.writeEndElement();
+    }
+
+    xml.writeEndElement(); // Geometry
+
+    if (!field_file.isEmpty()) {
+        xml.writeStartElement("Attribute");
+        xml.writeAttribute("Name", "density");
+        xml.writeAttribute("AttributeType", "Scalar");
+        xml.writeAttribute("Center", "Node");
+
+        xml.writeStartElement("DataItem");
+        xml.writeAttribute("Format", "Binary");
+        xml.writeAttribute("DataType", "Float");
+        xml.writeAttribute("Precision", "4");
+        xml.writeAttribute("Dimensions", dims);
+        xml.writeCharacters(field_file);
+        xml.writeEndElement();
+
+        xml.writeEndElement(); // Attribute
+    }
+
+    xml.writeEndElement(); // Grid
+    xml.writeEndElement(); // Domain
+    xml.writeEndElement(); // Xdmf
+    xml.writeEndDocument();
+
+    return path;
+}
+
+} // namespace
+
+QString write_structured_xdmf(QString directory, QString name, size_t nodes) {
+    return write_corect_xdmf(directory, name, nodes, {});
+}
+
+QString write_volume_xdmf(QString directory, QString name, size_t nodes) {
+    auto field_file = name + "_density.bin";
+
+    QFile file(QDir(directory).filePath(field_file));
+    file.open(QFile::WriteOnly | QFile::Truncate);
+
+    // a few overlapping blobs, so the surface has some shape to it
+    std::array<glm::vec3, 4> const centers = {
+        glm::vec3(0.3f, 0.3f, 0.3f),
+        glm::vec3(0.7f, 0.4f, 0.5f),
+        glm::vec3(0.4f, 0.7f, 0.6f),
+        glm::vec3(0.6f, 0.6f, 0.3f),
+    };
+
+    std::vector<float> slice(nodes * nodes);
+
+    for (size_t k = 0; k < nodes; k++) {
+        for (size_t j = 0; j < nodes; j++) {
+            for (size_t i = 0; i < nodes; i++) {
+                auto p = glm::vec3(i, j, k) / float(nodes);
+
+                float density = 0;
+                for (auto const& c : centers) {
+                    auto d = p - c;
+                    density += 0.02f / (glm::dot(d, d) + 0.001f);
+                }
+
+                slice[j * nodes + i] = density;
+            }
+        }
+
+        file.write(reinterpret_cast<char const*>(slice.data()),
+                   slice.size() * sizeof(float));
+    }
+
+    return write_corect_xdmf(directory, name, nodes, field_file);
+}
+
+QString write_bulk(QString    directory,
+                   QString    name,
+                   size_t     triangle_count,
+                   BulkFormat format) {
+    auto [coords, conn] = make_heightfield(triangle_count);
+
+    size_t const vertices  = coords.size() / 3;
+    size_t const triangles = conn.size() / 3;
+
+    auto corner = [&](size_t t, size_t k) {
+        auto i = size_t(conn[t * 3 + k]) * 3;
+        return aiVector3D(coords[i], coords[i + 1], coords[i + 2]);
+    };
+
+    auto facet_normal = [&](size_t t) {
+        auto a = corner(t, 0);
+        return ((corner(t, 1) - a) ^ (corner(t, 2) - a)).Normalize();
+    };
+
+    static char const* const suffixes[] = {
+        ".stl", ".stl", ".obj", ".ply", ".ply",
+    };
+
+    auto path = QDir(directory).filePath(name + suffixes[int(format)]);
+
+    QFile file(path);
+    file.open(QFile::WriteOnly | QFile::Truncate);
+
+    auto write_raw = [&file](auto const& value) {
+        file.write(reinterpret_cast<char const*>(&value), sizeof(value));
+    };
+
+    if (format == BulkFormat::BinarySTL) {
+        file.write(QByteArray(80, ' '));
+        write_raw(uint32_t(triangles));
+
+        for (size_t t = 0; t < triangles; t++) {
+            write_raw(facet_normal(t));
+            for (size_t k = 0; k < 3; k++) {
+                write_raw(corner(t, k));
+            }
+            write_raw(uint16_t(0));
+        }
+
+        return path;
+    }
+
+    if (format == BulkFormat::BinaryPLY) {
+        file.write(QString("ply\n"
+                           "format binary_little_endian 1.0\n"
+                           "element vertex %1\n"
+                           "property float x\n"
+                           "property float y\n"
+                           "property float z\n"
+                           "element face %2\n"
+                           "property list uchar uint vertex_indices\n"
+                           "end_header\n")
+                       .arg(vertices)
+                       .arg(triangles)
+                       .toUtf8());
+
+        std::vector<float> positions(coords.begin(), coords.end());
+        file.write(reinterpret_cast<char const*>(positions.data()),
+                   positions.size() * sizeof(float));
+
+        for (size_t t = 0; t < triangles; t++) {
+            write_raw(uint8_t(3));
+            for (size_t k = 0; k < 3; k++) {
+                write_raw(uint32_t(conn[t * 3 + k]));
+            }
+        }
+
+        return path;
+    }
+
+    QTextStream out(&file);
+
+    switch (format) {
+    case BulkFormat::AsciiSTL:
+        out << "solid " << name << "\n";
+
+        for (size_t t = 0; t < triangles; t++) {
+            auto n = facet_normal(t);
+
+            out << "facet normal " << n.x << " " << n.y << " " << n.z
+                << "\n outer loop\n";
+
+            for (size_t k = 0; k < 3; k++) {
+                auto v = corner(t, k);
+                out << "  vertex " << v.x << " " << v.y << " " << v.z << "\n";
+            }
+
+            out << " endloop\nendfacet\n";
+        }
+
+        out << "endsolid " << name << "\n";
+        break;
+    case BulkFormat::OBJ:
+        out << "o " << name << "\n";
+
+        for (size_t i = 0; i < vertices; i++) {
+            out << "v " << coords[i * 3] << " " << coords[i * 3 + 1] << " "
+                << coords[i * 3 + 2] << "\n";
+        }
+
+        for (size_t t = 0; t < triangles; t++) {
+            out << "f " << size_t(conn[t * 3]) + 1 << " "
+                << size_t(conn[t * 3 + 1]) + 1 << " "
+                << size_t(conn[t * 3 + 2]) + 1 << "\n";
+        }
+        break;
+    case BulkFormat::AsciiPLY:
+        out << "ply\nformat ascii 1.0\n"
+            << "element vertex " << vertices << "\n"
+            << "property float x\nproperty float y\nproperty float z\n"
+            << "element face " << triangles << "\n"
+            << "property list uchar uint vertex_indices\nend_header\n";
+
+        for (size_t i = 0; i < vertices; i++) {
+            out << coords[i * 3] << " " << coords[i * 3 + 1] << " "
+                << coords[i * 3 + 2] << "\n";
+        }
+
+        for (size_t t = 0; t < triangles; t++) {
+            out << "3 " << size_t(conn[t * 3]) << " "
+                << size_t(conn[t * 3 + 1]) << " " << size_t(conn[t * 3 + 2])
+                << "\n";
+        }
+        break;
+    default: break;
+    }
+
+    return path;
+}
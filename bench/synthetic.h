@@ -0,0 +1,79 @@
+#pragma once
+
+#include "xdmfimporter.h"
+
+#include <QString>
+
+#include <memory>
+
+struct aiScene;
+
+// Synthetic asset generation for the benchmark suite. Everything is generated
+// from a fixed seed so runs on different machines see identical inputs.
+
+/// Independent triangles scattered through a unit cube, with UVs and colors.
+std::unique_ptr<aiScene> make_triangle_soup(size_t triangle_count);
+
+/// A single chain of nodes `depth` deep, each holding a small box.
+std::unique_ptr<aiScene> make_deep_hierarchy(size_t depth);
+
+/// A flat grid of `instance_count` nodes that all reference a handful of
+/// shared meshes.
+std::unique_ptr<aiScene> make_instanced_scene(size_t instance_count);
+
+/// `texture_count` quads, each with its own material and embedded PNG
+/// texture of `texture_size` squared pixels.
+std::unique_ptr<aiScene> make_texture_scene(size_t texture_count,
+                                            int    texture_size);
+
+/// Export a scene as binary glTF so it can be loaded through `make_thing`.
+/// Returns an error message on failure.
+std::optional<QString> write_scene(aiScene const&, QString path);
+
+struct XDMFWriteResult {
+    QString xmf_path;
+    QString coord_path;
+    QString conn_path;
+    size_t  vertex_count   = 0;
+    size_t  triangle_count = 0;
+};
+
+/// Write a raw binary XDMF heightfield with roughly `triangle_count`
+/// triangles. Coordinates are stored as `coord_type` (Float32/Float64) and
+/// connectivity as `conn_type` (Int32/Int64).
+XDMFWriteResult write_xdmf(QString           directory,
+                           QString           name,
+                           size_t            triangle_count,
+                           MappedFile::PType coord_type,
+                           MappedFile::PType conn_type);
+
+/// Write the same heightfield as a spatial collection of `partitions`
+/// strips, as a domain decomposed solver would. Neighbouring strips repeat
+/// the row of nodes they share. Only `xmf_path` and the counts are set.
+XDMFWriteResult write_partitioned_xdmf(QString directory,
+                                       QString name,
+                                       size_t  triangle_count,
+                                       size_t  partitions);
+
+/// Write a structured XDMF grid of `nodes` cubed nodes, with the geometry
+/// implied by an origin and spacing. Returns the path of the .xmf file.
+QString write_structured_xdmf(QString directory, QString name, size_t nodes);
+
+/// The same grid with a node centered scalar field of a few blobs, stored as
+/// binary float32. Returns the path of the .xmf file.
+QString write_volume_xdmf(QString directory, QString name, size_t nodes);
+
+enum class BulkFormat {
+    AsciiSTL,
+    BinarySTL,
+    OBJ,
+    AsciiPLY,
+    BinaryPLY,
+};
+
+/// Write the XDMF heightfield, about `triangle_count` triangles, as an STL,
+/// OBJ or PLY file. Returns the path written.
+QString write_bulk(QString    directory,
+                   QString    name,
+                   size_t     triangle_count,
+                   BulkFormat format);
@@ -0,0 +1,401 @@
+#include "loadclient.h"
+
+#include <QCborValue>
+#include <QDebug>
+#include <QJsonArray>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Probe positions are offset so they can't be confused with real content
+constexpr double probe_offset = 100000.0;
+
+QJsonObject latency_summary(std::vector<double> v) {
+    if (v.empty()) return {};
+
+    std::sort(v.begin(), v.end());
+
+    auto at = [&](double p) {
+        return v[std::min(v.size() - 1, size_t(p * v.size()))];
+    };
+
+    return {
+        { "count", (qint64)v.size() },
+        { "min_ms", v.front() },
+        { "p50_ms", at(0.5) },
+        { "p95_ms", at(0.95) },
+        { "max_ms", v.back() },
+    };
+}
+
+void collect_keys(QCborValue const& v, std::vector<ComponentKey>& out) {
+    // ids are encoded as a two element array of integers; anything else is
+    // searched recursively
+    if (auto key = component_key(v)) {
+        out.push_back(*key);
+        return;
+    }
+
+    if (v.isArray()) {
+        for (auto const& c : v.toArray()) {
+            collect_keys(c, out);
+        }
+    } else if (v.isMap()) {
+        auto map = v.toMap();
+        for (auto iter = map.constBegin(); iter != map.constEnd(); ++iter) {
+            collect_keys(iter.value(), out);
+        }
+    }
+}
+
+} // namespace
+
+QString message_name(int id) {
+    static QStringList const names = {
+        "MethodCreate",     "MethodDelete",     "SignalCreate",
+        "SignalDelete",     "EntityCreate",     "EntityUpdate",
+        "EntityDelete",     "PlotCreate",       "PlotUpdate",
+        "PlotDelete",       "BufferCreate",     "BufferDelete",
+        "BufferViewCreate", "BufferViewDelete", "MaterialCreate",
+        "MaterialUpdate",   "MaterialDelete",   "ImageCreate",
+        "ImageDelete",      "TextureCreate",    "TextureDelete",
+        "SamplerCreate",    "SamplerDelete",    "LightCreate",
+        "LightUpdate",      "LightDelete",      "GeometryCreate",
+        "GeometryDelete",   "TableCreate",      "TableUpdate",
+        "TableDelete",      "DocumentUpdate",   "DocumentReset",
+        "SignalInvoke",     "MethodReply",      "DocumentInitialized",
+    };
+
+    if (id < 0 or id >= names.size()) return QString("Unknown%1").arg(id);
+
+    return names[id];
+}
+
+std::optional<ComponentKey> component_key(QCborValue const& v) {
+    if (!v.isArray()) return std::nullopt;
+
+    auto arr = v.toArray();
+
+    if (arr.size() != 2 or !arr[0].isInteger() or !arr[1].isInteger()) {
+        return std::nullopt;
+    }
+
+    return (ComponentKey(arr[0].toInteger()) << 32) |
+           ComponentKey(arr[1].toInteger() & 0xFFFFFFFF);
+}
+
+// =============================================================================
+
+LoadClient::LoadClient(LoadController& c, int index, QUrl url)
+    : m_controller(c), m_index(index), m_url(url) {
+
+    connect(&m_socket, &QWebSocket::connected, this, &LoadClient::on_connected);
+
+    connect(&m_socket,
+            &QWebSocket::binaryMessageReceived,
+            this,
+            &LoadClient::on_frame);
+
+    connect(&m_socket, &QWebSocket::disconnected, this, [this]() {
+        emit disconnected(m_index);
+    });
+}
+
+double LoadClient::now_ms() const { return m_controller.elapsed_ms(); }
+
+void LoadClient::start() { m_socket.open(m_url); }
+
+void LoadClient::stop() { m_socket.close(); }
+
+void LoadClient::on_connected() {
+    m_connect_ms = now_ms();
+
+    QCborArray intro;
+    intro << 0
+          << QCborMap {
+                 { QStringLiteral("client_name"),
+                   QString("LoadTest %1").arg(m_index) },
+             };
+
+    m_socket.sendBinaryMessage(QCborValue(intro).toCbor());
+}
+
+void LoadClient::on_frame(QByteArray const& frame) {
+    m_frames++;
+    m_frame_bytes += frame.size();
+
+    auto array = QCborValue::fromCbor(frame).toArray();
+
+    for (qsizetype i = 0; i + 1 < array.size(); i += 2) {
+        auto id      = (int)array[i].toInteger(-1);
+        auto content = array[i + 1];
+
+        // the frame is not split per message, so re-encode to get a size
+        auto bytes = content.toCbor().size();
+
+        on_message(id, content.toMap(), bytes);
+    }
+}
+
+void LoadClient::on_message(int id, QCborMap const& content, qint64 bytes) {
+    m_message_counts[id]++;
+    m_message_bytes[id] += bytes;
+
+    auto key = component_key(content[QStringLiteral("id")]);
+
+    switch (ServerMessage(id)) {
+    case ServerMessage::MethodCreate:
+        if (key) {
+            m_method_names[*key] = content[QStringLiteral("name")].toString();
+        }
+        break;
+    case ServerMessage::EntityCreate:
+    case ServerMessage::EntityUpdate: {
+        if (!key) break;
+
+        auto& ent = m_entities[*key];
+
+        if (content.contains(QStringLiteral("name"))) {
+            ent.name = content[QStringLiteral("name")].toString();
+        }
+
+        if (content.contains(QStringLiteral("parent"))) {
+            ent.parent = component_key(content[QStringLiteral("parent")]);
+        }
+
+        if (content.contains(QStringLiteral("render_rep"))) {
+            auto rep = content[QStringLiteral("render_rep")].toMap();
+            ent.geometry = component_key(rep[QStringLiteral("mesh")]);
+        }
+
+        if (content.contains(QStringLiteral("methods_list"))) {
+            ent.methods.clear();
+            collect_keys(content[QStringLiteral("methods_list")], ent.methods);
+        }
+
+        if (content.contains(QStringLiteral("transform"))) {
+            auto tf = content[QStringLiteral("transform")].toArray();
+            // column major, translation lives in 12..14
+            if (tf.size() == 16) {
+                auto probe = m_controller.probe_latency(tf[12].toDouble());
+                if (probe and !m_seen_probes.contains(probe->first)) {
+                    m_seen_probes.insert(probe->first);
+                    m_transform_latency_ms.push_back(probe->second);
+                }
+            }
+        }
+
+        break;
+    }
+    case ServerMessage::EntityDelete:
+        if (key) m_entities.remove(*key);
+        break;
+    case ServerMessage::GeometryCreate:
+        if (m_first_mesh_ms < 0) m_first_mesh_ms = now_ms();
+        m_last_mesh_ms = now_ms();
+        [[fallthrough]];
+    case ServerMessage::BufferCreate:
+    case ServerMessage::BufferViewCreate:
+    case ServerMessage::MaterialCreate:
+    case ServerMessage::ImageCreate:
+    case ServerMessage::TextureCreate:
+    case ServerMessage::SamplerCreate: {
+        if (!key) break;
+
+        auto& res = m_resources[*key];
+        res.bytes = bytes;
+        res.references.clear();
+
+        for (auto iter = content.constBegin(); iter != content.constEnd();
+             ++iter) {
+            if (iter.key().toString() == QStringLiteral("id")) continue;
+            collect_keys(iter.value(), res.references);
+        }
+        break;
+    }
+    case ServerMessage::BufferDelete:
+    case ServerMessage::BufferViewDelete:
+    case ServerMessage::MaterialDelete:
+    case ServerMessage::ImageDelete:
+    case ServerMessage::TextureDelete:
+    case ServerMessage::SamplerDelete:
+    case ServerMessage::GeometryDelete:
+        if (key) m_resources.remove(*key);
+        break;
+    case ServerMessage::DocumentInitialized:
+        if (m_initialized_ms < 0) {
+            m_initialized_ms = now_ms();
+            emit initialized(m_index);
+        }
+        break;
+    default: break;
+    }
+}
+
+std::optional<ComponentKey>
+LoadClient::find_method(QString name) const {
+    for (auto iter = m_method_names.begin(); iter != m_method_names.end();
+         ++iter) {
+        if (iter.value() == name) return iter.key();
+    }
+    return std::nullopt;
+}
+
+std::optional<ComponentKey>
+LoadClient::find_entity_with_method(QString name) const {
+    auto method = find_method(name);
+
+    if (!method) return std::nullopt;
+
+    for (auto iter = m_entities.begin(); iter != m_entities.end(); ++iter) {
+        auto const& m = iter.value().methods;
+        if (std::find(m.begin(), m.end(), *method) != m.end()) {
+            return iter.key();
+        }
+    }
+
+    return std::nullopt;
+}
+
+void LoadClient::invoke(ComponentKey method,
+                        ComponentKey entity,
+                        QCborArray   args) {
+    auto encode = [](ComponentKey k) {
+        return QCborArray { qint64(k >> 32), qint64(k & 0xFFFFFFFF) };
+    };
+
+    static qint64 invoke_counter = 0;
+
+    QCborArray message;
+    message << 1
+            << QCborMap {
+                   { QStringLiteral("method"), encode(method) },
+                   { QStringLiteral("context"),
+                     QCborMap { { QStringLiteral("entity"), encode(entity) } } },
+                   { QStringLiteral("invoke_id"),
+                     QString::number(invoke_counter++) },
+                   { QStringLiteral("args"), args },
+               };
+
+    m_socket.sendBinaryMessage(QCborValue(message).toCbor());
+}
+
+QHash<QString, qint64> LoadClient::bytes_per_model() const {
+    QHash<QString, qint64> ret;
+
+    // find the scene root: models are its direct children
+    std::optional<ComponentKey> scene_root;
+
+    for (auto iter = m_entities.begin(); iter != m_entities.end(); ++iter) {
+        if (iter.value().name == QStringLiteral("Scene Root")) {
+            scene_root = iter.key();
+        }
+    }
+
+    auto model_of = [&](ComponentKey k) -> std::optional<ComponentKey> {
+        // walk up the parents; bounded in case of a malformed tree
+        for (int guard = 0; guard < 100000; guard++) {
+            auto iter = m_entities.find(k);
+            if (iter == m_entities.end()) return std::nullopt;
+            if (!iter->parent) return std::nullopt;
+            if (iter->parent == scene_root) return k;
+            k = *iter->parent;
+        }
+        return std::nullopt;
+    };
+
+    // resources shared between models are charged to the first one seen
+    QSet<ComponentKey> charged;
+
+    for (auto iter = m_entities.begin(); iter != m_entities.end(); ++iter) {
+        if (!iter->geometry) continue;
+
+        auto model = model_of(iter.key());
+        if (!model) continue;
+
+        auto model_name = m_entities[*model].name;
+        if (model_name.isEmpty()) {
+            model_name = QString("model %1").arg(*model >> 32);
+        }
+
+        std::vector<ComponentKey> stack = { *iter->geometry };
+
+        while (!stack.empty()) {
+            auto k = stack.back();
+            stack.pop_back();
+
+            if (charged.contains(k)) continue;
+
+            auto res = m_resources.find(k);
+            if (res == m_resources.end()) continue;
+
+            charged.insert(k);
+
+            ret[model_name] += res->bytes;
+
+            stack.insert(
+                stack.end(), res->references.begin(), res->references.end());
+        }
+    }
+
+    return ret;
+}
+
+QJsonObject LoadClient::report() const {
+    QJsonObject messages;
+
+    for (auto iter = m_message_counts.begin(); iter != m_message_counts.end();
+         ++iter) {
+        messages[message_name(iter.key())] = QJsonObject {
+            { "count", iter.value() },
+            { "bytes", m_message_bytes.value(iter.key()) },
+        };
+    }
+
+    QJsonObject models;
+
+    auto per_model = bytes_per_model();
+
+    for (auto iter = per_model.begin(); iter != per_model.end(); ++iter) {
+        models[iter.key()] = iter.value();
+    }
+
+    return {
+        { "client", m_index },
+        { "connect_ms", m_connect_ms },
+        { "initialized_ms", m_initialized_ms },
+        { "first_mesh_ms", m_first_mesh_ms },
+        { "last_mesh_ms", m_last_mesh_ms },
+        { "frames", m_frames },
+        { "frame_bytes", m_frame_bytes },
+        { "messages", messages },
+        { "model_bytes", models },
+        { "transform_latency", latency_summary(m_transform_latency_ms) },
+    };
+}
+
+// =============================================================================
+
+LoadController::LoadController() { m_clock.start(); }
+
+double LoadController::elapsed_ms() const {
+    return m_clock.nsecsElapsed() / 1.0e6;
+}
+
+double LoadController::begin_probe(qint64 nonce) {
+    m_pending_probes[nonce] = elapsed_ms();
+    return probe_offset + nonce;
+}
+
+std::optional<std::pair<qint64, double>>
+LoadController::probe_latency(double x) const {
+    qint64 nonce = std::llround(x - probe_offset);
+
+    auto iter = m_pending_probes.find(nonce);
+
+    if (iter == m_pending_probes.end()) return std::nullopt;
+
+    return std::pair(nonce, elapsed_ms() - iter.value());
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <QCborArray>
+#include <QCborMap>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QJsonObject>
+#include <QObject>
+#include <QSet>
+#include <QUrl>
+#include <QWebSocket>
+
+#include <optional>
+#include <vector>
+
+/// Message ids sent by a NOODLES server
+enum class ServerMessage : int {
+    MethodCreate        = 0,
+    MethodDelete        = 1,
+    SignalCreate        = 2,
+    SignalDelete        = 3,
+    EntityCreate        = 4,
+    EntityUpdate        = 5,
+    EntityDelete        = 6,
+    PlotCreate          = 7,
+    PlotUpdate          = 8,
+    PlotDelete          = 9,
+    BufferCreate        = 10,
+    BufferDelete        = 11,
+    BufferViewCreate    = 12,
+    BufferViewDelete    = 13,
+    MaterialCreate      = 14,
+    MaterialUpdate      = 15,
+    MaterialDelete      = 16,
+    ImageCreate         = 17,
+    ImageDelete         = 18,
+    TextureCreate       = 19,
+    TextureDelete       = 20,
+    SamplerCreate       = 21,
+    SamplerDelete       = 22,
+    LightCreate         = 23,
+    LightUpdate         = 24,
+    LightDelete         = 25,
+    GeometryCreate      = 26,
+    GeometryDelete      = 27,
+    TableCreate         = 28,
+    TableUpdate         = 29,
+    TableDelete         = 30,
+    DocumentUpdate      = 31,
+    DocumentReset       = 32,
+    SignalInvoke        = 33,
+    MethodReply         = 34,
+    DocumentInitialized = 35,
+};
+
+QString message_name(int id);
+
+/// Compact key for a NOODLES [slot, generation] id
+using ComponentKey = quint64;
+
+std::optional<ComponentKey> component_key(QCborValue const&);
+
+class LoadController;
+
+/// A single headless client. Decodes everything the server sends without
+/// rendering, and keeps enough of the document around to attribute bytes to
+/// models.
+class LoadClient : public QObject {
+    Q_OBJECT
+
+    LoadController& m_controller;
+    int             m_index;
+    QUrl            m_url;
+    QWebSocket      m_socket;
+
+    // timestamps are ms since the controller epoch, -1 if not seen
+    double m_connect_ms     = -1;
+    double m_initialized_ms = -1;
+    double m_first_mesh_ms  = -1;
+    double m_last_mesh_ms   = -1;
+
+    qint64 m_frames      = 0;
+    qint64 m_frame_bytes = 0;
+
+    QHash<int, qint64> m_message_counts;
+    QHash<int, qint64> m_message_bytes;
+
+    std::vector<double> m_transform_latency_ms;
+    QSet<qint64>        m_seen_probes;
+
+    // document mirror, only what is needed for byte attribution
+    struct Entity {
+        std::optional<ComponentKey> parent;
+        QString                     name;
+        std::optional<ComponentKey> geometry;
+        std::vector<ComponentKey>   methods;
+    };
+
+    struct Resource {
+        qint64                    bytes = 0;
+        std::vector<ComponentKey> references;
+    };
+
+    QHash<ComponentKey, QString>  m_method_names;
+    QHash<ComponentKey, Entity>   m_entities;
+    QHash<ComponentKey, Resource> m_resources;
+
+    void on_connected();
+    void on_frame(QByteArray const&);
+    void on_message(int id, QCborMap const& content, qint64 bytes);
+
+    double now_ms() const;
+
+public:
+    LoadClient(LoadController&, int index, QUrl url);
+
+    void start();
+    void stop();
+
+    bool is_initialized() const { return m_initialized_ms >= 0; }
+
+    /// Find an entity that accepts the given method, for transform probes
+    std::optional<ComponentKey> find_entity_with_method(QString name) const;
+    std::optional<ComponentKey> find_method(QString name) const;
+
+    void invoke(ComponentKey method, ComponentKey entity, QCborArray args);
+
+    /// Bytes of everything reachable from each top-level model entity
+    QHash<QString, qint64> bytes_per_model() const;
+
+    QJsonObject report() const;
+
+    std::vector<double> const& transform_latencies() const {
+        return m_transform_latency_ms;
+    }
+
+signals:
+    void initialized(int index);
+    void disconnected(int index);
+};
+
+/// Owns the shared clock and the outstanding transform probes so that latency
+/// can be measured across every client.
+class LoadController : public QObject {
+    Q_OBJECT
+
+    QElapsedTimer m_clock;
+
+    // probe x coordinate -> send time in ms
+    QHash<qint64, double> m_pending_probes;
+
+public:
+    LoadController();
+
+    double elapsed_ms() const;
+
+    /// Record a probe that was just sent. Returns the coordinate to send.
+    double begin_probe(qint64 nonce);
+
+    /// Match a received translation against an outstanding probe, giving
+    /// the probe nonce and the time since it was sent
+    std::optional<std::pair<qint64, double>> probe_latency(double x) const;
+};
@@ -0,0 +1,207 @@
+#include "loadclient.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QTextStream>
+#include <QTimer>
+
+#include <algorithm>
+#include <memory>
+
+namespace {
+
+QJsonObject summarize(std::vector<double> v) {
+    v.erase(std::remove_if(v.begin(), v.end(), [](double d) { return d < 0; }),
+            v.end());
+
+    if (v.empty()) return {};
+
+    std::sort(v.begin(), v.end());
+
+    auto at = [&](double p) {
+        return v[std::min(v.size() - 1, size_t(p * v.size()))];
+    };
+
+    return {
+        { "count", (qint64)v.size() },
+        { "min", v.front() },
+        { "p50", at(0.5) },
+        { "p95", at(0.95) },
+        { "max", v.back() },
+    };
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    auto app = QCoreApplication(argc, argv);
+
+    QCoreApplication::setApplicationName("PlaygroundLoadTest");
+    QCoreApplication::setApplicationVersion("0.2");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        "Headless NOODLES clients for load testing a Playground server");
+    parser.addHelpOption();
+    parser.addVersionOption();
+
+    auto url_opt = QCommandLineOption(
+        "url", "Server to connect to", "url", "ws://localhost:50000");
+    auto clients_opt = QCommandLineOption(
+        "clients", "Number of concurrent clients", "n", "1");
+    auto stagger_opt = QCommandLineOption(
+        "stagger", "Delay between client connections", "ms", "0");
+    auto duration_opt = QCommandLineOption(
+        "duration",
+        "How long to probe transform latency once every client has the "
+        "document",
+        "seconds",
+        "5");
+    auto interval_opt = QCommandLineOption(
+        "probe-interval", "Time between transform probes", "ms", "100");
+    auto timeout_opt =
+        QCommandLineOption("timeout",
+                           "Give up waiting for clients after this long",
+                           "seconds",
+                           "300");
+    auto output_opt = QCommandLineOption(
+        "output", "Write the JSON report to this file", "path");
+
+    parser.addOptions({ url_opt,
+                        clients_opt,
+                        stagger_opt,
+                        duration_opt,
+                        interval_opt,
+                        timeout_opt,
+                        output_opt });
+
+    parser.process(app);
+
+    auto url         = QUrl(parser.value(url_opt));
+    auto num_clients = std::max(1, parser.value(clients_opt).toInt());
+    auto stagger     = parser.value(stagger_opt).toInt();
+    auto duration_ms = int(parser.value(duration_opt).toDouble() * 1000);
+    auto interval    = std::max(1, parser.value(interval_opt).toInt());
+    auto timeout_ms  = int(parser.value(timeout_opt).toDouble() * 1000);
+
+    LoadController controller;
+
+    std::vector<std::unique_ptr<LoadClient>> clients;
+
+    int ready_count = 0;
+
+    QTimer probe_timer;
+    probe_timer.setInterval(interval);
+
+    qint64 probe_nonce = 0;
+
+    auto finish = [&]() {
+        probe_timer.stop();
+
+        QJsonArray          per_client;
+        std::vector<double> first_mesh, last_mesh, initialized, latencies;
+        qint64              total_bytes = 0;
+
+        for (auto const& c : clients) {
+            auto r = c->report();
+            per_client << r;
+
+            first_mesh.push_back(r["first_mesh_ms"].toDouble());
+            last_mesh.push_back(r["last_mesh_ms"].toDouble());
+            initialized.push_back(r["initialized_ms"].toDouble());
+            total_bytes += r["frame_bytes"].toInteger();
+
+            auto const& l = c->transform_latencies();
+            latencies.insert(latencies.end(), l.begin(), l.end());
+        }
+
+        QJsonObject report {
+            { "url", url.toString() },
+            { "clients", num_clients },
+            { "ready_clients", ready_count },
+            { "probes_sent", probe_nonce },
+            { "total_bytes", total_bytes },
+            { "first_mesh_ms", summarize(first_mesh) },
+            { "last_mesh_ms", summarize(last_mesh) },
+            { "initialized_ms", summarize(initialized) },
+            { "transform_latency_ms", summarize(latencies) },
+            { "per_client", per_client },
+        };
+
+        auto json = QJsonDocument(report).toJson();
+
+        if (parser.isSet(output_opt)) {
+            QFile out(parser.value(output_opt));
+            if (out.open(QFile::WriteOnly | QFile::Truncate)) {
+                out.write(json);
+            } else {
+                qCritical() << "Unable to write" << out.fileName();
+            }
+        } else {
+            QTextStream(stdout) << json;
+        }
+
+        for (auto& c : clients) {
+            c->stop();
+        }
+
+        QCoreApplication::exit(ready_count == num_clients ? 0 : 1);
+    };
+
+    auto start_probing = [&]() {
+        qInfo() << "All clients have the document, probing transforms";
+
+        auto& probe = *clients.front();
+
+        auto method = probe.find_method("noo::set_position");
+        auto entity = probe.find_entity_with_method("noo::set_position");
+
+        if (method and entity) {
+            QObject::connect(
+                &probe_timer, &QTimer::timeout, [&, method, entity]() {
+                    auto x = controller.begin_probe(probe_nonce++);
+                    clients.front()->invoke(
+                        *method, *entity, QCborArray { QCborArray { x, 0, 0 } });
+                });
+            probe_timer.start();
+        } else {
+            qWarning() << "No entity accepts set_position, skipping latency";
+        }
+
+        QTimer::singleShot(duration_ms, finish);
+    };
+
+    for (int i = 0; i < num_clients; i++) {
+        auto& c = clients.emplace_back(
+            std::make_unique<LoadClient>(controller, i, url));
+
+        QObject::connect(c.get(), &LoadClient::initialized, [&](int index) {
+            qInfo() << "Client" << index << "initialized at"
+                    << controller.elapsed_ms() << "ms";
+            ready_count++;
+            if (ready_count == num_clients) start_probing();
+        });
+
+        QObject::connect(c.get(), &LoadClient::disconnected, [&](int index) {
+            if (ready_count < num_clients) {
+                qWarning() << "Client" << index << "disconnected early";
+            }
+        });
+
+        QTimer::singleShot(i * stagger, c.get(), &LoadClient::start);
+    }
+
+    QTimer::singleShot(timeout_ms, [&]() {
+        if (ready_count < num_clients) {
+            qWarning() << "Timed out with" << ready_count << "of"
+                       << num_clients << "clients ready";
+            finish();
+        }
+    });
+
+    return app.exec();
+}
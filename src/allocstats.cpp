@@ -0,0 +1,72 @@
+#include "allocstats.h"
+
+#ifdef PLAYGROUND_COUNT_ALLOCATIONS
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+// apart, so the two do not fight over one cache line
+alignas(64) std::atomic<uint64_t> allocation_count = 0;
+alignas(64) std::atomic<uint64_t> allocation_bytes = 0;
+
+void* counted_alloc(std::size_t size, std::size_t alignment = 0) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+
+    if (size == 0) size = 1;
+
+    void* p = nullptr;
+
+    if (alignment > alignof(std::max_align_t)) {
+        // aligned_alloc wants a multiple of the alignment
+        p = std::aligned_alloc(alignment,
+                               (size + alignment - 1) / alignment * alignment);
+    } else {
+        p = std::malloc(size);
+    }
+
+    if (!p) throw std::bad_alloc();
+
+    return p;
+}
+
+} // namespace
+
+// The nothrow and array forms forward to these by default. Memory comes from
+// malloc either way, so the default deletes stay correct; they are replaced
+// anyway to keep the pairs together.
+
+void* operator new(std::size_t size) { return counted_alloc(size); }
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    return counted_alloc(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+AllocationStats allocation_stats() {
+    return { allocation_count.load(std::memory_order_relaxed),
+             allocation_bytes.load(std::memory_order_relaxed) };
+}
+
+bool allocations_counted() { return true; }
+
+#else
+
+AllocationStats allocation_stats() { return {}; }
+
+bool allocations_counted() { return false; }
+
+#endif
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+/// Heap allocations made through operator new, process wide. They are only
+/// counted in builds configured with PLAYGROUND_COUNT_ALLOCATIONS, as every
+/// allocation then touches two shared counters; elsewhere both stay zero.
+struct AllocationStats {
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+
+    AllocationStats operator-(AllocationStats const& o) const {
+        return { count - o.count, bytes - o.bytes };
+    }
+};
+
+AllocationStats allocation_stats();
+
+/// Whether this build counts allocations at all
+bool allocations_counted();
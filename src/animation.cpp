@@ -0,0 +1,435 @@
+#include "animation.h"
+
+#include "metrics.h"
+#include "playground.h"
+#include "threadpool.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <QDebug>
+
+#include <assimp/scene.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// clips with more channels than this are sampled on the thread pool
+constexpr uint32_t parallel_channels = 4096;
+
+// nothing compares equal to it, so every channel is sent after a (re)bind
+glm::mat4 const never_sent =
+    glm::mat4(std::numeric_limits<float>::quiet_NaN());
+
+template <class Key, class T, class Convert>
+ModelAnimations::Track append_keys(std::vector<float>& times,
+                                   std::vector<T>&     values,
+                                   Key const*          keys,
+                                   unsigned            count,
+                                   double              ticks_per_second,
+                                   Convert             convert) {
+    ModelAnimations::Track ret {
+        .first = (uint32_t)times.size(),
+        .count = count,
+    };
+
+    for (unsigned i = 0; i < count; i++) {
+        times.push_back(float(keys[i].mTime / ticks_per_second));
+        values.push_back(convert(keys[i].mValue));
+    }
+
+    return ret;
+}
+
+glm::vec3 to_glm(aiVector3D const& v) { return { v.x, v.y, v.z }; }
+
+glm::quat to_glm(aiQuaternion const& q) { return { q.w, q.x, q.y, q.z }; }
+
+/// Value of a track at time `t`. `cursor` is the key used last time; time
+/// only moves back when a clip loops or seeks, so the scan is usually a step
+/// or two.
+template <class T, class Mix>
+T sample_track(ModelAnimations::Track    track,
+               std::vector<float> const& times,
+               std::vector<T> const&     values,
+               uint32_t&                 cursor,
+               float                     t,
+               T                         rest,
+               Mix                       mix) {
+    if (track.count == 0) return rest;
+
+    auto const* k = times.data() + track.first;
+    auto const* v = values.data() + track.first;
+
+    auto const last = track.count - 1;
+
+    if (t <= k[0]) return v[0];
+    if (t >= k[last]) return v[last];
+
+    if (cursor >= last or k[cursor] > t) cursor = 0;
+
+    while (k[cursor + 1] <= t) cursor++;
+
+    float span = k[cursor + 1] - k[cursor];
+    float f    = span > 0 ? (t - k[cursor]) / span : 0;
+
+    return mix(v[cursor], v[cursor + 1], f);
+}
+
+double last_key(ModelAnimations::Track    track,
+                std::vector<float> const& times) {
+    if (!track.count) return 0;
+    return times[track.first + track.count - 1];
+}
+
+double wrap_time(double t, double duration) {
+    if (!(duration > 0)) return 0;
+
+    t = std::fmod(t, duration);
+
+    return t < 0 ? t + duration : t;
+}
+
+} // namespace
+
+int ModelAnimations::find_clip(QString const& name) const {
+    for (size_t i = 0; i < clips.size(); i++) {
+        if (clips[i].name == name) return i;
+    }
+    return -1;
+}
+
+qint64 ModelAnimations::byte_size() const {
+    return clips.size() * sizeof(Clip) + channels.size() * sizeof(Channel) +
+           (position_times.size() + rotation_times.size() +
+            scale_times.size()) *
+               sizeof(float) +
+           positions.size() * sizeof(glm::vec3) +
+           rotations.size() * sizeof(glm::quat) +
+           scales.size() * sizeof(glm::vec3);
+}
+
+std::shared_ptr<ModelAnimations const>
+extract_animations(aiScene const&                       scene,
+                   QHash<aiNode const*, QString> const& node_paths) {
+    if (!scene.mNumAnimations or !scene.mRootNode) return nullptr;
+
+    auto ret = std::make_shared<ModelAnimations>();
+
+    for (unsigned ai = 0; ai < scene.mNumAnimations; ai++) {
+        auto const& anim = *scene.mAnimations[ai];
+
+        // Assimp's own default when the file does not say
+        double tps = anim.mTicksPerSecond > 0 ? anim.mTicksPerSecond : 25;
+
+        ModelAnimations::Clip clip {
+            .name = QString::fromUtf8(anim.mName.C_Str(), anim.mName.length),
+            .duration      = anim.mDuration / tps,
+            .first_channel = (uint32_t)ret->channels.size(),
+        };
+
+        if (clip.name.isEmpty()) clip.name = QString("Clip %1").arg(ai);
+
+        for (unsigned ci = 0; ci < anim.mNumChannels; ci++) {
+            auto const& src  = *anim.mChannels[ci];
+            auto const* node = scene.mRootNode->FindNode(src.mNodeName);
+
+            auto path = node ? node_paths.find(node) : node_paths.end();
+
+            if (path == node_paths.end()) {
+                qDebug() << "Skipping animation channel of"
+                         << src.mNodeName.C_Str();
+                continue;
+            }
+
+            ModelAnimations::Channel channel { .node = *path };
+
+            aiVector3D   scaling, position;
+            aiQuaternion rotation;
+            node->mTransformation.Decompose(scaling, rotation, position);
+
+            channel.rest_position = to_glm(position);
+            channel.rest_rotation = to_glm(rotation);
+            channel.rest_scale    = to_glm(scaling);
+
+            auto vec = [](aiVector3D const& v) { return to_glm(v); };
+            auto rot = [](aiQuaternion const& q) { return to_glm(q); };
+
+            channel.position = append_keys(ret->position_times,
+                                           ret->positions,
+                                           src.mPositionKeys,
+                                           src.mNumPositionKeys,
+                                           tps,
+                                           vec);
+            channel.rotation = append_keys(ret->rotation_times,
+                                           ret->rotations,
+                                           src.mRotationKeys,
+                                           src.mNumRotationKeys,
+                                           tps,
+                                           rot);
+            channel.scale    = append_keys(ret->scale_times,
+                                           ret->scales,
+                                           src.mScalingKeys,
+                                           src.mNumScalingKeys,
+                                           tps,
+                                           vec);
+
+            // some exporters leave the duration short of the last key
+            clip.duration = std::max({
+                clip.duration,
+                last_key(channel.position, ret->position_times),
+                last_key(channel.rotation, ret->rotation_times),
+                last_key(channel.scale, ret->scale_times),
+            });
+
+            ret->channels.push_back(std::move(channel));
+        }
+
+        clip.channel_count = ret->channels.size() - clip.first_channel;
+
+        qInfo() << "Animation" << clip.name << "|" << clip.channel_count
+                << "channels," << clip.duration << "seconds";
+
+        ret->clips.push_back(std::move(clip));
+    }
+
+    return ret;
+}
+
+// =============================================================================
+
+AnimationEngine::AnimationEngine(double rate, QObject* parent)
+    : QObject(parent) {
+    m_timer.setTimerType(Qt::PreciseTimer);
+    m_timer.setInterval(std::max(1, (int)std::lround(1000.0 / rate)));
+
+    connect(&m_timer, &QTimer::timeout, this, &AnimationEngine::tick);
+}
+
+bool AnimationEngine::bind(Playback& pb, Model& model) {
+    pb.source = model.animations;
+
+    if (!pb.source or pb.clip < 0 or
+        pb.clip >= (int)pb.source->clips.size()) {
+        pb.playing = false;
+        pb.targets.clear();
+        return false;
+    }
+
+    auto const& clip = pb.source->clips[pb.clip];
+    auto const  n    = clip.channel_count;
+
+    pb.time = wrap_time(pb.time, clip.duration);
+
+    pb.targets.assign(n, {});
+    pb.cursors.assign(n, {});
+    pb.pose.resize(n);
+    pb.sent.assign(n, never_sent);
+
+    for (uint32_t i = 0; i < n; i++) {
+        auto const& channel = pb.source->channels[clip.first_channel + i];
+
+        auto iter = model.nodes.find(channel.node);
+        if (iter != model.nodes.end()) pb.targets[i] = iter->object;
+    }
+
+    return true;
+}
+
+void AnimationEngine::sample(Playback& pb, ModelAnimations const& anims) {
+    auto const& clip = anims.clips[pb.clip];
+    float const t    = pb.time;
+
+    auto lerp  = [](glm::vec3 a, glm::vec3 b, float f) {
+        return glm::mix(a, b, f);
+    };
+    auto slerp = [](glm::quat a, glm::quat b, float f) {
+        return glm::slerp(a, b, f);
+    };
+
+    auto run = [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; i++) {
+            auto const& ch     = anims.channels[clip.first_channel + i];
+            auto&       cursor = pb.cursors[i];
+
+            auto p = sample_track(ch.position,
+                                  anims.position_times,
+                                  anims.positions,
+                                  cursor[0],
+                                  t,
+                                  ch.rest_position,
+                                  lerp);
+            auto r = sample_track(ch.rotation,
+                                  anims.rotation_times,
+                                  anims.rotations,
+                                  cursor[1],
+                                  t,
+                                  ch.rest_rotation,
+                                  slerp);
+            auto s = sample_track(ch.scale,
+                                  anims.scale_times,
+                                  anims.scales,
+                                  cursor[2],
+                                  t,
+                                  ch.rest_scale,
+                                  lerp);
+
+            auto m     = glm::translate(glm::mat4(1), p) * glm::mat4_cast(r);
+            pb.pose[i] = glm::scale(m, s);
+        }
+    };
+
+    if (clip.channel_count >= parallel_channels) {
+        ThreadPool::global().parallel_chunks(clip.channel_count, run);
+    } else {
+        run(0, clip.channel_count);
+    }
+}
+
+void AnimationEngine::send(Playback& pb) {
+    uint64_t count = 0;
+
+    for (size_t i = 0; i < pb.pose.size(); i++) {
+        if (pb.pose[i] == pb.sent[i]) continue;
+
+        auto target = pb.targets[i].lock();
+        if (!target) continue;
+
+        noo::ObjectUpdateData update;
+        update.transform = pb.pose[i];
+        noo::update_object(target, update);
+
+        pb.sent[i] = pb.pose[i];
+        count++;
+    }
+
+    metrics::transform_updates_sent().add(count);
+}
+
+void AnimationEngine::tick() {
+    ScopedTimer timer(metrics::animation_tick());
+
+    auto now = std::chrono::steady_clock::now();
+    auto dt  = std::chrono::duration<double>(now - m_last_tick).count();
+
+    m_last_tick = now;
+
+    for (auto iter = m_playbacks.begin(); iter != m_playbacks.end();) {
+        auto& pb    = iter->second;
+        auto  model = pb.model.lock();
+
+        if (!model) {
+            iter = m_playbacks.erase(iter);
+            continue;
+        }
+
+        ++iter;
+
+        // an evicted model has no nodes to move; it picks up where it left
+        // off once restored
+        if (!pb.playing or !model->resident) continue;
+
+        if (pb.source != model->animations and !bind(pb, *model)) continue;
+
+        auto const& anims = *pb.source;
+
+        pb.time = wrap_time(pb.time + dt, anims.clips[pb.clip].duration);
+
+        sample(pb, anims);
+        send(pb);
+    }
+
+    update_timer();
+}
+
+void AnimationEngine::update_timer() {
+    bool const want = playing() > 0;
+
+    if (want == m_timer.isActive()) return;
+
+    if (want) {
+        m_last_tick = std::chrono::steady_clock::now();
+        m_timer.start();
+    } else {
+        m_timer.stop();
+    }
+}
+
+bool AnimationEngine::play(std::shared_ptr<Model> const& model, int clip) {
+    if (!model or !model->animations) return false;
+
+    if (clip < 0 or clip >= (int)model->animations->clips.size()) {
+        return false;
+    }
+
+    auto& pb = m_playbacks[model->id];
+
+    if (pb.model.lock() != model or pb.clip != clip) {
+        pb       = Playback {};
+        pb.model = model;
+        pb.clip  = clip;
+    }
+
+    if (pb.source != model->animations) bind(pb, *model);
+
+    qInfo() << "Playing" << model->animations->clips[clip].name << "on model"
+            << model->id << "from" << pb.time << "seconds";
+
+    pb.playing = true;
+
+    update_timer();
+
+    return true;
+}
+
+bool AnimationEngine::pause(int id) {
+    auto iter = m_playbacks.find(id);
+
+    if (iter == m_playbacks.end()) return false;
+
+    iter->second.playing = false;
+
+    update_timer();
+
+    return true;
+}
+
+bool AnimationEngine::seek(std::shared_ptr<Model> const& model,
+                           double                        seconds) {
+    if (!model or !model->animations or model->animations->clips.empty()) {
+        return false;
+    }
+
+    auto& pb = m_playbacks[model->id];
+
+    if (pb.model.lock() != model) {
+        pb       = Playback {};
+        pb.model = model;
+    }
+
+    if (pb.source != model->animations and !bind(pb, *model)) return false;
+
+    pb.time = wrap_time(seconds, pb.source->clips[pb.clip].duration);
+
+    if (model->resident) {
+        sample(pb, *pb.source);
+        send(pb);
+    }
+
+    return true;
+}
+
+void AnimationEngine::forget(int id) {
+    m_playbacks.erase(id);
+    update_timer();
+}
+
+size_t AnimationEngine::playing() const {
+    size_t ret = 0;
+    for (auto const& [id, pb] : m_playbacks) {
+        ret += pb.playing;
+    }
+    return ret;
+}
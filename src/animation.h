@@ -0,0 +1,128 @@
+#pragma once
+
+#include <noo_server_interface.h>
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+struct aiNode;
+struct aiScene;
+struct Model;
+
+/// Node animations of a model. The keys of every track of every clip sit
+/// back to back in one array per property, so sampling a clip walks each
+/// array front to back.
+struct ModelAnimations {
+    /// A run of keys in the arrays of one property
+    struct Track {
+        uint32_t first = 0;
+        uint32_t count = 0;
+    };
+
+    /// The tracks moving one node in a clip. A property without keys stays
+    /// at the rest pose of the node.
+    struct Channel {
+        QString   node; // path in Model::nodes
+        Track     position;
+        Track     rotation;
+        Track     scale;
+        glm::vec3 rest_position = glm::vec3(0);
+        glm::quat rest_rotation = glm::quat(1, 0, 0, 0);
+        glm::vec3 rest_scale    = glm::vec3(1);
+    };
+
+    struct Clip {
+        QString  name;
+        double   duration      = 0; // seconds
+        uint32_t first_channel = 0;
+        uint32_t channel_count = 0;
+    };
+
+    std::vector<Clip>    clips;
+    std::vector<Channel> channels;
+
+    // key times in seconds, and the value at each
+    std::vector<float>     position_times;
+    std::vector<glm::vec3> positions;
+    std::vector<float>     rotation_times;
+    std::vector<glm::quat> rotations;
+    std::vector<float>     scale_times;
+    std::vector<glm::vec3> scales;
+
+    /// Index of the clip with a name, or -1
+    int find_clip(QString const& name) const;
+
+    qint64 byte_size() const;
+};
+
+/// Gather the node animations of a scene. Channels of nodes missing from
+/// `node_paths`, such as the model root whose transform belongs to the user,
+/// are skipped. Returns null if nothing is animated.
+std::shared_ptr<ModelAnimations const>
+extract_animations(aiScene const&                       scene,
+                   QHash<aiNode const*, QString> const& node_paths);
+
+/// Plays node animations on the server. Every tick samples all channels of
+/// the clips that are playing and sends the transforms of the nodes whose
+/// pose changed since the last one sent.
+class AnimationEngine : public QObject {
+    Q_OBJECT
+
+    struct Playback {
+        std::weak_ptr<Model> model;
+
+        // what the per channel state below was built for
+        std::shared_ptr<ModelAnimations const> source;
+
+        int    clip    = 0;
+        double time    = 0;
+        bool   playing = false;
+
+        // by channel of the clip. Cursors are the last key used of each
+        // track, so sampling costs nothing extra while time moves forward.
+        std::vector<std::weak_ptr<noo::ObjectT>> targets;
+        std::vector<std::array<uint32_t, 3>>     cursors;
+        std::vector<glm::mat4>                   pose;
+        std::vector<glm::mat4>                   sent;
+    };
+
+    std::unordered_map<int, Playback> m_playbacks;
+
+    QTimer                                m_timer;
+    std::chrono::steady_clock::time_point m_last_tick;
+
+    void tick();
+    void update_timer();
+
+    bool bind(Playback&, Model&);
+    void sample(Playback&, ModelAnimations const&);
+    void send(Playback&);
+
+public:
+    /// Tick `rate` times a second while anything plays
+    explicit AnimationEngine(double rate, QObject* parent = nullptr);
+
+    /// Start or resume a clip of a model. Switching clips starts over.
+    bool play(std::shared_ptr<Model> const&, int clip);
+
+    bool pause(int id);
+
+    /// Jump to a time in the current clip, wrapping around its duration. The
+    /// new pose is sent right away, even while paused.
+    bool seek(std::shared_ptr<Model> const&, double seconds);
+
+    /// Drop the playback state of a model that is going away
+    void forget(int id);
+
+    size_t playing() const;
+};
@@ -0,0 +1,603 @@
+#include "asyncread.h"
+
+#include "threadpool.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <optional>
+#include <thread>
+#include <unordered_set>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define PLAYGROUND_IO_URING 1
+#endif
+#endif
+
+namespace {
+
+// the pread fallback; a few requests in flight keep a disk busy
+constexpr unsigned fallback_threads = 4;
+
+// sized for a wave of grids, each with a few data items of a few chunks
+constexpr unsigned ring_entries = 128;
+
+} // namespace
+
+// =============================================================================
+
+PendingRead::~PendingRead() {
+    if (m_fd >= 0) ::close(m_fd);
+}
+
+void PendingRead::chunk_done(bool ok) {
+    if (!ok) m_failed = true;
+    if (m_chunks.fetch_sub(1) == 1) finish();
+}
+
+void PendingRead::finish() {
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+
+    // before waking the waiters, so the rate is current once they return
+    m_owner->read_done(m_failed ? 0 : m_size);
+
+    {
+        std::scoped_lock lock(m_lock);
+        m_done = true;
+    }
+
+    m_done_signal.notify_all();
+}
+
+bool PendingRead::ready() const {
+    std::scoped_lock lock(m_lock);
+    return m_done;
+}
+
+std::span<unsigned char> PendingRead::wait() {
+    std::unique_lock lock(m_lock);
+    m_done_signal.wait(lock, [this] { return m_done; });
+
+    if (m_failed) return {};
+
+    return { m_data.get(), m_size };
+}
+
+// =============================================================================
+
+#ifdef PLAYGROUND_IO_URING
+
+/// A submission and completion queue shared with the kernel, driven with
+/// raw system calls. Submissions take the lock; one thread reaps, and
+/// queues again whatever came back short. If the kernel refuses the ring
+/// itself, it is broken for good: every chunk it still holds fails, so its
+/// read falls back to mapping, and the reaper stops.
+struct AsyncReader::Ring {
+    int      fd      = -1;
+    unsigned entries = 0;
+
+    void*  sq_ring      = MAP_FAILED;
+    size_t sq_ring_size = 0;
+    void*  cq_ring      = MAP_FAILED;
+    size_t cq_ring_size = 0;
+
+    io_uring_sqe* sqes      = nullptr;
+    size_t        sqes_size = 0;
+
+    unsigned* sq_head  = nullptr;
+    unsigned* sq_tail  = nullptr;
+    unsigned* sq_mask  = nullptr;
+    unsigned* sq_array = nullptr;
+
+    unsigned*     cq_head = nullptr;
+    unsigned*     cq_tail = nullptr;
+    unsigned*     cq_mask = nullptr;
+    io_uring_cqe* cqes    = nullptr;
+
+    // chunks that did not fit in the ring yet, and those in it
+    std::mutex                 lock;
+    std::deque<Chunk*>         waiting;
+    std::unordered_set<Chunk*> out;
+    unsigned                   in_flight = 0;
+    bool                       broken    = false; // takes no more chunks
+    bool                       reaping   = true;
+    std::thread                reaper;
+
+    static std::unique_ptr<Ring> open();
+
+    Ring() = default;
+    ~Ring();
+
+    int enter(unsigned to_submit, unsigned min_complete, unsigned flags) {
+        return (int)::syscall(__NR_io_uring_enter,
+                              fd,
+                              to_submit,
+                              min_complete,
+                              flags,
+                              nullptr,
+                              0);
+    }
+
+    /// Whether a failed io_uring_enter is worth trying again
+    static bool is_transient(int error) {
+        return error == EINTR or error == EAGAIN or error == EBUSY;
+    }
+
+    /// Fail chunks the kernel never took, so their reads fall back to
+    /// mapping. Not under the lock, as the last chunk of a read finishes it.
+    static void fail(std::vector<Chunk*> const& chunks) {
+        for (auto* chunk : chunks) {
+            chunk->read->chunk_done(false);
+            delete chunk;
+        }
+    }
+
+    void push(std::vector<Chunk*> const& chunks) {
+        std::vector<Chunk*> failed;
+
+        {
+            std::scoped_lock guard(lock);
+            waiting.insert(waiting.end(), chunks.begin(), chunks.end());
+            failed = fill();
+        }
+
+        fail(failed);
+    }
+
+    io_uring_sqe& next_sqe(unsigned tail) {
+        auto  index     = tail & *sq_mask;
+        auto& sqe       = sqes[index];
+        sq_array[index] = index;
+        std::memset(&sqe, 0, sizeof(sqe));
+        return sqe;
+    }
+
+    /// Mark the ring broken and take every chunk still waiting. Holds the
+    /// lock.
+    std::vector<Chunk*> take_waiting() {
+        broken = true;
+
+        std::vector<Chunk*> ret(waiting.begin(), waiting.end());
+        waiting.clear();
+
+        return ret;
+    }
+
+    /// Move waiting chunks into the ring and submit them. Holds the lock.
+    /// Returns the chunks to fail once the ring is broken.
+    std::vector<Chunk*> fill() {
+        if (broken) return take_waiting();
+
+        // no more out than the completion queue holds, so none are dropped
+        unsigned tail  = *sq_tail;
+        unsigned added = 0;
+
+        while (!waiting.empty() and in_flight < entries) {
+            auto* chunk = waiting.front();
+            waiting.pop_front();
+
+            auto& sqe     = next_sqe(tail++);
+            sqe.opcode    = IORING_OP_READ;
+            sqe.fd        = chunk->read->m_fd;
+            sqe.addr      = (uint64_t)chunk->dest;
+            sqe.len       = (uint32_t)chunk->length;
+            sqe.off       = chunk->offset;
+            sqe.user_data = (uint64_t)chunk;
+
+            out.insert(chunk);
+
+            added++;
+            in_flight++;
+        }
+
+        if (!added) return {};
+
+        auto refused = submit(tail, added);
+
+        if (!refused) return {};
+
+        auto ret = take_waiting();
+        ret.insert(ret.end(), refused->begin(), refused->end());
+        return ret;
+    }
+
+    /// Hand the entries up to `tail` to the kernel. Holds the lock. If the
+    /// ring fails, the entries the kernel did not take are taken back, and
+    /// their chunks returned.
+    std::optional<std::vector<Chunk*>> submit(unsigned tail, unsigned count) {
+        __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+
+        while (count > 0) {
+            int ret = enter(count, 0, 0);
+
+            if (ret >= 0) {
+                count -= ret;
+                continue;
+            }
+
+            if (is_transient(errno)) continue;
+
+            qCritical() << "io_uring submission failed:"
+                        << std::strerror(errno);
+
+            unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+
+            std::vector<Chunk*> refused;
+
+            for (auto t = head; t != tail; t++) {
+                auto* chunk = (Chunk*)sqes[sq_array[t & *sq_mask]].user_data;
+
+                in_flight--;
+
+                // the no-op posted on shutdown has no chunk
+                if (!chunk) continue;
+
+                out.erase(chunk);
+                refused.push_back(chunk);
+            }
+
+            __atomic_store_n(sq_tail, head, __ATOMIC_RELEASE);
+
+            return refused;
+        }
+
+        return {};
+    }
+
+    void reap() {
+        bool stop = false;
+
+        while (!stop) {
+            if (enter(0, 1, IORING_ENTER_GETEVENTS) < 0 and
+                !is_transient(errno)) {
+                qCritical() << "io_uring wait failed:" << std::strerror(errno);
+                abandon();
+                return;
+            }
+
+            unsigned head = *cq_head;
+            unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+
+            std::vector<Chunk*> done;
+            std::vector<Chunk*> again;
+            unsigned            seen = 0;
+
+            for (; head != tail; head++, seen++) {
+                auto const& cqe = cqes[head & *cq_mask];
+
+                // the no-op posted on shutdown
+                if (cqe.user_data == 0) {
+                    stop = true;
+                    continue;
+                }
+
+                auto* chunk = (Chunk*)cqe.user_data;
+
+                if (advance(*chunk, cqe.res)) {
+                    done.push_back(chunk);
+                } else {
+                    again.push_back(chunk);
+                }
+            }
+
+            __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+
+            if (!seen) continue;
+
+            std::vector<Chunk*> failed;
+
+            {
+                std::scoped_lock guard(lock);
+
+                for (auto* chunk : done) {
+                    out.erase(chunk);
+                }
+
+                for (auto* chunk : again) {
+                    out.erase(chunk);
+                }
+
+                in_flight -= seen;
+                waiting.insert(waiting.begin(), again.begin(), again.end());
+                failed = fill();
+            }
+
+            for (auto* chunk : done) {
+                delete chunk;
+            }
+
+            fail(failed);
+        }
+    }
+
+    /// Give up on the ring once completions can no longer be waited for.
+    /// Chunks still in the kernel fail too, but stay allocated, along with
+    /// the memory of their reads, as the kernel may yet write into it.
+    void abandon() {
+        std::vector<Chunk*> failed;
+        std::vector<Chunk*> lost;
+
+        {
+            std::scoped_lock guard(lock);
+
+            failed  = take_waiting();
+            reaping = false;
+            lost.assign(out.begin(), out.end());
+        }
+
+        fail(failed);
+
+        for (auto* chunk : lost) {
+            chunk->read->chunk_done(false);
+        }
+    }
+};
+
+std::unique_ptr<AsyncReader::Ring> AsyncReader::Ring::open() {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    int fd = (int)::syscall(__NR_io_uring_setup, ring_entries, &params);
+
+    if (fd < 0) {
+        qInfo() << "io_uring unavailable:" << std::strerror(errno);
+        return {};
+    }
+
+    auto ret = std::make_unique<Ring>();
+    ret->fd  = fd;
+
+    // plain reads came with the same kernel as this flag
+    if (!(params.features & IORING_FEAT_RW_CUR_POS)) {
+        qInfo() << "io_uring too old for plain reads";
+        return {};
+    }
+
+    ret->entries = params.sq_entries;
+
+    ret->sq_ring_size =
+        params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ret->cq_ring_size =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+    bool const single = params.features & IORING_FEAT_SINGLE_MMAP;
+
+    if (single) {
+        ret->sq_ring_size = ret->cq_ring_size =
+            std::max(ret->sq_ring_size, ret->cq_ring_size);
+    }
+
+    auto map = [fd](size_t size, off_t offset) {
+        return ::mmap(nullptr,
+                      size,
+                      PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE,
+                      fd,
+                      offset);
+    };
+
+    ret->sq_ring = map(ret->sq_ring_size, IORING_OFF_SQ_RING);
+
+    if (ret->sq_ring == MAP_FAILED) return {};
+
+    ret->cq_ring =
+        single ? ret->sq_ring : map(ret->cq_ring_size, IORING_OFF_CQ_RING);
+
+    if (ret->cq_ring == MAP_FAILED) return {};
+
+    ret->sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+
+    auto* sqes = map(ret->sqes_size, IORING_OFF_SQES);
+
+    if (sqes == MAP_FAILED) return {};
+
+    ret->sqes = (io_uring_sqe*)sqes;
+
+    auto* sq = (char*)ret->sq_ring;
+    auto* cq = (char*)ret->cq_ring;
+
+    ret->sq_head  = (unsigned*)(sq + params.sq_off.head);
+    ret->sq_tail  = (unsigned*)(sq + params.sq_off.tail);
+    ret->sq_mask  = (unsigned*)(sq + params.sq_off.ring_mask);
+    ret->sq_array = (unsigned*)(sq + params.sq_off.array);
+
+    ret->cq_head = (unsigned*)(cq + params.cq_off.head);
+    ret->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    ret->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    ret->cqes    = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    ret->reaper = std::thread([ring = ret.get()] { ring->reap(); });
+
+    return ret;
+}
+
+AsyncReader::Ring::~Ring() {
+    if (reaper.joinable()) {
+        // everything is in by now; a no-op wakes the reaper to quit, unless
+        // it stopped already
+        std::scoped_lock guard(lock);
+
+        if (reaping) {
+            auto tail = *sq_tail;
+            next_sqe(tail++).opcode = IORING_OP_NOP;
+            in_flight++;
+
+            // with no way to wake it, the reaper stays blocked on a ring
+            // with nothing left in it, and the ring is left to it
+            if (submit(tail, 1)) {
+                reaper.detach();
+                return;
+            }
+        }
+    }
+
+    if (reaper.joinable()) reaper.join();
+
+    if (sqes) ::munmap(sqes, sqes_size);
+    if (cq_ring != MAP_FAILED and cq_ring != sq_ring) {
+        ::munmap(cq_ring, cq_ring_size);
+    }
+    if (sq_ring != MAP_FAILED) ::munmap(sq_ring, sq_ring_size);
+    if (fd >= 0) ::close(fd);
+}
+
+#else
+
+struct AsyncReader::Ring {
+    static std::unique_ptr<Ring> open() { return {}; }
+
+    void push(std::vector<Chunk*> const&) { }
+};
+
+#endif
+
+// =============================================================================
+
+AsyncReader::AsyncReader(bool use_ring) {
+    if (use_ring) m_ring = Ring::open();
+
+    if (!m_ring) m_pool = std::make_unique<ThreadPool>(fallback_threads);
+}
+
+AsyncReader::~AsyncReader() {
+    {
+        std::unique_lock lock(m_stats_lock);
+        m_idle.wait(lock, [this] { return m_outstanding == 0; });
+    }
+
+    m_ring.reset();
+    m_pool.reset();
+}
+
+void AsyncReader::read_started() {
+    std::scoped_lock lock(m_stats_lock);
+    if (m_outstanding++ == 0) m_busy_since = std::chrono::steady_clock::now();
+}
+
+void AsyncReader::read_done(size_t bytes) {
+    m_bytes += bytes;
+
+    std::scoped_lock lock(m_stats_lock);
+
+    if (--m_outstanding > 0) return;
+
+    m_busy += std::chrono::steady_clock::now() - m_busy_since;
+    m_idle.notify_all();
+}
+
+double AsyncReader::busy_seconds() {
+    std::scoped_lock lock(m_stats_lock);
+
+    auto busy = m_busy;
+
+    if (m_outstanding) busy += std::chrono::steady_clock::now() - m_busy_since;
+
+    return std::chrono::duration<double>(busy).count();
+}
+
+bool AsyncReader::advance(Chunk& chunk, int64_t result) {
+    if (result == -EINTR or result == -EAGAIN) return false;
+
+    // an error, or the file ended early
+    if (result <= 0) {
+        chunk.read->chunk_done(false);
+        return true;
+    }
+
+    chunk.offset += result;
+    chunk.dest += result;
+    chunk.length -= result;
+
+    if (chunk.length > 0) return false;
+
+    chunk.read->chunk_done(true);
+    return true;
+}
+
+std::vector<AsyncReader::ReadPtr>
+AsyncReader::submit(std::vector<Request> const& requests) {
+    std::vector<ReadPtr> ret;
+    std::vector<Chunk*>  chunks;
+
+    ret.reserve(requests.size());
+
+    for (auto const& request : requests) {
+        auto read     = std::make_shared<PendingRead>();
+        read->m_owner = this;
+        read->m_size  = request.length;
+        ret.push_back(read);
+
+        read_started();
+
+        read->m_fd = ::open(request.path.toLocal8Bit().constData(),
+                            O_RDONLY | O_CLOEXEC);
+
+        struct stat info;
+
+        bool const fits =
+            read->m_fd >= 0 and ::fstat(read->m_fd, &info) == 0 and
+            request.offset + request.length <= (size_t)info.st_size;
+
+        if (!fits or request.length == 0) {
+            qWarning() << "Unable to read" << request.length << "bytes at"
+                       << request.offset << "of" << request.path;
+            read->m_failed = true;
+            read->finish();
+            continue;
+        }
+
+        read->m_data =
+            std::make_unique_for_overwrite<unsigned char[]>(request.length);
+
+        size_t const count = (request.length + chunk_size - 1) / chunk_size;
+
+        read->m_chunks = count;
+
+        for (size_t i = 0; i < count; i++) {
+            size_t const start = i * chunk_size;
+
+            chunks.push_back(new Chunk {
+                .read   = read,
+                .offset = request.offset + start,
+                .length = std::min(chunk_size, request.length - start),
+                .dest   = read->m_data.get() + start,
+            });
+        }
+    }
+
+    if (m_ring) {
+        m_ring->push(chunks);
+        return ret;
+    }
+
+    for (auto* chunk : chunks) {
+        m_pool->submit([chunk] {
+            while (true) {
+                auto got = ::pread(chunk->read->m_fd,
+                                   chunk->dest,
+                                   chunk->length,
+                                   chunk->offset);
+
+                if (advance(*chunk, got < 0 ? -errno : got)) break;
+            }
+
+            delete chunk;
+        });
+    }
+
+    return ret;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <QString>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+class AsyncReader;
+class ThreadPool;
+
+/// A byte range of a file being read into memory of its own
+class PendingRead {
+    friend class AsyncReader;
+
+    AsyncReader*                     m_owner = nullptr;
+    int                              m_fd    = -1;
+    size_t                           m_size  = 0;
+    std::unique_ptr<unsigned char[]> m_data;
+
+    // chunks still out; the read is over when this reaches zero
+    std::atomic<size_t> m_chunks = 0;
+    std::atomic<bool>   m_failed = false;
+
+    mutable std::mutex              m_lock;
+    mutable std::condition_variable m_done_signal;
+    bool                            m_done = false;
+
+    void chunk_done(bool ok);
+    void finish();
+
+public:
+    PendingRead()  = default;
+    ~PendingRead();
+
+    PendingRead(PendingRead const&)            = delete;
+    PendingRead& operator=(PendingRead const&) = delete;
+
+    bool ready() const;
+
+    /// Block until the read is over. The bytes, or an empty span if the
+    /// file could not be opened or was shorter than asked.
+    std::span<unsigned char> wait();
+};
+
+/// Reads many byte ranges at once. On Linux they go to the kernel as one
+/// batch through io_uring, and a thread reaps completions as they come, so
+/// the caller is free to work until it needs the bytes. Where io_uring is
+/// missing or not allowed, a few threads of its own issue `pread`s instead;
+/// they are not the global pool's, as its workers block on these reads.
+class AsyncReader {
+public:
+    struct Request {
+        QString path;
+        size_t  offset = 0;
+        size_t  length = 0;
+    };
+
+    using ReadPtr = std::shared_ptr<PendingRead>;
+
+    // larger reads are split so they spread over the device queue
+    static constexpr size_t chunk_size = 8 << 20;
+
+private:
+    friend class PendingRead;
+
+    struct Ring;
+
+    /// A piece of a read, at most `chunk_size` long
+    struct Chunk {
+        ReadPtr        read;
+        size_t         offset = 0; // in the file
+        size_t         length = 0;
+        unsigned char* dest   = nullptr;
+    };
+
+    std::unique_ptr<Ring>       m_ring;
+    std::unique_ptr<ThreadPool> m_pool;
+
+    // time with at least one read out, for the rate
+    std::mutex                            m_stats_lock;
+    std::condition_variable               m_idle;
+    size_t                                m_outstanding = 0;
+    std::chrono::steady_clock::time_point m_busy_since;
+    std::chrono::nanoseconds              m_busy { 0 };
+    std::atomic<size_t>                   m_bytes = 0;
+
+    void read_started();
+    void read_done(size_t bytes);
+
+    /// Account for `result` bytes of a chunk, or a negated errno. True when
+    /// the chunk is over; false if the rest should be read again.
+    static bool advance(Chunk&, int64_t result);
+
+public:
+    /// Without `use_ring`, reads always go through `pread`
+    explicit AsyncReader(bool use_ring = true);
+
+    /// Waits for reads still out
+    ~AsyncReader();
+
+    AsyncReader(AsyncReader const&)            = delete;
+    AsyncReader& operator=(AsyncReader const&) = delete;
+
+    bool uses_io_uring() const { return (bool)m_ring; }
+
+    /// Start all reads. Results are in request order; an empty request
+    /// reads nothing and so counts as failed.
+    std::vector<ReadPtr> submit(std::vector<Request> const&);
+
+    /// Bytes read in full so far
+    size_t bytes_read() const { return m_bytes; }
+
+    /// Time during which reads were out
+    double busy_seconds();
+};
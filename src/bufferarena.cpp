@@ -0,0 +1,173 @@
+#include "bufferarena.h"
+
+#include <QDebug>
+
+#include <atomic>
+
+namespace {
+
+std::atomic<uint64_t> next_serial = 0;
+
+} // namespace
+
+BufferArena::BufferArena(QString name, size_t chunk_limit)
+    : m_name(name), m_chunk_limit(chunk_limit), m_serial(next_serial++) { }
+
+BufferArena::Slice BufferArena::append(std::span<std::byte const> bytes,
+                                       size_t                     alignment) {
+    bool const has_open_chunk = m_staged.size() > m_sealed;
+
+    auto aligned_end = [&](QByteArray const& chunk) {
+        return (chunk.size() + alignment - 1) / alignment * alignment;
+    };
+
+    bool needs_new_chunk = !has_open_chunk;
+
+    if (has_open_chunk) {
+        auto const& open = m_staged.back();
+
+        // an empty chunk takes anything, however large
+        needs_new_chunk = !open.isEmpty() and
+                          aligned_end(open) + bytes.size() > m_chunk_limit;
+    }
+
+    if (needs_new_chunk) m_staged.emplace_back();
+
+    auto& chunk = m_staged.back();
+
+    Slice ret {
+        .chunk  = m_staged.size() - 1,
+        .offset = (uint64_t)aligned_end(chunk),
+        .length = bytes.size(),
+    };
+
+    chunk.resize(ret.offset, '\0');
+    chunk.append(reinterpret_cast<char const*>(bytes.data()), bytes.size());
+
+    return ret;
+}
+
+BufferArena::Slice BufferArena::adopt(QByteArray bytes) {
+    seal();
+
+    Slice ret {
+        .chunk  = m_staged.size(),
+        .offset = 0,
+        .length = (uint64_t)bytes.size(),
+    };
+
+    m_staged.push_back(std::move(bytes));
+
+    seal();
+
+    return ret;
+}
+
+void BufferArena::seal() {
+    for (size_t i = m_sealed; i < m_staged.size(); i++) {
+        m_sizes.push_back(m_staged[i].size());
+    }
+
+    m_sealed = m_staged.size();
+
+    m_buffers.resize(m_sealed);
+    m_geometry_views.resize(m_sealed);
+}
+
+void BufferArena::flush(noo::DocumentTPtrRef doc) {
+    seal();
+
+    for (size_t i = 0; i < m_sealed; i++) {
+        buffer(doc, i);
+    }
+}
+
+noo::BufferTPtr BufferArena::buffer(noo::DocumentTPtrRef doc, size_t chunk) {
+    Q_ASSERT(chunk < m_sealed);
+
+    auto& buffer = m_buffers[chunk];
+
+    if (buffer) return buffer;
+
+    qDebug() << "Arena" << m_name << "chunk" << chunk << m_sizes[chunk]
+             << "bytes";
+
+    buffer = noo::create_buffer(
+        doc,
+        noo::BufferData {
+            .name   = QString("%1 %2").arg(m_name).arg(chunk),
+            .source = noo::BufferInlineSource {
+                .data = m_staged[chunk],
+            },
+        });
+
+    // the buffer holds the bytes now
+    m_staged[chunk] = QByteArray();
+
+    return buffer;
+}
+
+size_t BufferArena::buffer_count() const {
+    return std::count_if(m_buffers.begin(), m_buffers.end(), [](auto const& b) {
+        return bool(b);
+    });
+}
+
+noo::BufferViewTPtr BufferArena::geometry_view(noo::DocumentTPtrRef doc,
+                                               size_t               chunk) {
+    Q_ASSERT(chunk < m_sealed);
+
+    auto& view = m_geometry_views[chunk];
+
+    if (!view) {
+        view = noo::create_buffer_view(
+            doc,
+            noo::BufferViewData {
+                .source_buffer = buffer(doc, chunk),
+                .type          = noo::ViewType::GEOMETRY_INFO,
+                .offset        = 0,
+                .length        = m_sizes[chunk],
+            });
+    }
+
+    return view;
+}
+
+noo::BufferViewTPtr BufferArena::view_of(noo::DocumentTPtrRef doc,
+                                         Slice const&         slice,
+                                         noo::ViewType        type) {
+    Q_ASSERT(slice.chunk < m_sealed);
+
+    return noo::create_buffer_view(
+        doc,
+        noo::BufferViewData {
+            .source_buffer = buffer(doc, slice.chunk),
+            .type          = type,
+            .offset        = slice.offset,
+            .length        = slice.length,
+        });
+}
+
+std::vector<BufferArena::ChunkUse>
+BufferArena::chunks_of(std::span<Slice const> slices) const {
+    std::vector<ChunkUse> ret;
+
+    for (auto const& slice : slices) {
+        Q_ASSERT(slice.chunk < m_sealed);
+
+        auto id = m_serial << 32 | slice.chunk;
+
+        auto iter = std::find_if(ret.begin(), ret.end(), [id](auto const& c) {
+            return c.id == id;
+        });
+
+        if (iter == ret.end()) {
+            ret.push_back({ .id = id, .size = (qint64)m_sizes[slice.chunk] });
+            iter = ret.end() - 1;
+        }
+
+        iter->used += slice.length;
+    }
+
+    return ret;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <noo_server_interface.h>
+
+#include <QByteArray>
+#include <QString>
+
+#include <algorithm>
+#include <span>
+#include <vector>
+
+/// Packs many small byte ranges into a few large buffers, so a model with
+/// thousands of meshes does not cost thousands of buffer messages. Ranges are
+/// staged with append(); flush() then creates one buffer per chunk. A sealed
+/// chunk that was not flushed gets its buffer when a view first needs it, so
+/// publishing can be spread out.
+class BufferArena {
+public:
+    struct Slice {
+        size_t   chunk  = 0;
+        uint64_t offset = 0;
+        uint64_t length = 0;
+    };
+
+    /// A chunk some slices lie in, named uniquely across arenas, with its
+    /// size and how much of it the slices take. A chunk is one buffer, so
+    /// it lives as long as anything in it does.
+    struct ChunkUse {
+        uint64_t id   = 0;
+        qint64   size = 0;
+        qint64   used = 0;
+    };
+
+    // attribute offsets are 32 bit, so chunks have to stay well below that
+    static constexpr size_t default_chunk_limit = 64 * 1024 * 1024;
+
+private:
+    QString  m_name;
+    size_t   m_chunk_limit;
+    uint64_t m_serial;
+
+    // chunks below m_sealed take no more appends; their buffers are made
+    // on flush or first use
+    size_t                           m_sealed = 0;
+    std::vector<QByteArray>          m_staged;
+    std::vector<noo::BufferTPtr>     m_buffers;
+    std::vector<uint64_t>            m_sizes;
+    std::vector<noo::BufferViewTPtr> m_geometry_views;
+
+public:
+    explicit BufferArena(QString name,
+                         size_t  chunk_limit = default_chunk_limit);
+
+    /// Copy bytes into the arena, starting at a multiple of `alignment`.
+    /// Ranges larger than the chunk limit get a chunk of their own.
+    Slice append(std::span<std::byte const> bytes, size_t alignment = 4);
+
+    template <class T, size_t N>
+    Slice append(std::span<T, N> values) {
+        return append(std::as_bytes(values), std::max<size_t>(alignof(T), 4));
+    }
+
+    /// Take bytes as a sealed chunk of their own, without copying them.
+    /// Bytes the arena does not own, such as those of a mapped file, have to
+    /// outlive the buffer made of the chunk.
+    Slice adopt(QByteArray bytes);
+
+    /// Close every staged chunk to further appends, without creating
+    /// anything
+    void seal();
+
+    /// Seal, and create buffers for everything staged since the last flush
+    void flush(noo::DocumentTPtrRef doc);
+
+    /// The buffer of a sealed chunk, created on first use
+    noo::BufferTPtr buffer(noo::DocumentTPtrRef doc, size_t chunk);
+
+    /// A geometry view over a whole sealed chunk. Attributes and indices
+    /// address into it with the slice offset.
+    noo::BufferViewTPtr geometry_view(noo::DocumentTPtrRef doc, size_t chunk);
+
+    /// A view covering exactly one sealed slice, as images need
+    noo::BufferViewTPtr
+    view_of(noo::DocumentTPtrRef doc, Slice const&, noo::ViewType);
+
+    size_t buffer_count() const;
+
+    /// The sealed chunks the slices lie in, each once
+    std::vector<ChunkUse> chunks_of(std::span<Slice const>) const;
+};
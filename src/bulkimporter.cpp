@@ -0,0 +1,1453 @@
+#include "bulkimporter.h"
+
+#include "threadpool.h"
+#include "weld.h"
+
+#include <assimp/material.h>
+#include <assimp/scene.h>
+
+#include <glm/geometric.hpp>
+#include <glm/vec4.hpp>
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using Bytes = std::span<unsigned char const>;
+
+/// One mesh as the parsers leave it
+struct BulkMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec4> colors;
+
+    // triangles; empty for a point cloud
+    std::vector<uint32_t> indices;
+};
+
+using ParseResult = std::variant<BulkMesh, QString>;
+
+// text smaller than this is not worth a task of its own
+constexpr size_t min_piece = 64 * 1024;
+
+// records decoded per task when their offsets have to be walked first
+constexpr size_t record_run = 64 * 1024;
+
+/// The first error raised by any of a set of parallel tasks. Tasks check
+/// failed() to give up early once another one has.
+class FirstError {
+    std::mutex             m_lock;
+    std::optional<QString> m_error;
+    std::atomic<bool>      m_failed = false;
+
+public:
+    void set(QString error) {
+        std::scoped_lock lock(m_lock);
+        if (!m_error) m_error = std::move(error);
+        m_failed = true;
+    }
+
+    bool failed() const { return m_failed.load(std::memory_order_relaxed); }
+
+    /// Only valid once every task is done
+    std::optional<QString> const& error() const { return m_error; }
+};
+
+std::string_view as_text(Bytes bytes) {
+    return { reinterpret_cast<char const*>(bytes.data()), bytes.size() };
+}
+
+/// Cut text into pieces that each end at a line break, a few per worker
+std::vector<std::string_view> split_lines(std::string_view text) {
+    size_t const parts = std::clamp<size_t>(
+        text.size() / min_piece, 1, ThreadPool::global().size() * 4);
+
+    size_t const step = text.size() / parts;
+
+    std::vector<std::string_view> ret;
+
+    size_t begin = 0;
+
+    while (begin < text.size()) {
+        size_t end = begin + step;
+
+        if (end >= text.size()) {
+            end = text.size();
+        } else {
+            auto brk = text.find('\n', end);
+            end      = brk == std::string_view::npos ? text.size() : brk + 1;
+        }
+
+        ret.push_back(text.substr(begin, end - begin));
+
+        begin = end;
+    }
+
+    return ret;
+}
+
+/// Call `f` with every line, minus its line break, while it returns true
+template <class Function>
+void for_each_line(std::string_view text, Function&& f) {
+    while (!text.empty()) {
+        auto end  = text.find('\n');
+        auto line = text.substr(0, end);
+
+        if (!line.empty() and line.back() == '\r') line.remove_suffix(1);
+
+        if (!f(line) or end == std::string_view::npos) return;
+
+        text.remove_prefix(end + 1);
+    }
+}
+
+/// Whitespace separated words off the front of a line
+struct Tokens {
+    std::string_view rest;
+
+    /// The next word, or empty at the end of the line
+    std::string_view word() {
+        auto begin = rest.find_first_not_of(" \t\r");
+
+        if (begin == std::string_view::npos) {
+            rest = {};
+            return {};
+        }
+
+        rest.remove_prefix(begin);
+
+        auto ret = rest.substr(0, rest.find_first_of(" \t\r"));
+
+        rest.remove_prefix(ret.size());
+
+        return ret;
+    }
+
+    size_t words_left() const {
+        Tokens copy = *this;
+        size_t ret  = 0;
+        while (!copy.word().empty()) ret++;
+        return ret;
+    }
+
+    template <class T>
+    bool number(T& out) {
+        return parse(word(), out);
+    }
+
+    bool vec3(glm::vec3& out) {
+        return number(out.x) and number(out.y) and number(out.z);
+    }
+
+    template <class T>
+    static bool parse(std::string_view w, T& out) {
+        // from_chars takes no plus sign
+        if (!w.empty() and w.front() == '+') w.remove_prefix(1);
+
+        auto [end, ec] = std::from_chars(w.data(), w.data() + w.size(), out);
+
+        return !w.empty() and ec == std::errc() and end == w.data() + w.size();
+    }
+};
+
+/// Replace per piece counts with the offset of each piece. Returns the total.
+size_t to_offsets(std::vector<size_t>& counts) {
+    size_t total = 0;
+    for (auto& c : counts) {
+        total += std::exchange(c, total);
+    }
+    return total;
+}
+
+template <class Piece, class Member>
+std::vector<size_t> offsets_of(std::vector<Piece> const& pieces,
+                               Member                    member,
+                               size_t&                   total) {
+    std::vector<size_t> ret;
+    ret.reserve(pieces.size());
+
+    for (auto const& p : pieces) {
+        ret.push_back(p.*member);
+    }
+
+    total = to_offsets(ret);
+
+    return ret;
+}
+
+/// Index a triangle soup by joining corners that are the same in every
+/// attribute, as Assimp's JoinIdenticalVertices would
+BulkMesh index_soup(BulkMesh&& soup) {
+    auto joined = join_identical(soup.positions, soup.normals);
+
+    BulkMesh ret {
+        .positions = std::move(joined.positions),
+        .normals   = std::move(joined.normals),
+    };
+
+    ret.indices.resize(soup.positions.size());
+    std::iota(ret.indices.begin(), ret.indices.end(), 0u);
+
+    soup = {};
+
+    remap_triangles(ret.indices, joined.remap);
+
+    return ret;
+}
+
+// =============================================================================
+// STL
+
+constexpr size_t stl_header = 84;
+constexpr size_t stl_record = 50;
+
+bool is_binary_stl(Bytes bytes) {
+    if (bytes.size() < stl_header) return false;
+
+    uint32_t count;
+    std::memcpy(&count, bytes.data() + 80, sizeof(count));
+
+    // some binary exporters start the header with "solid" too; those still
+    // have to be exactly the size the header claims
+    if (stl_header + size_t(count) * stl_record == bytes.size()) return true;
+
+    return !as_text(bytes).starts_with("solid");
+}
+
+/// Exporters may leave facet normals zero for the reader to work out
+void fill_facet_normal(glm::vec3& normal, glm::vec3 const* corners) {
+    if (normal != glm::vec3(0)) return;
+
+    auto n = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+    auto l = glm::length(n);
+
+    normal = l > 0 ? n / l : glm::vec3(0);
+}
+
+/// Facets are decoded straight out of the mapping, a chunk per task
+ParseResult parse_binary_stl(Bytes bytes) {
+    uint32_t count;
+    std::memcpy(&count, bytes.data() + 80, sizeof(count));
+
+    if (bytes.size() < stl_header + size_t(count) * stl_record) {
+        return "Truncated binary STL";
+    }
+
+    if (count == 0) return "No facets";
+
+    BulkMesh soup;
+    soup.positions.resize(size_t(count) * 3);
+    soup.normals.resize(size_t(count) * 3);
+
+    ThreadPool::global().parallel_chunks(count, [&](size_t b, size_t e) {
+        for (size_t f = b; f < e; f++) {
+            auto const* record = bytes.data() + stl_header + f * stl_record;
+            auto*       corner = soup.positions.data() + f * 3;
+
+            glm::vec3 normal;
+            std::memcpy(&normal, record, sizeof(normal));
+            std::memcpy(corner, record + 12, 3 * sizeof(glm::vec3));
+
+            fill_facet_normal(normal, corner);
+
+            std::fill_n(soup.normals.data() + f * 3, 3, normal);
+        }
+    });
+
+    return soup;
+}
+
+struct StlPiece {
+    size_t facets   = 0;
+    size_t vertices = 0;
+    size_t solids   = 0;
+};
+
+ParseResult parse_ascii_stl(std::string_view text) {
+    auto& pool = ThreadPool::global();
+
+    auto pieces = split_lines(text);
+
+    std::vector<StlPiece> counts(pieces.size());
+
+    pool.parallel_for(pieces.size(), [&](size_t p) {
+        auto& c = counts[p];
+
+        for_each_line(pieces[p], [&c](std::string_view line) {
+            auto word = Tokens { line }.word();
+
+            if (word == "vertex") {
+                c.vertices++;
+            } else if (word == "facet") {
+                c.facets++;
+            } else if (word == "solid") {
+                c.solids++;
+            }
+
+            return true;
+        });
+    });
+
+    size_t facets, vertices, solids;
+
+    auto facet_first  = offsets_of(counts, &StlPiece::facets, facets);
+    auto vertex_first = offsets_of(counts, &StlPiece::vertices, vertices);
+    offsets_of(counts, &StlPiece::solids, solids);
+
+    // Assimp makes a mesh of every solid
+    if (solids > 1) return "Multiple solids";
+    if (facets == 0) return "No facets";
+    if (vertices != facets * 3) return "Facets without three vertices";
+
+    BulkMesh               soup;
+    std::vector<glm::vec3> facet_normals(facets);
+
+    soup.positions.resize(vertices);
+
+    FirstError error;
+
+    pool.parallel_for(pieces.size(), [&](size_t p) {
+        size_t facet  = facet_first[p];
+        size_t vertex = vertex_first[p];
+
+        for_each_line(pieces[p], [&](std::string_view line) {
+            Tokens tokens { line };
+
+            auto word = tokens.word();
+
+            if (word == "vertex") {
+                if (!tokens.vec3(soup.positions[vertex++])) {
+                    error.set("Bad STL vertex");
+                }
+            } else if (word == "facet") {
+                // every facet starts three vertices after the one before
+                if (vertex != facet * 3) {
+                    error.set("Facets without three vertices");
+                } else if (tokens.word() != "normal" or
+                           !tokens.vec3(facet_normals[facet++])) {
+                    error.set("Bad STL facet");
+                }
+            }
+
+            return !error.failed();
+        });
+    });
+
+    if (error.error()) return *error.error();
+
+    soup.normals.resize(vertices);
+
+    pool.parallel_chunks(facets, [&](size_t b, size_t e) {
+        for (size_t f = b; f < e; f++) {
+            auto normal = facet_normals[f];
+
+            fill_facet_normal(normal, soup.positions.data() + f * 3);
+
+            std::fill_n(soup.normals.data() + f * 3, 3, normal);
+        }
+    });
+
+    return soup;
+}
+
+ParseResult parse_stl(Bytes bytes) {
+    auto soup = is_binary_stl(bytes) ? parse_binary_stl(bytes)
+                                     : parse_ascii_stl(as_text(bytes));
+
+    if (auto* mesh = std::get_if<BulkMesh>(&soup)) {
+        return index_soup(std::move(*mesh));
+    }
+
+    return soup;
+}
+
+// =============================================================================
+// OBJ
+
+struct ObjPiece {
+    size_t positions = 0;
+    size_t colored   = 0;
+    size_t normals   = 0;
+    size_t triangles = 0;
+    size_t corners   = 0;
+    size_t named     = 0; // corners that name a normal
+    size_t objects   = 0;
+    size_t groups    = 0;
+};
+
+/// Split a face corner such as 4, 4/2, 4//7 or 4/2/7 into its position and
+/// normal index. A missing normal is zero.
+bool parse_corner(std::string_view w, int64_t& position, int64_t& normal) {
+    normal = 0;
+
+    auto first = w.find('/');
+
+    if (!Tokens::parse(w.substr(0, first), position)) return false;
+    if (first == std::string_view::npos) return true;
+
+    auto second = w.find('/', first + 1);
+
+    if (second == std::string_view::npos) return true;
+
+    return Tokens::parse(w.substr(second + 1), normal);
+}
+
+/// Resolve a one based or, if negative, relative OBJ index against `so_far`
+/// values defined before it and `total` in the file
+std::optional<uint32_t> resolve(int64_t index, size_t so_far, size_t total) {
+    int64_t ret = index > 0 ? index - 1 : int64_t(so_far) + index;
+
+    if (index == 0 or ret < 0 or ret >= int64_t(total)) return std::nullopt;
+
+    return uint32_t(ret);
+}
+
+/// Geometry only: positions, optional vertex colors, normals indexed like
+/// the positions, and polygons, which are fanned into triangles. Anything
+/// else, materials and texture coordinates included, is left to Assimp.
+ParseResult parse_obj(std::string_view text) {
+    auto& pool = ThreadPool::global();
+
+    auto pieces = split_lines(text);
+
+    std::vector<ObjPiece> counts(pieces.size());
+
+    FirstError error;
+
+    pool.parallel_for(pieces.size(), [&](size_t p) {
+        auto& c = counts[p];
+
+        for_each_line(pieces[p], [&](std::string_view line) {
+            Tokens tokens { line };
+
+            auto word = tokens.word();
+
+            if (word.empty() or word.starts_with('#') or word == "s") {
+                return true;
+            }
+
+            if (word == "v") {
+                auto n = tokens.words_left();
+
+                if (n == 6) {
+                    c.colored++;
+                } else if (n != 3 and n != 4) {
+                    error.set("Bad OBJ vertex");
+                }
+
+                c.positions++;
+            } else if (word == "vn") {
+                c.normals++;
+            } else if (word == "f") {
+                size_t n = 0;
+
+                for (auto w = tokens.word(); !w.empty(); w = tokens.word()) {
+                    c.named += std::count(w.begin(), w.end(), '/') == 2;
+                    n++;
+                }
+
+                if (n < 3) error.set("OBJ face with fewer than three corners");
+
+                c.triangles += n - 2;
+                c.corners += n;
+            } else if (word == "o") {
+                c.objects++;
+            } else if (word == "g") {
+                c.groups++;
+            } else {
+                auto name = QString::fromUtf8(word.data(), word.size());
+                error.set(QString("Unsupported OBJ statement %1").arg(name));
+            }
+
+            return !error.failed();
+        });
+    });
+
+    if (error.error()) return *error.error();
+
+    size_t positions, colored, normals, triangles, corners, named, objects,
+        groups;
+
+    auto position_first = offsets_of(counts, &ObjPiece::positions, positions);
+    auto normal_first   = offsets_of(counts, &ObjPiece::normals, normals);
+    auto triangle_first = offsets_of(counts, &ObjPiece::triangles, triangles);
+    offsets_of(counts, &ObjPiece::colored, colored);
+    offsets_of(counts, &ObjPiece::corners, corners);
+    offsets_of(counts, &ObjPiece::named, named);
+    offsets_of(counts, &ObjPiece::objects, objects);
+    offsets_of(counts, &ObjPiece::groups, groups);
+
+    // Assimp makes a mesh of each
+    if (objects > 1 or groups > 1) return "Multiple OBJ objects or groups";
+
+    if (positions == 0) return "No vertices";
+
+    if (colored != 0 and colored != positions) {
+        return "Only some OBJ vertices have colors";
+    }
+
+    if (named != 0 and (named != corners or normals != positions)) {
+        return "OBJ normals are indexed apart from positions";
+    }
+
+    BulkMesh mesh;
+    mesh.positions.resize(positions);
+    mesh.indices.resize(triangles * 3);
+
+    if (colored) mesh.colors.resize(positions);
+    if (named) mesh.normals.resize(normals);
+
+    pool.parallel_for(pieces.size(), [&](size_t p) {
+        size_t position = position_first[p];
+        size_t normal   = normal_first[p];
+
+        uint32_t* out = mesh.indices.data() + triangle_first[p] * 3;
+
+        auto read_face = [&](Tokens& tokens) {
+            uint32_t first = 0, last = 0;
+            size_t   k     = 0;
+
+            for (auto w = tokens.word(); !w.empty(); w = tokens.word(), k++) {
+                int64_t v, vn;
+
+                if (!parse_corner(w, v, vn)) return false;
+
+                auto index = resolve(v, position, positions);
+
+                if (!index) return false;
+
+                // named != 0 means normals and positions go together
+                if (named and resolve(vn, normal, normals) != index) {
+                    return false;
+                }
+
+                if (k == 0) {
+                    first = *index;
+                } else if (k >= 2) {
+                    *out++ = first;
+                    *out++ = last;
+                    *out++ = *index;
+                }
+
+                last = *index;
+            }
+
+            return true;
+        };
+
+        for_each_line(pieces[p], [&](std::string_view line) {
+            Tokens tokens { line };
+
+            auto word = tokens.word();
+
+            if (word == "v") {
+                glm::vec3 color;
+
+                if (!tokens.vec3(mesh.positions[position])) {
+                    error.set("Bad OBJ vertex");
+                } else if (colored and !tokens.vec3(color)) {
+                    error.set("Bad OBJ vertex color");
+                } else if (colored) {
+                    mesh.colors[position] = glm::vec4(color, 1);
+                }
+
+                position++;
+            } else if (word == "vn") {
+                if (named and !tokens.vec3(mesh.normals[normal])) {
+                    error.set("Bad OBJ normal");
+                }
+
+                normal++;
+            } else if (word == "f") {
+                if (!read_face(tokens)) error.set("Bad OBJ face");
+            }
+
+            return !error.failed();
+        });
+    });
+
+    if (error.error()) return *error.error();
+
+    return mesh;
+}
+
+// =============================================================================
+// PLY
+
+enum class PlyType {
+    Int8,
+    UInt8,
+    Int16,
+    UInt16,
+    Int32,
+    UInt32,
+    Float32,
+    Float64,
+};
+
+std::optional<PlyType> ply_type(std::string_view name) {
+    static constexpr std::pair<std::string_view, PlyType> names[] = {
+        { "char", PlyType::Int8 },       { "int8", PlyType::Int8 },
+        { "uchar", PlyType::UInt8 },     { "uint8", PlyType::UInt8 },
+        { "short", PlyType::Int16 },     { "int16", PlyType::Int16 },
+        { "ushort", PlyType::UInt16 },   { "uint16", PlyType::UInt16 },
+        { "int", PlyType::Int32 },       { "int32", PlyType::Int32 },
+        { "uint", PlyType::UInt32 },     { "uint32", PlyType::UInt32 },
+        { "float", PlyType::Float32 },   { "float32", PlyType::Float32 },
+        { "double", PlyType::Float64 },  { "float64", PlyType::Float64 },
+    };
+
+    for (auto const& [n, t] : names) {
+        if (n == name) return t;
+    }
+
+    return std::nullopt;
+}
+
+size_t ply_size(PlyType type) {
+    switch (type) {
+    case PlyType::Int8:
+    case PlyType::UInt8: return 1;
+    case PlyType::Int16:
+    case PlyType::UInt16: return 2;
+    case PlyType::Int32:
+    case PlyType::UInt32:
+    case PlyType::Float32: return 4;
+    case PlyType::Float64: return 8;
+    }
+    return 0;
+}
+
+/// What maps a stored color component onto [0, 1]
+double ply_color_scale(PlyType type) {
+    switch (type) {
+    case PlyType::Int8: return 1.0 / 127;
+    case PlyType::UInt8: return 1.0 / 255;
+    case PlyType::Int16: return 1.0 / 32767;
+    case PlyType::UInt16: return 1.0 / 65535;
+    case PlyType::Int32: return 1.0 / 2147483647;
+    case PlyType::UInt32: return 1.0 / 4294967295;
+    case PlyType::Float32:
+    case PlyType::Float64: return 1;
+    }
+    return 1;
+}
+
+template <class T>
+T load_as(unsigned char const* p, bool swap) {
+    unsigned char bytes[sizeof(T)];
+
+    if (swap) {
+        std::reverse_copy(p, p + sizeof(T), bytes);
+    } else {
+        std::memcpy(bytes, p, sizeof(T));
+    }
+
+    T ret;
+    std::memcpy(&ret, bytes, sizeof(T));
+    return ret;
+}
+
+double load_ply(PlyType type, unsigned char const* p, bool swap) {
+    switch (type) {
+    case PlyType::Int8: return load_as<int8_t>(p, swap);
+    case PlyType::UInt8: return load_as<uint8_t>(p, swap);
+    case PlyType::Int16: return load_as<int16_t>(p, swap);
+    case PlyType::UInt16: return load_as<uint16_t>(p, swap);
+    case PlyType::Int32: return load_as<int32_t>(p, swap);
+    case PlyType::UInt32: return load_as<uint32_t>(p, swap);
+    case PlyType::Float32: return load_as<float>(p, swap);
+    case PlyType::Float64: return load_as<double>(p, swap);
+    }
+    return 0;
+}
+
+struct PlyProperty {
+    std::string_view       name;
+    PlyType                type = PlyType::Float32;
+    std::optional<PlyType> count_type; // set for lists
+    size_t                 offset = 0; // in a binary record, up to a list
+};
+
+struct PlyElement {
+    std::string_view         name;
+    size_t                   count = 0;
+    std::vector<PlyProperty> properties;
+
+    int find(std::string_view name) const {
+        for (size_t i = 0; i < properties.size(); i++) {
+            if (properties[i].name == name) return i;
+        }
+        return -1;
+    }
+
+    bool has_list() const {
+        return std::any_of(properties.begin(),
+                           properties.end(),
+                           [](auto const& p) { return p.count_type; });
+    }
+
+    /// Bytes of a binary record without lists
+    size_t record_size() const {
+        size_t ret = 0;
+        for (auto const& p : properties) {
+            ret += ply_size(p.type);
+        }
+        return ret;
+    }
+};
+
+struct PlyHeader {
+    enum Format {
+        Ascii,
+        LittleEndian,
+        BigEndian,
+    };
+
+    Format                  format = Ascii;
+    std::vector<PlyElement> elements;
+    size_t                  body = 0; // offset of the data
+};
+
+std::variant<PlyHeader, QString> parse_ply_header(std::string_view text) {
+    auto end = text.find("end_header");
+
+    if (!text.starts_with("ply") or end == std::string_view::npos) {
+        return "Not a PLY file";
+    }
+
+    auto body = text.find('\n', end);
+
+    if (body == std::string_view::npos) return "Not a PLY file";
+
+    PlyHeader ret { .body = body + 1 };
+
+    bool    has_format = false;
+    QString error;
+
+    for_each_line(text.substr(0, end), [&](std::string_view line) {
+        Tokens tokens { line };
+
+        auto word = tokens.word();
+
+        if (word == "format") {
+            auto format = tokens.word();
+
+            if (format == "ascii") {
+                ret.format = PlyHeader::Ascii;
+            } else if (format == "binary_little_endian") {
+                ret.format = PlyHeader::LittleEndian;
+            } else if (format == "binary_big_endian") {
+                ret.format = PlyHeader::BigEndian;
+            } else {
+                error = "Unknown PLY format";
+            }
+
+            has_format = true;
+        } else if (word == "element") {
+            PlyElement element { .name = tokens.word() };
+
+            if (!tokens.number(element.count)) error = "Bad PLY element";
+
+            ret.elements.push_back(element);
+        } else if (word == "property") {
+            if (ret.elements.empty()) {
+                error = "PLY property outside an element";
+                return false;
+            }
+
+            auto& element = ret.elements.back();
+
+            PlyProperty property;
+
+            auto type = tokens.word();
+
+            if (type == "list") {
+                property.count_type = ply_type(tokens.word());
+                type                = tokens.word();
+
+                if (!property.count_type) error = "Bad PLY list";
+            }
+
+            auto parsed   = ply_type(type);
+            property.name = tokens.word();
+
+            if (!parsed or property.name.empty()) {
+                error = "Bad PLY property";
+            } else {
+                property.type = *parsed;
+            }
+
+            if (!element.has_list()) property.offset = element.record_size();
+
+            element.properties.push_back(property);
+        } else if (word == "comment" and tokens.word() == "TextureFile") {
+            error = "PLY textures";
+        }
+
+        return error.isEmpty();
+    });
+
+    if (!error.isEmpty()) return error;
+    if (!has_format) return "Not a PLY file";
+
+    return ret;
+}
+
+/// The properties of a vertex we keep, by index into the element
+struct PlyVertexLayout {
+    std::array<int, 3> position;
+    std::array<int, 3> normal;
+    std::array<int, 4> color;
+
+    std::array<double, 4> color_scale = { 1, 1, 1, 1 };
+
+    bool has_normals() const { return normal[0] >= 0; }
+    bool has_colors() const { return color[0] >= 0; }
+};
+
+std::variant<PlyVertexLayout, QString> vertex_layout(PlyElement const& vertex) {
+    if (vertex.has_list()) return "PLY vertex lists";
+
+    for (auto name : { "u", "v", "s", "t", "texture_u", "texture_v" }) {
+        if (vertex.find(name) >= 0) return "PLY texture coordinates";
+    }
+
+    PlyVertexLayout ret {
+        .position = { vertex.find("x"), vertex.find("y"), vertex.find("z") },
+        .normal   = { vertex.find("nx"), vertex.find("ny"), vertex.find("nz") },
+        .color    = { vertex.find("red"),
+                      vertex.find("green"),
+                      vertex.find("blue"),
+                      vertex.find("alpha") },
+    };
+
+    auto all_or_none = [](auto const& indices) {
+        auto found = std::count_if(
+            indices.begin(), indices.end(), [](int i) { return i >= 0; });
+        return found == 0 or found == 3;
+    };
+
+    if (std::ranges::find(ret.position, -1) != ret.position.end()) {
+        return "PLY vertices without positions";
+    }
+
+    if (!all_or_none(ret.normal)) return "Partial PLY normals";
+
+    if (!all_or_none(std::span(ret.color).first<3>())) {
+        return "Partial PLY colors";
+    }
+
+    for (size_t i = 0; i < 4; i++) {
+        if (ret.color[i] < 0) continue;
+
+        auto type          = vertex.properties[ret.color[i]].type;
+        ret.color_scale[i] = ply_color_scale(type);
+    }
+
+    return ret;
+}
+
+/// Store vertex `i`; `value(property)` reads one property of it
+template <class Value>
+void store_vertex(BulkMesh&              mesh,
+                  size_t                 i,
+                  PlyVertexLayout const& layout,
+                  Value&&                value) {
+    auto vec3 = [&](std::array<int, 3> const& p) {
+        return glm::vec3(value(p[0]), value(p[1]), value(p[2]));
+    };
+
+    mesh.positions[i] = vec3(layout.position);
+
+    if (layout.has_normals()) mesh.normals[i] = vec3(layout.normal);
+
+    if (layout.has_colors()) {
+        auto& c = mesh.colors[i];
+
+        for (int k = 0; k < 4; k++) {
+            c[k] = layout.color[k] < 0
+                       ? 1.0
+                       : value(layout.color[k]) * layout.color_scale[k];
+        }
+    }
+}
+
+/// Where the vertex indices of a face are, and what surrounds them
+struct PlyFaceLayout {
+    int     list = -1;
+    PlyType count_type;
+    PlyType index_type;
+    size_t  before = 0; // bytes of the properties before the list
+    size_t  after  = 0; // and after it
+};
+
+std::variant<PlyFaceLayout, QString> face_layout(PlyElement const& face) {
+    PlyFaceLayout ret;
+
+    for (size_t i = 0; i < face.properties.size(); i++) {
+        auto const& p = face.properties[i];
+
+        if (p.count_type) {
+            if (ret.list >= 0 or
+                (p.name != "vertex_indices" and p.name != "vertex_index")) {
+                return "Unsupported PLY face lists";
+            }
+
+            ret.list       = i;
+            ret.count_type = *p.count_type;
+            ret.index_type = p.type;
+        } else {
+            (ret.list < 0 ? ret.before : ret.after) += ply_size(p.type);
+        }
+    }
+
+    if (ret.list < 0) return "PLY faces without vertex indices";
+
+    return ret;
+}
+
+/// Check and fan a polygon into `out`. Returns false on a bad index.
+template <class Index>
+bool fan_polygon(size_t     corners,
+                 Index&&    index,
+                 size_t     vertex_count,
+                 uint32_t*& out) {
+    for (size_t k = 0; k < corners; k++) {
+        if (index(k) >= vertex_count) return false;
+    }
+
+    for (size_t k = 2; k < corners; k++) {
+        *out++ = index(0);
+        *out++ = index(k - 1);
+        *out++ = index(k);
+    }
+
+    return true;
+}
+
+size_t fan_size(size_t corners) { return corners < 3 ? 0 : corners - 2; }
+
+/// Binary PLY. Fixed size records are decoded in place, in parallel. Faces
+/// are first assumed to all be triangles, so they are fixed size too; if
+/// that is wrong, their offsets are walked once, keeping one in every run of
+/// records, and the runs are decoded in parallel.
+ParseResult parse_binary_ply(Bytes bytes, PlyHeader const& header) {
+    auto& pool = ThreadPool::global();
+
+    bool const swap = header.format == PlyHeader::BigEndian;
+
+    PlyElement const* vertex      = nullptr;
+    PlyElement const* face        = nullptr;
+    size_t            vertex_data = 0;
+    size_t            face_data   = 0;
+
+    // the data of an element only has a known offset if everything before
+    // it has fixed size records
+    size_t offset = header.body;
+
+    for (auto const& element : header.elements) {
+        if (element.name == "vertex") {
+            vertex      = &element;
+            vertex_data = offset;
+        } else if (element.name == "face") {
+            if (!vertex) return "PLY faces before vertices";
+
+            face      = &element;
+            face_data = offset;
+            break;
+        }
+
+        if (element.has_list()) return "Unsupported PLY lists";
+
+        offset += element.count * element.record_size();
+    }
+
+    if (!vertex) return "No PLY vertices";
+
+    auto layout = vertex_layout(*vertex);
+
+    if (auto* err = std::get_if<QString>(&layout)) return *err;
+
+    auto const& vl = std::get<PlyVertexLayout>(layout);
+
+    size_t const record = vertex->record_size();
+    size_t const count  = vertex->count;
+
+    if (bytes.size() < vertex_data + count * record) {
+        return "Truncated PLY vertices";
+    }
+
+    BulkMesh mesh;
+    mesh.positions.resize(count);
+
+    if (vl.has_normals()) mesh.normals.resize(count);
+    if (vl.has_colors()) mesh.colors.resize(count);
+
+    pool.parallel_chunks(count, [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; i++) {
+            auto const* data = bytes.data() + vertex_data + i * record;
+
+            store_vertex(mesh, i, vl, [&](int p) {
+                auto const& property = vertex->properties[p];
+                return load_ply(property.type, data + property.offset, swap);
+            });
+        }
+    });
+
+    if (!face or face->count == 0) return mesh;
+
+    auto flayout = face_layout(*face);
+
+    if (auto* err = std::get_if<QString>(&flayout)) return *err;
+
+    auto const& fl = std::get<PlyFaceLayout>(flayout);
+
+    size_t const count_size = ply_size(fl.count_type);
+    size_t const index_size = ply_size(fl.index_type);
+
+    auto const* end = bytes.data() + bytes.size();
+
+    struct Run {
+        unsigned char const* data           = nullptr;
+        size_t               first_triangle = 0;
+        size_t               count          = 0;
+    };
+
+    /// Decode a run of faces. With `triangles_only`, anything but a triangle
+    /// stops it, as the runs were laid out assuming there was nothing else.
+    auto decode = [&](Run const& run, bool triangles_only, FirstError& error) {
+        auto const* data = run.data;
+        uint32_t*   out  = mesh.indices.data() + run.first_triangle * 3;
+
+        for (size_t f = 0; f < run.count and !error.failed(); f++) {
+            auto const* list = data + fl.before;
+
+            size_t corners = load_ply(fl.count_type, list, swap);
+
+            if (triangles_only and corners != 3) {
+                error.set("Not only triangles");
+                return;
+            }
+
+            auto const* indices = list + count_size;
+
+            auto index = [&](size_t k) -> uint32_t {
+                return load_ply(
+                    fl.index_type, indices + k * index_size, swap);
+            };
+
+            if (!fan_polygon(corners, index, count, out)) {
+                error.set("PLY face index out of range");
+            }
+
+            data = indices + corners * index_size + fl.after;
+        }
+    };
+
+    size_t const triangle_record =
+        fl.before + count_size + 3 * index_size + fl.after;
+
+    std::vector<Run> runs;
+
+    bool const fits_triangles =
+        bytes.size() >= face_data + face->count * triangle_record;
+
+    if (fits_triangles) {
+        FirstError error;
+
+        auto const* data = bytes.data() + face_data;
+
+        for (size_t f = 0; f < face->count; f += record_run) {
+            runs.push_back({
+                .data           = data + f * triangle_record,
+                .first_triangle = f,
+                .count          = std::min(record_run, face->count - f),
+            });
+        }
+
+        mesh.indices.resize(face->count * 3);
+
+        pool.parallel_for(runs.size(),
+                          [&](size_t r) { decode(runs[r], true, error); });
+
+        if (!error.error()) return mesh;
+
+        // Runs fail in any order, and past the first non-triangle they read
+        // other fields as indices, so an index out of range may come first.
+        // Any error is only trusted from the walk.
+    }
+
+    // mixed polygons, or an error: walk the records to find where each run
+    // starts
+    runs.clear();
+
+    auto const* data      = bytes.data() + face_data;
+    size_t      triangles = 0;
+
+    for (size_t f = 0; f < face->count; f++) {
+        if (data + fl.before + count_size > end) {
+            return "Truncated PLY faces";
+        }
+
+        if (f % record_run == 0) {
+            runs.push_back({ .data = data, .first_triangle = triangles });
+        }
+
+        runs.back().count++;
+
+        size_t corners = load_ply(fl.count_type, data + fl.before, swap);
+
+        triangles += fan_size(corners);
+
+        data += fl.before + count_size + corners * index_size + fl.after;
+    }
+
+    if (data > end) return "Truncated PLY faces";
+
+    FirstError error;
+
+    mesh.indices.assign(triangles * 3, 0);
+
+    pool.parallel_for(runs.size(),
+                      [&](size_t r) { decode(runs[r], false, error); });
+
+    if (error.error()) return *error.error();
+
+    return mesh;
+}
+
+/// ASCII PLY. Every record is a line; lines are counted per piece first, so
+/// each piece knows which element its lines belong to.
+ParseResult parse_ascii_ply(std::string_view text, PlyHeader const& header) {
+    auto& pool = ThreadPool::global();
+
+    auto pieces = split_lines(text.substr(header.body));
+
+    // first line of every element
+    std::vector<size_t> element_first;
+    size_t              lines = 0;
+
+    int vertex_element = -1;
+    int face_element   = -1;
+
+    for (size_t e = 0; e < header.elements.size(); e++) {
+        auto const& element = header.elements[e];
+
+        if (element.name == "vertex") vertex_element = e;
+        if (element.name == "face") face_element = e;
+
+        element_first.push_back(lines);
+        lines += element.count;
+    }
+
+    element_first.push_back(lines);
+
+    if (vertex_element < 0) return "No PLY vertices";
+
+    auto const& vertex = header.elements[vertex_element];
+
+    auto layout = vertex_layout(vertex);
+
+    if (auto* err = std::get_if<QString>(&layout)) return *err;
+
+    auto const& vl = std::get<PlyVertexLayout>(layout);
+
+    PlyFaceLayout fl;
+
+    if (face_element >= 0) {
+        auto flayout = face_layout(header.elements[face_element]);
+
+        if (auto* err = std::get_if<QString>(&flayout)) return *err;
+
+        fl = std::get<PlyFaceLayout>(flayout);
+    }
+
+    auto const& properties = vertex.properties;
+
+    if (properties.size() > 32) return "Too many PLY vertex properties";
+
+    struct Piece {
+        size_t lines     = 0;
+        size_t triangles = 0;
+    };
+
+    std::vector<Piece> counts(pieces.size());
+
+    pool.parallel_for(pieces.size(), [&](size_t p) {
+        for_each_line(pieces[p], [&](std::string_view line) {
+            counts[p].lines += !Tokens { line }.word().empty();
+            return true;
+        });
+    });
+
+    size_t total_lines;
+    auto   line_first = offsets_of(counts, &Piece::lines, total_lines);
+
+    if (total_lines < lines) return "Truncated PLY";
+
+    BulkMesh mesh;
+    mesh.positions.resize(vertex.count);
+
+    if (vl.has_normals()) mesh.normals.resize(vertex.count);
+    if (vl.has_colors()) mesh.colors.resize(vertex.count);
+
+    FirstError error;
+
+    /// Visit the lines of a piece with the element and index they belong to
+    auto walk = [&](size_t p, auto&& f) {
+        size_t line    = line_first[p];
+        size_t element = 0;
+
+        for_each_line(pieces[p], [&](std::string_view text) {
+            Tokens tokens { text };
+
+            if (tokens.words_left() == 0) return true;
+
+            while (element + 1 < element_first.size() and
+                   line >= element_first[element + 1]) {
+                element++;
+            }
+
+            if (element >= header.elements.size()) return false;
+
+            f(element, line - element_first[element], tokens);
+
+            line++;
+
+            return !error.failed();
+        });
+    };
+
+    /// Skip the face properties before the index list and read its length
+    auto face_corners = [&](Tokens& tokens) -> std::optional<size_t> {
+        for (int i = 0; i < fl.list; i++) {
+            tokens.word();
+        }
+
+        size_t corners;
+        if (!tokens.number(corners)) return std::nullopt;
+        return corners;
+    };
+
+    // vertices, and how many triangles the faces of each piece make
+    pool.parallel_for(pieces.size(), [&](size_t p) {
+        walk(p, [&](size_t element, size_t i, Tokens& tokens) {
+            if ((int)element == vertex_element) {
+                std::array<double, 32> values;
+
+                for (size_t k = 0; k < properties.size(); k++) {
+                    if (!tokens.number(values[k])) {
+                        error.set("Bad PLY vertex");
+                        return;
+                    }
+                }
+
+                store_vertex(mesh, i, vl, [&](int k) { return values[k]; });
+            } else if ((int)element == face_element) {
+                auto corners = face_corners(tokens);
+
+                if (!corners) {
+                    error.set("Bad PLY face");
+                    return;
+                }
+
+                counts[p].triangles += fan_size(*corners);
+            }
+        });
+    });
+
+    if (error.error()) return *error.error();
+
+    if (face_element < 0) return mesh;
+
+    size_t triangles;
+    auto   triangle_first = offsets_of(counts, &Piece::triangles, triangles);
+
+    if (triangles == 0) return mesh;
+
+    mesh.indices.resize(triangles * 3);
+
+    pool.parallel_for(pieces.size(), [&](size_t p) {
+        uint32_t* out = mesh.indices.data() + triangle_first[p] * 3;
+
+        walk(p, [&](size_t element, size_t, Tokens& tokens) {
+            if ((int)element != face_element) return;
+
+            auto corners = face_corners(tokens);
+
+            std::array<uint32_t, 64> indices;
+
+            if (!corners or *corners > indices.size()) {
+                error.set("Bad PLY face");
+                return;
+            }
+
+            for (size_t k = 0; k < *corners; k++) {
+                if (!tokens.number(indices[k])) {
+                    error.set("Bad PLY face");
+                    return;
+                }
+            }
+
+            auto index = [&](size_t k) { return indices[k]; };
+
+            if (!fan_polygon(*corners, index, vertex.count, out)) {
+                error.set("PLY face index out of range");
+            }
+        });
+    });
+
+    if (error.error()) return *error.error();
+
+    return mesh;
+}
+
+ParseResult parse_ply(Bytes bytes) {
+    auto header = parse_ply_header(as_text(bytes));
+
+    if (auto* err = std::get_if<QString>(&header)) return *err;
+
+    auto const& h = std::get<PlyHeader>(header);
+
+    if (h.format == PlyHeader::Ascii) return parse_ascii_ply(as_text(bytes), h);
+
+    return parse_binary_ply(bytes, h);
+}
+
+// =============================================================================
+
+template <class To, class From>
+To* to_assimp_array(std::vector<From> const& values) {
+    static_assert(sizeof(To) == sizeof(From));
+
+    auto* ret = new To[values.size()];
+
+    auto& pool = ThreadPool::global();
+
+    pool.parallel_chunks(values.size(), [&](size_t b, size_t e) {
+        std::memcpy(ret + b, values.data() + b, (e - b) * sizeof(To));
+    });
+
+    return ret;
+}
+
+/// Wrap a parsed mesh in a scene shaped like the one Assimp would make: the
+/// mesh on the root node, with a plain grey material
+std::shared_ptr<aiScene> make_scene(BulkMesh const& bulk, QString name) {
+    auto mesh = new aiMesh;
+
+    mesh->mName          = aiString(name.toStdString());
+    mesh->mMaterialIndex = 0;
+
+    mesh->mNumVertices = bulk.positions.size();
+    mesh->mVertices    = to_assimp_array<aiVector3D>(bulk.positions);
+
+    if (!bulk.normals.empty()) {
+        mesh->mNormals = to_assimp_array<aiVector3D>(bulk.normals);
+    }
+
+    if (!bulk.colors.empty()) {
+        mesh->mColors[0] = to_assimp_array<aiColor4D>(bulk.colors);
+    }
+
+    if (bulk.indices.empty()) {
+        mesh->mPrimitiveTypes = aiPrimitiveType_POINT;
+    } else {
+        mesh->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+        mesh->mNumFaces       = bulk.indices.size() / 3;
+        mesh->mFaces          = new aiFace[mesh->mNumFaces];
+
+        ThreadPool::global().parallel_chunks(
+            mesh->mNumFaces, [&](size_t b, size_t e) {
+                for (size_t f = b; f < e; f++) {
+                    auto& face       = mesh->mFaces[f];
+                    face.mNumIndices = 3;
+                    face.mIndices    = new unsigned[3];
+                    std::copy_n(bulk.indices.data() + f * 3, 3, face.mIndices);
+                }
+            });
+    }
+
+    auto material = new aiMaterial;
+
+    aiString  material_name("DefaultMaterial");
+    aiColor4D grey(0.6f, 0.6f, 0.6f, 1.0f);
+
+    material->AddProperty(&material_name, AI_MATKEY_NAME);
+    material->AddProperty(&grey, 1, AI_MATKEY_COLOR_DIFFUSE);
+
+    auto scene = std::make_shared<aiScene>();
+
+    scene->mNumMeshes    = 1;
+    scene->mMeshes       = new aiMesh*[1] { mesh };
+    scene->mNumMaterials = 1;
+    scene->mMaterials    = new aiMaterial*[1] { material };
+
+    scene->mRootNode             = new aiNode(name.toStdString());
+    scene->mRootNode->mNumMeshes = 1;
+    scene->mRootNode->mMeshes    = new unsigned[1] { 0 };
+
+    return scene;
+}
+
+} // namespace
+
+bool is_bulk_path(QString path) {
+    return path.endsWith(".stl", Qt::CaseInsensitive) or
+           path.endsWith(".obj", Qt::CaseInsensitive) or
+           path.endsWith(".ply", Qt::CaseInsensitive);
+}
+
+std::variant<std::shared_ptr<aiScene>, QString> load_bulk(QString path) {
+    QElapsedTimer timer;
+    timer.start();
+
+    QFile file(path);
+
+    if (!file.open(QFile::ReadOnly)) return "Unable to open file";
+
+    if (file.size() == 0) return "Empty file";
+
+    auto* mapped = file.map(0, file.size());
+
+    if (!mapped) return "Unable to map file";
+
+    Bytes bytes(mapped, file.size());
+
+    QFileInfo info(path);
+
+    auto suffix = info.suffix().toLower();
+
+    auto parsed = suffix == "stl"   ? parse_stl(bytes)
+                  : suffix == "obj" ? parse_obj(as_text(bytes))
+                                    : parse_ply(bytes);
+
+    if (auto* err = std::get_if<QString>(&parsed)) return *err;
+
+    auto& mesh = std::get<BulkMesh>(parsed);
+
+    auto scene = make_scene(mesh, info.completeBaseName());
+
+    qInfo() << "Parsed" << path << "natively |" << mesh.positions.size()
+            << "vertices," << mesh.indices.size() / 3 << "triangles in"
+            << timer.elapsed() << "ms";
+
+    return scene;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <QString>
+
+#include <memory>
+#include <variant>
+
+struct aiScene;
+
+bool is_bulk_path(QString path);
+
+/// Parse an STL, OBJ or PLY file with the native parsers. The file is mapped
+/// and split at line or record boundaries, and every piece is parsed on the
+/// thread pool. What comes back is one indexed triangle mesh, or one point
+/// mesh, as Assimp would make of the file before post-processing; normals
+/// the file lacks are left to process_meshes. Returns an error if the file
+/// uses something the native parsers do not handle, such as OBJ materials;
+/// callers should then fall back to Assimp. Thread safe.
+std::variant<std::shared_ptr<aiScene>, QString> load_bulk(QString path);
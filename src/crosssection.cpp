@@ -0,0 +1,579 @@
+#include "crosssection.h"
+
+#include "threadpool.h"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <limits>
+
+namespace {
+
+// work per task
+constexpr size_t block_triangles = 65536;
+constexpr size_t block_boxes     = 16384;
+constexpr size_t block_leaves    = 1024;
+constexpr size_t block_slabs     = 256;
+
+constexpr uint32_t none = std::numeric_limits<uint32_t>::max();
+
+/// Run `f(begin, end, out)` on blocks of [0, count) in parallel, and join
+/// what each block put out in block order
+template <class T, class F>
+std::vector<T> gather(size_t count, size_t block, F const& f) {
+    size_t const blocks = (count + block - 1) / block;
+
+    std::vector<std::vector<T>> parts(blocks);
+
+    auto run = [&](size_t bi) {
+        f(bi * block, std::min(count, (bi + 1) * block), parts[bi]);
+    };
+
+    if (blocks == 1) {
+        run(0);
+    } else if (blocks > 1) {
+        ThreadPool::global().parallel_for(blocks, run);
+    }
+
+    if (parts.size() == 1) return std::move(parts.front());
+
+    size_t total = 0;
+    for (auto const& part : parts) {
+        total += part.size();
+    }
+
+    std::vector<T> ret;
+    ret.reserve(total);
+
+    for (auto const& part : parts) {
+        ret.insert(ret.end(), part.begin(), part.end());
+    }
+
+    return ret;
+}
+
+/// Spread the low 10 bits of `v` out to every third bit
+uint32_t spread_bits(uint32_t v) {
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+}
+
+/// Position along a Morton curve of a point in [0, 1] cubed
+uint32_t morton_code(glm::vec3 p) {
+    auto cell = glm::uvec3(glm::clamp(p * 1024.0f, 0.0f, 1023.0f));
+    return spread_bits(cell.x) | (spread_bits(cell.y) << 1) |
+           (spread_bits(cell.z) << 2);
+}
+
+uint64_t edge_key(uint32_t a, uint32_t b) {
+    if (a > b) std::swap(a, b);
+    return (uint64_t(a) << 32) | b;
+}
+
+bool plane_cuts(Plane const& plane, Bounds const& b) {
+    auto center = (b.min + b.max) * 0.5f;
+    auto half   = (b.max - b.min) * 0.5f;
+
+    // a little slack, so triangles touching the plane are never culled
+    auto reach = glm::dot(glm::abs(plane.normal), half) * 1.0001f;
+
+    return std::abs(plane.distance(center)) <= reach;
+}
+
+/// One triangle cut by a plane: where it crosses its two cut edges, keyed by
+/// the vertices of each edge
+struct Segment {
+    std::array<uint64_t, 2>  edges;
+    std::array<glm::vec3, 2> points;
+};
+
+/// Join segments that share an edge into lines, open ones first so each is
+/// walked from one of its ends
+std::vector<Section::Line> chain(std::vector<Segment> const& segments) {
+    size_t const ends = segments.size() * 2;
+
+    std::vector<std::pair<uint64_t, uint32_t>> keyed(ends);
+
+    ThreadPool::global().parallel_chunks(ends, [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; i++) {
+            keyed[i] = { segments[i / 2].edges[i % 2], (uint32_t)i };
+        }
+    });
+
+    parallel_sort(keyed);
+
+    // edges shared by more than two triangles are paired off in order
+    std::vector<uint32_t> partner(ends, none);
+
+    for (size_t i = 0; i + 1 < ends; i++) {
+        if (keyed[i].first != keyed[i + 1].first) continue;
+
+        partner[keyed[i].second]     = keyed[i + 1].second;
+        partner[keyed[i + 1].second] = keyed[i].second;
+        i++;
+    }
+
+    std::vector<bool>          used(segments.size());
+    std::vector<Section::Line> ret;
+
+    auto walk = [&](uint32_t s, uint32_t k) {
+        Section::Line line;
+
+        auto push = [&](glm::vec3 p) {
+            if (line.points.empty() or line.points.back() != p) {
+                line.points.push_back(p);
+            }
+        };
+
+        auto const start = s;
+
+        push(segments[s].points[k]);
+
+        while (true) {
+            used[s] = true;
+
+            push(segments[s].points[1 - k]);
+
+            auto next = partner[2 * s + 1 - k];
+
+            if (next == none) break;
+
+            s = next / 2;
+            k = next % 2;
+
+            if (used[s]) {
+                line.closed = s == start;
+                break;
+            }
+        }
+
+        // the way back in crosses the first edge again
+        if (line.closed and line.points.size() > 1 and
+            line.points.back() == line.points.front()) {
+            line.points.pop_back();
+        }
+
+        ret.push_back(std::move(line));
+    };
+
+    for (uint32_t e = 0; e < ends; e++) {
+        if (partner[e] == none and !used[e / 2]) walk(e / 2, e % 2);
+    }
+
+    for (uint32_t s = 0; s < segments.size(); s++) {
+        if (!used[s]) walk(s, 0);
+    }
+
+    return ret;
+}
+
+/// An edge of a closed line in the coordinates of the plane, low end first
+struct CapEdge {
+    glm::vec2 lo, hi;
+    glm::vec3 lo_point, hi_point;
+
+    float x_at(float y) const {
+        return lo.x + (hi.x - lo.x) * ((y - lo.y) / (hi.y - lo.y));
+    }
+
+    glm::vec3 point_at(float y) const {
+        return lo_point + (hi_point - lo_point) * ((y - lo.y) / (hi.y - lo.y));
+    }
+};
+
+/// Fill the closed lines, by the even-odd rule so that inner lines make
+/// holes. The plane is cut into slabs between consecutive heights of line
+/// points; within a slab the edges crossing it never cross each other, so
+/// sorting them across the slab and pairing them off gives trapezoids.
+void fill(Plane const& plane, Section& section) {
+    auto n = glm::normalize(plane.normal);
+    auto u = glm::normalize(glm::cross(
+        n, std::abs(n.x) < 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0)));
+    auto v = glm::cross(n, u);
+
+    auto flat = [&](glm::vec3 p) {
+        return glm::vec2(glm::dot(p, u), glm::dot(p, v));
+    };
+
+    std::vector<CapEdge> edges;
+    std::vector<float>   heights;
+
+    for (auto const& line : section.lines) {
+        if (!line.closed) continue;
+
+        auto const& points = line.points;
+
+        for (size_t i = 0; i < points.size(); i++) {
+            auto a = points[i];
+            auto b = points[(i + 1) % points.size()];
+
+            auto fa = flat(a);
+            auto fb = flat(b);
+
+            heights.push_back(fa.y);
+
+            // level edges bound no slab
+            if (fa.y == fb.y) continue;
+
+            if (fa.y < fb.y) {
+                edges.push_back({ fa, fb, a, b });
+            } else {
+                edges.push_back({ fb, fa, b, a });
+            }
+        }
+    }
+
+    if (edges.empty()) return;
+
+    std::sort(heights.begin(), heights.end());
+    heights.erase(std::unique(heights.begin(), heights.end()), heights.end());
+
+    std::sort(edges.begin(), edges.end(), [](auto const& a, auto const& b) {
+        return a.lo.y < b.lo.y;
+    });
+
+    using Quad = std::array<glm::vec3, 4>;
+
+    auto quads = gather<Quad>(
+        heights.size() - 1,
+        block_slabs,
+        [&](size_t first, size_t last, std::vector<Quad>& out) {
+            std::vector<uint32_t> active;
+
+            size_t next = 0;
+
+            for (size_t s = first; s < last; s++) {
+                auto const y0 = heights[s];
+                auto const y1 = heights[s + 1];
+
+                std::erase_if(active,
+                              [&](uint32_t e) { return edges[e].hi.y <= y0; });
+
+                for (; next < edges.size() and edges[next].lo.y <= y0; next++) {
+                    if (edges[next].hi.y > y0) active.push_back(next);
+                }
+
+                auto const mid = (y0 + y1) * 0.5f;
+
+                std::sort(active.begin(), active.end(), [&](auto a, auto b) {
+                    return edges[a].x_at(mid) < edges[b].x_at(mid);
+                });
+
+                for (size_t i = 0; i + 1 < active.size(); i += 2) {
+                    auto const& left  = edges[active[i]];
+                    auto const& right = edges[active[i + 1]];
+
+                    out.push_back({ left.point_at(y0),
+                                    right.point_at(y0),
+                                    right.point_at(y1),
+                                    left.point_at(y1) });
+                }
+            }
+        });
+
+    auto const base = (uint32_t)section.cap_positions.size();
+
+    section.cap_positions.reserve(base + quads.size() * 4);
+    section.cap_indices.reserve(section.cap_indices.size() + quads.size() * 6);
+
+    for (size_t q = 0; q < quads.size(); q++) {
+        auto const first = base + (uint32_t)(q * 4);
+
+        section.cap_positions.insert(
+            section.cap_positions.end(), quads[q].begin(), quads[q].end());
+
+        for (uint32_t corner : { 0, 1, 2, 0, 2, 3 }) {
+            section.cap_indices.push_back(first + corner);
+        }
+    }
+}
+
+} // namespace
+
+Plane Plane::pulled_back(glm::mat4 const& tf) const {
+    // n . (L p + t) = d  is  (L^T n) . p = d - n . t
+    return {
+        glm::transpose(glm::mat3(tf)) * normal,
+        offset - glm::dot(normal, glm::vec3(tf[3])),
+    };
+}
+
+size_t Section::closed_count() const {
+    return std::count_if(
+        lines.begin(), lines.end(), [](auto const& l) { return l.closed; });
+}
+
+size_t Section::point_count() const {
+    size_t ret = 0;
+    for (auto const& line : lines) {
+        ret += line.points.size();
+    }
+    return ret;
+}
+
+void Section::append(Section&& other) {
+    auto const base = (uint32_t)cap_positions.size();
+
+    for (auto& line : other.lines) {
+        lines.push_back(std::move(line));
+    }
+
+    cap_positions.insert(cap_positions.end(),
+                         other.cap_positions.begin(),
+                         other.cap_positions.end());
+
+    for (auto index : other.cap_indices) {
+        cap_indices.push_back(base + index);
+    }
+
+    segment_count += other.segment_count;
+}
+
+// =============================================================================
+
+MeshBVH::MeshBVH(std::span<glm::vec3 const> positions,
+                 std::span<uint32_t const>  indices)
+    : m_positions(positions.begin(), positions.end()) {
+    auto& pool = ThreadPool::global();
+
+    auto const vertex_count = (uint32_t)positions.size();
+
+    size_t const count =
+        indices.empty() ? positions.size() / 3 : indices.size() / 3;
+
+    m_triangles.resize(count);
+
+    std::atomic<bool> out_of_range = false;
+
+    pool.parallel_chunks(count, [&](size_t b, size_t e) {
+        bool bad = false;
+
+        for (size_t i = b; i < e; i++) {
+            if (indices.empty()) {
+                m_triangles[i] = glm::uvec3(i * 3, i * 3 + 1, i * 3 + 2);
+                continue;
+            }
+
+            glm::uvec3 t(
+                indices[i * 3], indices[i * 3 + 1], indices[i * 3 + 2]);
+
+            bad |= glm::any(
+                glm::greaterThanEqual(t, glm::uvec3(vertex_count)));
+
+            m_triangles[i] = t;
+        }
+
+        if (bad) out_of_range = true;
+    });
+
+    if (out_of_range) {
+        std::erase_if(m_triangles, [&](glm::uvec3 t) {
+            return glm::any(glm::greaterThanEqual(t, glm::uvec3(vertex_count)));
+        });
+    }
+
+    auto const triangles = m_triangles.size();
+
+    if (triangles == 0) return;
+
+    auto centroid = [this](glm::uvec3 t) {
+        return (m_positions[t.x] + m_positions[t.y] + m_positions[t.z]) /
+               3.0f;
+    };
+
+    // sort along the curve, the triangle index riding in the low bits
+    auto centroid_boxes =
+        gather<Bounds>(triangles,
+                       block_triangles,
+                       [&](size_t b, size_t e, std::vector<Bounds>& out) {
+                           Bounds box;
+                           for (size_t i = b; i < e; i++) {
+                               box.grow(centroid(m_triangles[i]));
+                           }
+                           out.push_back(box);
+                       });
+
+    Bounds centroids;
+    for (auto const& box : centroid_boxes) {
+        centroids.grow(box);
+    }
+
+    auto const scale = 1.0f / glm::max(centroids.size(), glm::vec3(1e-30f));
+
+    std::vector<uint64_t> keys(triangles);
+
+    pool.parallel_chunks(triangles, [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; i++) {
+            auto p  = (centroid(m_triangles[i]) - centroids.min) * scale;
+            keys[i] = (uint64_t(morton_code(p)) << 32) | i;
+        }
+    });
+
+    parallel_sort(keys);
+
+    {
+        std::vector<glm::uvec3> sorted(triangles);
+
+        pool.parallel_chunks(triangles, [&](size_t b, size_t e) {
+            for (size_t i = b; i < e; i++) {
+                sorted[i] = m_triangles[keys[i] & 0xFFFFFFFF];
+            }
+        });
+
+        m_triangles = std::move(sorted);
+    }
+
+    // leaves, then every level above until one box is left
+    std::vector<Bounds> level((triangles + leaf_size - 1) / leaf_size);
+
+    pool.parallel_chunks(level.size(), [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; i++) {
+            auto last = std::min(triangles, (i + 1) * leaf_size);
+            for (size_t t = i * leaf_size; t < last; t++) {
+                for (int k = 0; k < 3; k++) {
+                    level[i].grow(m_positions[m_triangles[t][k]]);
+                }
+            }
+        }
+    });
+
+    m_levels.push_back(std::move(level));
+
+    while (m_levels.back().size() > 1) {
+        auto const& below = m_levels.back();
+
+        std::vector<Bounds> above((below.size() + fanout - 1) / fanout);
+
+        pool.parallel_chunks(above.size(), [&](size_t b, size_t e) {
+            for (size_t i = b; i < e; i++) {
+                auto last = std::min(below.size(), (i + 1) * fanout);
+                for (size_t c = i * fanout; c < last; c++) {
+                    above[i].grow(below[c]);
+                }
+            }
+        });
+
+        m_levels.push_back(std::move(above));
+    }
+}
+
+Bounds MeshBVH::bounds() const {
+    if (m_levels.empty()) return {};
+    return m_levels.back().front();
+}
+
+std::vector<uint32_t> MeshBVH::leaves_cut(Plane const& plane) const {
+    if (m_levels.empty()) return {};
+
+    // the root, then the children of every box cut a level up
+    std::vector<uint32_t> ret;
+
+    if (plane_cuts(plane, m_levels.back().front())) ret.push_back(0);
+
+    for (size_t l = m_levels.size() - 1; l-- > 0 and !ret.empty();) {
+        auto const& boxes = m_levels[l];
+
+        auto expand = [&](size_t b, size_t e, std::vector<uint32_t>& out) {
+            for (size_t i = b; i < e; i++) {
+                size_t first = size_t(ret[i]) * fanout;
+                size_t last  = std::min(boxes.size(), first + fanout);
+
+                for (auto c = first; c < last; c++) {
+                    if (plane_cuts(plane, boxes[c])) out.push_back(c);
+                }
+            }
+        };
+
+        ret = gather<uint32_t>(ret.size(), block_boxes, expand);
+    }
+
+    return ret;
+}
+
+Section MeshBVH::slice(Plane const&     plane,
+                       glm::mat4 const& tf,
+                       bool             cap) const {
+    auto leaves = leaves_cut(plane);
+
+    auto cut = [&](size_t b, size_t e, std::vector<Segment>& out) {
+        for (size_t li = b; li < e; li++) {
+            auto first = leaves[li] * leaf_size;
+            auto last  = std::min(m_triangles.size(), first + leaf_size);
+
+            for (size_t t = first; t < last; t++) {
+                auto const& tri = m_triangles[t];
+
+                std::array<float, 3> d;
+                std::array<bool, 3>  above;
+
+                for (int k = 0; k < 3; k++) {
+                    d[k]     = plane.distance(m_positions[tri[k]]);
+                    above[k] = d[k] > 0;
+                }
+
+                if (above[0] == above[1] and above[1] == above[2]) continue;
+
+                Segment segment;
+                int     found = 0;
+
+                for (int k = 0; k < 3; k++) {
+                    int a = k;
+                    int c = (k + 1) % 3;
+
+                    if (above[a] == above[c]) continue;
+
+                    // measured from the lower vertex index, so that both
+                    // triangles of an edge agree to the bit
+                    if (tri[a] > tri[c]) std::swap(a, c);
+
+                    auto const& pa = m_positions[tri[a]];
+                    auto const& pc = m_positions[tri[c]];
+
+                    segment.edges[found] = edge_key(tri[a], tri[c]);
+                    segment.points[found] =
+                        pa + (pc - pa) * (d[a] / (d[a] - d[c]));
+                    found++;
+                }
+
+                out.push_back(segment);
+            }
+        }
+    };
+
+    auto segments = gather<Segment>(leaves.size(), block_leaves, cut);
+
+    Section ret;
+    ret.segment_count = segments.size();
+
+    if (segments.empty()) return ret;
+
+    ret.lines = chain(segments);
+
+    if (cap) fill(plane, ret);
+
+    auto move = [&](glm::vec3& p) { p = glm::vec3(tf * glm::vec4(p, 1)); };
+
+    for (auto& line : ret.lines) {
+        std::for_each(line.points.begin(), line.points.end(), move);
+    }
+
+    std::for_each(ret.cap_positions.begin(), ret.cap_positions.end(), move);
+
+    return ret;
+}
+
+size_t MeshBVH::byte_size() const {
+    size_t ret = m_positions.size() * sizeof(glm::vec3) +
+                 m_triangles.size() * sizeof(glm::uvec3);
+
+    for (auto const& level : m_levels) {
+        ret += level.size() * sizeof(Bounds);
+    }
+
+    return ret;
+}
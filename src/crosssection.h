@@ -0,0 +1,84 @@
+#pragma once
+
+#include "transformtree.h"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/// The points p with dot(normal, p) == offset. The normal need not be of
+/// unit length.
+struct Plane {
+    glm::vec3 normal = glm::vec3(0, 0, 1);
+    float     offset = 0;
+
+    static Plane through(glm::vec3 point, glm::vec3 normal) {
+        return { normal, glm::dot(normal, point) };
+    }
+
+    /// Signed, and scaled by the length of the normal
+    float distance(glm::vec3 p) const { return glm::dot(normal, p) - offset; }
+
+    /// The same plane in the space `tf` maps from. Exact for any affine
+    /// transform, which is why the normal is left unnormalized.
+    Plane pulled_back(glm::mat4 const& tf) const;
+};
+
+/// Where planes cut meshes: polylines, and with caps, the triangles filling
+/// the closed ones
+struct Section {
+    struct Line {
+        std::vector<glm::vec3> points;
+        bool                   closed = false; // last point joins the first
+    };
+
+    std::vector<Line> lines;
+
+    std::vector<glm::vec3> cap_positions;
+    std::vector<uint32_t>  cap_indices;
+
+    size_t segment_count = 0; // one per triangle cut
+
+    size_t closed_count() const;
+    size_t point_count() const;
+
+    /// Move the lines and caps of another section into this one
+    void append(Section&&);
+};
+
+/// The triangles of one mesh, sorted along a Morton curve through their
+/// centroids, with a box around every `leaf_size` of them and a box around
+/// every `fanout` boxes of the level below, up to a single root. The order
+/// makes neighbouring leaves spatially close, so the levels need no child
+/// links and every level is built in parallel.
+class MeshBVH {
+public:
+    static constexpr size_t leaf_size = 16;
+    static constexpr size_t fanout    = 4;
+
+private:
+    std::vector<glm::vec3>  m_positions;
+    std::vector<glm::uvec3> m_triangles;
+
+    // leaves first, root last
+    std::vector<std::vector<Bounds>> m_levels;
+
+    std::vector<uint32_t> leaves_cut(Plane const&) const;
+
+public:
+    /// Copies the mesh. Without indices every three positions are a
+    /// triangle; triangles with indices out of range are dropped.
+    MeshBVH(std::span<glm::vec3 const> positions,
+            std::span<uint32_t const>  indices);
+
+    size_t triangle_count() const { return m_triangles.size(); }
+
+    Bounds bounds() const;
+
+    /// Where a plane, in mesh space, cuts the mesh, moved by `tf`. Lines
+    /// follow shared edges; a closed mesh gives closed lines, and with `cap`
+    /// those are filled, holes and all.
+    Section slice(Plane const&, glm::mat4 const& tf, bool cap) const;
+
+    size_t byte_size() const;
+};
@@ -0,0 +1,1727 @@
+#include "gltfimporter.h"
+
+#include "bufferarena.h"
+#include "crosssection.h"
+#include "metrics.h"
+#include "threadpool.h"
+#include "transformtree.h"
+
+#include <QColor>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QUrl>
+
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtx/quaternion.hpp>
+
+#include <cstring>
+
+namespace {
+
+constexpr uint32_t glb_magic      = 0x46546C67;
+constexpr uint32_t glb_json_chunk = 0x4E4F534A;
+constexpr uint32_t glb_bin_chunk  = 0x004E4942;
+
+// glTF enums
+constexpr int gl_byte           = 5120;
+constexpr int gl_unsigned_byte  = 5121;
+constexpr int gl_short          = 5122;
+constexpr int gl_unsigned_short = 5123;
+constexpr int gl_unsigned_int   = 5125;
+constexpr int gl_float          = 5126;
+
+constexpr int gl_nearest        = 9728;
+constexpr int gl_linear         = 9729;
+constexpr int gl_clamp_to_edge  = 33071;
+constexpr int gl_mirrored_repeat = 33648;
+
+using SourcePtr = std::shared_ptr<GLTFSource>;
+
+std::optional<noo::Format> attribute_format(QJsonObject const& accessor) {
+    auto component = accessor["componentType"].toInt();
+    auto type      = accessor["type"].toString();
+
+    if (component == gl_float) {
+        if (type == "VEC2") return noo::Format::VEC2;
+        if (type == "VEC3") return noo::Format::VEC3;
+        if (type == "VEC4") return noo::Format::VEC4;
+    } else if (component == gl_unsigned_byte and type == "VEC4") {
+        return noo::Format::U8VEC4;
+    } else if (component == gl_unsigned_short and type == "VEC2") {
+        return noo::Format::U16VEC2;
+    }
+
+    return std::nullopt;
+}
+
+std::optional<noo::Format> index_format(QJsonObject const& accessor) {
+    if (accessor["type"].toString() != "SCALAR") return std::nullopt;
+
+    switch (accessor["componentType"].toInt()) {
+    case gl_unsigned_byte: return noo::Format::U8;
+    case gl_unsigned_short: return noo::Format::U16;
+    case gl_unsigned_int: return noo::Format::U32;
+    }
+
+    return std::nullopt;
+}
+
+/// A JSON number as an integer. QJsonValue::toInteger is new in Qt 6, and
+/// a double holds any offset or count a glTF file can have exactly.
+qint64 integer_of(QJsonValue const& value, qint64 fallback = 0) {
+    return qint64(value.toDouble(fallback));
+}
+
+/// Bytes of one element of an accessor, or 0 if its type is not valid glTF
+qint64 element_size(QJsonObject const& accessor) {
+    qint64 component = 0;
+
+    switch (accessor["componentType"].toInt()) {
+    case gl_byte:
+    case gl_unsigned_byte: component = 1; break;
+    case gl_short:
+    case gl_unsigned_short: component = 2; break;
+    case gl_unsigned_int:
+    case gl_float: component = 4; break;
+    default: return 0;
+    }
+
+    auto type = accessor["type"].toString();
+
+    if (type == "SCALAR") return component;
+    if (type == "VEC2") return component * 2;
+    if (type == "VEC3") return component * 3;
+    if (type == "VEC4" or type == "MAT2") return component * 4;
+    if (type == "MAT3") return component * 9;
+    if (type == "MAT4") return component * 16;
+
+    return 0;
+}
+
+std::optional<noo::PrimitiveType> primitive_type(int mode) {
+    switch (mode) {
+    case 0: return noo::PrimitiveType::POINTS;
+    case 1: return noo::PrimitiveType::LINES;
+    case 2: return noo::PrimitiveType::LINE_LOOP;
+    case 3: return noo::PrimitiveType::LINE_STRIP;
+    case 4: return noo::PrimitiveType::TRIANGLES;
+    case 5: return noo::PrimitiveType::TRIANGLE_STRIP;
+    }
+    // triangle fans have no noodles equivalent
+    return std::nullopt;
+}
+
+std::optional<std::pair<noo::AttributeSemantic, int>>
+attribute_semantic(QString name) {
+    auto channel = [&](QString prefix) {
+        return name.mid(prefix.size()).toInt();
+    };
+
+    using S = noo::AttributeSemantic;
+
+    if (name == "POSITION") return std::pair(S::POSITION, 0);
+    if (name == "NORMAL") return std::pair(S::NORMAL, 0);
+    if (name == "TANGENT") return std::pair(S::TANGENT, 0);
+    if (name.startsWith("TEXCOORD_")) {
+        return std::pair(S::TEXTURE, channel("TEXCOORD_"));
+    }
+    if (name.startsWith("COLOR_")) {
+        return std::pair(S::COLOR, channel("COLOR_"));
+    }
+
+    // joints, weights and custom attributes are not used by noodles
+    return std::nullopt;
+}
+
+noo::MagFilter convert_mag(int f) {
+    return f == gl_nearest ? noo::MagFilter::NEAREST : noo::MagFilter::LINEAR;
+}
+
+noo::MinFilter convert_min(int f) {
+    switch (f) {
+    case gl_nearest: return noo::MinFilter::NEAREST;
+    case gl_linear: return noo::MinFilter::LINEAR;
+    }
+    // any mipmapped mode
+    return noo::MinFilter::LINEAR_MIPMAP_LINEAR;
+}
+
+noo::SamplerMode convert_wrap(int w) {
+    switch (w) {
+    case gl_clamp_to_edge: return noo::SamplerMode::CLAMP_TO_EDGE;
+    case gl_mirrored_repeat: return noo::SamplerMode::MIRRORED_REPEAT;
+    }
+    return noo::SamplerMode::REPEAT;
+}
+
+std::optional<QByteArray> decode_data_uri(QString uri) {
+    if (!uri.startsWith("data:")) return std::nullopt;
+
+    auto comma = uri.indexOf(',');
+
+    if (comma < 0 or !uri.left(comma).endsWith(";base64")) return QByteArray();
+
+    return QByteArray::fromBase64(uri.mid(comma + 1).toLatin1());
+}
+
+/// Read a whole file
+std::optional<QByteArray> read_file(QString path) {
+    QFile file(path);
+
+    if (!file.open(QFile::ReadOnly)) return std::nullopt;
+
+    return file.readAll();
+}
+
+/// Map a whole file, keeping it open in the source, or read it if the
+/// source is not to be mapped
+std::optional<QByteArray>
+open_file(GLTFSource& source, QString path, bool map) {
+    if (!map) return read_file(path);
+
+    auto file = std::make_unique<QFile>(path);
+
+    if (!file->open(QFile::ReadOnly)) return std::nullopt;
+
+    if (file->size() == 0) return QByteArray();
+
+    auto* bytes = file->map(0, file->size());
+
+    if (!bytes) return std::nullopt;
+
+    auto ret = QByteArray::fromRawData(reinterpret_cast<char const*>(bytes),
+                                       file->size());
+
+    source.files.push_back(std::move(file));
+
+    return ret;
+}
+
+std::optional<QString> load_glb(GLTFSource&       source,
+                                QByteArray const& whole) {
+    struct ChunkHeader {
+        uint32_t length;
+        uint32_t type;
+    };
+
+    if (whole.size() < 12 + (qsizetype)sizeof(ChunkHeader)) {
+        return "Truncated GLB";
+    }
+
+    std::array<uint32_t, 3> header;
+    std::memcpy(header.data(), whole.constData(), sizeof(header));
+
+    if (header[0] != glb_magic) return "Not a GLB file";
+    if (header[1] != 2) return "Only glTF 2.0 is supported";
+
+    qsizetype cursor = 12;
+
+    QByteArray bin;
+
+    while (cursor + (qsizetype)sizeof(ChunkHeader) <= whole.size()) {
+        ChunkHeader chunk;
+        std::memcpy(&chunk, whole.constData() + cursor, sizeof(chunk));
+        cursor += sizeof(chunk);
+
+        if (cursor + chunk.length > whole.size()) return "Truncated GLB chunk";
+
+        auto payload = QByteArray::fromRawData(whole.constData() + cursor,
+                                               chunk.length);
+
+        if (chunk.type == glb_json_chunk) {
+            source.json = QJsonDocument::fromJson(payload).object();
+        } else if (chunk.type == glb_bin_chunk and bin.isNull()) {
+            bin = payload;
+        }
+
+        // chunks are 4 byte aligned
+        cursor += (chunk.length + 3) & ~3u;
+    }
+
+    if (source.json.isEmpty()) return "GLB has no JSON chunk";
+
+    // the first buffer of a GLB without a uri is the binary chunk
+    auto buffers = source.json["buffers"].toArray();
+
+    for (int i = 0; i < buffers.size(); i++) {
+        auto uri = buffers[i].toObject()["uri"].toString();
+
+        if (i == 0 and uri.isEmpty()) {
+            source.buffers.push_back(bin);
+            continue;
+        }
+
+        source.buffers.emplace_back();
+    }
+
+    return std::nullopt;
+}
+
+std::optional<QString> load_external_buffers(GLTFSource& source, bool map) {
+    auto buffers = source.json["buffers"].toArray();
+    auto dir     = QFileInfo(source.path).absoluteDir();
+
+    source.buffers.resize(buffers.size());
+
+    for (int i = 0; i < buffers.size(); i++) {
+        if (!source.buffers[i].isNull()) continue;
+
+        auto uri = buffers[i].toObject()["uri"].toString();
+
+        if (auto decoded = decode_data_uri(uri)) {
+            source.buffers[i] = *decoded;
+            continue;
+        }
+
+        auto file_path =
+            dir.filePath(QUrl::fromPercentEncoding(uri.toUtf8()));
+
+        auto bytes = open_file(source, file_path, map);
+
+        if (!bytes) return QString("Unable to open buffer %1").arg(uri);
+
+        source.buffers[i] = *bytes;
+    }
+
+    return std::nullopt;
+}
+
+/// Check that everything the converter will touch is something it supports
+std::optional<QString> check_supported(GLTFSource const& source) {
+    auto const& json = source.json;
+
+    if (json["asset"].toObject()["version"].toString() != "2.0") {
+        return "Only glTF 2.0 is supported";
+    }
+
+    if (!json["extensionsRequired"].toArray().isEmpty()) {
+        return "File requires extensions";
+    }
+
+    auto accessors = json["accessors"].toArray();
+    auto views     = json["bufferViews"].toArray();
+
+    // Every view has to lie within its buffer and every accessor within its
+    // view, as views are published to clients as they are
+    for (auto const& view_value : views) {
+        auto view = view_value.toObject();
+
+        auto buffer = view["buffer"].toInt(-1);
+
+        if (buffer < 0 or buffer >= (int)source.buffers.size()) {
+            return "Bad buffer reference";
+        }
+
+        auto offset = integer_of(view["byteOffset"]);
+        auto length = integer_of(view["byteLength"], -1);
+        auto stride = integer_of(view["byteStride"]);
+
+        if (offset < 0 or length < 1 or
+            offset + length > source.buffers[buffer].size()) {
+            return "Buffer view out of range";
+        }
+
+        if (stride != 0 and (stride < 4 or stride > 252 or stride % 4)) {
+            return "Bad buffer view stride";
+        }
+    }
+
+    for (auto const& acc_value : accessors) {
+        auto acc = acc_value.toObject();
+
+        // without a view, an accessor is all zeros, which is not supported
+        // where it is used below
+        if (!acc.contains("bufferView")) continue;
+
+        auto view_index = acc["bufferView"].toInt(-1);
+
+        if (view_index < 0 or view_index >= views.size()) {
+            return "Bad buffer view reference";
+        }
+
+        auto view = views[view_index].toObject();
+
+        auto element = element_size(acc);
+        auto offset  = integer_of(acc["byteOffset"]);
+        auto count   = integer_of(acc["count"]);
+        auto stride  = integer_of(view["byteStride"]);
+
+        if (element == 0) return "Bad accessor type";
+
+        if (stride == 0) stride = element;
+
+        if (offset < 0 or count < 1 or
+            offset + (count - 1) * stride + element >
+                integer_of(view["byteLength"])) {
+            return "Accessor out of range";
+        }
+    }
+
+    for (auto const& img_value : json["images"].toArray()) {
+        auto img = img_value.toObject();
+
+        if (!img.contains("bufferView")) continue;
+
+        auto view = img["bufferView"].toInt(-1);
+
+        if (view < 0 or view >= views.size()) return "Bad image buffer view";
+    }
+
+    auto check_accessor = [&](int index) -> std::optional<QString> {
+        if (index < 0 or index >= accessors.size()) return "Bad accessor";
+
+        auto acc = accessors[index].toObject();
+
+        if (acc.contains("sparse")) return "Sparse accessors";
+
+        if (!acc.contains("bufferView")) return "Accessor without view";
+
+        return std::nullopt;
+    };
+
+    for (auto const& mesh_value : json["meshes"].toArray()) {
+        for (auto const& prim_value :
+             mesh_value.toObject()["primitives"].toArray()) {
+            auto prim = prim_value.toObject();
+
+            if (!primitive_type(prim["mode"].toInt(4))) {
+                return "Unsupported primitive mode";
+            }
+
+            auto attribs = prim["attributes"].toObject();
+
+            if (!attribs.contains("POSITION")) {
+                return "Primitive without positions";
+            }
+
+            for (auto iter = attribs.begin(); iter != attribs.end(); ++iter) {
+                if (!attribute_semantic(iter.key())) continue;
+
+                auto index = iter.value().toInt(-1);
+
+                if (auto err = check_accessor(index)) return err;
+
+                if (!attribute_format(accessors[index].toObject())) {
+                    return "Unsupported attribute format for " + iter.key();
+                }
+            }
+
+            if (prim.contains("indices")) {
+                auto index = prim["indices"].toInt(-1);
+
+                if (auto err = check_accessor(index)) return err;
+
+                if (!index_format(accessors[index].toObject())) {
+                    return "Unsupported index format";
+                }
+            }
+
+            if (!prim["targets"].toArray().isEmpty()) return "Morph targets";
+        }
+    }
+
+    // Assimp brings these in for the animation engine
+    if (!json["animations"].toArray().isEmpty()) return "Animations";
+
+    return std::nullopt;
+}
+
+} // namespace
+
+/// A glTF file hashed and staged, with only document components left to
+/// create. Made by stage_gltf, used up by update_model_from_gltf.
+struct StagedGLTF {
+    struct PendingAttribute {
+        int                      view   = 0; // glTF index
+        uint32_t                 offset = 0; // into the view
+        noo::AttributeSemantic   semantic;
+        uint32_t                 channel = 0;
+        uint32_t                 stride  = 0;
+        noo::Format              format;
+        std::optional<glm::vec4> minimum_value;
+        std::optional<glm::vec4> maximum_value;
+        bool                     normalized = false;
+    };
+
+    struct PendingIndices {
+        int         view   = 0;
+        uint32_t    offset = 0;
+        uint32_t    count  = 0;
+        uint32_t    stride = 0;
+        noo::Format format;
+    };
+
+    struct PendingPatch {
+        noo::PrimitiveType            type;
+        int                           material     = -1; // glTF index
+        uint32_t                      vertex_count = 0;
+        std::vector<PendingAttribute> attributes;
+        std::optional<PendingIndices> indices;
+    };
+
+    struct PendingMesh {
+        QString                   name;
+        std::vector<PendingPatch> patches;
+
+        // the bytes of the buffers the mesh uses, for keeping count
+        std::vector<BufferArena::Slice> ranges;
+        qint64                          bytes = 0;
+    };
+
+    struct PendingTexture {
+        QString name;
+        int     image   = -1;
+        int     sampler = -1;
+    };
+
+    // what the model held when staging began; none of it is staged, it is
+    // claimed instead
+    ReusableComponents reuse;
+
+    // Every glTF buffer is a chunk of its own, adopted rather than copied,
+    // as are images read from files of their own
+    std::shared_ptr<BufferArena> arena =
+        std::make_shared<BufferArena>("glTF Arena");
+
+    // where each glTF buffer view lies in the arena, by glTF index
+    std::vector<BufferArena::Slice> views;
+
+    // content hashes by glTF index; empty for what no node shows
+    std::vector<QByteArray> mesh_keys;
+    std::vector<QByteArray> material_keys;
+    std::vector<QByteArray> texture_keys;
+    QByteArray              default_material_key;
+
+    // encoded images of the textures to create, by glTF image index
+    QHash<int, BufferArena::Slice> images;
+
+    QHash<QByteArray, PendingTexture> pending_textures;
+    QHash<QByteArray, PendingMesh>    pending_meshes;
+
+    // by glTF mesh index, in mesh space
+    std::vector<Bounds> mesh_bounds;
+
+    // triangle hierarchies for slicing, new or carried over
+    QHash<QByteArray, std::shared_ptr<MeshBVH const>> bvhs;
+
+    // size of the distinct geometry
+    qint64 vertex_count   = 0;
+    qint64 triangle_count = 0;
+};
+
+namespace {
+
+/// The part of a glTF import that needs no document: hashes meshes,
+/// materials and textures, and lays out those the model cannot reuse over
+/// the buffers of the file. Touches neither the document nor the model, so
+/// it runs off the main thread.
+struct GLTFStager {
+    GLTFSource const&    source;
+    ImportOptions const& options;
+    StagedGLTF&          out;
+
+    QJsonArray accessors = source.json["accessors"].toArray();
+    QJsonArray views     = source.json["bufferViews"].toArray();
+    QJsonArray images    = source.json["images"].toArray();
+    QJsonArray samplers  = source.json["samplers"].toArray();
+    QJsonArray textures  = source.json["textures"].toArray();
+    QJsonArray materials = source.json["materials"].toArray();
+    QJsonArray meshes    = source.json["meshes"].toArray();
+
+    /// Bytes of a buffer that a mesh uses. The accessors of a mesh that
+    /// share a view share a range, so interleaved attributes count once.
+    struct Range {
+        int    buffer = 0;
+        qint64 begin  = 0;
+        qint64 end    = 0;
+    };
+
+    /// A mesh hashed and laid out in ranges
+    struct PlannedMesh {
+        QByteArray              key;
+        StagedGLTF::PendingMesh mesh;
+        std::vector<Range>      ranges;
+        Bounds                  bounds;
+        qint64                  vertex_count   = 0;
+        qint64                  triangle_count = 0;
+    };
+
+    // meshes staged or claimed so far, as two glTF meshes may be the same
+    QSet<QByteArray> seen_meshes;
+
+    // the arena chunk of each glTF buffer
+    std::vector<size_t> buffer_chunks;
+
+    /// Where the elements of an accessor lie in its buffer. check_supported
+    /// has made sure they are all there.
+    Range accessor_range(QJsonObject const& acc) const {
+        auto view   = views[acc["bufferView"].toInt()].toObject();
+        auto stride = integer_of(view["byteStride"]);
+        auto size   = element_size(acc);
+        auto begin =
+            integer_of(view["byteOffset"]) + integer_of(acc["byteOffset"]);
+        auto count = integer_of(acc["count"]);
+
+        return {
+            .buffer = view["buffer"].toInt(),
+            .begin  = begin,
+            .end    = begin + (count - 1) * (stride ? stride : size) + size,
+        };
+    }
+
+    /// The first element of an accessor, and the bytes from one element to
+    /// the next
+    char const* accessor_data(QJsonObject const& acc, size_t& stride) const {
+        auto range = accessor_range(acc);
+
+        stride = views[acc["bufferView"].toInt()]
+                     .toObject()["byteStride"]
+                     .toInt(0);
+
+        if (stride == 0) stride = element_size(acc);
+
+        return source.buffers[range.buffer].constData() + range.begin;
+    }
+
+    /// The encoded bytes of an image, from its view, a data URI, or a file
+    /// next to the glTF one. Empty if there are none.
+    QByteArray image_bytes(int index) const {
+        if (index < 0 or index >= images.size()) return {};
+
+        auto img = images[index].toObject();
+
+        if (img.contains("bufferView")) {
+            auto view = views[img["bufferView"].toInt()].toObject();
+
+            auto const& buffer = source.buffers[view["buffer"].toInt()];
+
+            return QByteArray::fromRawData(
+                buffer.constData() + integer_of(view["byteOffset"]),
+                integer_of(view["byteLength"]));
+        }
+
+        auto uri = img["uri"].toString();
+
+        if (auto decoded = decode_data_uri(uri)) return *decoded;
+
+        auto path = QFileInfo(source.path).absoluteDir().filePath(
+            QUrl::fromPercentEncoding(uri.toUtf8()));
+
+        auto bytes = read_file(path);
+
+        if (!bytes) {
+            qWarning() << "Unable to open image" << path;
+            return {};
+        }
+
+        return *bytes;
+    }
+
+    QByteArray texture_key(int index) const {
+        if (index < 0 or index >= (int)out.texture_keys.size()) return {};
+        return out.texture_keys[index];
+    }
+
+    /// Read and hash the image and sampler of every texture in `used`, and
+    /// stage the images the model does not hold yet. Those in a buffer view
+    /// are published from there; the others, as read.
+    void stage_textures(std::vector<int> const& used) {
+        std::vector<QByteArray> bytes(used.size());
+
+        ThreadPool::global().parallel_for(used.size(), [&](size_t i) {
+            auto tex = textures[used[i]].toObject();
+
+            bytes[i] = image_bytes(tex["source"].toInt(-1));
+
+            if (bytes[i].isEmpty()) return;
+
+            QCryptographicHash hash(QCryptographicHash::Md5);
+            hash.addData(bytes[i]);
+
+            // samplers are carried per texture, unlike the Assimp path
+            auto sampler = tex["sampler"].toInt(-1);
+
+            if (sampler >= 0 and sampler < samplers.size()) {
+                hash.addData(QJsonDocument(samplers[sampler].toObject())
+                                 .toJson(QJsonDocument::Compact));
+            }
+
+            out.texture_keys[used[i]] = hash.result();
+        });
+
+        for (size_t i = 0; i < used.size(); i++) {
+            auto const& key = out.texture_keys[used[i]];
+
+            if (key.isEmpty()) continue;
+
+            metrics::texture_source_bytes().add(bytes[i].size());
+            metrics::texture_encoded_bytes().add(bytes[i].size());
+
+            // claimed when the import is applied
+            if (out.reuse.textures.contains(key)) continue;
+
+            if (out.pending_textures.contains(key)) continue;
+
+            auto tex   = textures[used[i]].toObject();
+            auto image = tex["source"].toInt();
+
+            if (!out.images.contains(image)) {
+                auto img = images[image].toObject();
+
+                out.images[image] =
+                    img.contains("bufferView")
+                        ? out.views[img["bufferView"].toInt()]
+                        : out.arena->adopt(bytes[i]);
+            }
+
+            out.pending_textures[key] = StagedGLTF::PendingTexture {
+                .name    = tex["name"].toString(),
+                .image   = image,
+                .sampler = tex["sampler"].toInt(-1),
+            };
+        }
+    }
+
+    /// The hash of a material; an index out of range is the default one
+    QByteArray material_key(int index) const {
+        QCryptographicHash hash(QCryptographicHash::Md5);
+
+        hash.addData(QByteArray::number(options.double_sided));
+
+        if (index < 0 or index >= materials.size()) {
+            hash.addData(QByteArray("default"));
+            return hash.result();
+        }
+
+        auto mat = materials[index].toObject();
+
+        hash.addData(QJsonDocument(mat).toJson(QJsonDocument::Compact));
+
+        // the texture index is in the JSON, but the image behind it may
+        // have changed
+        auto info = mat["pbrMetallicRoughness"]
+                        .toObject()["baseColorTexture"]
+                        .toObject();
+
+        hash.addData(texture_key(info["index"].toInt(-1)));
+
+        return hash.result();
+    }
+
+    /// Accessors of a primitive that the mesh is made of
+    std::vector<int> used_accessors(QJsonObject const& prim) const {
+        std::vector<int> ret;
+
+        auto attribs = prim["attributes"].toObject();
+
+        for (auto iter = attribs.begin(); iter != attribs.end(); ++iter) {
+            if (attribute_semantic(iter.key())) {
+                ret.push_back(iter.value().toInt());
+            }
+        }
+
+        if (prim.contains("indices")) ret.push_back(prim["indices"].toInt());
+
+        return ret;
+    }
+
+    /// Lay out a mesh in ranges of the buffers and hash it, bytes, layout
+    /// and material key and all. Reads only, so meshes are planned in
+    /// parallel.
+    PlannedMesh plan_mesh(int index) const {
+        PlannedMesh ret;
+
+        auto mesh       = meshes[index].toObject();
+        auto primitives = mesh["primitives"].toArray();
+
+        ret.mesh.name = mesh["name"].toString();
+
+        // one range per view the mesh uses
+        QHash<int, size_t> view_ranges;
+
+        for (auto const& prim_value : primitives) {
+            for (auto acc_index : used_accessors(prim_value.toObject())) {
+                auto acc   = accessors[acc_index].toObject();
+                auto view  = acc["bufferView"].toInt();
+                auto range = accessor_range(acc);
+
+                if (auto iter = view_ranges.find(view);
+                    iter != view_ranges.end()) {
+                    auto& r = ret.ranges[*iter];
+                    r.begin = std::min(r.begin, range.begin);
+                    r.end   = std::max(r.end, range.end);
+                    continue;
+                }
+
+                view_ranges[view] = ret.ranges.size();
+                ret.ranges.push_back(range);
+            }
+        }
+
+        QCryptographicHash hash(QCryptographicHash::Md5);
+
+        auto add = [&hash](auto const& value) {
+            hash.addData(reinterpret_cast<char const*>(&value), sizeof(value));
+        };
+
+        // Where an accessor lies in the ranges of the mesh, which unlike its
+        // place in the file does not move when other meshes change
+        auto add_place = [&](QJsonObject const& acc) {
+            auto range = view_ranges.value(acc["bufferView"].toInt());
+            add(range);
+            add(accessor_range(acc).begin - ret.ranges[range].begin);
+        };
+
+        for (auto const& prim_value : primitives) {
+            auto prim = prim_value.toObject();
+
+            StagedGLTF::PendingPatch patch {
+                .type     = *primitive_type(prim["mode"].toInt(4)),
+                .material = prim["material"].toInt(-1),
+            };
+
+            auto attribs = prim["attributes"].toObject();
+
+            for (auto iter = attribs.begin(); iter != attribs.end(); ++iter) {
+                auto semantic = attribute_semantic(iter.key());
+                if (!semantic) continue;
+
+                auto acc  = accessors[iter.value().toInt()].toObject();
+                auto view = views[acc["bufferView"].toInt()].toObject();
+
+                StagedGLTF::PendingAttribute attrib {
+                    .view       = acc["bufferView"].toInt(),
+                    .offset     = (uint32_t)integer_of(acc["byteOffset"]),
+                    .semantic   = semantic->first,
+                    .channel    = (uint32_t)semantic->second,
+                    .stride     = (uint32_t)view["byteStride"].toInt(0),
+                    .format     = *attribute_format(acc),
+                    .normalized = acc["normalized"].toBool(false),
+                };
+
+                if (semantic->first == noo::AttributeSemantic::POSITION) {
+                    patch.vertex_count = integer_of(acc["count"]);
+
+                    auto mn = acc["min"].toArray();
+                    auto mx = acc["max"].toArray();
+
+                    if (mn.size() == 3 and mx.size() == 3) {
+                        glm::vec3 lmin(mn[0].toDouble(),
+                                       mn[1].toDouble(),
+                                       mn[2].toDouble());
+                        glm::vec3 lmax(mx[0].toDouble(),
+                                       mx[1].toDouble(),
+                                       mx[2].toDouble());
+
+                        attrib.minimum_value = glm::vec4(lmin, 1);
+                        attrib.maximum_value = glm::vec4(lmax, 1);
+
+                        ret.bounds.grow(Bounds { lmin, lmax });
+                    }
+                }
+
+                add_place(acc);
+                add(attrib.semantic);
+                add(attrib.channel);
+                add(attrib.stride);
+                add(attrib.format);
+                add(attrib.normalized);
+                add(attrib.minimum_value.value_or(glm::vec4(0)));
+                add(attrib.maximum_value.value_or(glm::vec4(0)));
+
+                patch.attributes.push_back(attrib);
+            }
+
+            if (prim.contains("indices")) {
+                auto acc  = accessors[prim["indices"].toInt()].toObject();
+                auto view = views[acc["bufferView"].toInt()].toObject();
+
+                StagedGLTF::PendingIndices indices {
+                    .view   = acc["bufferView"].toInt(),
+                    .offset = (uint32_t)integer_of(acc["byteOffset"]),
+                    .count  = (uint32_t)integer_of(acc["count"]),
+                    .stride = (uint32_t)view["byteStride"].toInt(0),
+                    .format = *index_format(acc),
+                };
+
+                add_place(acc);
+                add(indices.count);
+                add(indices.stride);
+                add(indices.format);
+
+                patch.indices = indices;
+            }
+
+            add(patch.type);
+            add(patch.vertex_count);
+
+            // a mesh is made with its materials
+            hash.addData(patch.material >= 0 and
+                                 patch.material < (int)out.material_keys.size()
+                             ? out.material_keys[patch.material]
+                             : out.default_material_key);
+
+            ret.vertex_count += patch.vertex_count;
+
+            if (patch.type == noo::PrimitiveType::TRIANGLES) {
+                auto count = patch.indices ? patch.indices->count
+                                           : patch.vertex_count;
+                ret.triangle_count += count / 3;
+            }
+
+            ret.mesh.patches.push_back(std::move(patch));
+        }
+
+        for (auto const& range : ret.ranges) {
+            hash.addData(source.buffers[range.buffer].constData() + range.begin,
+                         range.end - range.begin);
+
+            ret.mesh.ranges.push_back({
+                .chunk  = buffer_chunks[range.buffer],
+                .offset = (uint64_t)range.begin,
+                .length = uint64_t(range.end - range.begin),
+            });
+
+            ret.mesh.bytes += range.end - range.begin;
+        }
+
+        ret.key = hash.result();
+
+        return ret;
+    }
+
+    /// Stage a planned mesh unless the model holds it already
+    void stage_mesh(int index, PlannedMesh& plan) {
+        out.mesh_keys[index]   = plan.key;
+        out.mesh_bounds[index] = plan.bounds;
+
+        if (seen_meshes.contains(plan.key)) return;
+
+        seen_meshes << plan.key;
+
+        out.vertex_count += plan.vertex_count;
+        out.triangle_count += plan.triangle_count;
+
+        index_for_slicing(index, plan.key);
+
+        // claimed when the import is applied
+        if (out.reuse.meshes.contains(plan.key)) return;
+
+        out.pending_meshes[plan.key] = std::move(plan.mesh);
+    }
+
+    /// Decode the triangles of a mesh and sort them into a hierarchy for
+    /// cross-sections, or keep the one of the last import if the mesh is
+    /// unchanged
+    void index_for_slicing(int index, QByteArray const& key) {
+        if (!options.slicing) return;
+
+        if (auto previous = out.reuse.bvhs.value(key)) {
+            out.bvhs[key] = std::move(previous);
+            return;
+        }
+
+        auto mesh = meshes[index].toObject();
+
+        auto& pool = ThreadPool::global();
+
+        std::vector<glm::vec3> positions;
+        std::vector<uint32_t>  indices;
+
+        for (auto const& prim_value : mesh["primitives"].toArray()) {
+            auto prim = prim_value.toObject();
+
+            if (prim["mode"].toInt(4) != 4) continue;
+
+            auto attribs = prim["attributes"].toObject();
+            auto acc     = accessors[attribs["POSITION"].toInt()].toObject();
+
+            if (acc["componentType"].toInt() != gl_float or
+                acc["type"].toString() != "VEC3") {
+                continue;
+            }
+
+            size_t stride;
+            auto*  data = accessor_data(acc, stride);
+
+            auto const first = positions.size();
+            auto const count = (size_t)integer_of(acc["count"]);
+
+            positions.resize(first + count);
+
+            pool.parallel_chunks(count, [&](size_t b, size_t e) {
+                for (size_t v = b; v < e; v++) {
+                    std::memcpy(&positions[first + v],
+                                data + v * stride,
+                                sizeof(glm::vec3));
+                }
+            });
+
+            auto const base = indices.size();
+
+            if (!prim.contains("indices")) {
+                indices.resize(base + count);
+                for (size_t v = 0; v < count; v++) {
+                    indices[base + v] = first + v;
+                }
+                continue;
+            }
+
+            auto iacc  = accessors[prim["indices"].toInt()].toObject();
+            auto width = (size_t)element_size(iacc);
+
+            size_t istride;
+            auto*  idata = accessor_data(iacc, istride);
+
+            auto const icount = (size_t)integer_of(iacc["count"]);
+
+            indices.resize(base + icount);
+
+            pool.parallel_chunks(icount, [&](size_t b, size_t e) {
+                for (size_t n = b; n < e; n++) {
+                    uint32_t value = 0;
+                    std::memcpy(&value, idata + n * istride, width);
+                    indices[base + n] = first + value;
+                }
+            });
+        }
+
+        if (indices.size() < 3) return;
+
+        out.bvhs[key] = std::make_shared<MeshBVH const>(positions, indices);
+    }
+
+    /// Hash and stage every mesh a node shows, with its materials and
+    /// textures
+    void stage() {
+        std::vector<int> used_meshes;
+        std::vector<int> used_materials;
+        std::vector<int> used_textures;
+
+        {
+            std::vector<bool> seen(meshes.size());
+
+            for (auto const& node : source.json["nodes"].toArray()) {
+                auto m = node.toObject()["mesh"].toInt(-1);
+                if (m < 0 or m >= (int)seen.size() or seen[m]) continue;
+                seen[m] = true;
+                used_meshes.push_back(m);
+            }
+        }
+
+        {
+            std::vector<bool> seen(materials.size());
+
+            for (auto m : used_meshes) {
+                auto primitives = meshes[m].toObject()["primitives"].toArray();
+
+                for (auto const& prim : primitives) {
+                    auto i = prim.toObject()["material"].toInt(-1);
+                    if (i < 0 or i >= (int)seen.size() or seen[i]) continue;
+                    seen[i] = true;
+                    used_materials.push_back(i);
+                }
+            }
+        }
+
+        {
+            std::vector<bool> seen(textures.size());
+
+            for (auto m : used_materials) {
+                auto i = materials[m]
+                             .toObject()["pbrMetallicRoughness"]
+                             .toObject()["baseColorTexture"]
+                             .toObject()["index"]
+                             .toInt(-1);
+                if (i < 0 or i >= (int)seen.size() or seen[i]) continue;
+                seen[i] = true;
+                used_textures.push_back(i);
+            }
+        }
+
+        // buffers go into the arena whole and uncopied, so views are slices
+        for (auto const& buffer : source.buffers) {
+            buffer_chunks.push_back(out.arena->adopt(buffer).chunk);
+        }
+
+        for (auto const& view_value : views) {
+            auto view = view_value.toObject();
+
+            out.views.push_back({
+                .chunk  = buffer_chunks[view["buffer"].toInt()],
+                .offset = (uint64_t)integer_of(view["byteOffset"]),
+                .length = (uint64_t)integer_of(view["byteLength"]),
+            });
+        }
+
+        out.mesh_keys.resize(meshes.size());
+        out.mesh_bounds.resize(meshes.size());
+        out.material_keys.resize(materials.size());
+        out.texture_keys.resize(textures.size());
+
+        {
+            ScopedTimer timer(
+                metrics::import_phase(metrics::ImportPhase::Textures));
+            stage_textures(used_textures);
+        }
+
+        // mesh hashes include their material's, so materials go first
+        for (auto m : used_materials) {
+            out.material_keys[m] = material_key(m);
+        }
+
+        out.default_material_key = material_key(-1);
+
+        std::vector<PlannedMesh> planned(used_meshes.size());
+
+        {
+            ScopedTimer timer(
+                metrics::import_phase(metrics::ImportPhase::Convert));
+
+            auto& pool = ThreadPool::global();
+
+            pool.parallel_for(used_meshes.size(), [&](size_t i) {
+                planned[i] = plan_mesh(used_meshes[i]);
+            });
+        }
+
+        QList<QByteArray> keys;
+
+        for (auto const& plan : planned) {
+            keys << plan.key;
+        }
+
+        drop_sparse_chunks(out.reuse, keys);
+
+        ScopedTimer timer(metrics::import_phase(metrics::ImportPhase::Stage));
+
+        for (size_t i = 0; i < used_meshes.size(); i++) {
+            stage_mesh(used_meshes[i], planned[i]);
+        }
+    }
+};
+
+// =============================================================================
+
+/// The part of a glTF import that needs the document: creates what staging
+/// left for it, claims everything else from what the model held, and builds
+/// the objects of the node tree. Main thread only.
+struct GLTFImporter {
+    SourcePtr const&       source;
+    QJsonObject const&     json;
+    StagedGLTF&            staged;
+    noo::DocumentTPtrRef   doc;
+    std::shared_ptr<Model> model_ref;
+    Model&                 thing;
+    ImportOptions          options;
+
+    // What the model held before this import. Anything not claimed again is
+    // released when the importer goes away.
+    QHash<QString, ModelNode>            previous_nodes;
+    QHash<QByteArray, noo::MeshTPtr>     previous_meshes;
+    QHash<QByteArray, noo::MaterialTPtr> previous_materials;
+    QHash<QByteArray, noo::TextureTPtr>  previous_textures;
+
+    // by glTF index
+    std::vector<noo::BufferViewTPtr> views;
+    std::vector<noo::ImageTPtr>      images;
+    std::vector<noo::SamplerTPtr>    samplers;
+
+    // textures made by this import rather than claimed
+    QSet<QByteArray> created_textures;
+
+    uint32_t tree_root = TransformTree::none;
+
+    void begin() {
+        previous_nodes     = std::exchange(thing.nodes, {});
+        previous_meshes    = std::exchange(thing.meshes, {});
+        previous_materials = std::exchange(thing.materials, {});
+        previous_textures  = std::exchange(thing.textures, {});
+
+        thing.min_bb = glm::vec3(std::numeric_limits<float>::max());
+        thing.max_bb = glm::vec3(std::numeric_limits<float>::lowest());
+
+        thing.tree.clear();
+
+        thing.bvhs = std::move(staged.bvhs);
+        thing.mesh_nodes.clear();
+
+        thing.vertex_count   = staged.vertex_count;
+        thing.triangle_count = staged.triangle_count;
+
+        thing.animations.reset();
+
+        views.resize(staged.views.size());
+        images.resize(json["images"].toArray().size());
+        samplers.resize(json["samplers"].toArray().size());
+    }
+
+    /// Recompute what the model costs now that the import is done
+    void finish() {
+        ModelMemory mem;
+
+        count_component_bytes(
+            thing, thing.meshes.keys(), thing.textures.keys(), mem);
+
+        mem.cpu_bytes = thing.nodes.size() * sizeof(ModelNode) +
+                        thing.tree.byte_size() +
+                        thing.mesh_nodes.size() * sizeof(thing.mesh_nodes[0]);
+
+        for (auto const& bvh : qAsConst(thing.bvhs)) {
+            mem.cpu_bytes += bvh->byte_size();
+        }
+
+        thing.memory = mem;
+    }
+
+    /// A geometry view where the glTF view lies in its buffer, made once
+    noo::BufferViewTPtr get_view(int i) {
+        if (!views[i]) {
+            views[i] = staged.arena->view_of(
+                doc, staged.views[i], noo::ViewType::GEOMETRY_INFO);
+        }
+
+        return views[i];
+    }
+
+    noo::ImageTPtr get_image(int i) {
+        if (images[i]) return images[i];
+
+        auto img = json["images"].toArray()[i].toObject();
+
+        images[i] = noo::create_image(
+            doc,
+            noo::ImageData {
+                .name   = img["name"].toString(),
+                .source = staged.arena->view_of(
+                    doc, staged.images.value(i), noo::ViewType::IMAGE_INFO),
+            });
+
+        return images[i];
+    }
+
+    noo::SamplerTPtr get_sampler(int i) {
+        if (samplers[i]) return samplers[i];
+
+        auto s = json["samplers"].toArray()[i].toObject();
+
+        samplers[i] = noo::create_sampler(
+            doc,
+            noo::SamplerData {
+                .mag_filter = convert_mag(s["magFilter"].toInt(gl_linear)),
+                .min_filter = convert_min(s["minFilter"].toInt(gl_linear)),
+                .wrap_s     = convert_wrap(s["wrapS"].toInt()),
+                .wrap_t     = convert_wrap(s["wrapT"].toInt()),
+            });
+
+        return samplers[i];
+    }
+
+    /// Claim the textures the model holds already, and create the staged
+    /// ones; those of claimed materials too, so the model keeps count
+    void create_textures() {
+        for (int i = 0; i < (int)staged.texture_keys.size(); i++) {
+            get_texture(i);
+        }
+    }
+
+    /// Claim a texture the model holds already, or create a staged one
+    noo::TextureTPtr get_texture(int i) {
+        if (i < 0 or i >= (int)staged.texture_keys.size()) return nullptr;
+
+        auto const& key = staged.texture_keys[i];
+
+        if (key.isEmpty()) return nullptr;
+
+        auto iter = staged.pending_textures.find(key);
+
+        if (iter == staged.pending_textures.end()) {
+            return claim(thing.textures, previous_textures, key);
+        }
+
+        auto pending = *iter;
+        staged.pending_textures.erase(iter);
+
+        auto tex_data = noo::TextureData {
+            .name  = pending.name,
+            .image = get_image(pending.image),
+        };
+
+        if (pending.sampler >= 0 and pending.sampler < (int)samplers.size()) {
+            tex_data.sampler = get_sampler(pending.sampler);
+        }
+
+        auto ret = noo::create_texture(doc, tex_data);
+
+        created_textures << key;
+
+        auto const slice = staged.images.value(pending.image);
+
+        thing.textures[key]          = ret;
+        thing.component_bytes[key]   = slice.length;
+        thing.component_chunks[key]  = staged.arena->chunks_of(
+            std::span(&slice, 1));
+        thing.component_sources[key] = source;
+
+        metrics::buffer_bytes_created(metrics::BufferType::Image)
+            .add(slice.length);
+
+        return ret;
+    }
+
+    /// The key of the base color texture of a material; empty if it has none
+    QByteArray base_texture_key(int material) const {
+        auto index = json["materials"]
+                         .toArray()[material]
+                         .toObject()["pbrMetallicRoughness"]
+                         .toObject()["baseColorTexture"]
+                         .toObject()["index"]
+                         .toInt(-1);
+
+        if (index < 0 or index >= (int)staged.texture_keys.size()) return {};
+
+        return staged.texture_keys[index];
+    }
+
+    /// Claim a material the model holds already, or create it. An index
+    /// out of range is the default material.
+    noo::MaterialTPtr get_material(int i) {
+        bool const valid = i >= 0 and i < (int)staged.material_keys.size();
+
+        auto const& key =
+            valid ? staged.material_keys[i] : staged.default_material_key;
+
+        // The material a texture made anew replaces holds on to the old
+        // texture, which may be over a file rewritten since
+        auto const& previous =
+            valid and created_textures.contains(base_texture_key(i))
+                ? QHash<QByteArray, noo::MaterialTPtr>()
+                : previous_materials;
+
+        if (auto ret = claim(thing.materials, previous, key)) return ret;
+
+        noo::MaterialData mdata;
+
+        if (!valid) {
+            mdata.pbr_info.emplace().base_color = QColor(Qt::white);
+            mdata.double_sided                  = options.double_sided;
+
+            return thing.materials[key] = noo::create_material(doc, mdata);
+        }
+
+        auto mat      = json["materials"].toArray()[i].toObject();
+        auto pbr_json = mat["pbrMetallicRoughness"].toObject();
+
+        mdata.name = mat["name"].toString();
+
+        auto& pbr = mdata.pbr_info.emplace();
+
+        auto factor = pbr_json["baseColorFactor"].toArray();
+        if (factor.size() == 4) {
+            pbr.base_color = QColor::fromRgbF(factor[0].toDouble(),
+                                              factor[1].toDouble(),
+                                              factor[2].toDouble(),
+                                              factor[3].toDouble());
+        } else {
+            pbr.base_color = QColor(Qt::white);
+        }
+
+        pbr.metallic  = pbr_json["metallicFactor"].toDouble(1);
+        pbr.roughness = pbr_json["roughnessFactor"].toDouble(1);
+
+        if (pbr_json.contains("baseColorTexture")) {
+            auto info = pbr_json["baseColorTexture"].toObject();
+
+            if (auto tex = get_texture(info["index"].toInt(-1))) {
+                pbr.base_color_texture.emplace(noo::TextureRef {
+                    .source             = tex,
+                    .transform          = glm::mat3(1),
+                    .texture_coord_slot = info["texCoord"].toInt(0),
+                });
+            }
+        }
+
+        mdata.double_sided =
+            options.double_sided or mat["doubleSided"].toBool(false);
+
+        return thing.materials[key] = noo::create_material(doc, mdata);
+    }
+
+    /// Claim a mesh the model holds already, or create a staged one over the
+    /// views of the file
+    noo::MeshTPtr get_mesh(int i) {
+        auto const& key = staged.mesh_keys[i];
+
+        auto iter = staged.pending_meshes.find(key);
+
+        if (iter == staged.pending_meshes.end()) {
+            return claim(thing.meshes, previous_meshes, key);
+        }
+
+        auto pending = std::move(*iter);
+        staged.pending_meshes.erase(iter);
+
+        noo::MeshData mesh_data;
+        mesh_data.name = pending.name;
+
+        for (auto const& staged_patch : pending.patches) {
+            noo::MeshPatch patch;
+            patch.type         = staged_patch.type;
+            patch.material     = get_material(staged_patch.material);
+            patch.vertex_count = staged_patch.vertex_count;
+
+            for (auto const& attrib : staged_patch.attributes) {
+                patch.attributes.push_back(noo::Attribute {
+                    .view          = get_view(attrib.view),
+                    .semantic      = attrib.semantic,
+                    .channel       = attrib.channel,
+                    .offset        = attrib.offset,
+                    .stride        = attrib.stride,
+                    .format        = attrib.format,
+                    .minimum_value = attrib.minimum_value,
+                    .maximum_value = attrib.maximum_value,
+                    .normalized    = attrib.normalized,
+                });
+            }
+
+            if (auto const& indices = staged_patch.indices) {
+                patch.indices = noo::Index {
+                    .view   = get_view(indices->view),
+                    .count  = indices->count,
+                    .offset = indices->offset,
+                    .stride = indices->stride,
+                    .format = indices->format,
+                };
+            }
+
+            mesh_data.patches.push_back(patch);
+        }
+
+        auto ret = noo::create_mesh(doc, mesh_data);
+
+        thing.meshes[key]            = ret;
+        thing.component_bytes[key]   = pending.bytes;
+        thing.component_chunks[key]  = staged.arena->chunks_of(pending.ranges);
+        thing.component_sources[key] = source;
+
+        metrics::buffer_bytes_created(metrics::BufferType::Geometry)
+            .add(pending.bytes);
+
+        return ret;
+    }
+
+    static glm::mat4 node_transform(QJsonObject const& node) {
+        auto matrix = node["matrix"].toArray();
+
+        if (matrix.size() == 16) {
+            glm::mat4 ret;
+            for (int i = 0; i < 16; i++) {
+                // glTF is already column major
+                glm::value_ptr(ret)[i] = matrix[i].toDouble();
+            }
+            return ret;
+        }
+
+        auto t = node["translation"].toArray();
+        auto r = node["rotation"].toArray();
+        auto s = node["scale"].toArray();
+
+        auto vec3_of = [](QJsonArray const& a) {
+            return glm::vec3(a[0].toDouble(), a[1].toDouble(), a[2].toDouble());
+        };
+
+        glm::mat4 ret(1);
+
+        if (t.size() == 3) {
+            ret = glm::translate(ret, vec3_of(t));
+        }
+
+        if (r.size() == 4) {
+            // glTF quaternions are xyzw, glm's constructor is wxyz
+            ret = ret * glm::mat4_cast(glm::quat(r[3].toDouble(),
+                                                 r[0].toDouble(),
+                                                 r[1].toDouble(),
+                                                 r[2].toDouble()));
+        }
+
+        if (s.size() == 3) {
+            ret = glm::scale(ret, vec3_of(s));
+        }
+
+        return ret;
+    }
+
+    noo::ObjectTPtr make_root(noo::ObjectTPtr collective_root) {
+        ModelNode record = previous_nodes.take(QString());
+
+        if (!record.object) {
+            noo::ObjectData root_data;
+            root_data.name   = QFileInfo(source->path).fileName();
+            root_data.parent = collective_root;
+            root_data.create_callbacks = [model = model_ref](noo::ObjectT* t) {
+                return std::make_unique<ModelCallbacks>(t, model);
+            };
+
+            record.object = noo::create_object(doc, root_data);
+        }
+
+        record.parts.clear();
+        record.mesh_key.clear();
+
+        thing.object = record.object;
+
+        // the tree is in the space of the root object
+        tree_root = thing.tree.add(TransformTree::none, glm::mat4(1), {});
+
+        auto ret = record.object;
+
+        thing.nodes[QString()] = std::move(record);
+
+        return ret;
+    }
+
+    void process_nodes(noo::ObjectTPtr root) {
+        auto nodes = json["nodes"].toArray();
+
+        auto scene_index = json["scene"].toInt(0);
+        auto scene = json["scenes"].toArray()[scene_index].toObject();
+
+        struct Pending {
+            int             node;
+            noo::ObjectTPtr parent;
+            QString         path;
+            uint32_t        tree_node; // of the parent
+        };
+
+        // walk iteratively; exported hierarchies can be very deep
+        std::vector<Pending> stack;
+
+        auto roots = scene["nodes"].toArray();
+        for (int ci = roots.size() - 1; ci >= 0; ci--) {
+            auto n = roots[ci].toInt();
+            stack.push_back({ n,
+                              root,
+                              QString("/%1:%2").arg(ci).arg(
+                                  nodes[n].toObject()["name"].toString()),
+                              tree_root });
+        }
+
+        while (!stack.empty()) {
+            auto item = std::move(stack.back());
+            stack.pop_back();
+
+            if (item.node < 0 or item.node >= nodes.size()) continue;
+
+            auto node      = nodes[item.node].toObject();
+            auto transform = node_transform(node);
+
+            ModelNode record = previous_nodes.take(item.path);
+
+            if (record.object) {
+                if (record.transform != transform) {
+                    noo::ObjectUpdateData update;
+                    update.transform = transform;
+                    noo::update_object(record.object, update);
+                    metrics::transform_updates_sent().add();
+                }
+                record.parts.clear();
+            } else {
+                noo::ObjectData data;
+                data.name      = node["name"].toString();
+                data.parent    = item.parent;
+                data.transform = transform;
+
+                record.object = noo::create_object(doc, data);
+            }
+
+            record.transform = transform;
+            record.mesh_key.clear();
+
+            Bounds own_bounds;
+
+            auto mesh_index = node["mesh"].toInt(-1);
+
+            if (mesh_index >= 0 and
+                mesh_index < (int)staged.mesh_keys.size()) {
+                noo::ObjectData sub_obj_data;
+
+                sub_obj_data.definition = noo::ObjectRenderableDefinition {
+                    .mesh = get_mesh(mesh_index),
+                };
+
+                sub_obj_data.parent = record.object;
+
+                sub_obj_data.tags = QStringList()
+                                    << noo::names::tag_user_hidden;
+
+                record.parts.push_back(noo::create_object(doc, sub_obj_data));
+                record.mesh_key = staged.mesh_keys[mesh_index];
+
+                own_bounds = staged.mesh_bounds[mesh_index];
+            }
+
+            auto tree_node =
+                thing.tree.add(item.tree_node, transform, own_bounds);
+
+            if (!record.mesh_key.isEmpty()) {
+                thing.mesh_nodes.push_back({ tree_node, record.mesh_key });
+            }
+
+            auto children = node["children"].toArray();
+
+            for (int ci = children.size() - 1; ci >= 0; ci--) {
+                auto c = children[ci].toInt();
+                stack.push_back(
+                    { c,
+                      record.object,
+                      QString("%1/%2:%3")
+                          .arg(item.path)
+                          .arg(ci)
+                          .arg(nodes[c].toObject()["name"].toString()),
+                      tree_node });
+            }
+
+            thing.nodes[item.path] = std::move(record);
+        }
+
+        thing.tree.update();
+
+        auto bounds  = thing.tree.bounds();
+        thing.min_bb = bounds.min;
+        thing.max_bb = bounds.max;
+    }
+};
+
+} // namespace
+
+bool is_gltf_path(QString path) {
+    return path.endsWith(".glb", Qt::CaseInsensitive) or
+           path.endsWith(".gltf", Qt::CaseInsensitive);
+}
+
+std::variant<SourcePtr, QString> load_gltf(QString path, bool map) {
+    ScopedTimer timer(metrics::import_phase(metrics::ImportPhase::Parse));
+
+    auto source  = std::make_shared<GLTFSource>();
+    source->path = QFileInfo(path).absoluteFilePath();
+
+    auto whole = open_file(*source, path, map);
+
+    if (!whole) return "Unable to open file";
+
+    if (whole->size() >= 4) {
+        uint32_t magic;
+        std::memcpy(&magic, whole->constData(), sizeof(magic));
+
+        if (magic == glb_magic) {
+            // the binary chunk points into the file, which has to stay
+            if (!map) source->file = *whole;
+            if (auto err = load_glb(*source, *whole)) return *err;
+        } else {
+            source->json = QJsonDocument::fromJson(*whole).object();
+
+            // only binary buffers are needed once the text is parsed
+            source->files.clear();
+        }
+    }
+
+    if (source->json.isEmpty()) return "Unable to parse glTF JSON";
+
+    if (auto err = load_external_buffers(*source, map)) return *err;
+
+    if (auto err = check_supported(*source)) return *err;
+
+    return source;
+}
+
+void stage_gltf(GLTFSource&          source,
+                ImportOptions const& options,
+                ReusableComponents   reuse) {
+    auto staged   = std::make_shared<StagedGLTF>();
+    staged->reuse = std::move(reuse);
+
+    GLTFStager stager {
+        .source  = source,
+        .options = options,
+        .out     = *staged,
+    };
+
+    stager.stage();
+
+    source.staged = std::move(staged);
+}
+
+bool is_stale(GLTFSource const& source, Model const& model) {
+    if (!source.staged) return false;
+
+    auto const& staged = *source.staged;
+
+    // whatever is not pending was left out, to be claimed from the model
+    for (auto const& key : staged.mesh_keys) {
+        if (!key.isEmpty() and !staged.pending_meshes.contains(key) and
+            !model.meshes.contains(key)) {
+            return true;
+        }
+    }
+
+    for (auto const& key : staged.texture_keys) {
+        if (!key.isEmpty() and !staged.pending_textures.contains(key) and
+            !model.textures.contains(key)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::optional<QString>
+update_model_from_gltf(std::shared_ptr<GLTFSource> const& source,
+                       noo::DocumentTPtrRef               doc,
+                       noo::ObjectTPtr                    collective_root,
+                       ModelPtr const&                    model) {
+    // not staged in the background, as for imports done on the spot
+    if (!source->staged) {
+        stage_gltf(*source, model->options, reusable_components(*model));
+    }
+
+    // Replaced components may outlive the importer by a moment, and their
+    // buffers may point into the last mapping of the file
+    auto previous_sources = model->component_sources;
+
+    GLTFImporter imp {
+        .source    = source,
+        .json      = source->json,
+        .staged    = *source->staged,
+        .doc       = doc,
+        .model_ref = model,
+        .thing     = *model,
+        .options   = model->options,
+    };
+
+    imp.begin();
+
+    imp.create_textures();
+
+    {
+        ScopedTimer timer(metrics::import_phase(metrics::ImportPhase::Tree));
+
+        auto root = imp.make_root(collective_root);
+
+        imp.process_nodes(root);
+    }
+
+    imp.finish();
+
+    // The buffers are document components now, and the source may go last
+    // on a worker. Nothing else staged is needed any more.
+    source->staged = nullptr;
+
+    model->resident = true;
+
+    return std::nullopt;
+}
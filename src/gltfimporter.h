@@ -0,0 +1,70 @@
+#pragma once
+
+#include "importer.h"
+#include "playground.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QJsonObject>
+#include <QString>
+
+#include <memory>
+#include <optional>
+#include <variant>
+#include <vector>
+
+struct StagedGLTF;
+
+/// A glTF 2.0 file that has been mapped, or read, and checked for the
+/// native loader. Buffers are published as they are, one document buffer
+/// per glTF buffer, so those point into the mapping; whatever holds on to
+/// them has to hold on to this.
+struct GLTFSource {
+    QString     path;
+    QJsonObject json;
+
+    // open, mapped files backing the buffers below
+    std::vector<std::unique_ptr<QFile>> files;
+
+    // the whole of a GLB file read rather than mapped
+    QByteArray file;
+
+    // one entry per glTF buffer; raw data over a mapping or the file above,
+    // or decoded data URIs
+    std::vector<QByteArray> buffers;
+
+    /// Hashed and staged by stage_gltf, and used up by
+    /// update_model_from_gltf
+    std::shared_ptr<StagedGLTF> staged;
+
+    bool is_mapped() const { return !files.empty(); }
+};
+
+bool is_gltf_path(QString path);
+
+/// Map and check a glTF file, or read it with `map` false. Returns an error
+/// if the file uses something the native loader does not handle; callers
+/// should then fall back to Assimp. Thread safe.
+std::variant<std::shared_ptr<GLTFSource>, QString> load_gltf(QString path,
+                                                             bool    map);
+
+/// Hash the meshes, materials and textures of a glTF file, and sort
+/// triangles for slicing. Nothing is copied: the buffers of the file go into
+/// an arena as chunks of their own, to be published as they are. Touches no
+/// document state, so it is safe off the main thread.
+void stage_gltf(GLTFSource&, ImportOptions const&, ReusableComponents reuse);
+
+/// Whether the model has lost something that staging left out of `source`;
+/// see is_stale
+bool is_stale(GLTFSource const& source, Model const&);
+
+/// Convert a glTF file into a model. As with Assimp scenes, the model root
+/// object is kept, node objects are reused by path, and meshes, materials
+/// and textures by content hash. A file not staged yet is staged on the
+/// spot. The model keeps the source for as long as it shows anything made
+/// from it.
+std::optional<QString>
+update_model_from_gltf(std::shared_ptr<GLTFSource> const& source,
+                       noo::DocumentTPtrRef               doc,
+                       noo::ObjectTPtr                    collective_root,
+                       ModelPtr const&                    model);
@@ -0,0 +1,75 @@
+#include "importarena.h"
+
+#include <algorithm>
+
+ImportArena::ImportArena(size_t block_size) : m_block_size(block_size) { }
+
+ImportArena::Block* ImportArena::add_block(size_t size) {
+    auto block   = std::make_unique<Block>();
+    block->bytes = std::make_unique_for_overwrite<std::byte[]>(size);
+    block->size  = size;
+
+    m_blocks.push_back(std::move(block));
+
+    return m_blocks.back().get();
+}
+
+void* ImportArena::do_allocate(size_t bytes, size_t alignment) {
+    m_allocations.fetch_add(1, std::memory_order_relaxed);
+    m_allocated_bytes.fetch_add(bytes, std::memory_order_relaxed);
+
+    // room for the worst case padding, so a claimed range always fits
+    size_t const claim = bytes + alignment - 1;
+
+    auto align = [alignment](std::byte* p) {
+        auto address = reinterpret_cast<uintptr_t>(p);
+        address      = (address + alignment - 1) & ~(uintptr_t)(alignment - 1);
+        return reinterpret_cast<std::byte*>(address);
+    };
+
+    // large requests get a block of their own and leave the current one be
+    if (claim > m_block_size / 4) {
+        std::scoped_lock lock(m_lock);
+        return align(add_block(claim)->bytes.get());
+    }
+
+    while (true) {
+        auto* block = m_current.load(std::memory_order_acquire);
+
+        if (block) {
+            auto offset =
+                block->used.fetch_add(claim, std::memory_order_relaxed);
+
+            if (offset + claim <= block->size) {
+                return align(block->bytes.get() + offset);
+            }
+        }
+
+        std::scoped_lock lock(m_lock);
+
+        // another thread got here first
+        if (m_current.load(std::memory_order_relaxed) != block) continue;
+
+        m_current.store(add_block(m_block_size), std::memory_order_release);
+    }
+}
+
+void ImportArena::reset() {
+    std::scoped_lock lock(m_lock);
+
+    auto* keep = m_current.load();
+
+    std::erase_if(m_blocks, [keep](auto const& b) { return b.get() != keep; });
+
+    if (keep) keep->used = 0;
+}
+
+size_t ImportArena::reserved_bytes() {
+    std::scoped_lock lock(m_lock);
+
+    size_t ret = 0;
+    for (auto const& block : m_blocks) {
+        ret += block->size;
+    }
+    return ret;
+}
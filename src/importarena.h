@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <span>
+#include <vector>
+
+/// Scratch memory for one import. Allocating bumps an atomic cursor in the
+/// current block, so any thread may allocate at once without taking a lock
+/// but for the rare new block. Nothing is freed on its own; everything goes
+/// at once on reset() or destruction, neither of which may race with
+/// allocation. Usable directly or as a std::pmr resource.
+class ImportArena : public std::pmr::memory_resource {
+    struct Block {
+        std::unique_ptr<std::byte[]> bytes;
+        size_t                       size = 0;
+        std::atomic<size_t>          used = 0;
+    };
+
+    size_t m_block_size;
+
+    std::mutex                          m_lock;
+    std::vector<std::unique_ptr<Block>> m_blocks;
+    std::atomic<Block*>                 m_current = nullptr;
+
+    std::atomic<uint64_t> m_allocations     = 0;
+    std::atomic<uint64_t> m_allocated_bytes = 0;
+
+    Block* add_block(size_t size);
+
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void  do_deallocate(void*, size_t, size_t) override { }
+    bool  do_is_equal(std::pmr::memory_resource const& o) const
+        noexcept override {
+        return this == &o;
+    }
+
+public:
+    static constexpr size_t default_block_size = 4 * 1024 * 1024;
+
+    ImportArena() : ImportArena(default_block_size) { }
+    explicit ImportArena(size_t block_size);
+
+    ImportArena(ImportArena const&)            = delete;
+    ImportArena& operator=(ImportArena const&) = delete;
+
+    /// Uninitialized room for `count` values
+    template <class T>
+    std::span<T> allocate_array(size_t count) {
+        static_assert(std::is_trivially_destructible_v<T>);
+        if (count == 0) return {};
+        return { static_cast<T*>(allocate(count * sizeof(T), alignof(T))),
+                 count };
+    }
+
+    /// Forget every allocation, keeping one block to serve the next ones
+    void reset();
+
+    uint64_t allocations() const { return m_allocations.load(); }
+    uint64_t allocated_bytes() const { return m_allocated_bytes.load(); }
+
+    /// Bytes taken from the heap for blocks
+    size_t reserved_bytes();
+};
@@ -0,0 +1,1898 @@
+#include "importer.h"
+
+#include "animation.h"
+#include "bufferarena.h"
+#include "bulkimporter.h"
+#include "crosssection.h"
+#include "gltfimporter.h"
+#include "importarena.h"
+#include "isosurface.h"
+#include "mappediosystem.h"
+#include "meshprocessing.h"
+#include "metrics.h"
+#include "pointcloud.h"
+#include "publishqueue.h"
+#include "threadpool.h"
+#include "transformtree.h"
+#include "utility.h"
+#include "xdmfimporter.h"
+
+#include <glm/gtx/quaternion.hpp>
+
+#include <QBuffer>
+#include <QByteArray>
+#include <QColor>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QFileInfo>
+#include <QImageWriter>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMimeDatabase>
+
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+
+std::span<glm::vec3> convert_vec3(aiVector3D* src, size_t count) {
+    return { reinterpret_cast<glm::vec3*>(src), count };
+}
+
+glm::u8vec4 convert_col(aiColor4D const& src) {
+    return (glm::vec4(src[0], src[1], src[2], src[3]) * 255.0f);
+}
+
+glm::u16vec2 convert_tex(aiVector3D const& src) {
+    return (glm::vec2(src[0], src[1]) * 65535.0f);
+}
+
+QColor convert_qcol(aiColor4D const& src) {
+    return QColor::fromRgbF(src.r, src.g, src.b, src.a);
+}
+
+QDebug operator<<(QDebug debug, glm::vec4 const& c) {
+    QDebugStateSaver saver(debug);
+    debug.nospace() << '<' << c.x << ", " << c.y << ", " << c.z << ", " << c.w
+                    << '>';
+
+    return debug;
+}
+
+QDebug operator<<(QDebug debug, glm::mat4 const& c) {
+    QDebugStateSaver saver(debug);
+    debug.nospace() << "[\n " << c[0] << "\n " << c[1] << "\n " << c[2] << "\n "
+                    << c[3] << "\n]";
+
+    return debug;
+}
+
+
+// =============================================================================
+
+#define GET_MATKEY(MAT, KEY, TYPE)                                             \
+    ({                                                                         \
+        std::optional<TYPE> ret;                                               \
+        ret.emplace();                                                         \
+        if (AI_SUCCESS != MAT.Get(KEY, *ret)) { ret.reset(); }                 \
+        ret;                                                                   \
+    })
+
+
+QByteArray content_hash(std::initializer_list<std::span<std::byte const>> parts) {
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    for (auto part : parts) {
+        hash.addData(reinterpret_cast<char const*>(part.data()), part.size());
+    }
+    return hash.result();
+}
+
+template <class T, size_t N>
+std::span<std::byte const> hash_bytes(std::span<T, N> s) {
+    return std::as_bytes(s);
+}
+
+template <class T>
+std::span<std::byte const> hash_bytes(T const& v) {
+    return std::as_bytes(std::span(&v, 1));
+}
+
+/// An import converted, hashed and staged into an arena, with only document
+/// components left to create. Made by stage_scene, used up by update_model.
+struct StagedScene {
+    struct PendingTexture {
+        QString            name;
+        BufferArena::Slice slice;
+    };
+
+    struct StagedAttribute {
+        BufferArena::Slice       slice;
+        noo::AttributeSemantic   semantic;
+        noo::Format              format;
+        std::optional<glm::vec4> minimum_value;
+        std::optional<glm::vec4> maximum_value;
+        bool                     normalized = false;
+    };
+
+    struct PendingMesh {
+        QString                           name;
+        noo::PrimitiveType                type;
+        unsigned                          material     = 0; // scene index
+        uint32_t                          vertex_count = 0;
+        uint32_t                          index_count  = 0;
+        std::vector<StagedAttribute>      attributes;
+        std::optional<BufferArena::Slice> indices;
+        qint64                            bytes = 0;
+    };
+
+    // what the model held when staging began; none of it is in the arena,
+    // it is claimed instead
+    ReusableComponents reuse;
+
+    // Everything new is staged here, so the model ends up with a handful of
+    // buffers. Shared with queued publish tasks, which create its buffers as
+    // they first need them.
+    std::shared_ptr<BufferArena> arena =
+        std::make_shared<BufferArena>("Model Arena");
+
+    QHash<QByteArray, PendingTexture> pending_textures;
+    QHash<QByteArray, PendingMesh>    pending_meshes;
+
+    // content hashes, by scene mesh index and material index, and the scene
+    // material of every distinct mesh
+    std::unordered_map<unsigned, QByteArray> mesh_keys;
+    QHash<unsigned, QByteArray>              material_textures;
+    QHash<QByteArray, unsigned>              mesh_materials;
+
+    // by scene material index
+    std::vector<QByteArray>        material_keys;
+    std::vector<noo::MaterialData> material_data;
+
+    // bounds of every mesh, in mesh space
+    QHash<QByteArray, Bounds> mesh_bounds;
+
+    // triangle hierarchies for slicing, new or carried over
+    QHash<QByteArray, std::shared_ptr<MeshBVH const>> bvhs;
+
+    // size of the distinct geometry
+    qint64 vertex_count   = 0;
+    qint64 triangle_count = 0;
+};
+
+/// The part of an import that needs no document: reads and hashes images,
+/// converts materials and meshes in parallel, and copies whatever the model
+/// cannot reuse into the arena. Touches neither the document nor the model,
+/// so it runs off the main thread.
+struct Stager {
+    aiScene const&       scene;
+    ImportOptions const& options;
+    StagedScene&         out;
+
+    // prepared point clouds, and whether to stage their preview level
+    PreparedPoints const*           points  = nullptr;
+    bool                            preview = false;
+    std::shared_ptr<PreparedPoints> own_points;
+
+    // content hash of the image behind each texture path
+    QHash<QString, QByteArray> converted_textures;
+
+    // Per mesh conversion arrays, dropped in bulk once they are staged.
+    // Thread safe, so const conversion may allocate from it.
+    mutable ImportArena scratch;
+
+    /// A mesh converted into CPU arrays, ready to stage. The spans point into
+    /// the scene, a prepared point cloud, or the scratch arena.
+    struct ConvertedMesh {
+        QString            name;
+        noo::PrimitiveType type         = noo::PrimitiveType::TRIANGLES;
+        unsigned           material     = 0;
+        uint32_t           vertex_count = 0;
+        glm::vec3          min          = glm::vec3(0);
+        glm::vec3          max          = glm::vec3(0);
+
+        std::span<glm::vec3 const>    positions;
+        std::span<glm::vec3 const>    normals;
+        std::span<glm::vec3 const>    tangents;
+        std::span<glm::u8vec4 const>  colors;
+        std::span<glm::u16vec2 const> textures;
+        std::span<uint32_t const>     indices;
+
+        std::shared_ptr<PointCloud const> cloud;
+
+        QByteArray hash;
+    };
+
+    QString texture_path(aiMaterial const&          m,
+                         std::vector<aiTextureType> types) const {
+        for (auto type : types) {
+            if (m.GetTextureCount(type) < 1) continue;
+
+            aiString path;
+            m.GetTexture(type, 0, &path);
+
+            qDebug() << "Texture path at" << path.C_Str();
+
+            return QString::fromUtf8(path.C_Str(), path.length);
+        }
+
+        return {};
+    }
+
+    /// The encoded image behind a texture path. Touches nothing but the
+    /// scene and the file system, so it may run on any thread.
+    QByteArray read_texture(QString path) const {
+        qDebug() << "Loading texture from path:" << path;
+
+        if (path.startsWith("*")) {
+            qDebug() << "Appears to be path to builtin";
+            bool ok;
+            int  index = path.mid(1).toInt(&ok);
+            if (!ok or index >= scene.mNumTextures) {
+                qDebug() << "Apparently not. Bailing.";
+                return {};
+            }
+
+            auto const& tex = *scene.mTextures[index];
+
+            qDebug() << "TEX" << tex.achFormatHint << tex.mWidth << tex.mHeight
+                     << tex.mFilename.C_Str();
+
+            if (tex.mHeight == 0) {
+                qDebug() << "Texture is compressed";
+                metrics::texture_source_bytes().add(tex.mWidth);
+                metrics::texture_encoded_bytes().add(tex.mWidth);
+                return QByteArray((char*)tex.pcData, tex.mWidth);
+            }
+
+            qCritical() << "Image conversion is not yet supported";
+
+            return {};
+        }
+
+        qDebug() << "Path is external, loading";
+
+        QMimeDatabase db;
+        auto          type = db.mimeTypeForFile(path);
+
+        if (type.inherits("image/png") or type.inherits("image/jpeg")) {
+            // just use as is
+            QFile file(path);
+            file.open(QFile::ReadOnly);
+            auto bytes = file.readAll();
+            metrics::texture_source_bytes().add(bytes.size());
+            metrics::texture_encoded_bytes().add(bytes.size());
+            return bytes;
+        }
+
+        QByteArray bytes;
+        {
+            QBuffer      out_stream(&bytes);
+            QImageWriter writer(&out_stream, "png");
+            QImage       img(path);
+            writer.write(img);
+        }
+
+        metrics::texture_source_bytes().add(QFileInfo(path).size());
+        metrics::texture_encoded_bytes().add(bytes.size());
+
+        return bytes;
+    }
+
+    QByteArray texture_hash(QByteArray const& array) const {
+        return content_hash(
+            { std::as_bytes(std::span(array.data(), array.size())),
+              hash_bytes(options.force_samplers_to_nearest) });
+    }
+
+    void stage_texture(QByteArray const& hash,
+                       QByteArray const& array,
+                       QString           name) {
+        qDebug() << "Loading raw texture" << array.size() << "bytes";
+
+        if (out.pending_textures.contains(hash)) return;
+
+        // claimed when the import is applied
+        if (out.reuse.textures.contains(hash)) return;
+
+        out.pending_textures[hash] = StagedScene::PendingTexture {
+            .name  = name,
+            .slice = out.arena->append(
+                std::as_bytes(std::span(array.data(), array.size()))),
+        };
+    }
+
+    /// Read and hash the image of every material in parallel, and stage
+    /// those the model does not hold yet
+    void stage_textures() {
+        QStringList              paths;
+        QHash<unsigned, QString> material_paths;
+
+        for (unsigned i = 0; i < scene.mNumMaterials; i++) {
+            auto path = texture_path(
+                *scene.mMaterials[i],
+                { aiTextureType_BASE_COLOR, aiTextureType_DIFFUSE });
+
+            if (path.isEmpty()) continue;
+
+            material_paths[i] = path;
+
+            if (!paths.contains(path)) paths << path;
+        }
+
+        std::vector<QByteArray> bytes(paths.size());
+        std::vector<QByteArray> hashes(paths.size());
+
+        ThreadPool::global().parallel_for(paths.size(), [&](size_t i) {
+            bytes[i] = read_texture(paths[i]);
+            if (!bytes[i].isEmpty()) hashes[i] = texture_hash(bytes[i]);
+        });
+
+        for (int i = 0; i < paths.size(); i++) {
+            if (bytes[i].isEmpty()) continue;
+
+            stage_texture(hashes[i], bytes[i], paths[i]);
+            converted_textures[paths[i]] = hashes[i];
+        }
+
+        for (auto iter = material_paths.begin(); iter != material_paths.end();
+             ++iter) {
+            auto key = converted_textures.value(iter.value());
+            if (!key.isEmpty()) out.material_textures[iter.key()] = key;
+        }
+
+        // meshes go into chunks of their own, made as they are published
+        out.arena->seal();
+    }
+
+    QByteArray material_hash(aiMaterial const& m,
+                             QByteArray const& base) const {
+        QCryptographicHash hash(QCryptographicHash::Md5);
+
+        for (unsigned i = 0; i < m.mNumProperties; i++) {
+            auto const& prop = *m.mProperties[i];
+            hash.addData(prop.mKey.C_Str(), prop.mKey.length);
+            hash.addData(reinterpret_cast<char const*>(&prop.mSemantic),
+                         sizeof(prop.mSemantic));
+            hash.addData(reinterpret_cast<char const*>(&prop.mIndex),
+                         sizeof(prop.mIndex));
+            hash.addData(prop.mData, prop.mDataLength);
+        }
+
+        // the texture path is in the properties, but the file behind it may
+        // have changed
+        hash.addData(base);
+
+        hash.addData(reinterpret_cast<char const*>(&options.double_sided),
+                     sizeof(options.double_sided));
+
+        return hash.result();
+    }
+
+    /// Everything about a material but its texture, which has to be created
+    /// on the main thread first
+    noo::MaterialData convert_material(aiMaterial const& m) const {
+        noo::MaterialData mdata;
+
+        auto& pbr = mdata.pbr_info.emplace();
+
+        {
+            auto base_color = GET_MATKEY(m, AI_MATKEY_BASE_COLOR, aiColor4D);
+            if (!base_color) {
+                base_color = GET_MATKEY(m, AI_MATKEY_COLOR_DIFFUSE, aiColor4D);
+            }
+            if (!base_color) { base_color = aiColor4D(1, 1, 1, 1); }
+
+            pbr.base_color = convert_qcol(base_color.value());
+        }
+
+        {
+            auto metallic = GET_MATKEY(m, AI_MATKEY_METALLIC_FACTOR, float);
+            if (!metallic) {
+                metallic = GET_MATKEY(m, AI_MATKEY_SPECULAR_FACTOR, float);
+            }
+
+            pbr.metallic = metallic.value_or(1);
+        }
+
+        {
+            auto roughness = GET_MATKEY(m, AI_MATKEY_ROUGHNESS_FACTOR, float);
+            if (!roughness) {
+                roughness = GET_MATKEY(m, AI_MATKEY_GLOSSINESS_FACTOR, float);
+            }
+
+            pbr.roughness = roughness.value_or(1);
+        }
+
+        mdata.double_sided = GET_MATKEY(m, AI_MATKEY_TWOSIDED, bool);
+
+        if (options.double_sided) { mdata.double_sided = true; }
+
+        return mdata;
+    }
+
+    template <class T, size_t N>
+    void stage_attribute(StagedScene::PendingMesh& pending,
+                         std::span<T, N>           values,
+                         noo::AttributeSemantic    semantic,
+                         noo::Format               format,
+                         bool                      normalized = false) {
+        if (values.empty()) return;
+
+        auto& attrib      = pending.attributes.emplace_back();
+        attrib.slice      = out.arena->append(values);
+        attrib.semantic   = semantic;
+        attrib.format     = format;
+        attrib.normalized = normalized;
+
+        pending.bytes += attrib.slice.length;
+    }
+
+    /// Point meshes come from prepare_points, already ordered and reduced
+    void convert_points(unsigned index, ConvertedMesh& ret) const {
+        std::shared_ptr<PointCloud const> cloud;
+
+        auto find = [index](auto const& map) {
+            auto iter = map.find(index);
+            return iter == map.end() ? nullptr : iter->second;
+        };
+
+        if (preview) cloud = find(points->preview);
+        if (!cloud) cloud = find(points->full);
+        if (!cloud) return;
+
+        qDebug() << "Adding point cloud" << cloud->positions.size();
+
+        ret.type         = noo::PrimitiveType::POINTS;
+        ret.vertex_count = cloud->positions.size();
+        ret.positions    = cloud->positions;
+        ret.normals      = cloud->normals;
+        ret.colors       = cloud->colors;
+        ret.cloud        = cloud;
+    }
+
+    /// Convert a mesh into CPU arrays and hash them. Reads only the scene
+    /// and the material hashes, so meshes convert in parallel.
+    ConvertedMesh convert_mesh(unsigned index) const {
+        auto const& mesh = *scene.mMeshes[index];
+
+        ConvertedMesh ret {
+            .name     = QString::fromUtf8(mesh.mName.C_Str()),
+            .material = mesh.mMaterialIndex,
+        };
+
+        if (is_point_mesh(mesh)) {
+            convert_points(index, ret);
+        } else {
+            convert_geometry(mesh, ret);
+        }
+
+        if (ret.positions.empty()) return ret;
+
+        std::tie(ret.min, ret.max) = min_max_of(ret.positions);
+
+        auto const& material_key = out.material_keys[ret.material];
+
+        ret.hash = content_hash({
+            hash_bytes(ret.positions),
+            hash_bytes(ret.normals),
+            hash_bytes(ret.tangents),
+            hash_bytes(ret.colors),
+            hash_bytes(ret.textures),
+            hash_bytes(ret.indices),
+            hash_bytes(ret.type),
+            hash_bytes(std::span(material_key.data(), material_key.size())),
+        });
+
+        return ret;
+    }
+
+    void convert_geometry(aiMesh const& mesh, ConvertedMesh& ret) const {
+        qDebug() << "Adding new mesh from scene...";
+
+        qDebug() << "Num Verts" << mesh.mNumVertices;
+
+        static_assert(sizeof(glm::vec3) == sizeof(aiVector3D));
+
+        ret.vertex_count = mesh.mNumVertices;
+        ret.positions    = convert_vec3(mesh.mVertices, mesh.mNumVertices);
+
+        if (mesh.mNormals) {
+            qDebug() << "Adding normals";
+            ret.normals = convert_vec3(mesh.mNormals, mesh.mNumVertices);
+        }
+
+        if (mesh.mTangents) {
+            qDebug() << "Adding tangents";
+            ret.tangents = convert_vec3(mesh.mTangents, mesh.mNumVertices);
+        }
+
+        if (mesh.mColors[0]) {
+            qDebug() << "Adding colors[0]";
+            auto channel = mesh.mColors[0];
+            auto colors =
+                scratch.allocate_array<glm::u8vec4>(mesh.mNumVertices);
+
+            for (size_t i = 0; i < mesh.mNumVertices; i++) {
+                colors[i] = convert_col(channel[i]);
+            }
+
+            ret.colors = colors;
+        }
+
+        if (mesh.HasTextureCoords(0)) {
+            qDebug() << "Adding uv[0]";
+            auto channel = mesh.mTextureCoords[0];
+            auto textures =
+                scratch.allocate_array<glm::u16vec2>(mesh.mNumVertices);
+
+            for (size_t i = 0; i < mesh.mNumVertices; i++) {
+                textures[i] = convert_tex(channel[i]);
+            }
+
+            ret.textures = textures;
+        }
+
+        if (mesh.mPrimitiveTypes & aiPrimitiveType::aiPrimitiveType_LINE) {
+            qDebug() << "Adding LINE" << mesh.mNumFaces;
+            auto indices = scratch.allocate_array<uint32_t>(mesh.mNumFaces * 2);
+            for (size_t i = 0; i < mesh.mNumFaces; i++) {
+                auto const& face = mesh.mFaces[i];
+                assert(face.mNumIndices >= 2);
+                indices[i * 2]     = face.mIndices[0];
+                indices[i * 2 + 1] = face.mIndices[1];
+            }
+            ret.indices = indices;
+            ret.type    = noo::PrimitiveType::LINES;
+
+        } else if (mesh.mPrimitiveTypes &
+                   aiPrimitiveType::aiPrimitiveType_TRIANGLE) {
+            qDebug() << "Adding TRIANGLES" << mesh.mNumFaces;
+            auto indices = scratch.allocate_array<uint32_t>(mesh.mNumFaces * 3);
+            for (size_t i = 0; i < mesh.mNumFaces; i++) {
+                auto const& face = mesh.mFaces[i];
+                assert(face.mNumIndices >= 3);
+                indices[i * 3]     = face.mIndices[0];
+                indices[i * 3 + 1] = face.mIndices[1];
+                indices[i * 3 + 2] = face.mIndices[2];
+            }
+            ret.indices = indices;
+            ret.type    = noo::PrimitiveType::TRIANGLES;
+        }
+    }
+
+    /// Stage a converted mesh unless the model holds it already. Returns the
+    /// content hash; the mesh itself is made when the import is applied.
+    QByteArray stage_mesh(ConvertedMesh const& c) {
+        if (c.positions.empty()) return {};
+
+        // shown more than once in this import
+        if (out.mesh_bounds.contains(c.hash)) return c.hash;
+
+        out.mesh_bounds[c.hash]    = Bounds { c.min, c.max };
+        out.mesh_materials[c.hash] = c.material;
+
+        out.vertex_count += c.vertex_count;
+
+        if (c.type == noo::PrimitiveType::TRIANGLES) {
+            out.triangle_count +=
+                (c.indices.empty() ? c.vertex_count : c.indices.size()) / 3;
+        }
+
+        index_for_slicing(c);
+
+        // claimed when the import is applied
+        if (out.reuse.meshes.contains(c.hash)) return c.hash;
+
+        StagedScene::PendingMesh pending {
+            .name         = c.name,
+            .type         = c.type,
+            .material     = c.material,
+            .vertex_count = c.vertex_count,
+            .index_count  = (uint32_t)c.indices.size(),
+        };
+
+        using S = noo::AttributeSemantic;
+        using F = noo::Format;
+
+        stage_attribute(pending, c.positions, S::POSITION, F::VEC3);
+        stage_attribute(pending, c.normals, S::NORMAL, F::VEC3);
+        stage_attribute(pending, c.tangents, S::TANGENT, F::VEC3);
+        stage_attribute(pending, c.colors, S::COLOR, F::U8VEC4, true);
+        stage_attribute(pending, c.textures, S::TEXTURE, F::U16VEC2, true);
+
+        auto& position         = pending.attributes.front();
+        position.minimum_value = glm::vec4(c.min, 1);
+        position.maximum_value = glm::vec4(c.max, 1);
+
+        if (!c.indices.empty()) {
+            pending.indices = out.arena->append(c.indices);
+            pending.bytes += pending.indices->length;
+        }
+
+        out.pending_meshes[c.hash] = std::move(pending);
+
+        return c.hash;
+    }
+
+    /// Sort the triangles of a mesh into a hierarchy for cross-sections, or
+    /// keep the one of the last import if the mesh is unchanged
+    void index_for_slicing(ConvertedMesh const& c) {
+        if (!options.slicing) return;
+        if (c.type != noo::PrimitiveType::TRIANGLES) return;
+
+        if (auto previous = out.reuse.bvhs.value(c.hash)) {
+            out.bvhs[c.hash] = std::move(previous);
+            return;
+        }
+
+        out.bvhs[c.hash] =
+            std::make_shared<MeshBVH const>(c.positions, c.indices);
+    }
+
+    /// Free the arrays of a scene mesh whose data has been staged. The scene
+    /// belongs to this import alone, and nothing reads the mesh afterwards.
+    void release_mesh(unsigned index) const {
+        auto& mesh = const_cast<aiMesh&>(*scene.mMeshes[index]);
+
+        auto drop = [](auto*& array) {
+            delete[] array;
+            array = nullptr;
+        };
+
+        drop(mesh.mVertices);
+        drop(mesh.mNormals);
+        drop(mesh.mTangents);
+        drop(mesh.mBitangents);
+        drop(mesh.mFaces);
+
+        for (auto& channel : mesh.mColors) {
+            drop(channel);
+        }
+
+        for (auto& channel : mesh.mTextureCoords) {
+            drop(channel);
+        }
+
+        mesh.mNumVertices = 0;
+        mesh.mNumFaces    = 0;
+    }
+
+    /// Convert and stage one batch of meshes at a time, releasing each source
+    /// mesh as soon as it is in the arena. At any moment only a batch of
+    /// converted copies exists, and the scene shrinks as the arena grows.
+    void stream_meshes() {
+        ScopedTimer timer(metrics::import_phase(metrics::ImportPhase::Stream));
+
+        auto& pool = ThreadPool::global();
+
+        size_t const batch = std::max(1u, pool.size());
+
+        std::vector<ConvertedMesh> converted(batch);
+
+        for (size_t first = 0; first < scene.mNumMeshes; first += batch) {
+            auto count = std::min<size_t>(batch, scene.mNumMeshes - first);
+
+            pool.parallel_for(count, [&](size_t i) {
+                converted[i] = convert_mesh(first + i);
+            });
+
+            for (size_t i = 0; i < count; i++) {
+                out.mesh_keys[first + i] = stage_mesh(converted[i]);
+                converted[i]             = ConvertedMesh {};
+                release_mesh(first + i);
+            }
+
+            // the next batch reuses the same block
+            scratch.reset();
+        }
+
+        metrics::meshes_converted().add(scene.mNumMeshes);
+    }
+
+    /// Convert every material and mesh of the scene in parallel, then stage
+    /// those the model does not hold yet
+    void stage_meshes() {
+        if (!points) {
+            ScopedTimer timer(
+                metrics::import_phase(metrics::ImportPhase::Points));
+            own_points = prepare_points(scene, options);
+            points     = own_points.get();
+        }
+
+        auto& pool = ThreadPool::global();
+
+        // mesh hashes include their material's, so materials go first
+        out.material_keys.resize(scene.mNumMaterials);
+        out.material_data.resize(scene.mNumMaterials);
+
+        pool.parallel_for(scene.mNumMaterials, [this](size_t i) {
+            auto const& m = *scene.mMaterials[i];
+            out.material_keys[i] =
+                material_hash(m, out.material_textures.value(i));
+            out.material_data[i] = convert_material(m);
+        });
+
+        if (options.low_memory) {
+            stream_meshes();
+        } else {
+            std::vector<ConvertedMesh> converted(scene.mNumMeshes);
+
+            {
+                ScopedTimer timer(
+                    metrics::import_phase(metrics::ImportPhase::Convert));
+
+                pool.parallel_for(scene.mNumMeshes, [&](size_t i) {
+                    converted[i] = convert_mesh(i);
+                });
+
+                metrics::meshes_converted().add(scene.mNumMeshes);
+            }
+
+            // streaming cannot look ahead, so only this path copies meshes
+            // out of chunks the last import mostly leaves behind
+            QList<QByteArray> keys;
+
+            for (auto const& c : converted) {
+                keys << c.hash;
+            }
+
+            drop_sparse_chunks(out.reuse, keys);
+
+            ScopedTimer timer(
+                metrics::import_phase(metrics::ImportPhase::Stage));
+
+            for (unsigned i = 0; i < scene.mNumMeshes; i++) {
+                out.mesh_keys[i] = stage_mesh(converted[i]);
+            }
+        }
+
+        qInfo() << "Conversion scratch served" << scratch.allocations()
+                << "allocations," << scratch.allocated_bytes() << "bytes";
+
+        scratch.reset();
+
+        // buffers are made once the import is applied
+        out.arena->seal();
+    }
+};
+
+/// The part of an import that needs the document: creates what staging
+/// left for it, claims everything else from what the model held, and builds
+/// the objects of the node tree. Main thread only.
+struct Importer {
+    aiScene const&         scene;
+    StagedScene&           staged;
+    noo::DocumentTPtrRef   doc;
+    noo::ObjectTPtr        root;
+    std::shared_ptr<Model> model_ref;
+    Model&                 thing;
+    ImportOptions          options;
+
+    // When set, new meshes and the objects showing them are queued here
+    // instead of created on the spot
+    PublishQueue* queue = nullptr;
+
+    // the box of the scene in world space, which publish priorities are
+    // fractions of
+    Bounds scene_bounds;
+
+    // by scene material index
+    std::unordered_map<unsigned, noo::MaterialTPtr> converted_materials;
+
+    // object parts waiting for publish(), and the priority of each mesh, the
+    // largest of the parts showing it
+    struct QueuedPart {
+        QString         path;
+        noo::ObjectTPtr object;
+        QByteArray      mesh;
+        float           priority;
+    };
+
+    std::vector<QueuedPart>  queued_parts;
+    QHash<QByteArray, float> mesh_priority;
+    QList<QByteArray>        queued_meshes;
+
+    // path of every node but the root, for animation channels to find
+    QHash<aiNode const*, QString> node_paths;
+
+    // What the model held before this import. Anything not claimed again is
+    // released when the importer goes away.
+    QHash<QString, ModelNode>            previous_nodes;
+    QHash<QByteArray, noo::MeshTPtr>     previous_meshes;
+    QHash<QByteArray, noo::MaterialTPtr> previous_materials;
+    QHash<QByteArray, noo::TextureTPtr>  previous_textures;
+
+    void begin() {
+        if (queue) {
+            queue->cancel(thing.id);
+
+            // whatever was still queued gets queued again below
+            for (auto& node : thing.nodes) {
+                if (!node.queued_parts) continue;
+                node.parts.clear();
+                node.queued_parts = 0;
+            }
+        }
+
+        previous_nodes     = std::exchange(thing.nodes, {});
+        previous_meshes    = std::exchange(thing.meshes, {});
+        previous_materials = std::exchange(thing.materials, {});
+        previous_textures  = std::exchange(thing.textures, {});
+
+        thing.bvhs = std::move(staged.bvhs);
+
+        thing.mesh_nodes.clear();
+
+        thing.min_bb = glm::vec3(std::numeric_limits<float>::max());
+        thing.max_bb = glm::vec3(std::numeric_limits<float>::lowest());
+
+        thing.tree.clear();
+
+        thing.vertex_count   = staged.vertex_count;
+        thing.triangle_count = staged.triangle_count;
+    }
+
+    /// Recompute what the model costs now that the import is done
+    void finish() {
+        ModelMemory mem;
+
+        // queued meshes count now, so the memory budget sees them before
+        // they are out
+        count_component_bytes(thing,
+                              thing.meshes.keys() + queued_meshes,
+                              thing.textures.keys(),
+                              mem);
+
+        auto const entries = thing.component_bytes.size();
+
+        // our own bookkeeping; a rough figure, but it scales with the model
+        mem.cpu_bytes = thing.nodes.size() * sizeof(ModelNode) +
+                        entries * (sizeof(qint64) + 16) * 2;
+
+        for (auto const& chunks : qAsConst(thing.component_chunks)) {
+            mem.cpu_bytes += chunks.size() * sizeof(chunks[0]);
+        }
+
+        for (auto const& node : qAsConst(thing.nodes)) {
+            mem.cpu_bytes += node.mesh_key.size() +
+                             node.parts.size() * sizeof(noo::ObjectTPtr);
+        }
+
+        if (thing.animations) mem.cpu_bytes += thing.animations->byte_size();
+
+        mem.cpu_bytes += thing.tree.byte_size();
+
+        if (thing.volume) mem.cpu_bytes += thing.volume->byte_size();
+
+        for (auto const& bvh : qAsConst(thing.bvhs)) {
+            mem.cpu_bytes += bvh->byte_size();
+        }
+
+        mem.cpu_bytes += thing.mesh_nodes.size() * sizeof(thing.mesh_nodes[0]);
+
+        thing.memory = mem;
+    }
+
+    /// Claim the textures the model holds already, and create the staged
+    /// ones out of the arena
+    void create_textures() {
+        for (auto const& key : qAsConst(staged.material_textures)) {
+            if (!staged.pending_textures.contains(key)) {
+                claim(thing.textures, previous_textures, key);
+            }
+        }
+
+        auto& pending_textures = staged.pending_textures;
+
+        if (pending_textures.isEmpty()) return;
+
+        ScopedTimer timer(metrics::import_phase(metrics::ImportPhase::Create));
+
+        noo::SamplerTPtr nearest;
+
+        if (options.force_samplers_to_nearest) {
+            qDebug() << "Adding sampler hack";
+            noo::SamplerData sampler_data {
+                .mag_filter = noo::MagFilter::NEAREST,
+                .min_filter = noo::MinFilter::NEAREST,
+                .wrap_s     = noo::SamplerMode::CLAMP_TO_EDGE,
+                .wrap_t     = noo::SamplerMode::CLAMP_TO_EDGE,
+            };
+
+            nearest = noo::create_sampler(doc, sampler_data);
+        }
+
+        for (auto iter = pending_textures.begin();
+             iter != pending_textures.end();
+             ++iter) {
+            auto const& pending = iter.value();
+
+            auto new_image = noo::create_image(
+                doc,
+                noo::ImageData {
+                    .name   = pending.name,
+                    .source = staged.arena->view_of(
+                        doc, pending.slice, noo::ViewType::IMAGE_INFO),
+                });
+
+            auto tex_data =
+                noo::TextureData { .name = pending.name, .image = new_image };
+
+            if (nearest) tex_data.sampler = nearest;
+
+            auto new_texture = noo::create_texture(doc, tex_data);
+
+            thing.textures[iter.key()]         = new_texture;
+            thing.component_bytes[iter.key()]  = pending.slice.length;
+            thing.component_chunks[iter.key()] = staged.arena->chunks_of(
+                std::span(&pending.slice, 1));
+
+            metrics::buffer_bytes_created(metrics::BufferType::Image)
+                .add(pending.slice.length);
+        }
+
+        pending_textures.clear();
+    }
+
+    noo::MaterialTPtr import_material(unsigned index) {
+        if (auto iter = converted_materials.find(index);
+            iter != converted_materials.end()) {
+            return iter->second;
+        }
+
+        auto const& hash = staged.material_keys[index];
+
+        auto ret = claim(thing.materials, previous_materials, hash);
+
+        if (!ret) {
+            qDebug() << "Adding new material";
+
+            auto mdata = staged.material_data[index];
+
+            auto base =
+                thing.textures.value(staged.material_textures.value(index));
+
+            if (base) {
+                mdata.pbr_info->base_color_texture.emplace(noo::TextureRef {
+                    .source             = base,
+                    .transform          = glm::mat3(1),
+                    .texture_coord_slot = 0,
+                });
+            }
+
+            ret                   = noo::create_material(doc, mdata);
+            thing.materials[hash] = ret;
+        }
+
+        converted_materials[index] = ret;
+
+        return ret;
+    }
+
+    /// Claim the meshes the model holds already and, without a queue,
+    /// create the staged ones out of the arena
+    void create_meshes() {
+        for (auto iter = staged.mesh_materials.begin();
+             iter != staged.mesh_materials.end();
+             ++iter) {
+            import_material(iter.value());
+
+            if (!staged.pending_meshes.contains(iter.key())) {
+                claim(thing.meshes, previous_meshes, iter.key());
+            }
+        }
+
+        // known before the meshes are made, so queued ones count too
+        for (auto iter = staged.pending_meshes.begin();
+             iter != staged.pending_meshes.end();
+             ++iter) {
+            auto const& pending = iter.value();
+
+            std::vector<BufferArena::Slice> slices;
+
+            for (auto const& attrib : pending.attributes) {
+                slices.push_back(attrib.slice);
+            }
+
+            if (pending.indices) slices.push_back(*pending.indices);
+
+            thing.component_bytes[iter.key()] = pending.bytes;
+            thing.component_chunks[iter.key()] =
+                staged.arena->chunks_of(slices);
+        }
+
+        // made by publish(), once priorities are known
+        if (queue) return;
+
+        ScopedTimer create_timer(
+            metrics::import_phase(metrics::ImportPhase::Create));
+
+        auto& arena = *staged.arena;
+
+        if (!staged.pending_meshes.isEmpty()) arena.flush(doc);
+
+        for (auto iter = staged.pending_meshes.begin();
+             iter != staged.pending_meshes.end();
+             ++iter) {
+            auto const& pending = iter.value();
+
+            auto new_mesh = create_mesh(
+                doc, arena, pending, import_material(pending.material));
+
+            thing.meshes[iter.key()] = new_mesh;
+        }
+
+        staged.pending_meshes.clear();
+
+        qDebug() << "Model uses" << arena.buffer_count() << "arena buffers";
+    }
+
+    static noo::MeshTPtr
+    create_mesh(noo::DocumentTPtrRef            doc,
+                BufferArena&                    arena,
+                StagedScene::PendingMesh const& pending,
+                noo::MaterialTPtr const&        material) {
+        noo::MeshPatch patch;
+        patch.type         = pending.type;
+        patch.material     = material;
+        patch.vertex_count = pending.vertex_count;
+
+        for (auto const& attrib : pending.attributes) {
+            auto view = arena.geometry_view(doc, attrib.slice.chunk);
+
+            patch.attributes.push_back(noo::Attribute {
+                .view          = view,
+                .semantic      = attrib.semantic,
+                .channel       = 0,
+                .offset        = (uint32_t)attrib.slice.offset,
+                .stride        = 0,
+                .format        = attrib.format,
+                .minimum_value = attrib.minimum_value,
+                .maximum_value = attrib.maximum_value,
+                .normalized    = attrib.normalized,
+            });
+        }
+
+        if (pending.indices) {
+            patch.indices = noo::Index {
+                .view   = arena.geometry_view(doc, pending.indices->chunk),
+                .count  = pending.index_count,
+                .offset = (uint32_t)pending.indices->offset,
+                .stride = 0,
+                .format = noo::Format::U32,
+            };
+        }
+
+        noo::MeshData mesh_data;
+        mesh_data.name = pending.name;
+        mesh_data.patches.push_back(patch);
+
+        metrics::buffer_bytes_created(metrics::BufferType::Geometry)
+            .add(pending.bytes);
+
+        return noo::create_mesh(doc, mesh_data);
+    }
+
+    static noo::ObjectTPtr create_part(noo::DocumentTPtrRef   doc,
+                                       noo::ObjectTPtr const& parent,
+                                       noo::MeshTPtr const&   mesh) {
+        noo::ObjectData sub_obj_data;
+
+        sub_obj_data.definition =
+            noo::ObjectRenderableDefinition { .mesh = mesh };
+
+        sub_obj_data.parent = parent;
+
+        sub_obj_data.tags = QStringList() << noo::names::tag_user_hidden;
+
+        return noo::create_object(doc, sub_obj_data);
+    }
+
+    /// How much a part matters to the look of the scene: the size of its box
+    /// in world space. publish() makes it a fraction of the scene.
+    float importance(glm::mat4 const& world, QByteArray const& mesh) const {
+        auto extent = staged.mesh_bounds.value(mesh).size();
+
+        // the box of a transformed box
+        glm::vec3 world_extent = glm::abs(glm::mat3(world)[0]) * extent.x +
+                                 glm::abs(glm::mat3(world)[1]) * extent.y +
+                                 glm::abs(glm::mat3(world)[2]) * extent.z;
+
+        return glm::length(world_extent);
+    }
+
+    /// Queue the meshes and parts of this import, most important first.
+    /// Every mesh goes ahead of the parts that show it.
+    void publish() {
+        if (!queue) return;
+
+        std::weak_ptr<Model> weak_model = model_ref;
+        noo::DocumentTPtr    doc_ref    = doc;
+
+        // the scene as it is about to be, with this model in it, so that
+        // parts of a small model do not outrank large parts of others
+        auto bounds = scene_bounds;
+        bounds.grow(thing.world_bounds());
+
+        auto const scene_size = glm::length(bounds.size());
+
+        auto share = [&](float size) {
+            return scene_size > 0 ? size / scene_size : 0.0f;
+        };
+
+        auto& pending_meshes = staged.pending_meshes;
+
+        for (auto iter = pending_meshes.begin(); iter != pending_meshes.end();
+             ++iter) {
+            auto key = iter.key();
+
+            queued_meshes << key;
+
+            queue->push(thing.id,
+                        share(mesh_priority.value(key, 0)),
+                        [weak_model,
+                         doc_ref,
+                         key,
+                         arena    = staged.arena,
+                         material = import_material(iter.value().material),
+                         pending  = std::move(iter.value())]() {
+                            auto model = weak_model.lock();
+                            if (!model) return;
+
+                            model->meshes[key] = create_mesh(
+                                doc_ref, *arena, pending, material);
+                        });
+        }
+
+        pending_meshes.clear();
+
+        for (auto& part : queued_parts) {
+            queue->push(
+                thing.id,
+                share(part.priority),
+                [weak_model, doc_ref, part = std::move(part)]() {
+                    auto model = weak_model.lock();
+                    if (!model) return;
+
+                    auto iter = model->nodes.find(part.path);
+
+                    // replaced by a newer import
+                    if (iter == model->nodes.end() or
+                        iter->object != part.object) {
+                        return;
+                    }
+
+                    iter->queued_parts--;
+
+                    auto mesh = model->meshes.value(part.mesh);
+                    if (!mesh) return;
+
+                    iter->parts.push_back(
+                        create_part(doc_ref, part.object, mesh));
+                });
+        }
+
+        queued_parts.clear();
+    }
+
+    /// Nodes are keyed by their path from the root, so a re-import can find
+    /// the object it created for the same node last time. Walks with an
+    /// explicit stack, so deep hierarchies cannot overflow ours; the visit
+    /// order is the same depth first order recursion would give. The nodes
+    /// also go into the transform tree of the model, which then gives the
+    /// model its bounds.
+    void process_import_tree(aiNode const&   root_node,
+                             noo::ObjectTPtr root_parent) {
+        struct Pending {
+            aiNode const*   node;
+            noo::ObjectTPtr parent;
+            QString         path;
+            glm::mat4       world;     // of the parent, within the model
+            uint32_t        tree_node; // of the parent
+        };
+
+        std::vector<Pending> stack;
+        stack.push_back({ &root_node,
+                          root_parent,
+                          QString(),
+                          glm::mat4(1),
+                          TransformTree::none });
+
+        while (!stack.empty()) {
+            auto [node, parent, path, world, tree_node] =
+                std::move(stack.back());
+            stack.pop_back();
+
+            auto this_node =
+                process_node(*node, parent, path, world, tree_node);
+
+            for (unsigned ci = node->mNumChildren; ci-- > 0;) {
+                auto const& child = *node->mChildren[ci];
+                stack.push_back({ &child,
+                                  this_node,
+                                  QString("%1/%2:%3")
+                                      .arg(path)
+                                      .arg(ci)
+                                      .arg(child.mName.C_Str()),
+                                  world,
+                                  tree_node });
+            }
+        }
+
+        thing.tree.update();
+
+        auto bounds  = thing.tree.bounds();
+        thing.min_bb = bounds.min;
+        thing.max_bb = bounds.max;
+    }
+
+    /// Create or update the object of a node. `world` and `tree_node` come
+    /// in as the transform and tree node of the parent and go out as those
+    /// of this node.
+    noo::ObjectTPtr process_node(aiNode const&   node,
+                                 noo::ObjectTPtr parent,
+                                 QString const&  path,
+                                 glm::mat4&      world,
+                                 uint32_t&       tree_node) {
+        qDebug() << "Handling new node...";
+
+        bool const is_root = path.isEmpty();
+
+        glm::mat4 transform;
+
+        for (int i = 0; i < (4 * 4); i++) {
+            // from Row major to column major
+            glm::value_ptr(transform)[i] = (node.mTransformation[0])[i];
+        }
+
+        qDebug() << "Transformation:" << transform;
+
+        world = world * transform;
+
+        std::vector<QByteArray> meshes;
+        QByteArray              mesh_key;
+        Bounds                  own_bounds;
+
+        for (unsigned mi = 0; mi < node.mNumMeshes; mi++) {
+            auto key = staged.mesh_keys[node.mMeshes[mi]];
+
+            // empty point clouds have nothing to show
+            if (key.isEmpty()) continue;
+
+            mesh_key += key;
+            meshes.push_back(key);
+            own_bounds.grow(staged.mesh_bounds.value(key));
+        }
+
+        // the tree is in the space of the root object
+        tree_node = thing.tree.add(
+            tree_node, is_root ? glm::mat4(1) : transform, own_bounds);
+
+        for (auto const& key : meshes) {
+            thing.mesh_nodes.push_back({ tree_node, key });
+        }
+
+        ModelNode record = previous_nodes.take(path);
+
+        bool const existed = bool(record.object);
+
+        if (existed) {
+            // keep the root as is; it carries the user's transform
+            if (!is_root and record.transform != transform) {
+                noo::ObjectUpdateData update;
+                update.transform = transform;
+                noo::update_object(record.object, update);
+                metrics::transform_updates_sent().add();
+            }
+
+            if (record.mesh_key != mesh_key) record.parts.clear();
+
+        } else {
+            noo::ObjectData new_obj_data;
+
+            if (node.mName.length) new_obj_data.name = node.mName.C_Str();
+
+            if (parent) new_obj_data.parent = parent;
+
+            new_obj_data.transform = transform;
+
+            // the root of the model gets the user facing callbacks
+            if (is_root) {
+                new_obj_data.create_callbacks = [=](noo::ObjectT* t) {
+                    return std::make_unique<ModelCallbacks>(t, model_ref);
+                };
+            }
+
+            record.object = noo::create_object(doc, new_obj_data);
+        }
+
+        // the root keeps whatever the user moved it to
+        if (!is_root or !existed) record.transform = transform;
+
+        record.mesh_key = mesh_key;
+
+        if (is_root) {
+            thing.object = record.object;
+        } else {
+            node_paths[&node] = path;
+        }
+
+        if (!meshes.empty() and record.parts.empty()) {
+            qDebug() << "Adding sub-meshes:" << node.mNumMeshes;
+
+            // create bits. we could pack this into patches...
+            // but for now, just create multiple objects
+
+            for (auto const& key : meshes) {
+                if (!queue) {
+                    record.parts.push_back(create_part(
+                        doc, record.object, thing.meshes.value(key)));
+                    continue;
+                }
+
+                auto priority = importance(world, key);
+
+                mesh_priority[key] =
+                    std::max(mesh_priority.value(key, 0), priority);
+
+                queued_parts.push_back({ path, record.object, key, priority });
+                record.queued_parts++;
+            }
+        }
+
+        auto this_node = record.object;
+
+        thing.nodes[path] = std::move(record);
+
+        return this_node;
+    }
+};
+
+
+ReusableComponents reusable_components(Model const& model, bool changed) {
+    ReusableComponents ret {
+        .meshes   = QSet<QByteArray>(model.meshes.keyBegin(),
+                                   model.meshes.keyEnd()),
+        .textures = QSet<QByteArray>(model.textures.keyBegin(),
+                                     model.textures.keyEnd()),
+        .bvhs     = model.bvhs,
+        .chunks   = model.component_chunks,
+    };
+
+    if (!changed) return ret;
+
+    for (auto iter = model.component_sources.begin();
+         iter != model.component_sources.end();
+         ++iter) {
+        if (!iter.value()->is_mapped()) continue;
+
+        ret.meshes.remove(iter.key());
+        ret.textures.remove(iter.key());
+    }
+
+    return ret;
+}
+
+void drop_sparse_chunks(ReusableComponents&      reuse,
+                        QList<QByteArray> const& keys) {
+    QSet<QByteArray>        survivors;
+    QHash<uint64_t, qint64> live;
+
+    for (auto const& key : keys) {
+        if (!reuse.meshes.contains(key) or survivors.contains(key)) continue;
+
+        survivors << key;
+
+        for (auto const& chunk : reuse.chunks.value(key)) {
+            live[chunk.id] += chunk.used;
+        }
+    }
+
+    qint64 copied = 0;
+
+    for (auto const& key : qAsConst(survivors)) {
+        for (auto const& chunk : reuse.chunks.value(key)) {
+            if (live.value(chunk.id) * 2 >= chunk.size) continue;
+
+            reuse.meshes.remove(key);
+
+            for (auto const& c : reuse.chunks.value(key)) {
+                copied += c.used;
+            }
+
+            break;
+        }
+    }
+
+    if (copied) {
+        qDebug() << "Copying" << copied << "bytes out of sparse arena chunks";
+    }
+}
+
+void count_component_bytes(Model&                   model,
+                           QList<QByteArray> const& meshes,
+                           QList<QByteArray> const& textures,
+                           ModelMemory&             mem) {
+    QHash<QByteArray, qint64>                             bytes;
+    QHash<QByteArray, std::vector<BufferArena::ChunkUse>> chunks;
+    QHash<QByteArray, std::shared_ptr<GLTFSource const>>  sources;
+
+    // a chunk of both meshes and images, as a GLB buffer may be, counts once
+    QSet<uint64_t> counted;
+
+    auto count = [&](QList<QByteArray> const& keys, qint64& total) {
+        for (auto const& key : keys) {
+            if (bytes.contains(key)) continue;
+
+            bytes[key] = model.component_bytes.value(key);
+
+            if (auto source = model.component_sources.value(key)) {
+                sources[key] = std::move(source);
+            }
+
+            auto iter = model.component_chunks.find(key);
+
+            if (iter == model.component_chunks.end()) {
+                total += bytes[key];
+                continue;
+            }
+
+            for (auto const& chunk : *iter) {
+                if (counted.contains(chunk.id)) continue;
+
+                counted << chunk.id;
+                total += chunk.size;
+            }
+
+            chunks[key] = *iter;
+        }
+    };
+
+    count(meshes, mem.buffer_bytes);
+    count(textures, mem.texture_bytes);
+
+    model.component_bytes   = std::move(bytes);
+    model.component_chunks  = std::move(chunks);
+    model.component_sources = std::move(sources);
+}
+
+std::shared_ptr<StagedScene> stage_import(aiScene const&        scene,
+                                          ImportOptions const&  options,
+                                          PreparedPoints const* points,
+                                          bool                  preview,
+                                          ReusableComponents    reuse) {
+    auto ret   = std::make_shared<StagedScene>();
+    ret->reuse = std::move(reuse);
+
+    Stager stager {
+        .scene   = scene,
+        .options = options,
+        .out     = *ret,
+        .points  = points,
+        .preview = preview,
+    };
+
+    {
+        ScopedTimer timer(
+            metrics::import_phase(metrics::ImportPhase::Textures));
+        stager.stage_textures();
+    }
+
+    stager.stage_meshes();
+
+    return ret;
+}
+
+/// Create what a staged import left to do and fit it into the model
+std::optional<QString> apply_import(aiScene const&       scene,
+                                    StagedScene&         staged,
+                                    noo::DocumentTPtrRef doc,
+                                    noo::ObjectTPtr      collective_root,
+                                    ModelPtr const&      model,
+                                    PublishQueue*        queue,
+                                    Bounds const&        scene_bounds) {
+    if (!scene.mRootNode) return "Scene has no root node";
+
+    Importer imp {
+        .scene        = scene,
+        .staged       = staged,
+        .doc          = doc,
+        .root         = collective_root,
+        .model_ref    = model,
+        .thing        = *model,
+        .options      = model->options,
+        .queue        = queue,
+        .scene_bounds = scene_bounds,
+    };
+
+    imp.begin();
+
+    imp.create_textures();
+
+    imp.create_meshes();
+
+    {
+        ScopedTimer timer(metrics::import_phase(metrics::ImportPhase::Tree));
+        imp.process_import_tree(*(scene.mRootNode), collective_root);
+    }
+
+    model->animations = extract_animations(scene, imp.node_paths);
+
+    imp.publish();
+
+    imp.finish();
+
+    // Its buffers are document components now, and the staged scene may go
+    // last on a worker; queued tasks hold the arena themselves
+    staged.arena = nullptr;
+
+    model->resident = true;
+
+    return std::nullopt;
+}
+
+void stage_scene(LoadedScene& loaded, ReusableComponents reuse) {
+    if (loaded.gltf) {
+        stage_gltf(*loaded.gltf, loaded.options, std::move(reuse));
+        return;
+    }
+
+    if (!loaded.scene or !loaded.scene->mRootNode) return;
+
+    loaded.staged = stage_import(*loaded.scene,
+                                 loaded.options,
+                                 loaded.points.get(),
+                                 loaded.preview,
+                                 std::move(reuse));
+}
+
+bool is_stale(LoadedScene const& loaded, Model const& model) {
+    if (loaded.gltf) return is_stale(*loaded.gltf, model);
+
+    if (!loaded.staged) return false;
+
+    auto const& staged = *loaded.staged;
+
+    // whatever is not pending was left out, to be claimed from the model
+    for (auto iter = staged.mesh_materials.begin();
+         iter != staged.mesh_materials.end();
+         ++iter) {
+        if (!staged.pending_meshes.contains(iter.key()) and
+            !model.meshes.contains(iter.key())) {
+            return true;
+        }
+    }
+
+    for (auto const& key : staged.material_textures) {
+        if (!staged.pending_textures.contains(key) and
+            !model.textures.contains(key)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::optional<QString>
+update_model_from_scene(aiScene const&        scene,
+                        noo::DocumentTPtrRef  doc,
+                        noo::ObjectTPtr       collective_root,
+                        ModelPtr const&       model,
+                        PreparedPoints const* points,
+                        bool                  preview,
+                        PublishQueue*         queue,
+                        Bounds const&         scene_bounds) {
+    if (!scene.mRootNode) return "Scene has no root node";
+
+    auto staged = stage_import(
+        scene, model->options, points, preview, reusable_components(*model));
+
+    return apply_import(
+        scene, *staged, doc, collective_root, model, queue, scene_bounds);
+}
+
+std::variant<ModelPtr, QString> import_ai_scene(aiScene const&       scene,
+                                                noo::DocumentTPtrRef doc,
+                                                noo::ObjectTPtr collective_root,
+                                                int             id,
+                                                ImportOptions const& options) {
+    auto new_model     = std::make_shared<Model>();
+    new_model->id      = id;
+    new_model->options = options;
+
+    auto err = update_model_from_scene(scene, doc, collective_root, new_model);
+
+    if (err) return *err;
+
+    return new_model;
+}
+
+bool LoadedScene::has_preview() const {
+    return points and !points->preview.empty();
+}
+
+std::optional<QString> update_model(LoadedScene const&   loaded,
+                                    noo::DocumentTPtrRef doc,
+                                    noo::ObjectTPtr      collective_root,
+                                    ModelPtr const&      model,
+                                    PublishQueue*        queue,
+                                    Bounds const&        scene_bounds) {
+    model->options = loaded.options;
+    model->volume  = loaded.volume;
+
+    if (loaded.gltf) {
+        return update_model_from_gltf(loaded.gltf, doc, collective_root, model);
+    }
+
+    // not staged in the background, as for imports done on the spot
+    if (!loaded.staged) {
+        return update_model_from_scene(*loaded.scene,
+                                       doc,
+                                       collective_root,
+                                       model,
+                                       loaded.points.get(),
+                                       loaded.preview,
+                                       queue,
+                                       scene_bounds);
+    }
+
+    return apply_import(*loaded.scene,
+                        *loaded.staged,
+                        doc,
+                        collective_root,
+                        model,
+                        queue,
+                        scene_bounds);
+}
+
+std::variant<ModelPtr, QString> create_model(LoadedScene const&   loaded,
+                                             noo::DocumentTPtrRef doc,
+                                             noo::ObjectTPtr collective_root,
+                                             int             id,
+                                             PublishQueue*   queue,
+                                             Bounds const& scene_bounds) {
+    auto new_model = std::make_shared<Model>();
+    new_model->id  = id;
+
+    auto err = update_model(
+        loaded, doc, collective_root, new_model, queue, scene_bounds);
+
+    if (err) return *err;
+
+    return new_model;
+}
+
+bool needs_gltf_sampler_hack(QString path) {
+    auto check_json = [](QByteArray array) {
+        auto doc = QJsonDocument::fromJson(array).object();
+
+        auto samplers = doc["samplers"].toArray();
+
+        for (auto const& sampler : samplers) {
+            auto so = sampler.toObject();
+            // check for nearest in any filter slot
+            if (so["magFilter"].toInt() == 9728) return true;
+            if (so["minFilter"].toInt() == 9728) return true;
+        }
+
+        return false;
+    };
+
+    qDebug() << Q_FUNC_INFO << path;
+    // THIS IS HORRIBLE AND ONLY HERE TO FIX THE FACT THAT ASSIMP HAS NO SAMPLER
+    // CONCEPT.
+
+    if (!path.endsWith(".glb") and !path.endsWith(".gltf")) return false;
+
+    // hacks for GLTF
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly)) return false;
+
+    std::array<uint32_t, 5> header_first_chunk;
+    file.read((char*)header_first_chunk.data(), sizeof(header_first_chunk));
+
+    // check if its really a binary gltf
+    if (header_first_chunk[0] != 0x46546C67) {
+        // assume just json
+
+        file.seek(0);
+
+        return check_json(file.readAll());
+    }
+
+
+    // first chunk has to be json
+
+    auto chunk_len  = header_first_chunk[3];
+    auto chunk_type = header_first_chunk[4];
+
+    if (chunk_type != 0x4E4F534A) return false;
+
+    auto json_payload = file.read(chunk_len);
+
+    return check_json(json_payload);
+}
+
+
+unsigned import_postprocess_flags(ImportOptions const& options) {
+    unsigned flags = aiProcess_Triangulate | aiProcess_FixInfacingNormals |
+                     aiProcess_SortByPType;
+
+    if (!options.native_weld) flags |= aiProcess_JoinIdenticalVertices;
+    if (!options.native_normals) flags |= aiProcess_GenNormals;
+
+    return flags;
+}
+
+MeshProcessing mesh_processing(ImportOptions const& options, bool native) {
+    return {
+        .weld         = options.native_weld,
+        .tolerance    = options.weld_tolerance,
+        .normals      = options.native_normals or native,
+        .crease_angle = options.crease_angle,
+        .tangents     = options.tangents,
+    };
+}
+
+/// Run the heavy part of import left once the file is parsed, while still
+/// off the main thread: in-house post-processing, then point clouds
+LoadedScene finish_loading(LoadedScene loaded) {
+    auto steps = mesh_processing(loaded.options, loaded.native != nullptr);
+
+    if (steps.any()) {
+        // the scene belongs to this import alone
+        process_meshes(const_cast<aiScene&>(*loaded.scene), steps);
+    }
+
+    ScopedTimer timer(metrics::import_phase(metrics::ImportPhase::Points));
+
+    loaded.points = prepare_points(*loaded.scene, loaded.options);
+
+    return loaded;
+}
+
+std::variant<LoadedScene, QString>
+load_scene(QString path, ImportOptions options, bool changed) {
+    QFileInfo info(path);
+
+    if (!info.exists(path)) return "File does not exist.";
+
+    // a preview is followed by the full level from the same scene, which a
+    // low memory import does not keep
+    if (options.low_memory) options.point_preview = 0;
+
+    if (options.native_gltf and is_gltf_path(path)) {
+        auto gltf = load_gltf(path, options.mapped_io and !changed);
+
+        if (auto* source = std::get_if<std::shared_ptr<GLTFSource>>(&gltf)) {
+            return LoadedScene {
+                .gltf    = std::move(*source),
+                .options = options,
+            };
+        }
+
+        qInfo() << "Native glTF loader declined" << path << "|"
+                << std::get<QString>(gltf) << "| falling back to Assimp";
+    }
+
+    if (options.native_bulk and is_bulk_path(path)) {
+        std::variant<std::shared_ptr<aiScene>, QString> bulk;
+
+        {
+            ScopedTimer timer(
+                metrics::import_phase(metrics::ImportPhase::Read));
+            bulk = load_bulk(path);
+        }
+
+        if (auto* scene = std::get_if<std::shared_ptr<aiScene>>(&bulk)) {
+            auto const* raw = scene->get();
+
+            return finish_loading(LoadedScene {
+                .native  = std::move(*scene),
+                .scene   = raw,
+                .options = options,
+            });
+        }
+
+        qInfo() << "Native loader declined" << path << "|"
+                << std::get<QString>(bulk) << "| falling back to Assimp";
+    }
+
+    auto importer = std::make_shared<Assimp::Importer>();
+
+    // owned by the importer
+    auto* xdmf = new XDMFAssimpImporter(
+        options.xdmf_partitions, options.iso_value, options.async_io);
+
+    importer->RegisterLoader(xdmf);
+
+    // owned by the importer
+    MappedIOSystem* mapped_io = nullptr;
+
+    if (options.mapped_io) {
+        mapped_io = new MappedIOSystem;
+        importer->SetIOHandler(mapped_io);
+    }
+
+    auto path_str = path.toStdString();
+
+    aiScene const* scene = nullptr;
+
+    {
+        ScopedTimer timer(metrics::import_phase(metrics::ImportPhase::Read));
+        scene = importer->ReadFile(path_str, import_postprocess_flags(options));
+    }
+
+    if (mapped_io) {
+        auto const& stats = mapped_io->stats();
+        qint64      bytes = stats.bytes_read + stats.bytes_mapped;
+
+        qInfo() << "I/O total:" << (qint64)stats.files << "files" << bytes
+                << "bytes in" << stats.seconds() * 1000 << "ms";
+    }
+
+    if (!scene) {
+        return QString("Unable to import file: ") + importer->GetErrorString();
+    }
+
+    options.force_samplers_to_nearest = needs_gltf_sampler_hack(path);
+
+    if (options.force_samplers_to_nearest) {
+        qDebug() << "Enabling sampler hack";
+    }
+
+    return finish_loading(LoadedScene {
+        .importer = std::move(importer),
+        .scene    = scene,
+        .volume   = xdmf->volume(),
+        .options  = options,
+    });
+}
+
+std::variant<LoadedScene, QString>
+load_isosurface(std::shared_ptr<ScalarVolume const> volume,
+                ImportOptions                       options) {
+    auto const iso = options.iso_value.value_or(volume->middle());
+
+    Isosurface surface;
+
+    {
+        ScopedTimer timer(
+            metrics::import_phase(metrics::ImportPhase::Isosurface));
+        surface = extract_isosurface(*volume, iso);
+    }
+
+    if (surface.indices.empty()) {
+        return QString("No isosurface of %1 at %2").arg(volume->name).arg(iso);
+    }
+
+    auto scene      = isosurface_scene(surface, volume->name);
+    auto const* raw = scene.get();
+
+    return finish_loading(LoadedScene {
+        .native  = std::move(scene),
+        .scene   = raw,
+        .volume  = std::move(volume),
+        .options = options,
+    });
+}
+
+std::variant<ModelPtr, QString> make_thing(int                  id,
+                                           QString              path,
+                                           noo::DocumentTPtrRef doc,
+                                           noo::ObjectTPtr      collective_root,
+                                           ImportOptions        options) {
+
+    auto loaded = load_scene(path, options);
+
+    if (auto* err = std::get_if<QString>(&loaded)) return *err;
+
+    auto ret = create_model(
+        std::get<LoadedScene>(loaded), doc, collective_root, id);
+
+    if (auto* model = std::get_if<ModelPtr>(&ret)) {
+        (*model)->source_path = QFileInfo(path).absoluteFilePath();
+    }
+
+    return ret;
+}
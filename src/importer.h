@@ -0,0 +1,176 @@
+#pragma once
+
+#include "playground.h"
+
+#include <QString>
+
+#include <optional>
+#include <variant>
+
+struct aiScene;
+
+namespace Assimp {
+class Importer;
+}
+
+struct GLTFSource;
+struct MeshProcessing;
+struct PreparedPoints;
+struct ScalarVolume;
+struct StagedScene;
+class PublishQueue;
+
+/// What a model holds that a new import of it may reuse, by content hash.
+/// Taken on the main thread for staging elsewhere; plain data, so it may go
+/// to any thread.
+struct ReusableComponents {
+    QSet<QByteArray>                                  meshes;
+    QSet<QByteArray>                                  textures;
+    QHash<QByteArray, std::shared_ptr<MeshBVH const>> bvhs;
+
+    // the arena chunks of the above
+    QHash<QByteArray, std::vector<BufferArena::ChunkUse>> chunks;
+};
+
+/// What of the model a new import may reuse. With `changed`, the file was
+/// just written, perhaps in place, so components over a mapping of it no
+/// longer hold what they were made from and are left out.
+ReusableComponents reusable_components(Model const&, bool changed = false);
+
+/// Leave out of `reuse` those of `keys`, the meshes a new import shows, that
+/// would keep an arena chunk alive for less than half of it. Staged again,
+/// they let the chunk go along with the rest of the last import. Textures
+/// stay, as claimed materials hold on to them anyway.
+void drop_sparse_chunks(ReusableComponents&      reuse,
+                        QList<QByteArray> const& keys);
+
+/// Count what the given meshes and textures of a model keep alive into
+/// `mem`, and forget the sizes of all other components. A component in an
+/// arena keeps its whole chunk, so chunks count once each, in full.
+void count_component_bytes(Model&                   model,
+                           QList<QByteArray> const& meshes,
+                           QList<QByteArray> const& textures,
+                           ModelMemory&             mem);
+
+/// Look up a converted component by content hash, first in what this import
+/// has produced so far and then in what the model held before.
+template <class T>
+T claim(QHash<QByteArray, T>&       current,
+        QHash<QByteArray, T> const& previous,
+        QByteArray const&           key) {
+    if (auto iter = current.find(key); iter != current.end()) return *iter;
+
+    if (auto iter = previous.find(key); iter != previous.end()) {
+        current[key] = *iter;
+        return *iter;
+    }
+
+    return {};
+}
+
+/// A file parsed but not yet converted into the document. Producing one
+/// touches no document state, so it is safe to do off the main thread.
+/// Either `scene` or `gltf` is set.
+struct LoadedScene {
+    std::shared_ptr<Assimp::Importer>   importer; // owns the scene, or
+    std::shared_ptr<aiScene const>      native;   // does if parsed natively
+    aiScene const*                      scene = nullptr;
+    std::shared_ptr<PreparedPoints>     points;
+    std::shared_ptr<GLTFSource>         gltf;
+    std::shared_ptr<ScalarVolume const> volume; // of an XDMF volume grid
+    ImportOptions                       options;
+
+    /// Publish the sparse preview of large point clouds instead of the full
+    /// level
+    bool preview = false;
+
+    /// Converted and staged by stage_scene, and used up by update_model
+    std::shared_ptr<StagedScene> staged;
+
+    bool has_preview() const;
+};
+
+/// Parse a file, with the native glTF, STL, OBJ or PLY loaders if possible
+/// and Assimp otherwise. With `changed`, the file was just written and may
+/// be written again while in use, so native glTF files are read rather than
+/// mapped. Thread safe.
+std::variant<LoadedScene, QString>
+load_scene(QString path, ImportOptions, bool changed = false);
+
+/// Extract the isosurface of a volume read before at the value given in the
+/// options, and prepare it like a freshly parsed file. Thread safe.
+std::variant<LoadedScene, QString>
+load_isosurface(std::shared_ptr<ScalarVolume const>, ImportOptions);
+
+/// Read the textures of a loaded scene and convert, hash and stage its
+/// materials and meshes, leaving out whatever `reuse` holds, so that
+/// update_model has only document components left to create. Touches no
+/// document state, so it is safe off the main thread. Native glTF files go
+/// through stage_gltf.
+void stage_scene(LoadedScene&, ReusableComponents reuse = {});
+
+/// Whether the model has lost something that staging left out of `loaded`,
+/// by eviction or another update since. The scene has to be staged again,
+/// from a fresh load, as staging may have used up its source meshes.
+bool is_stale(LoadedScene const& loaded, Model const&);
+
+/// Convert a loaded file into a new model
+std::variant<ModelPtr, QString> create_model(LoadedScene const&   loaded,
+                                             noo::DocumentTPtrRef doc,
+                                             noo::ObjectTPtr collective_root,
+                                             int             id,
+                                             PublishQueue*   queue = nullptr,
+                                             Bounds const& scene_bounds = {});
+
+/// Convert a loaded file into an existing model; see update_model_from_scene.
+/// A scene not staged yet is staged on the spot.
+std::optional<QString> update_model(LoadedScene const&   loaded,
+                                    noo::DocumentTPtrRef doc,
+                                    noo::ObjectTPtr      collective_root,
+                                    ModelPtr const&      model,
+                                    PublishQueue*        queue        = nullptr,
+                                    Bounds const&        scene_bounds = {});
+
+/// Convert a scene into an existing model. Components whose content hash
+/// matches what the model already holds are reused, everything else is
+/// created or released, and the model root object is kept. Point clouds are
+/// prepared on the spot unless `points` is given. With a queue, new meshes
+/// and the objects showing them are published from it over the next event
+/// loop turns, largest first; without, everything is created before return.
+/// Parts are ranked by their size in world space against the box of the
+/// scene, `scene_bounds`, and the model together, so ranks hold across
+/// models.
+std::optional<QString>
+update_model_from_scene(aiScene const&        scene,
+                        noo::DocumentTPtrRef  doc,
+                        noo::ObjectTPtr       collective_root,
+                        ModelPtr const&       model,
+                        PreparedPoints const* points       = nullptr,
+                        bool                  preview      = false,
+                        PublishQueue*         queue        = nullptr,
+                        Bounds const&         scene_bounds = {});
+
+/// Convert an already loaded Assimp scene into document objects, parented to
+/// the given root.
+std::variant<ModelPtr, QString> import_ai_scene(aiScene const&       scene,
+                                                noo::DocumentTPtrRef doc,
+                                                noo::ObjectTPtr collective_root,
+                                                int             id,
+                                                ImportOptions const& options);
+
+bool needs_gltf_sampler_hack(QString path);
+
+/// The Assimp post-processing steps requested when loading a file. Steps
+/// done in house are left out.
+unsigned import_postprocess_flags(ImportOptions const&);
+
+/// The post-processing steps to run in house on a scene from Assimp or, with
+/// `native`, on one from a native loader that Assimp never processed
+MeshProcessing mesh_processing(ImportOptions const&, bool native);
+
+/// Load a file from disk and convert it into document objects.
+std::variant<ModelPtr, QString> make_thing(int                  id,
+                                           QString              path,
+                                           noo::DocumentTPtrRef doc,
+                                           noo::ObjectTPtr      collective_root,
+                                           ImportOptions        options);
@@ -0,0 +1,226 @@
+#include "instanceset.h"
+
+#include "metrics.h"
+#include "threadpool.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+/// An instance of a part as clients read it: one matrix, its columns the
+/// position, color, rotation and scale. The part is placed first and the
+/// instance then moves it. A non-uniform instance scale is applied along
+/// the axes of the part, which is exact unless the part is rotated.
+glm::mat4 to_matrix(InstanceSet::Instance const&  instance,
+                    InstanceSet::Placement const& part) {
+    auto const q      = instance.rotation * part.rotation;
+    auto const offset = instance.rotation * (instance.scale * part.translation);
+
+    glm::mat4 ret;
+    ret[0] = glm::vec4(instance.position + offset, 1);
+    ret[1] = glm::vec4(instance.color) / 255.0f;
+    ret[2] = glm::vec4(q.x, q.y, q.z, q.w);
+    ret[3] = glm::vec4(instance.scale * part.scale, 1);
+    return ret;
+}
+
+size_t page_count(size_t instances) {
+    return (instances + InstanceSet::page_size - 1) / InstanceSet::page_size;
+}
+
+} // namespace
+
+std::optional<InstanceSet::Placement>
+InstanceSet::Placement::of(glm::mat4 const& tf) {
+    glm::mat3 linear(tf);
+
+    float const det = glm::determinant(linear);
+
+    if (!std::isfinite(det) or det == 0) return {};
+
+    float const scale = std::copysign(std::cbrt(std::abs(det)), det);
+
+    // what is left has to be a rotation
+    auto const rotation = linear / scale;
+    auto const product  = glm::transpose(rotation) * rotation;
+
+    for (int c = 0; c < 3; c++) {
+        for (int r = 0; r < 3; r++) {
+            if (std::abs(product[c][r] - (c == r)) > 1e-4f) return {};
+        }
+    }
+
+    return Placement {
+        .translation = glm::vec3(tf[3]),
+        .rotation    = glm::normalize(glm::quat_cast(rotation)),
+        .scale       = scale,
+    };
+}
+
+InstanceSet::InstanceSet(int                  id,
+                         noo::DocumentTPtrRef doc,
+                         noo::ObjectTPtr      parent,
+                         std::vector<Part>    parts,
+                         size_t               count)
+    : m_id(id), m_doc(doc), m_parts(std::move(parts)) {
+    noo::ObjectData data;
+    data.name   = QString("Instance Set %1").arg(id);
+    data.parent = parent;
+
+    m_root = noo::create_object(doc, data);
+
+    resize(count);
+}
+
+void InstanceSet::resize(size_t count) {
+    if (count == m_instances.size()) return;
+
+    // the page that used to be last, or becomes last, changes length
+    if (!m_pages.empty()) m_pages.back().dirty = true;
+
+    m_instances.resize(count);
+
+    // dropping a page deletes its objects, and then its buffer
+    m_pages.resize(page_count(count));
+
+    if (!m_pages.empty()) m_pages.back().dirty = true;
+}
+
+std::optional<QString> InstanceSet::apply(std::span<Edit const> edits) {
+    for (auto const& edit : edits) {
+        if (edit.index >= m_instances.size()) {
+            return QString("Instance %1 is out of range; the set has %2")
+                .arg(edit.index)
+                .arg(m_instances.size());
+        }
+    }
+
+    for (auto const& edit : edits) {
+        auto& instance = m_instances[edit.index];
+
+        if (edit.position) instance.position = *edit.position;
+        if (edit.rotation) instance.rotation = *edit.rotation;
+        if (edit.scale) instance.scale = *edit.scale;
+        if (edit.color) instance.color = *edit.color;
+
+        m_pages[edit.index / page_size].dirty = true;
+    }
+
+    return {};
+}
+
+bool InstanceSet::dirty() const {
+    return std::any_of(m_pages.begin(), m_pages.end(), [](auto const& p) {
+        return p.dirty;
+    });
+}
+
+QByteArray InstanceSet::pack(size_t page) const {
+    size_t const first = page * page_size;
+    size_t const count = std::min(page_size, m_instances.size() - first);
+
+    QByteArray ret(m_parts.size() * count * sizeof(glm::mat4),
+                   Qt::Uninitialized);
+
+    auto* out = reinterpret_cast<glm::mat4*>(ret.data());
+
+    // a block per part
+    for (auto const& part : m_parts) {
+        for (size_t i = 0; i < count; i++) {
+            *out++ = to_matrix(m_instances[first + i], part.placement);
+        }
+    }
+
+    return ret;
+}
+
+size_t InstanceSet::flush() {
+    std::vector<size_t> dirty;
+
+    for (size_t p = 0; p < m_pages.size(); p++) {
+        if (m_pages[p].dirty) dirty.push_back(p);
+    }
+
+    if (dirty.empty()) return 0;
+
+    std::vector<QByteArray> packed(dirty.size());
+
+    ThreadPool::global().parallel_for(
+        dirty.size(), [&](size_t i) { packed[i] = pack(dirty[i]); });
+
+    size_t sent = 0;
+
+    for (size_t i = 0; i < dirty.size(); i++) {
+        auto& page  = m_pages[dirty[i]];
+        auto  bytes = packed[i].size();
+        auto  block = bytes / m_parts.size();
+
+        auto buffer = noo::create_buffer(
+            m_doc,
+            noo::BufferData {
+                .source = noo::BufferInlineSource { .data = packed[i] },
+            });
+
+        std::vector<noo::BufferViewTPtr> views;
+
+        for (size_t p = 0; p < m_parts.size(); p++) {
+            views.push_back(noo::create_buffer_view(
+                m_doc,
+                noo::BufferViewData {
+                    .source_buffer = buffer,
+                    .type          = noo::ViewType::UNKNOWN,
+                    .offset        = (uint64_t)(p * block),
+                    .length        = (uint64_t)block,
+                }));
+        }
+
+        auto definition = [&](size_t p) {
+            return noo::ObjectRenderableDefinition {
+                .mesh      = m_parts[p].mesh,
+                .instances = noo::InstanceInfo { .view   = views[p],
+                                                 .stride = 0 },
+            };
+        };
+
+        if (page.objects.empty()) {
+            for (size_t p = 0; p < m_parts.size(); p++) {
+                noo::ObjectData data;
+                data.parent     = m_root;
+                data.definition = definition(p);
+
+                page.objects.push_back(noo::create_object(m_doc, data));
+            }
+        } else {
+            for (size_t p = 0; p < m_parts.size(); p++) {
+                noo::ObjectUpdateData update {
+                    .definition = definition(p),
+                };
+
+                noo::update_object(page.objects[p], update);
+            }
+        }
+
+        // nothing shows the previous buffer any more
+        page.views = std::move(views);
+        page.dirty = false;
+
+        sent += block / sizeof(glm::mat4);
+
+        metrics::buffer_bytes_created(metrics::BufferType::Instances)
+            .add(bytes);
+    }
+
+    qDebug() << "Instance set" << m_id << "sent" << (qint64)dirty.size()
+             << "of" << (qint64)m_pages.size() << "pages," << (qint64)sent
+             << "instances";
+
+    return sent;
+}
+
+qint64 InstanceSet::byte_size() const {
+    return m_instances.capacity() * sizeof(Instance) +
+           m_instances.size() * m_parts.size() * sizeof(glm::mat4);
+}
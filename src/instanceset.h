@@ -0,0 +1,116 @@
+#pragma once
+
+#include "noo_include_glm.h"
+
+#include <noo_server_interface.h>
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <QString>
+
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+/// Many copies of the meshes of a model, placed by clients. Instances live
+/// in a compact array and are published in pages of `page_size`, each page a
+/// buffer of its own holding a block of matrices per part, drawn by one
+/// object per part. Every matrix is an instance composed with the placement
+/// of its part, so an instance moves the whole assembly about its origin.
+/// Document buffers cannot change, so edits mark their page dirty and
+/// flush() replaces only dirty pages. Edits land in the array while the
+/// buffers last published stay up; the old buffer of a page is released once
+/// its objects show the new one.
+class InstanceSet {
+public:
+    struct Instance {
+        glm::vec3   position = glm::vec3(0);
+        glm::quat   rotation = glm::quat(1, 0, 0, 0);
+        glm::vec3   scale    = glm::vec3(1);
+        glm::u8vec4 color    = glm::u8vec4(255);
+    };
+
+    /// A change to one instance; fields left empty keep their value
+    struct Edit {
+        uint32_t                   index = 0;
+        std::optional<glm::vec3>   position;
+        std::optional<glm::quat>   rotation;
+        std::optional<glm::vec3>   scale;
+        std::optional<glm::u8vec4> color;
+    };
+
+    /// Where a node puts a mesh, relative to the model root. An instance
+    /// matrix has no room for more than a rotation and a scale, so the scale
+    /// is uniform, and negative for a mirror.
+    struct Placement {
+        glm::vec3 translation = glm::vec3(0);
+        glm::quat rotation    = glm::quat(1, 0, 0, 0);
+        float     scale       = 1;
+
+        /// Split a node transform, if it holds no shear or non-uniform scale
+        static std::optional<Placement> of(glm::mat4 const&);
+    };
+
+    /// A mesh of the model where one of its nodes shows it
+    struct Part {
+        noo::MeshTPtr mesh;
+        Placement     placement;
+
+        // what the buffers of the mesh point into, such as a mapped file
+        std::shared_ptr<void const> backing;
+    };
+
+    // 256 KiB of instance matrices
+    static constexpr size_t page_size = 4096;
+
+private:
+    struct Page {
+        std::vector<noo::BufferViewTPtr> views;   // by part; keep the buffer
+        std::vector<noo::ObjectTPtr>     objects; // by part
+        bool                             dirty = true;
+    };
+
+    int m_id;
+
+    noo::DocumentTPtr m_doc;
+    noo::ObjectTPtr   m_root;
+    std::vector<Part> m_parts;
+
+    std::vector<Instance> m_instances;
+    std::vector<Page>     m_pages;
+
+    QByteArray pack(size_t page) const;
+
+public:
+    /// `count` instances at the origin, under a new object parented to
+    /// `parent`. The set holds its own references to the meshes.
+    InstanceSet(int                  id,
+                noo::DocumentTPtrRef doc,
+                noo::ObjectTPtr      parent,
+                std::vector<Part>    parts,
+                size_t               count);
+
+    int id() const { return m_id; }
+
+    size_t size() const { return m_instances.size(); }
+
+    Instance const& operator[](size_t i) const { return m_instances[i]; }
+
+    /// Add instances at the origin, or drop them from the end
+    void resize(size_t count);
+
+    /// Apply a batch of edits. If any is out of range, nothing is changed and
+    /// an error is returned.
+    std::optional<QString> apply(std::span<Edit const>);
+
+    bool dirty() const;
+
+    /// Publish the pages changed since the last flush. Returns the number of
+    /// instances sent.
+    size_t flush();
+
+    /// Bytes of the instance array and of the page buffers, which hold a
+    /// matrix per instance and part
+    qint64 byte_size() const;
+};
@@ -0,0 +1,434 @@
+#include "isosurface.h"
+
+#include "threadpool.h"
+
+#include <assimp/scene.h>
+
+#include <glm/geometric.hpp>
+
+#include <QDebug>
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+// The six tetrahedra of a cell around its main diagonal, by corner bit:
+// x | y << 1 | z << 2. Each face diagonal runs from the low to the high
+// corner of its face, so neighbouring cells cut shared faces the same way.
+constexpr std::array<std::array<int, 4>, 6> cell_tetrahedra = { {
+    { 0, 1, 3, 7 },
+    { 0, 1, 5, 7 },
+    { 0, 2, 3, 7 },
+    { 0, 2, 6, 7 },
+    { 0, 4, 5, 7 },
+    { 0, 4, 6, 7 },
+} };
+
+// VTK hexahedron node by corner bit
+constexpr std::array<int, 8> vtk_corner = { 0, 1, 3, 2, 4, 5, 7, 6 };
+
+// cells of a structured grid, or tetrahedra, per task
+constexpr size_t block_rows       = 16;
+constexpr size_t block_tetrahedra = 65536;
+
+struct Corner {
+    uint32_t  node;
+    float     value;
+    glm::vec3 position;
+};
+
+uint64_t edge_key(uint32_t a, uint32_t b) {
+    if (a > b) std::swap(a, b);
+    return (uint64_t(a) << 32) | b;
+}
+
+/// Where the field crosses `iso` along an edge. Measured from the lower end,
+/// so that both directions of an edge agree to the bit.
+glm::vec3 crossing(Corner const& a, Corner const& b, float iso) {
+    auto const& lo = a.value < b.value ? a : b;
+    auto const& hi = a.value < b.value ? b : a;
+
+    float t = (iso - lo.value) / (hi.value - lo.value);
+
+    return lo.position + (hi.position - lo.position) * t;
+}
+
+/// Add the triangles of one tetrahedron to `out`, as the edge keys of their
+/// corners
+void march_tetrahedron(std::array<Corner, 4> const& c,
+                       float                        iso,
+                       std::vector<uint64_t>&       out) {
+    std::array<int, 4> inside, outside;
+    int                n_in = 0, n_out = 0;
+
+    for (int i = 0; i < 4; i++) {
+        if (c[i].value >= iso) {
+            inside[n_in++] = i;
+        } else {
+            outside[n_out++] = i;
+        }
+    }
+
+    if (n_in == 0 or n_out == 0) return;
+
+    // which way around the triangles go follows from the handedness of the
+    // tetrahedron, not from the triangles, which collapse where a node sits
+    // right on `iso`
+    auto handed = [&](int a, int b, int d, int e) {
+        auto const& o = c[a].position;
+        return glm::dot(glm::cross(c[b].position - o, c[d].position - o),
+                        c[e].position - o) > 0;
+    };
+
+    using Edge = std::pair<int, int>;
+
+    auto emit = [&](Edge a, Edge b, Edge d) {
+        for (auto [p, q] : { a, b, d }) {
+            out.push_back(edge_key(c[p].node, c[q].node));
+        }
+    };
+
+    if (n_in == 1 or n_in == 3) {
+        // the lone node, and the triangle that cuts it off, facing outward
+        auto lone = n_in == 1 ? inside[0] : outside[0];
+        auto far  = n_in == 1 ? outside : inside;
+
+        bool flip = handed(lone, far[0], far[1], far[2]) != (n_in == 1);
+
+        Edge e0 { lone, far[0] }, e1 { lone, far[1] }, e2 { lone, far[2] };
+
+        if (flip) std::swap(e1, e2);
+
+        emit(e0, e1, e2);
+    } else {
+        // a quad, its corners in order around it
+        Edge q0 { inside[0], outside[0] };
+        Edge q1 { inside[0], outside[1] };
+        Edge q2 { inside[1], outside[1] };
+        Edge q3 { inside[1], outside[0] };
+
+        if (!handed(inside[0], inside[1], outside[0], outside[1])) {
+            std::swap(q1, q3);
+        }
+
+        emit(q0, q1, q2);
+        emit(q0, q2, q3);
+    }
+}
+
+/// Corner keys of the triangles of each block of a structured grid
+std::vector<std::vector<uint64_t>> march_structured(ScalarVolume const& v,
+                                                    float iso) {
+    auto const& axes = v.axes;
+
+    size_t const nx = axes[0].size();
+    size_t const ny = axes[1].size();
+    size_t const nz = axes[2].size();
+
+    if (nx < 2 or ny < 2 or nz < 2) return {};
+
+    struct Block {
+        size_t k;
+        size_t first_row;
+    };
+
+    std::vector<Block> blocks;
+
+    for (size_t k = 0; k + 1 < nz; k++) {
+        for (size_t j = 0; j + 1 < ny; j += block_rows) {
+            blocks.push_back({ k, j });
+        }
+    }
+
+    std::vector<std::vector<uint64_t>> ret(blocks.size());
+
+    std::array<size_t, 8> offset;
+    for (int b = 0; b < 8; b++) {
+        offset[b] = (b & 1) + ((b >> 1) & 1) * nx + ((b >> 2) & 1) * nx * ny;
+    }
+
+    ThreadPool::global().parallel_for(blocks.size(), [&](size_t bi) {
+        auto const k    = blocks[bi].k;
+        auto const last = std::min(blocks[bi].first_row + block_rows, ny - 1);
+
+        auto& out = ret[bi];
+
+        std::array<Corner, 8> corners;
+        std::array<Corner, 4> tet;
+
+        for (size_t j = blocks[bi].first_row; j < last; j++) {
+            for (size_t i = 0; i + 1 < nx; i++) {
+                size_t const base = i + nx * (j + ny * k);
+
+                float lo = std::numeric_limits<float>::max();
+                float hi = std::numeric_limits<float>::lowest();
+
+                for (int b = 0; b < 8; b++) {
+                    corners[b].value = v.values[base + offset[b]];
+                    lo               = std::min(lo, corners[b].value);
+                    hi               = std::max(hi, corners[b].value);
+                }
+
+                // nearly every cell is wholly on one side
+                if (hi < iso or lo >= iso) continue;
+
+                for (int b = 0; b < 8; b++) {
+                    corners[b].node     = base + offset[b];
+                    corners[b].position = glm::vec3(axes[0][i + (b & 1)],
+                                                    axes[1][j + ((b >> 1) & 1)],
+                                                    axes[2][k + (b >> 2)]);
+                }
+
+                for (auto const& t : cell_tetrahedra) {
+                    for (int c = 0; c < 4; c++) {
+                        tet[c] = corners[t[c]];
+                    }
+                    march_tetrahedron(tet, iso, out);
+                }
+            }
+        }
+    });
+
+    return ret;
+}
+
+/// Corner keys of the triangles of each block of tetrahedra
+std::vector<std::vector<uint64_t>> march_tetrahedra(ScalarVolume const& v,
+                                                    float iso) {
+    size_t const count  = v.tetrahedra.size() / 4;
+    size_t const blocks = (count + block_tetrahedra - 1) / block_tetrahedra;
+
+    std::vector<std::vector<uint64_t>> ret(blocks);
+
+    ThreadPool::global().parallel_for(blocks, [&](size_t bi) {
+        auto const first = bi * block_tetrahedra;
+        auto const last  = std::min(first + block_tetrahedra, count);
+
+        std::array<Corner, 4> tet;
+
+        for (size_t t = first; t < last; t++) {
+            for (int c = 0; c < 4; c++) {
+                auto node = v.tetrahedra[t * 4 + c];
+                tet[c]    = { node, v.values[node], v.positions[node] };
+            }
+            march_tetrahedron(tet, iso, ret[bi]);
+        }
+    });
+
+    return ret;
+}
+
+} // namespace
+
+glm::vec3 ScalarVolume::node_position(uint32_t n) const {
+    if (!structured) return positions[n];
+
+    size_t const nx = axes[0].size();
+    size_t const ny = axes[1].size();
+
+    return glm::vec3(
+        axes[0][n % nx], axes[1][(n / nx) % ny], axes[2][n / (nx * ny)]);
+}
+
+void ScalarVolume::update_range() {
+    auto [lo, hi] = std::minmax_element(values.begin(), values.end());
+
+    min_value = lo == values.end() ? 0 : *lo;
+    max_value = hi == values.end() ? 0 : *hi;
+}
+
+qint64 ScalarVolume::byte_size() const {
+    qint64 ret = values.capacity() * sizeof(float) +
+                 positions.capacity() * sizeof(glm::vec3) +
+                 tetrahedra.capacity() * sizeof(uint32_t);
+
+    for (auto const& axis : axes) {
+        ret += axis.capacity() * sizeof(float);
+    }
+
+    return ret;
+}
+
+Isosurface extract_isosurface(ScalarVolume const& volume, float iso) {
+    auto& pool = ThreadPool::global();
+
+    auto blocks = volume.structured ? march_structured(volume, iso)
+                                    : march_tetrahedra(volume, iso);
+
+    std::vector<size_t> offsets(blocks.size() + 1);
+
+    for (size_t b = 0; b < blocks.size(); b++) {
+        offsets[b + 1] = offsets[b] + blocks[b].size();
+    }
+
+    std::vector<uint64_t> corners(offsets.back());
+
+    pool.parallel_for(blocks.size(), [&](size_t b) {
+        std::copy(blocks[b].begin(), blocks[b].end(), &corners[offsets[b]]);
+        blocks[b] = {};
+    });
+
+    // one vertex per crossed edge, wherever the triangles using it came from
+    std::vector<uint64_t> edges = corners;
+
+    parallel_sort(edges);
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    Isosurface ret;
+    ret.indices.resize(corners.size());
+    ret.positions.resize(edges.size());
+
+    pool.parallel_chunks(corners.size(), [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; i++) {
+            auto iter =
+                std::lower_bound(edges.begin(), edges.end(), corners[i]);
+            ret.indices[i] = iter - edges.begin();
+        }
+    });
+
+    pool.parallel_chunks(edges.size(), [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; i++) {
+            uint32_t a = edges[i] >> 32;
+            uint32_t c = edges[i] & 0xffffffff;
+
+            ret.positions[i] = crossing(
+                { a, volume.values[a], volume.node_position(a) },
+                { c, volume.values[c], volume.node_position(c) },
+                iso);
+        }
+    });
+
+    qDebug() << "Isosurface of" << volume.name << "at" << iso << "has"
+             << (qint64)ret.positions.size() << "vertices and"
+             << (qint64)(ret.indices.size() / 3) << "triangles";
+
+    return ret;
+}
+
+std::shared_ptr<aiScene> isosurface_scene(Isosurface const& surface,
+                                          QString           name) {
+    auto mesh = new aiMesh;
+
+    mesh->mName           = aiString(name.toStdString());
+    mesh->mMaterialIndex  = 0;
+    mesh->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+
+    mesh->mNumVertices = surface.positions.size();
+    mesh->mVertices    = new aiVector3D[mesh->mNumVertices];
+
+    std::transform(surface.positions.begin(),
+                   surface.positions.end(),
+                   mesh->mVertices,
+                   [](glm::vec3 const& p) {
+                       return aiVector3D(p.x, p.y, p.z);
+                   });
+
+    mesh->mNumFaces = surface.indices.size() / 3;
+    mesh->mFaces    = new aiFace[mesh->mNumFaces];
+
+    ThreadPool::global().parallel_chunks(
+        mesh->mNumFaces, [&](size_t b, size_t e) {
+            for (size_t f = b; f < e; f++) {
+                auto& face       = mesh->mFaces[f];
+                face.mNumIndices = 3;
+                face.mIndices    = new unsigned[3];
+                std::copy_n(surface.indices.data() + f * 3, 3, face.mIndices);
+            }
+        });
+
+    auto scene = std::make_shared<aiScene>();
+
+    scene->mNumMeshes    = 1;
+    scene->mMeshes       = new aiMesh*[1] { mesh };
+    scene->mNumMaterials = 1;
+    scene->mMaterials    = new aiMaterial*[1] { new aiMaterial };
+
+    scene->mRootNode             = new aiNode(name.toStdString());
+    scene->mRootNode->mNumMeshes = 1;
+    scene->mRootNode->mMeshes    = new unsigned[1] { 0 };
+
+    return scene;
+}
+
+std::vector<float> structured_cell_to_node(std::array<size_t, 3> nodes,
+                                           std::span<float const> cells) {
+    auto const [nx, ny, nz] = nodes;
+
+    // a flat axis has one layer of cells, not none
+    size_t const cx = std::max<size_t>(nx, 2) - 1;
+    size_t const cy = std::max<size_t>(ny, 2) - 1;
+    size_t const cz = std::max<size_t>(nz, 2) - 1;
+
+    std::vector<float> ret(nx * ny * nz);
+
+    ThreadPool::global().parallel_for(nz, [&](size_t k) {
+        for (size_t j = 0; j < ny; j++) {
+            for (size_t i = 0; i < nx; i++) {
+                float sum   = 0;
+                int   count = 0;
+
+                // the cells on either side along each axis, where there are
+                auto const k0 = k ? k - 1 : 0, k1 = std::min(k, cz - 1);
+                auto const j0 = j ? j - 1 : 0, j1 = std::min(j, cy - 1);
+                auto const i0 = i ? i - 1 : 0, i1 = std::min(i, cx - 1);
+
+                for (size_t ck = k0; ck <= k1; ck++) {
+                    for (size_t cj = j0; cj <= j1; cj++) {
+                        for (size_t ci = i0; ci <= i1; ci++) {
+                            sum += cells[ci + cx * (cj + cy * ck)];
+                            count++;
+                        }
+                    }
+                }
+
+                ret[i + nx * (j + ny * k)] = sum / count;
+            }
+        }
+    });
+
+    return ret;
+}
+
+std::vector<float> cell_to_node(std::span<uint32_t const> cells,
+                                unsigned                  cell_size,
+                                std::span<float const>    values,
+                                size_t                    node_count) {
+    std::vector<float>    sums(node_count, 0);
+    std::vector<uint32_t> counts(node_count, 0);
+
+    for (size_t c = 0; c < values.size(); c++) {
+        for (unsigned k = 0; k < cell_size; k++) {
+            auto n = cells[c * cell_size + k];
+            sums[n] += values[c];
+            counts[n]++;
+        }
+    }
+
+    for (size_t n = 0; n < node_count; n++) {
+        if (counts[n]) sums[n] /= counts[n];
+    }
+
+    return sums;
+}
+
+void append_hexahedra(std::span<uint32_t const> hexahedra,
+                      std::vector<uint32_t>&    tetrahedra) {
+    size_t const count = hexahedra.size() / 8;
+    size_t const first = tetrahedra.size();
+
+    tetrahedra.resize(first + count * 6 * 4);
+
+    ThreadPool::global().parallel_chunks(count, [&](size_t b, size_t e) {
+        for (size_t h = b; h < e; h++) {
+            auto const* hex = &hexahedra[h * 8];
+            auto*       out = &tetrahedra[first + h * 24];
+
+            for (auto const& t : cell_tetrahedra) {
+                for (int c = 0; c < 4; c++) {
+                    *out++ = hex[vtk_corner[t[c]]];
+                }
+            }
+        }
+    });
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "noo_include_glm.h"
+
+#include <QString>
+
+#include <array>
+#include <memory>
+#include <span>
+#include <vector>
+
+struct aiScene;
+
+/// A scalar field sampled at the nodes of a volume mesh: either a structured
+/// grid, given by its node coordinates along each axis, or tetrahedra over
+/// free nodes. Node indices fit in 32 bits.
+struct ScalarVolume {
+    QString name; // of the field
+
+    bool structured = false;
+
+    // structured grids: node coordinates along x, y and z; x varies fastest
+    std::array<std::vector<float>, 3> axes;
+
+    // everything else
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t>  tetrahedra; // four nodes each
+
+    std::vector<float> values; // by node
+
+    float min_value = 0;
+    float max_value = 0;
+
+    size_t node_count() const { return values.size(); }
+
+    glm::vec3 node_position(uint32_t) const;
+
+    /// Recompute the value range
+    void update_range();
+
+    float middle() const { return (min_value + max_value) / 2; }
+
+    qint64 byte_size() const;
+};
+
+struct Isosurface {
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t>  indices;
+};
+
+/// Triangles where the field crosses `iso`, facing toward lower values, by
+/// marching tetrahedra. Structured cells are cut into the six tetrahedra
+/// around their main diagonal, which match up between neighbouring cells.
+/// Cells are split into blocks on the thread pool; every vertex is keyed by
+/// the edge it lies on, so blocks that meet share their vertices.
+/// Vertices are interpolated from the lower end of their edge, so separate
+/// grids that repeat the same nodes give identical vertices too.
+Isosurface extract_isosurface(ScalarVolume const&, float iso);
+
+/// A scene with the surface as its one mesh, on the root node
+std::shared_ptr<aiScene> isosurface_scene(Isosurface const&, QString name);
+
+/// Values given per cell of a structured grid of `nodes` nodes along each
+/// axis, spread onto the nodes: each node gets the mean of its cells
+std::vector<float> structured_cell_to_node(std::array<size_t, 3> nodes,
+                                           std::span<float const> cells);
+
+/// The same for cells of `cell_size` nodes each, listed in `cells`
+std::vector<float> cell_to_node(std::span<uint32_t const> cells,
+                                unsigned                  cell_size,
+                                std::span<float const>    values,
+                                size_t                    node_count);
+
+/// Cut hexahedra, with nodes in VTK order, into six tetrahedra each around
+/// the diagonal from node 0 to node 6. Neighbours with the same orientation
+/// match up.
+void append_hexahedra(std::span<uint32_t const> hexahedra,
+                      std::vector<uint32_t>&    tetrahedra);
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+
+#include <QString>
+
+#include <atomic>
+#include <chrono>
+#include <span>
+
+/// Totals over every file opened through a MappedIOSystem
+struct IOStats {
+    std::atomic<int64_t> files        = 0;
+    std::atomic<int64_t> bytes_read   = 0; // copied out through Read()
+    std::atomic<int64_t> bytes_mapped = 0; // accessed in place via mapping()
+    std::atomic<int64_t> nanoseconds  = 0; // spent mapping and reading
+
+    double seconds() const { return nanoseconds / 1.0e9; }
+};
+
+/// A read-only file, memory mapped with sequential read-ahead.
+class MappedIOStream : public Assimp::IOStream {
+    QString              m_path;
+    unsigned char const* m_data   = nullptr;
+    size_t               m_size   = 0;
+    size_t               m_cursor = 0;
+    bool                 m_open   = false;
+    IOStats&             m_stats;
+
+    // for the per file report on close
+    int64_t m_bytes_read   = 0;
+    int64_t m_nanoseconds  = 0;
+    bool    m_mapping_used = false;
+
+public:
+    MappedIOStream(QString path, IOStats&);
+    ~MappedIOStream() override;
+
+    bool is_open() const { return m_open; }
+
+    /// The whole file, for readers that can use it in place
+    std::span<unsigned char const> mapping();
+
+    size_t   Read(void* pvBuffer, size_t pSize, size_t pCount) override;
+    size_t   Write(void const*, size_t, size_t) override { return 0; }
+    aiReturn Seek(size_t pOffset, aiOrigin pOrigin) override;
+    size_t   Tell() const override;
+    size_t   FileSize() const override;
+    void     Flush() override { }
+};
+
+/// Assimp IO that maps files instead of going through buffered stdio.
+/// Anything opened for writing is handed to Assimp's default system.
+class MappedIOSystem : public Assimp::IOSystem {
+    IOStats m_stats;
+
+public:
+    bool Exists(char const* pFile) const override;
+    char getOsSeparator() const override;
+
+    Assimp::IOStream* Open(char const* pFile, char const* pMode = "rb") override;
+    void              Close(Assimp::IOStream* pFile) override;
+
+    IOStats const& stats() const { return m_stats; }
+};
@@ -0,0 +1,580 @@
+#include "meshprocessing.h"
+
+#include "metrics.h"
+#include "threadpool.h"
+#include "weld.h"
+
+#include <assimp/scene.h>
+
+#include <glm/geometric.hpp>
+#include <glm/trigonometric.hpp>
+
+#include <QDebug>
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace {
+
+std::span<glm::vec3 const> as_vec3(aiVector3D const* src, size_t count) {
+    return { reinterpret_cast<glm::vec3 const*>(src), count };
+}
+
+bool is_triangle_mesh(aiMesh const& mesh) {
+    constexpr unsigned others = aiPrimitiveType_POINT | aiPrimitiveType_LINE |
+                                aiPrimitiveType_POLYGON;
+
+    return mesh.mNumFaces > 0 and
+           (mesh.mPrimitiveTypes & aiPrimitiveType_TRIANGLE) and
+           !(mesh.mPrimitiveTypes & others);
+}
+
+// bones and morph targets refer to vertices by index
+bool has_fixed_vertices(aiMesh const& mesh) {
+    return mesh.mNumBones > 0 or mesh.mNumAnimMeshes > 0;
+}
+
+std::vector<uint32_t> triangle_indices(aiMesh const& mesh, ThreadPool& pool) {
+    std::vector<uint32_t> ret(mesh.mNumFaces * 3);
+
+    pool.parallel_chunks(mesh.mNumFaces, [&](size_t b, size_t e) {
+        for (size_t f = b; f < e; f++) {
+            std::copy_n(mesh.mFaces[f].mIndices, 3, ret.data() + f * 3);
+        }
+    });
+
+    return ret;
+}
+
+/// Write triangle indices back into the faces of a mesh, making new faces if
+/// the count changed
+void store_triangles(aiMesh&                      mesh,
+                     std::vector<uint32_t> const& indices,
+                     ThreadPool&                  pool) {
+    size_t const count = indices.size() / 3;
+
+    if (count != mesh.mNumFaces) {
+        delete[] mesh.mFaces;
+
+        mesh.mNumFaces = count;
+        mesh.mFaces    = new aiFace[count];
+
+        pool.parallel_chunks(count, [&](size_t b, size_t e) {
+            for (size_t f = b; f < e; f++) {
+                mesh.mFaces[f].mNumIndices = 3;
+                mesh.mFaces[f].mIndices    = new unsigned[3];
+            }
+        });
+    }
+
+    pool.parallel_chunks(count, [&](size_t b, size_t e) {
+        for (size_t f = b; f < e; f++) {
+            std::copy_n(indices.data() + f * 3, 3, mesh.mFaces[f].mIndices);
+        }
+    });
+}
+
+/// Rebuild every per vertex array of a mesh, new vertex i being a copy of
+/// old vertex `sources[i]`
+void gather_vertices(aiMesh&                      mesh,
+                     std::vector<uint32_t> const& sources,
+                     ThreadPool&                  pool) {
+    auto regather = [&]<class T>(T*& array) {
+        if (!array) return;
+
+        auto* fresh = new T[sources.size()];
+
+        pool.parallel_chunks(sources.size(), [&](size_t b, size_t e) {
+            for (size_t i = b; i < e; i++) {
+                fresh[i] = array[sources[i]];
+            }
+        });
+
+        delete[] array;
+        array = fresh;
+    };
+
+    regather(mesh.mVertices);
+    regather(mesh.mNormals);
+    regather(mesh.mTangents);
+    regather(mesh.mBitangents);
+
+    for (auto& channel : mesh.mColors) {
+        regather(channel);
+    }
+
+    for (auto& channel : mesh.mTextureCoords) {
+        regather(channel);
+    }
+
+    mesh.mNumVertices = sources.size();
+}
+
+// =============================================================================
+
+/// FNV-1a over the bits of every attribute of a vertex but its position.
+/// Two different vertices share a key only by a 64 bit collision.
+uint64_t attribute_key(aiMesh const& mesh, size_t i) {
+    uint64_t key = 0xcbf29ce484222325;
+
+    auto add = [&key](float f) {
+        // negative zero has to meet positive zero
+        key = (key ^ std::bit_cast<uint32_t>(f + 0.0f)) * 0x100000001b3;
+    };
+
+    auto add_vector = [&](aiVector3D const* array) {
+        if (!array) return;
+        add(array[i].x);
+        add(array[i].y);
+        add(array[i].z);
+    };
+
+    add_vector(mesh.mNormals);
+    add_vector(mesh.mTangents);
+    add_vector(mesh.mBitangents);
+
+    for (auto const* channel : mesh.mTextureCoords) {
+        add_vector(channel);
+    }
+
+    for (auto const* channel : mesh.mColors) {
+        if (!channel) continue;
+        add(channel[i].r);
+        add(channel[i].g);
+        add(channel[i].b);
+        add(channel[i].a);
+    }
+
+    return key;
+}
+
+/// Returns how many vertices were merged away
+std::optional<size_t> weld_mesh(aiMesh& mesh, float tolerance) {
+    if (!is_triangle_mesh(mesh) or has_fixed_vertices(mesh)) return {};
+
+    auto& pool = ThreadPool::global();
+
+    size_t const count = mesh.mNumVertices;
+
+    std::vector<uint64_t> attributes(count);
+
+    pool.parallel_chunks(count, [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; i++) {
+            attributes[i] = attribute_key(mesh, i);
+        }
+    });
+
+    auto weld =
+        weld_positions(as_vec3(mesh.mVertices, count), tolerance, attributes);
+
+    if (weld.sources.size() == count) return 0;
+
+    auto indices = triangle_indices(mesh, pool);
+
+    remap_triangles(indices, weld.remap);
+
+    gather_vertices(mesh, weld.sources, pool);
+    store_triangles(mesh, indices, pool);
+
+    return count - weld.sources.size();
+}
+
+// =============================================================================
+
+/// The corners of the triangles around each vertex, as runs of one list.
+/// Each run is sorted, so sums over it come out the same every run.
+struct VertexCorners {
+    std::vector<uint32_t> first; // by vertex, plus one past the end
+    std::vector<uint32_t> corners;
+
+    std::span<uint32_t const> of(size_t v) const {
+        return { corners.data() + first[v], corners.data() + first[v + 1] };
+    }
+};
+
+VertexCorners vertex_corners(size_t                    vertex_count,
+                             std::span<uint32_t const> indices,
+                             ThreadPool&               pool) {
+    std::vector<std::atomic<uint32_t>> cursor(vertex_count);
+
+    pool.parallel_chunks(indices.size(), [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; i++) {
+            cursor[indices[i]].fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+
+    VertexCorners ret;
+
+    ret.first.resize(vertex_count + 1);
+
+    for (size_t v = 0; v < vertex_count; v++) {
+        ret.first[v + 1] =
+            ret.first[v] + cursor[v].load(std::memory_order_relaxed);
+        cursor[v].store(ret.first[v], std::memory_order_relaxed);
+    }
+
+    ret.corners.resize(indices.size());
+
+    pool.parallel_chunks(indices.size(), [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; i++) {
+            auto slot =
+                cursor[indices[i]].fetch_add(1, std::memory_order_relaxed);
+            ret.corners[slot] = i;
+        }
+    });
+
+    pool.parallel_chunks(vertex_count, [&](size_t b, size_t e) {
+        for (size_t v = b; v < e; v++) {
+            std::sort(ret.corners.begin() + ret.first[v],
+                      ret.corners.begin() + ret.first[v + 1]);
+        }
+    });
+
+    return ret;
+}
+
+struct FaceNormal {
+    glm::vec3 weighted; // twice the area long
+    glm::vec3 unit;     // zero without area
+};
+
+std::vector<FaceNormal> face_normals(std::span<glm::vec3 const> positions,
+                                     std::span<uint32_t const>  indices,
+                                     ThreadPool&                pool) {
+    std::vector<FaceNormal> ret(indices.size() / 3);
+
+    pool.parallel_chunks(ret.size(), [&](size_t b, size_t e) {
+        for (size_t t = b; t < e; t++) {
+            auto const& a = positions[indices[t * 3]];
+            auto const& c = positions[indices[t * 3 + 1]];
+            auto const& d = positions[indices[t * 3 + 2]];
+
+            auto n      = glm::cross(c - a, d - a);
+            auto length = glm::length(n);
+
+            ret[t] = { n, length > 0 ? n / length : glm::vec3(0) };
+        }
+    });
+
+    return ret;
+}
+
+struct CreaseNormals {
+    std::vector<glm::vec3> normals; // by output vertex
+    std::vector<uint32_t>  sources; // input vertex of every output vertex
+};
+
+/// Area weighted normals that only smooth across faces meeting at less than
+/// the crease angle. Each corner sums the faces around its vertex that lie
+/// within the angle of its own face; a face without area goes with anything.
+/// When the corners of a vertex end up with different normals, every normal
+/// past the first gets a copy of the vertex, and `indices` is changed to
+/// use it.
+CreaseNormals crease_normals(std::span<glm::vec3 const> positions,
+                             std::vector<uint32_t>&     indices,
+                             float                      crease_degrees,
+                             ThreadPool&                pool) {
+    size_t const count = positions.size();
+
+    auto faces  = face_normals(positions, indices, pool);
+    auto around = vertex_corners(count, indices, pool);
+
+    bool const  smooth     = crease_degrees >= 180;
+    float const cos_crease = std::cos(glm::radians(crease_degrees));
+
+    auto within = [&](FaceNormal const& a, FaceNormal const& b) {
+        if (smooth) return true;
+        if (a.unit == glm::vec3(0) or b.unit == glm::vec3(0)) return true;
+        return glm::dot(a.unit, b.unit) >= cos_crease;
+    };
+
+    // by corner: its normal, and the first corner of the same vertex with
+    // that normal
+    std::vector<glm::vec3> corner_normal(indices.size());
+    std::vector<uint32_t>  corner_leader(indices.size());
+
+    // by vertex: how many copies it needs
+    std::vector<uint32_t> copies(count);
+
+    pool.parallel_chunks(count, [&](size_t b, size_t e) {
+        for (size_t v = b; v < e; v++) {
+            auto corners = around.of(v);
+
+            uint32_t groups = 0;
+
+            for (size_t i = 0; i < corners.size(); i++) {
+                auto c = corners[i];
+
+                glm::vec3 n(0);
+
+                if (smooth and i > 0) {
+                    n = corner_normal[corners[0]];
+                } else {
+                    auto const& own = faces[c / 3];
+
+                    for (auto other : corners) {
+                        auto const& face = faces[other / 3];
+                        if (within(own, face)) n += face.weighted;
+                    }
+
+                    auto length = glm::length(n);
+
+                    n = length > 0 ? n / length : glm::vec3(0);
+                }
+
+                corner_normal[c] = n;
+                corner_leader[c] = c;
+
+                for (size_t j = 0; j < i; j++) {
+                    if (corner_normal[corners[j]] == n) {
+                        corner_leader[c] = corner_leader[corners[j]];
+                        break;
+                    }
+                }
+
+                if (corner_leader[c] == c) groups++;
+            }
+
+            copies[v] = groups > 1 ? groups - 1 : 0;
+        }
+    });
+
+    // number the copies of each vertex after all of the input vertices
+    std::vector<uint32_t> first_copy(count);
+
+    size_t total = count;
+
+    for (size_t v = 0; v < count; v++) {
+        first_copy[v] = total;
+        total += copies[v];
+    }
+
+    CreaseNormals ret;
+
+    ret.normals.resize(total);
+    ret.sources.resize(total);
+
+    pool.parallel_chunks(count, [&](size_t b, size_t e) {
+        for (size_t v = b; v < e; v++) {
+            auto corners = around.of(v);
+
+            ret.sources[v] = v;
+            ret.normals[v] = glm::vec3(0);
+
+            uint32_t next = first_copy[v];
+
+            for (size_t i = 0; i < corners.size(); i++) {
+                auto c = corners[i];
+
+                // leaders come first in a run, so theirs is set already
+                if (corner_leader[c] != c) {
+                    indices[c] = indices[corner_leader[c]];
+                    continue;
+                }
+
+                uint32_t target = i == 0 ? v : next++;
+
+                ret.sources[target] = v;
+                ret.normals[target] = corner_normal[c];
+                indices[c]          = target;
+            }
+        }
+    });
+
+    return ret;
+}
+
+/// Returns how many vertices were added at creases
+std::optional<size_t> normals_for_mesh(aiMesh& mesh, float crease_degrees) {
+    if (!is_triangle_mesh(mesh) or mesh.mNormals) return {};
+
+    auto& pool = ThreadPool::global();
+
+    // splitting would renumber vertices
+    if (has_fixed_vertices(mesh)) crease_degrees = 180;
+
+    auto indices = triangle_indices(mesh, pool);
+
+    auto positions = as_vec3(mesh.mVertices, mesh.mNumVertices);
+
+    auto result = crease_normals(positions, indices, crease_degrees, pool);
+
+    size_t const added = result.sources.size() - mesh.mNumVertices;
+
+    if (added > 0) {
+        gather_vertices(mesh, result.sources, pool);
+        store_triangles(mesh, indices, pool);
+    }
+
+    mesh.mNormals = new aiVector3D[mesh.mNumVertices];
+
+    std::copy(result.normals.begin(),
+              result.normals.end(),
+              reinterpret_cast<glm::vec3*>(mesh.mNormals));
+
+    return added;
+}
+
+// =============================================================================
+
+/// Some unit vector across `n`
+glm::vec3 perpendicular(glm::vec3 n) {
+    auto axis = std::abs(n.x) < 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+    auto p    = glm::cross(n, axis);
+    auto l    = glm::length(p);
+    return l > 0 ? p / l : glm::vec3(1, 0, 0);
+}
+
+/// Returns the number of vertices given tangents
+std::optional<size_t> tangents_for_mesh(aiMesh& mesh) {
+    if (!is_triangle_mesh(mesh) or mesh.mTangents or !mesh.mNormals or
+        !mesh.mTextureCoords[0]) {
+        return {};
+    }
+
+    auto& pool = ThreadPool::global();
+
+    size_t const count = mesh.mNumVertices;
+
+    auto positions = as_vec3(mesh.mVertices, count);
+    auto normals   = as_vec3(mesh.mNormals, count);
+    auto uvs       = mesh.mTextureCoords[0];
+
+    auto indices = triangle_indices(mesh, pool);
+
+    // by triangle, unnormalized, so larger ones weigh more
+    std::vector<glm::vec3> face_tangents(indices.size() / 3);
+    std::vector<glm::vec3> face_bitangents(indices.size() / 3);
+
+    pool.parallel_chunks(face_tangents.size(), [&](size_t b, size_t e) {
+        for (size_t t = b; t < e; t++) {
+            auto i0 = indices[t * 3], i1 = indices[t * 3 + 1],
+                 i2 = indices[t * 3 + 2];
+
+            auto e1 = positions[i1] - positions[i0];
+            auto e2 = positions[i2] - positions[i0];
+
+            float du1 = uvs[i1].x - uvs[i0].x, dv1 = uvs[i1].y - uvs[i0].y;
+            float du2 = uvs[i2].x - uvs[i0].x, dv2 = uvs[i2].y - uvs[i0].y;
+
+            float r = du1 * dv2 - du2 * dv1;
+
+            if (r == 0 or !std::isfinite(1 / r)) {
+                face_tangents[t]   = glm::vec3(0);
+                face_bitangents[t] = glm::vec3(0);
+                continue;
+            }
+
+            face_tangents[t]   = (e1 * dv2 - e2 * dv1) / r;
+            face_bitangents[t] = (e2 * du1 - e1 * du2) / r;
+        }
+    });
+
+    auto around = vertex_corners(count, indices, pool);
+
+    mesh.mTangents   = new aiVector3D[count];
+    mesh.mBitangents = new aiVector3D[count];
+
+    auto* tangents   = reinterpret_cast<glm::vec3*>(mesh.mTangents);
+    auto* bitangents = reinterpret_cast<glm::vec3*>(mesh.mBitangents);
+
+    pool.parallel_chunks(count, [&](size_t b, size_t e) {
+        for (size_t v = b; v < e; v++) {
+            glm::vec3 t(0), s(0);
+
+            for (auto c : around.of(v)) {
+                t += face_tangents[c / 3];
+                s += face_bitangents[c / 3];
+            }
+
+            auto const& n = normals[v];
+
+            // Gram-Schmidt against the normal
+            t -= n * glm::dot(n, t);
+
+            auto length = glm::length(t);
+
+            t = length > 1e-12f ? t / length : perpendicular(n);
+
+            auto bitangent = glm::cross(n, t);
+
+            // keep the handedness of mirrored texture coordinates
+            if (glm::dot(bitangent, s) < 0) bitangent = -bitangent;
+
+            tangents[v]   = t;
+            bitangents[v] = bitangent;
+        }
+    });
+
+    return count;
+}
+
+// =============================================================================
+
+/// Run one step over every mesh and report it. `step` returns nothing for a
+/// mesh it skipped, or the number of vertices it changed.
+template <class Step>
+void run_step(aiScene&             scene,
+              metrics::ImportPhase phase,
+              char const*          what,
+              Step                 step) {
+    QElapsedTimer timer;
+    timer.start();
+
+    std::atomic<size_t> meshes   = 0;
+    std::atomic<size_t> vertices = 0;
+
+    {
+        ScopedTimer scoped(metrics::import_phase(phase));
+
+        ThreadPool::global().parallel_for(scene.mNumMeshes, [&](size_t i) {
+            auto changed = step(*scene.mMeshes[i]);
+
+            if (!changed) return;
+
+            meshes++;
+            vertices += *changed;
+        });
+    }
+
+    if (meshes == 0) return;
+
+    qInfo() << "Mesh" << metrics::phase_name(phase) << "|"
+            << (qint64)meshes.load() << "meshes," << (qint64)vertices.load()
+            << what << "in" << timer.elapsed() << "ms";
+}
+
+} // namespace
+
+void process_meshes(aiScene& scene, MeshProcessing const& steps) {
+    if (steps.weld) {
+        run_step(scene,
+                 metrics::ImportPhase::Weld,
+                 "vertices merged",
+                 [&](aiMesh& mesh) {
+                     return weld_mesh(mesh, steps.tolerance);
+                 });
+    }
+
+    if (steps.normals) {
+        run_step(scene,
+                 metrics::ImportPhase::Normals,
+                 "vertices split",
+                 [&](aiMesh& mesh) {
+                     return normals_for_mesh(mesh, steps.crease_angle);
+                 });
+    }
+
+    if (steps.tangents) {
+        run_step(scene,
+                 metrics::ImportPhase::Tangents,
+                 "vertices",
+                 [&](aiMesh& mesh) { return tangents_for_mesh(mesh); });
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+struct aiScene;
+
+/// Assimp post-processing steps done in house instead, on the thread pool
+struct MeshProcessing {
+    // merge vertices that agree on every other attribute and share their
+    // position exactly, like JoinIdenticalVertices, or with a tolerance a
+    // cell of a grid that wide
+    bool  weld      = false;
+    float tolerance = 0;
+
+    // area weighted normals for meshes that have none, like GenNormals, only
+    // smoothed across edges where faces meet at less than the crease angle
+    bool  normals      = false;
+    float crease_angle = 60; // degrees
+
+    // tangents and bitangents from the first texture coordinates, like
+    // CalcTangentSpace
+    bool tangents = false;
+
+    bool any() const { return weld or normals or tangents; }
+};
+
+/// Run the selected steps on the triangle meshes of a scene: weld, then
+/// normals, then tangents. Each step takes all meshes at once, and large
+/// meshes are split up further, so one big mesh keeps every worker busy as
+/// well as many small ones do. Steps are timed under their import phase.
+/// Meshes with bones or morph targets are neither welded nor split at
+/// creases, as both would renumber the vertices those refer to.
+void process_meshes(aiScene&, MeshProcessing const&);
@@ -0,0 +1,839 @@
+#include "methods.h"
+
+#include "animation.h"
+#include "crosssection.h"
+#include "instanceset.h"
+#include "isosurface.h"
+#include "metrics.h"
+#include "playground.h"
+#include "pointplot.h"
+
+#include <QCborArray>
+#include <QCborMap>
+
+#include <array>
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+[[noreturn]] void bad_args(QString message) {
+    throw noo::MethodException(noo::ErrorCodes::INVALID_PARAMS, message);
+}
+
+QCborValue arg_at(QCborArray const& args, qsizetype i) {
+    if (i >= args.size()) return QCborValue();
+    return args[i];
+}
+
+/// Options of a model to load; whatever the map leaves out is taken from
+/// `base`
+ImportOptions parse_import_options(QCborValue const&    value,
+                                   ImportOptions const& base) {
+    ImportOptions ret = base;
+
+    if (value.isUndefined() or value.isNull()) return ret;
+
+    if (!value.isMap()) bad_args("Import options should be a map");
+
+    auto map = value.toMap();
+
+    ret.double_sided = map[QStringLiteral("double_sided")].toBool(ret.double_sided);
+
+    ret.async_io = map[QStringLiteral("async_io")].toBool(ret.async_io);
+
+    ret.xdmf_partitions =
+        map[QStringLiteral("xdmf_partitions")].toBool(ret.xdmf_partitions);
+
+    ret.low_memory = map[QStringLiteral("low_memory")].toBool(ret.low_memory);
+
+    auto iso = map[QStringLiteral("iso_value")];
+    if (iso.isDouble() or iso.isInteger()) ret.iso_value = iso.toDouble();
+
+    ret.weld_tolerance =
+        map[QStringLiteral("weld_tolerance")].toDouble(ret.weld_tolerance);
+    ret.crease_angle =
+        map[QStringLiteral("crease_angle")].toDouble(ret.crease_angle);
+    ret.tangents = map[QStringLiteral("tangents")].toBool(ret.tangents);
+
+    ret.slicing = map[QStringLiteral("slicing")].toBool(ret.slicing);
+
+    ret.point_voxel_size =
+        map[QStringLiteral("point_voxel_size")].toDouble(ret.point_voxel_size);
+    ret.point_budget =
+        map[QStringLiteral("point_budget")].toInteger(ret.point_budget);
+    ret.point_preview =
+        map[QStringLiteral("point_preview")].toInteger(ret.point_preview);
+
+    return ret;
+}
+
+int model_id(QCborValue const& value) {
+    if (!value.isInteger()) bad_args("Expected a model id");
+    return value.toInteger();
+}
+
+// 1 GiB of instance matrices
+constexpr qint64 max_instances = 1 << 24;
+
+size_t instance_count(QCborValue const& value) {
+    if (!value.isInteger() or value.toInteger() < 0 or
+        value.toInteger() > max_instances) {
+        bad_args(QString("Expected an instance count of at most %1")
+                     .arg(max_instances));
+    }
+    return value.toInteger();
+}
+
+template <int N>
+std::array<float, N> numbers_of(QCborValue const& value, QString field) {
+    auto const array = value.toArray();
+
+    auto fail = [&]() {
+        bad_args(QString("Expected %1 numbers for %2").arg(N).arg(field));
+    };
+
+    if (!value.isArray() or array.size() != N) fail();
+
+    std::array<float, N> ret;
+
+    for (int i = 0; i < N; i++) {
+        if (!array[i].isDouble() and !array[i].isInteger()) fail();
+        ret[i] = array[i].toDouble();
+    }
+
+    return ret;
+}
+
+Plane parse_plane(QCborValue const& value) {
+    if (!value.isMap()) bad_args("Each plane should be a map");
+
+    auto const map = value.toMap();
+
+    auto p = numbers_of<3>(map[QStringLiteral("point")], "point");
+    auto n = numbers_of<3>(map[QStringLiteral("normal")], "normal");
+
+    glm::vec3 normal(n[0], n[1], n[2]);
+
+    if (glm::length(normal) == 0) bad_args("Expected a nonzero normal");
+
+    return Plane::through(glm::vec3(p[0], p[1], p[2]),
+                          glm::normalize(normal));
+}
+
+// each plane is a pass over every mesh of every model
+constexpr qsizetype max_planes = 16;
+
+InstanceSet::Edit parse_instance_edit(QCborValue const& value) {
+    if (!value.isMap()) bad_args("Each instance edit should be a map");
+
+    auto const map = value.toMap();
+
+    auto index = map[QStringLiteral("index")];
+
+    if (!index.isInteger() or index.toInteger() < 0) {
+        bad_args("Each instance edit needs an index");
+    }
+
+    InstanceSet::Edit ret { .index = (uint32_t)index.toInteger() };
+
+    if (auto v = map[QStringLiteral("position")]; !v.isUndefined()) {
+        auto p       = numbers_of<3>(v, "position");
+        ret.position = glm::vec3(p[0], p[1], p[2]);
+    }
+
+    // x, y, z, w
+    if (auto v = map[QStringLiteral("rotation")]; !v.isUndefined()) {
+        auto q = numbers_of<4>(v, "rotation");
+
+        glm::quat rotation(q[3], q[0], q[1], q[2]);
+
+        if (glm::length(rotation) == 0) bad_args("Expected a unit rotation");
+
+        ret.rotation = glm::normalize(rotation);
+    }
+
+    if (auto v = map[QStringLiteral("scale")]; v.isDouble() or v.isInteger()) {
+        ret.scale = glm::vec3(v.toDouble());
+    } else if (!v.isUndefined()) {
+        auto s    = numbers_of<3>(v, "scale");
+        ret.scale = glm::vec3(s[0], s[1], s[2]);
+    }
+
+    // 0 to 1 per channel
+    if (auto v = map[QStringLiteral("color")]; !v.isUndefined()) {
+        auto c = numbers_of<4>(v, "color");
+
+        glm::vec4 rgba(c[0], c[1], c[2], c[3]);
+
+        ret.color = glm::u8vec4(glm::clamp(rgba, 0.0f, 1.0f) * 255.0f + 0.5f);
+    }
+
+    return ret;
+}
+
+// 1 GiB of point matrices, as for instances
+constexpr qint64 max_points = 1 << 24;
+
+size_t point_capacity(QCborValue const& value) {
+    if (value.isUndefined() or value.isNull()) return 0;
+
+    if (!value.isInteger() or value.toInteger() < 0 or
+        value.toInteger() > max_points) {
+        bad_args(QString("Expected a point capacity of at most %1")
+                     .arg(max_points));
+    }
+
+    return value.toInteger();
+}
+
+/// Values of a byte string, packed and little endian like document buffers
+template <class T>
+std::vector<T> unpack(QByteArray const& bytes, QString field) {
+    if (bytes.size() % sizeof(T)) {
+        bad_args(QString("The bytes of %1 should be a multiple of %2 long")
+                     .arg(field)
+                     .arg(sizeof(T)));
+    }
+
+    std::vector<T> ret(bytes.size() / sizeof(T));
+    if (!ret.empty()) std::memcpy(ret.data(), bytes.constData(), bytes.size());
+    return ret;
+}
+
+/// Packed x, y, z floats, or a flat array of numbers for small batches
+std::vector<glm::vec3> parse_positions(QCborValue const& value) {
+    std::vector<glm::vec3> ret;
+
+    if (value.isByteArray()) {
+        ret = unpack<glm::vec3>(value.toByteArray(), "positions");
+    } else if (value.isArray()) {
+        auto const array = value.toArray();
+
+        if (array.size() % 3) bad_args("Expected x, y, z for each position");
+
+        ret.resize(array.size() / 3);
+
+        for (qsizetype i = 0; i < array.size(); i++) {
+            if (!array[i].isDouble() and !array[i].isInteger()) {
+                bad_args("Expected numbers for positions");
+            }
+            ret[i / 3][i % 3] = array[i].toDouble();
+        }
+    } else {
+        bad_args("Expected positions as packed floats or an array");
+    }
+
+    if ((qint64)ret.size() > max_points) {
+        bad_args(QString("At most %1 points per append").arg(max_points));
+    }
+
+    return ret;
+}
+
+/// Packed 8 bit r, g, b, a per point, or one color for all as [r, g, b, a]
+/// from 0 to 1
+std::vector<glm::u8vec4> parse_point_colors(QCborValue const& value) {
+    if (value.isUndefined() or value.isNull()) return {};
+
+    if (value.isByteArray()) {
+        return unpack<glm::u8vec4>(value.toByteArray(), "colors");
+    }
+
+    auto c = numbers_of<4>(value, "colors");
+
+    glm::vec4 rgba(c[0], c[1], c[2], c[3]);
+
+    return { glm::u8vec4(glm::clamp(rgba, 0.0f, 1.0f) * 255.0f + 0.5f) };
+}
+
+/// Packed floats per point, or one number for all
+std::vector<float> parse_point_sizes(QCborValue const& value) {
+    if (value.isUndefined() or value.isNull()) return {};
+
+    if (value.isByteArray()) {
+        return unpack<float>(value.toByteArray(), "sizes");
+    }
+
+    if (!value.isDouble() and !value.isInteger()) {
+        bad_args("Expected sizes as packed floats or a number");
+    }
+
+    return { (float)value.toDouble() };
+}
+
+} // namespace
+
+noo::MethodTPtr make_load_model_method(Playground& pg) {
+    noo::MethodData data {
+        .method_name   = "load_model",
+        .documentation = "Import a model file from the server's file system. "
+                         "The import happens in the background; the model "
+                         "appears in the scene once it is done.",
+        .return_documentation = "The id the model will have",
+        .argument_documentation =
+            {
+                noo::MethodArg { .name = "path",
+                                 .doc  = "Path of the file to load" },
+                noo::MethodArg {
+                    .name = "options",
+                    .doc  = "Optional map of import options: double_sided, "
+                            "async_io, xdmf_partitions, iso_value, low_memory, "
+                            "weld_tolerance, crease_angle, tangents, "
+                            "slicing, point_voxel_size, point_budget, "
+                            "point_preview. Those left out are as given on "
+                            "the server command line." },
+            },
+        .code = [&pg](noo::MethodContext const&,
+                      QCborArray const& args) -> QCborValue {
+            auto path = arg_at(args, 0);
+
+            if (!path.isString()) bad_args("Expected a path");
+
+            auto options =
+                parse_import_options(arg_at(args, 1), pg.import_options());
+
+            return pg.load_model(path.toString(), options);
+        },
+    };
+
+    return noo::create_method(pg.document(), data);
+}
+
+noo::MethodTPtr make_unload_model_method(Playground& pg) {
+    noo::MethodData data {
+        .method_name = "unload_model",
+        .documentation =
+            "Remove a model from the scene and release everything only it "
+            "was using",
+        .return_documentation = "True if the model existed",
+        .argument_documentation =
+            {
+                noo::MethodArg { .name = "id", .doc = "Id of the model" },
+            },
+        .code = [&pg](noo::MethodContext const&,
+                      QCborArray const& args) -> QCborValue {
+            auto id = arg_at(args, 0);
+
+            if (!id.isInteger()) bad_args("Expected a model id");
+
+            return pg.unload_model(id.toInteger());
+        },
+    };
+
+    return noo::create_method(pg.document(), data);
+}
+
+noo::MethodTPtr make_list_models_method(Playground& pg) {
+    noo::MethodData data {
+        .method_name          = "list_models",
+        .documentation        = "List the models currently in the scene",
+        .return_documentation =
+            "Array of maps with id, path, residency, memory use and the "
+            "names of animation clips; volumes also have their iso_value and "
+            "the iso_range of their field",
+        .code = [&pg](noo::MethodContext const&,
+                      QCborArray const&) -> QCborValue {
+            QCborArray ret;
+
+            for (auto const& model : pg.models()) {
+                QCborArray clips;
+
+                if (model->animations) {
+                    for (auto const& clip : model->animations->clips) {
+                        clips << clip.name;
+                    }
+                }
+
+                QCborMap entry {
+                    { QStringLiteral("id"), model->id },
+                    { QStringLiteral("path"), model->source_path },
+                    { QStringLiteral("resident"), model->resident },
+                    { QStringLiteral("visible"), model->visible },
+                    { QStringLiteral("buffer_bytes"),
+                      model->memory.buffer_bytes },
+                    { QStringLiteral("texture_bytes"),
+                      model->memory.texture_bytes },
+                    { QStringLiteral("cpu_bytes"), model->memory.cpu_bytes },
+                    { QStringLiteral("animations"), clips },
+                };
+
+                if (auto const& volume = model->volume) {
+                    entry[QStringLiteral("iso_value")] =
+                        model->options.iso_value.value_or(volume->middle());
+                    entry[QStringLiteral("iso_range")] = QCborArray {
+                        volume->min_value,
+                        volume->max_value,
+                    };
+                }
+
+                ret << entry;
+            }
+
+            return ret;
+        },
+    };
+
+    return noo::create_method(pg.document(), data);
+}
+
+noo::MethodTPtr make_set_model_visible_method(Playground& pg) {
+    noo::MethodData data {
+        .method_name = "set_model_visible",
+        .documentation =
+            "Mark a model as visible or hidden. Hidden models are the first "
+            "to have their geometry evicted when over the memory budget; "
+            "showing a model loads it back in.",
+        .return_documentation = "True if the model exists",
+        .argument_documentation =
+            {
+                noo::MethodArg { .name = "id", .doc = "Id of the model" },
+                noo::MethodArg { .name = "visible", .doc = "Boolean" },
+            },
+        .code = [&pg](noo::MethodContext const&,
+                      QCborArray const& args) -> QCborValue {
+            auto id      = arg_at(args, 0);
+            auto visible = arg_at(args, 1);
+
+            if (!id.isInteger()) bad_args("Expected a model id");
+            if (!visible.isBool()) bad_args("Expected a boolean");
+
+            return pg.set_model_visible(id.toInteger(), visible.toBool());
+        },
+    };
+
+    return noo::create_method(pg.document(), data);
+}
+
+noo::MethodTPtr make_metrics_method(Playground& pg) {
+    noo::MethodData data {
+        .method_name          = "metrics",
+        .documentation        = "Current server metrics",
+        .return_documentation = "Text in the Prometheus exposition format",
+        .code = [](noo::MethodContext const&, QCborArray const&) -> QCborValue {
+            return MetricsRegistry::global().expose();
+        },
+    };
+
+    return noo::create_method(pg.document(), data);
+}
+
+noo::MethodTPtr make_play_animation_method(Playground& pg) {
+    noo::MethodData data {
+        .method_name = "play_animation",
+        .documentation =
+            "Play an animation clip of a model on the server. A paused clip "
+            "resumes where it was; another clip starts from its beginning. "
+            "Clips loop.",
+        .return_documentation = "True if the model has the clip",
+        .argument_documentation =
+            {
+                noo::MethodArg { .name = "id", .doc = "Id of the model" },
+                noo::MethodArg {
+                    .name = "clip",
+                    .doc  = "Optional clip name or index; the first clip by "
+                            "default" },
+            },
+        .code = [&pg](noo::MethodContext const&,
+                      QCborArray const& args) -> QCborValue {
+            auto id   = model_id(arg_at(args, 0));
+            auto clip = arg_at(args, 1);
+
+            if (clip.isUndefined() or clip.isNull()) {
+                return pg.play_animation(id, 0);
+            }
+
+            if (clip.isInteger()) {
+                return pg.play_animation(id, clip.toInteger());
+            }
+
+            if (!clip.isString()) bad_args("Expected a clip name or index");
+
+            auto model = pg.model(id);
+
+            if (!model or !model->animations) return false;
+
+            return pg.play_animation(
+                id, model->animations->find_clip(clip.toString()));
+        },
+    };
+
+    return noo::create_method(pg.document(), data);
+}
+
+noo::MethodTPtr make_pause_animation_method(Playground& pg) {
+    noo::MethodData data {
+        .method_name          = "pause_animation",
+        .documentation        = "Pause the animation of a model",
+        .return_documentation = "True if the model was animated",
+        .argument_documentation =
+            {
+                noo::MethodArg { .name = "id", .doc = "Id of the model" },
+            },
+        .code = [&pg](noo::MethodContext const&,
+                      QCborArray const& args) -> QCborValue {
+            return pg.pause_animation(model_id(arg_at(args, 0)));
+        },
+    };
+
+    return noo::create_method(pg.document(), data);
+}
+
+noo::MethodTPtr make_seek_animation_method(Playground& pg) {
+    noo::MethodData data {
+        .method_name = "seek_animation",
+        .documentation =
+            "Move the current animation clip of a model to a time. The pose "
+            "is shown right away, even while paused.",
+        .return_documentation = "True if the model has animations",
+        .argument_documentation =
+            {
+                noo::MethodArg { .name = "id", .doc = "Id of the model" },
+                noo::MethodArg { .name = "time",
+                                 .doc  = "Seconds from the start of the clip" },
+            },
+        .code = [&pg](noo::MethodContext const&,
+                      QCborArray const& args) -> QCborValue {
+            auto id   = model_id(arg_at(args, 0));
+            auto time = arg_at(args, 1);
+
+            if (!time.isDouble() and !time.isInteger()) {
+                bad_args("Expected a time in seconds");
+            }
+
+            return pg.seek_animation(id, time.toDouble());
+        },
+    };
+
+    return noo::create_method(pg.document(), data);
+}
+
+noo::MethodTPtr make_set_iso_value_method(Playground& pg) {
+    noo::MethodData data {
+        .method_name = "set_iso_value",
+        .documentation =
+            "Show the isosurface of the scalar field of a volume model at "
+            "another value. The surface is extracted in the background and "
+            "replaces the current one when done.",
+        .return_documentation = "True if the model has a scalar field",
+        .argument_documentation =
+            {
+                noo::MethodArg { .name = "id", .doc = "Id of the model" },
+                noo::MethodArg { .name = "value",
+                                 .doc  = "Value of the field to show" },
+            },
+        .code = [&pg](noo::MethodContext const&,
+                      QCborArray const& args) -> QCborValue {
+            auto id    = model_id(arg_at(args, 0));
+            auto value = arg_at(args, 1);
+
+            if (!value.isDouble() and !value.isInteger()) {
+                bad_args("Expected a field value");
+            }
+
+            return pg.set_iso_value(id, value.toDouble());
+        },
+    };
+
+    return noo::create_method(pg.document(), data);
+}
+
+noo::MethodTPtr make_slice_models_method(Playground& pg) {
+    noo::MethodData data {
+        .method_name = "slice_models",
+        .documentation =
+            "Show where planes cut every loaded model, as lines under the "
+            "root object of each, and optionally fill the closed ones. The "
+            "sections follow models as they move or change until replaced; "
+            "no planes removes them.",
+        .return_documentation =
+            "Array of the ids of the models being cut. Cuts run in the "
+            "background, and each section shows once its cut is done.",
+        .argument_documentation =
+            {
+                noo::MethodArg {
+                    .name = "planes",
+                    .doc  = "A map with a point and a normal, in the space "
+                            "of the scene, or an array of them" },
+                noo::MethodArg { .name = "caps",
+                                 .doc  = "Optional boolean; fill closed "
+                                         "lines. Off if not given." },
+            },
+        .code = [&pg](noo::MethodContext const&,
+                      QCborArray const& args) -> QCborValue {
+            auto planes_arg = arg_at(args, 0);
+            auto caps       = arg_at(args, 1).toBool(false);
+
+            std::vector<Plane> planes;
+
+            if (planes_arg.isMap()) {
+                planes.push_back(parse_plane(planes_arg));
+            } else if (planes_arg.isArray()) {
+                auto const array = planes_arg.toArray();
+
+                if (array.size() > max_planes) {
+                    bad_args(QString("Expected at most %1 planes")
+                                 .arg(max_planes));
+                }
+
+                for (auto const& plane : array) {
+                    planes.push_back(parse_plane(plane));
+                }
+            } else if (!planes_arg.isUndefined() and !planes_arg.isNull()) {
+                bad_args("Expected a plane or an array of planes");
+            }
+
+            QCborArray ret;
+
+            for (auto id : pg.set_section(std::move(planes), caps)) {
+                ret << id;
+            }
+
+            return ret;
+        },
+    };
+
+    return noo::create_method(pg.document(), data);
+}
+
+noo::MethodTPtr make_create_instance_set_method(Playground& pg) {
+    noo::MethodData data {
+        .method_name = "create_instance_set",
+        .documentation =
+            "Place many copies of the meshes of a loaded model. Instances "
+            "start at the origin; move them with edit_instances.",
+        .return_documentation =
+            "Id of the new instance set, or -1 if the model has no meshes "
+            "that can be instanced. Meshes placed with shear or non-uniform "
+            "scale are left out.",
+        .argument_documentation =
+            {
+                noo::MethodArg { .name = "id", .doc = "Id of the model" },
+                noo::MethodArg { .name = "count",
+                                 .doc  = "Number of instances" },
+            },
+        .code = [&pg](noo::MethodContext const&,
+                      QCborArray const& args) -> QCborValue {
+            auto id    = model_id(arg_at(args, 0));
+            auto count = instance_count(arg_at(args, 1));
+
+            return pg.create_instance_set(id, count);
+        },
+    };
+
+    return noo::create_method(pg.document(), data);
+}
+
+noo::MethodTPtr make_edit_instances_method(Playground& pg) {
+    noo::MethodData data {
+        .method_name = "edit_instances",
+        .documentation =
+            "Change any number of instances of a set at once. Only the pages "
+            "of instances that changed are sent again, on the next event "
+            "loop turn together with other edits.",
+        .return_documentation = "True if the set exists",
+        .argument_documentation =
+            {
+                noo::MethodArg { .name = "set", .doc = "Id of the set" },
+                noo::MethodArg {
+                    .name = "edits",
+                    .doc  = "Array of maps with an index and any of "
+                            "position [x, y, z], rotation [x, y, z, w], scale "
+                            "(a number or [x, y, z]) and color [r, g, b, a] "
+                            "from 0 to 1" },
+                noo::MethodArg {
+                    .name = "count",
+                    .doc  = "Optional new instance count, applied before the "
+                            "edits" },
+            },
+        .code = [&pg](noo::MethodContext const&,
+                      QCborArray const& args) -> QCborValue {
+            auto id    = arg_at(args, 0);
+            auto edits = arg_at(args, 1);
+            auto count = arg_at(args, 2);
+
+            if (!id.isInteger()) bad_args("Expected an instance set id");
+
+            if (!edits.isArray() and !edits.isUndefined() and
+                !edits.isNull()) {
+                bad_args("Expected an array of instance edits");
+            }
+
+            std::vector<InstanceSet::Edit> parsed;
+
+            for (auto const& edit : edits.toArray()) {
+                parsed.push_back(parse_instance_edit(edit));
+            }
+
+            auto set = pg.instance_set(id.toInteger());
+
+            if (!set) return false;
+
+            auto size = set->size();
+
+            if (!count.isUndefined() and !count.isNull()) {
+                size = instance_count(count);
+            }
+
+            // check before resizing, so a bad batch changes nothing
+            for (auto const& edit : parsed) {
+                if (edit.index >= size) {
+                    bad_args(QString("Instance %1 is out of range")
+                                 .arg(edit.index));
+                }
+            }
+
+            set->resize(size);
+
+            if (auto err = set->apply(parsed)) bad_args(*err);
+
+            pg.flush_instances_later();
+
+            return true;
+        },
+    };
+
+    return noo::create_method(pg.document(), data);
+}
+
+noo::MethodTPtr make_delete_instance_set_method(Playground& pg) {
+    noo::MethodData data {
+        .method_name          = "delete_instance_set",
+        .documentation        = "Remove an instance set and its objects",
+        .return_documentation = "True if the set existed",
+        .argument_documentation =
+            {
+                noo::MethodArg { .name = "set", .doc = "Id of the set" },
+            },
+        .code = [&pg](noo::MethodContext const&,
+                      QCborArray const& args) -> QCborValue {
+            auto id = arg_at(args, 0);
+
+            if (!id.isInteger()) bad_args("Expected an instance set id");
+
+            return pg.delete_instance_set(id.toInteger());
+        },
+    };
+
+    return noo::create_method(pg.document(), data);
+}
+
+noo::MethodTPtr make_create_point_plot_method(Playground& pg) {
+    noo::MethodData data {
+        .method_name = "create_point_plot",
+        .documentation =
+            "Create an empty plot of points, drawn as small glyphs. Fill it "
+            "with append_points.",
+        .return_documentation = "Id of the new plot",
+        .argument_documentation =
+            {
+                noo::MethodArg {
+                    .name = "capacity",
+                    .doc  = "Optional most points to keep; once full, the "
+                            "oldest are dropped as new ones arrive. All are "
+                            "kept by default." },
+            },
+        .code = [&pg](noo::MethodContext const&,
+                      QCborArray const& args) -> QCborValue {
+            return pg.create_point_plot(point_capacity(arg_at(args, 0)));
+        },
+    };
+
+    return noo::create_method(pg.document(), data);
+}
+
+noo::MethodTPtr make_append_points_method(Playground& pg) {
+    noo::MethodData data {
+        .method_name = "append_points",
+        .documentation =
+            "Add points to a plot. Points already sent are not sent again; "
+            "appends arriving in the same event loop turn go out together. "
+            "Packed arrays are little endian.",
+        .return_documentation =
+            "Number of points the plot holds, or -1 if there is no such plot",
+        .argument_documentation =
+            {
+                noo::MethodArg { .name = "plot", .doc = "Id of the plot" },
+                noo::MethodArg {
+                    .name = "positions",
+                    .doc  = "Bytes of packed 32 bit float x, y, z, or an "
+                            "array of numbers" },
+                noo::MethodArg {
+                    .name = "colors",
+                    .doc  = "Optional bytes of packed 8 bit r, g, b, a per "
+                            "point, or one color [r, g, b, a] from 0 to 1 "
+                            "for all" },
+                noo::MethodArg {
+                    .name = "sizes",
+                    .doc  = "Optional bytes of packed 32 bit floats per "
+                            "point, or one number for all" },
+                noo::MethodArg {
+                    .name = "capacity",
+                    .doc  = "Optional new capacity, applied before the "
+                            "points are added" },
+            },
+        .code = [&pg](noo::MethodContext const&,
+                      QCborArray const& args) -> QCborValue {
+            auto start = std::chrono::steady_clock::now();
+
+            auto id = arg_at(args, 0);
+
+            if (!id.isInteger()) bad_args("Expected a point plot id");
+
+            auto positions = parse_positions(arg_at(args, 1));
+            auto colors    = parse_point_colors(arg_at(args, 2));
+            auto sizes     = parse_point_sizes(arg_at(args, 3));
+            auto capacity  = arg_at(args, 4);
+
+            auto plot = pg.point_plot(id.toInteger());
+
+            if (!plot) return -1;
+
+            if (!capacity.isUndefined() and !capacity.isNull()) {
+                plot->set_capacity(point_capacity(capacity));
+            }
+
+            if (auto err = plot->append(positions, colors, sizes)) {
+                bad_args(*err);
+            }
+
+            pg.flush_point_plots_later();
+
+            std::chrono::duration<double> took =
+                std::chrono::steady_clock::now() - start;
+
+            metrics::points_ingested().add(positions.size());
+
+            if (took.count() > 0) {
+                metrics::point_ingest_rate().set(positions.size() /
+                                                 took.count());
+            }
+
+            return (qint64)plot->size();
+        },
+    };
+
+    return noo::create_method(pg.document(), data);
+}
+
+noo::MethodTPtr make_delete_point_plot_method(Playground& pg) {
+    noo::MethodData data {
+        .method_name          = "delete_point_plot",
+        .documentation        = "Remove a point plot and its objects",
+        .return_documentation = "True if the plot existed",
+        .argument_documentation =
+            {
+                noo::MethodArg { .name = "plot", .doc = "Id of the plot" },
+            },
+        .code = [&pg](noo::MethodContext const&,
+                      QCborArray const& args) -> QCborValue {
+            auto id = arg_at(args, 0);
+
+            if (!id.isInteger()) bad_args("Expected a point plot id");
+
+            return pg.delete_point_plot(id.toInteger());
+        },
+    };
+
+    return noo::create_method(pg.document(), data);
+}
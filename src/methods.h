@@ -0,0 +1,24 @@
+#pragma once
+
+#include <noo_server_interface.h>
+
+class Playground;
+
+// Document methods exposed to clients.
+
+noo::MethodTPtr make_load_model_method(Playground&);
+noo::MethodTPtr make_unload_model_method(Playground&);
+noo::MethodTPtr make_list_models_method(Playground&);
+noo::MethodTPtr make_set_model_visible_method(Playground&);
+noo::MethodTPtr make_metrics_method(Playground&);
+noo::MethodTPtr make_play_animation_method(Playground&);
+noo::MethodTPtr make_pause_animation_method(Playground&);
+noo::MethodTPtr make_seek_animation_method(Playground&);
+noo::MethodTPtr make_set_iso_value_method(Playground&);
+noo::MethodTPtr make_slice_models_method(Playground&);
+noo::MethodTPtr make_create_instance_set_method(Playground&);
+noo::MethodTPtr make_edit_instances_method(Playground&);
+noo::MethodTPtr make_delete_instance_set_method(Playground&);
+noo::MethodTPtr make_create_point_plot_method(Playground&);
+noo::MethodTPtr make_append_points_method(Playground&);
+noo::MethodTPtr make_delete_point_plot_method(Playground&);
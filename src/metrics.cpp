@@ -0,0 +1,466 @@
+#include "metrics.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QHostAddress>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTextStream>
+
+#include <algorithm>
+
+#include <unistd.h>
+
+Histogram::Histogram(std::vector<double> bounds)
+    : m_bounds(std::move(bounds)),
+      m_buckets(new std::atomic<uint64_t>[m_bounds.size() + 1]) {
+    for (size_t i = 0; i <= m_bounds.size(); i++) {
+        m_buckets[i] = 0;
+    }
+}
+
+void Histogram::observe(double v) {
+    auto iter  = std::lower_bound(m_bounds.begin(), m_bounds.end(), v);
+    auto index = iter - m_bounds.begin();
+
+    m_buckets[index].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(v, std::memory_order_relaxed);
+}
+
+// =============================================================================
+
+MetricsRegistry& MetricsRegistry::global() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+MetricsRegistry::Family&
+MetricsRegistry::family(QString const& name, QString const& help, Type type) {
+    auto [iter, inserted] = m_families.try_emplace(name);
+
+    if (inserted) {
+        iter->second.help = help;
+        iter->second.type = type;
+    }
+
+    Q_ASSERT(iter->second.type == type);
+
+    return iter->second;
+}
+
+Counter& MetricsRegistry::counter(QString const& name,
+                                  QString const& help,
+                                  QString const& labels) {
+    std::scoped_lock lock(m_lock);
+
+    auto& f = family(name, help, Type::Counter);
+
+    auto [iter, inserted] = f.by_labels.try_emplace(labels, f.counters.size());
+
+    if (inserted) f.counters.emplace_back();
+
+    return f.counters[iter->second];
+}
+
+Gauge& MetricsRegistry::gauge(QString const& name,
+                              QString const& help,
+                              QString const& labels) {
+    std::scoped_lock lock(m_lock);
+
+    auto& f = family(name, help, Type::Gauge);
+
+    auto [iter, inserted] = f.by_labels.try_emplace(labels, f.gauges.size());
+
+    if (inserted) f.gauges.emplace_back();
+
+    return f.gauges[iter->second];
+}
+
+Histogram& MetricsRegistry::histogram(QString const&      name,
+                                      QString const&      help,
+                                      std::vector<double> bounds,
+                                      QString const&      labels) {
+    std::scoped_lock lock(m_lock);
+
+    auto& f = family(name, help, Type::Histogram);
+
+    auto [iter, inserted] =
+        f.by_labels.try_emplace(labels, f.histograms.size());
+
+    if (inserted) f.histograms.emplace_back(std::move(bounds));
+
+    return f.histograms[iter->second];
+}
+
+void MetricsRegistry::add_collector(
+    std::function<std::vector<MetricSample>()> collector) {
+    std::scoped_lock lock(m_lock);
+    m_collectors.push_back(std::move(collector));
+}
+
+static QString with_labels(QString const& name,
+                           QString const& labels,
+                           QString const& extra = {}) {
+    QStringList all;
+    if (!labels.isEmpty()) all << labels;
+    if (!extra.isEmpty()) all << extra;
+
+    if (all.isEmpty()) return name;
+
+    return QString("%1{%2}").arg(name, all.join(','));
+}
+
+QString MetricsRegistry::expose() const {
+    QString     ret;
+    QTextStream out(&ret);
+
+    std::vector<std::function<std::vector<MetricSample>()>> collectors;
+
+    {
+        std::scoped_lock lock(m_lock);
+
+        for (auto const& [name, f] : m_families) {
+            static char const* const type_names[] = {
+                "counter",
+                "gauge",
+                "histogram",
+            };
+
+            out << "# HELP " << name << " " << f.help << "\n";
+            out << "# TYPE " << name << " " << type_names[(int)f.type] << "\n";
+
+            for (auto const& [labels, index] : f.by_labels) {
+                switch (f.type) {
+                case Type::Counter:
+                    out << with_labels(name, labels) << " "
+                        << f.counters[index].value() << "\n";
+                    break;
+                case Type::Gauge:
+                    out << with_labels(name, labels) << " "
+                        << f.gauges[index].value() << "\n";
+                    break;
+                case Type::Histogram: {
+                    auto const& h = f.histograms[index];
+
+                    uint64_t cumulative = 0;
+
+                    for (size_t i = 0; i <= h.bounds().size(); i++) {
+                        cumulative += h.bucket(i);
+
+                        auto le = i < h.bounds().size()
+                                      ? QString::number(h.bounds()[i])
+                                      : QString("+Inf");
+
+                        out << with_labels(name + "_bucket",
+                                           labels,
+                                           QString("le=\"%1\"").arg(le))
+                            << " " << cumulative << "\n";
+                    }
+
+                    out << with_labels(name + "_sum", labels) << " " << h.sum()
+                        << "\n";
+                    out << with_labels(name + "_count", labels) << " "
+                        << h.count() << "\n";
+                } break;
+                }
+            }
+        }
+
+        collectors = m_collectors;
+    }
+
+    // collectors may take their own locks; run them without ours
+    QString last_name;
+
+    for (auto const& collector : collectors) {
+        for (auto const& sample : collector()) {
+            if (sample.name != last_name) {
+                out << "# HELP " << sample.name << " " << sample.help << "\n";
+                out << "# TYPE " << sample.name << " gauge\n";
+                last_name = sample.name;
+            }
+
+            out << with_labels(sample.name, sample.labels) << " "
+                << sample.value << "\n";
+        }
+    }
+
+    out.flush();
+
+    return ret;
+}
+
+std::vector<double> duration_buckets() {
+    return { 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1, 5, 10, 30, 60, 300 };
+}
+
+int64_t process_rss_bytes() {
+    QFile statm("/proc/self/statm");
+
+    if (!statm.open(QFile::ReadOnly)) return 0;
+
+    auto fields = statm.readAll().split(' ');
+
+    if (fields.size() < 2) return 0;
+
+    return fields[1].toLongLong() * sysconf(_SC_PAGESIZE);
+}
+
+int64_t process_peak_rss_bytes() {
+    QFile status("/proc/self/status");
+
+    if (!status.open(QFile::ReadOnly)) return 0;
+
+    // a line like "VmHWM:   123456 kB"
+    for (auto const& line : status.readAll().split('\n')) {
+        if (!line.startsWith("VmHWM:")) continue;
+
+        auto fields = line.simplified().split(' ');
+
+        if (fields.size() < 2) return 0;
+
+        return fields[1].toLongLong() * 1024;
+    }
+
+    return 0;
+}
+
+bool reset_peak_rss() {
+    QFile clear_refs("/proc/self/clear_refs");
+
+    if (!clear_refs.open(QFile::WriteOnly)) return false;
+
+    // 5 resets the high water mark and leaves page state alone
+    return clear_refs.write("5") == 1;
+}
+
+// =============================================================================
+
+MetricsServer::MetricsServer(quint16 port, QObject* parent)
+    : QObject(parent), m_server(new QTcpServer(this)) {
+    connect(m_server,
+            &QTcpServer::newConnection,
+            this,
+            &MetricsServer::on_connection);
+
+    // local only; there is no authentication
+    if (!m_server->listen(QHostAddress::LocalHost, port)) {
+        qWarning() << "Unable to serve metrics on port" << port << "|"
+                   << m_server->errorString();
+        return;
+    }
+
+    qInfo() << qPrintable(
+        QString("Serving metrics at http://localhost:%1/metrics").arg(port));
+}
+
+bool MetricsServer::is_listening() const { return m_server->isListening(); }
+
+void MetricsServer::on_connection() {
+    while (auto* socket = m_server->nextPendingConnection()) {
+        connect(socket,
+                &QTcpSocket::disconnected,
+                socket,
+                &QObject::deleteLater);
+
+        connect(socket, &QTcpSocket::readyRead, socket, [socket]() {
+            // wait for the whole request head
+            if (!socket->peek(8192).contains("\r\n\r\n")) return;
+
+            auto request_line = socket->readLine().trimmed().split(' ');
+            socket->readAll();
+
+            QByteArray status = "200 OK";
+            QByteArray body;
+
+            if (request_line.size() >= 2 and request_line[0] == "GET" and
+                request_line[1] == "/metrics") {
+                body = MetricsRegistry::global().expose().toUtf8();
+            } else {
+                status = "404 Not Found";
+                body   = "Metrics are at /metrics\n";
+            }
+
+            socket->write("HTTP/1.1 " + status + "\r\n");
+            socket->write("Content-Type: text/plain; version=0.0.4\r\n");
+            socket->write("Content-Length: " + QByteArray::number(body.size()) +
+                          "\r\n");
+            socket->write("Connection: close\r\n\r\n");
+            socket->write(body);
+            socket->disconnectFromHost();
+        });
+    }
+}
+
+// =============================================================================
+
+namespace metrics {
+
+Counter& models_loaded() {
+    static auto& c = MetricsRegistry::global().counter(
+        "playground_models_loaded_total", "Models imported into the document");
+    return c;
+}
+
+Counter& models_unloaded() {
+    static auto& c = MetricsRegistry::global().counter(
+        "playground_models_unloaded_total", "Models removed from the document");
+    return c;
+}
+
+Counter& models_evicted() {
+    static auto& c = MetricsRegistry::global().counter(
+        "playground_models_evicted_total",
+        "Models whose geometry was evicted to meet the memory budget");
+    return c;
+}
+
+Counter& meshes_converted() {
+    static auto& c = MetricsRegistry::global().counter(
+        "playground_meshes_converted_total", "Meshes converted by importers");
+    return c;
+}
+
+namespace {
+
+constexpr std::array<char const*, size_t(BufferType::Count)> buffer_types = {
+    "geometry", "image", "points", "instances", "section",
+};
+
+constexpr std::array<char const*, size_t(ImportPhase::Count)> phases = {
+    "parse",   "read",   "stream", "points",     "textures",
+    "convert", "stage",  "create", "tree",       "isosurface",
+    "weld",    "normals", "tangents",
+};
+
+} // namespace
+
+char const* phase_name(ImportPhase phase) { return phases[size_t(phase)]; }
+
+Counter& buffer_bytes_created(BufferType type) {
+    // every label is looked up once, so that updates take no lock
+    static auto const counters = [] {
+        std::array<Counter*, buffer_types.size()> ret;
+
+        for (size_t i = 0; i < ret.size(); i++) {
+            ret[i] = &MetricsRegistry::global().counter(
+                "playground_buffer_bytes_created_total",
+                "Bytes of new buffer content, by what it holds",
+                QString("type=\"%1\"").arg(buffer_types[i]));
+        }
+
+        return ret;
+    }();
+
+    return *counters[size_t(type)];
+}
+
+Counter& texture_source_bytes() {
+    static auto& c = MetricsRegistry::global().counter(
+        "playground_texture_source_bytes_total",
+        "Bytes of texture images as read, before any re-encoding");
+    return c;
+}
+
+Counter& texture_encoded_bytes() {
+    static auto& c = MetricsRegistry::global().counter(
+        "playground_texture_encoded_bytes_total",
+        "Bytes of texture images as published, after re-encoding");
+    return c;
+}
+
+Counter& transform_updates_received() {
+    static auto& c = MetricsRegistry::global().counter(
+        "playground_transform_updates_received_total",
+        "Position, rotation and scale changes requested by clients");
+    return c;
+}
+
+Counter& transform_updates_sent() {
+    static auto& c = MetricsRegistry::global().counter(
+        "playground_transform_updates_sent_total",
+        "Object transform updates published to clients");
+    return c;
+}
+
+Counter& points_ingested() {
+    static auto& c = MetricsRegistry::global().counter(
+        "playground_points_ingested_total",
+        "Points appended to point plots by clients");
+    return c;
+}
+
+Counter& data_bytes_read() {
+    static auto& c = MetricsRegistry::global().counter(
+        "playground_data_bytes_read_total",
+        "Bytes of XDMF data items read ahead of conversion");
+    return c;
+}
+
+Histogram& import_phase(ImportPhase phase) {
+    static auto const histograms = [] {
+        std::array<Histogram*, phases.size()> ret;
+
+        for (size_t i = 0; i < ret.size(); i++) {
+            ret[i] = &MetricsRegistry::global().histogram(
+                "playground_import_phase_seconds",
+                "Time spent in each phase of an import",
+                duration_buckets(),
+                QString("phase=\"%1\"").arg(phases[i]));
+        }
+
+        return ret;
+    }();
+
+    return *histograms[size_t(phase)];
+}
+
+Histogram& animation_tick() {
+    // a tick has to fit well inside its interval, so the interesting range
+    // is far below that of an import
+    static auto& h = MetricsRegistry::global().histogram(
+        "playground_animation_tick_seconds",
+        "Time spent sampling and sending animated transforms per tick",
+        { 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05 });
+    return h;
+}
+
+Gauge& import_peak_rss() {
+    static auto& g = MetricsRegistry::global().gauge(
+        "playground_import_peak_rss_bytes",
+        "Peak resident set size of the process during the last import");
+    return g;
+}
+
+Gauge& import_allocations() {
+    static auto& g = MetricsRegistry::global().gauge(
+        "playground_import_heap_allocations",
+        "Heap allocations made during the last import, where counted");
+    return g;
+}
+
+Gauge& import_allocated_bytes() {
+    static auto& g = MetricsRegistry::global().gauge(
+        "playground_import_heap_allocated_bytes",
+        "Bytes of heap allocations made during the last import, where "
+        "counted");
+    return g;
+}
+
+Gauge& point_ingest_rate() {
+    static auto& g = MetricsRegistry::global().gauge(
+        "playground_point_ingest_points_per_second",
+        "Points per second decoded and staged by the last point append");
+    return g;
+}
+
+Gauge& data_read_rate() {
+    static auto& g = MetricsRegistry::global().gauge(
+        "playground_data_read_bytes_per_second",
+        "Bytes per second of XDMF data items read by the last import, over "
+        "the time reads were in flight");
+    return g;
+}
+
+} // namespace metrics
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class QTcpServer;
+
+/// A count that only goes up. Updates are relaxed atomics, so these are fine
+/// on hot paths.
+class Counter {
+    std::atomic<uint64_t> m_value = 0;
+
+public:
+    void add(uint64_t v = 1) {
+        m_value.fetch_add(v, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const { return m_value.load(std::memory_order_relaxed); }
+};
+
+/// A value that goes up and down
+class Gauge {
+    std::atomic<int64_t> m_value = 0;
+
+public:
+    void    set(int64_t v) { m_value.store(v, std::memory_order_relaxed); }
+    void    add(int64_t v) { m_value.fetch_add(v, std::memory_order_relaxed); }
+    int64_t value() const { return m_value.load(std::memory_order_relaxed); }
+};
+
+/// Observations sorted into fixed buckets, given by their upper bounds
+class Histogram {
+    std::vector<double>                      m_bounds;
+    std::unique_ptr<std::atomic<uint64_t>[]> m_buckets; // one past the bounds
+    std::atomic<uint64_t>                    m_count = 0;
+    std::atomic<double>                      m_sum   = 0;
+
+public:
+    explicit Histogram(std::vector<double> bounds);
+
+    void observe(double v);
+
+    std::vector<double> const& bounds() const { return m_bounds; }
+    uint64_t bucket(size_t i) const { return m_buckets[i].load(); }
+    uint64_t count() const { return m_count.load(); }
+    double   sum() const { return m_sum.load(); }
+};
+
+/// Times a scope into a histogram, in seconds
+class ScopedTimer {
+    Histogram&                            m_target;
+    std::chrono::steady_clock::time_point m_start;
+
+public:
+    explicit ScopedTimer(Histogram& target)
+        : m_target(target), m_start(std::chrono::steady_clock::now()) { }
+
+    ~ScopedTimer() {
+        std::chrono::duration<double> d =
+            std::chrono::steady_clock::now() - m_start;
+        m_target.observe(d.count());
+    }
+};
+
+/// A value computed when metrics are scraped, for things that are cheaper
+/// to look up than to track (per model sizes, process memory).
+struct MetricSample {
+    QString name;
+    QString help;
+    QString labels; // preformatted, e.g. model="3"
+    double  value = 0;
+};
+
+/// All metrics of the process. Registration takes a lock; callers keep the
+/// returned reference, so updates never do. Labels are preformatted Prometheus
+/// label pairs, e.g. `phase="read"`.
+class MetricsRegistry {
+    enum class Type { Counter, Gauge, Histogram };
+
+    struct Family {
+        QString help;
+        Type    type;
+
+        // deques keep addresses stable as entries are added
+        std::map<QString, size_t> by_labels;
+        std::deque<Counter>       counters;
+        std::deque<Gauge>         gauges;
+        std::deque<Histogram>     histograms;
+    };
+
+    mutable std::mutex        m_lock;
+    std::map<QString, Family> m_families;
+
+    std::vector<std::function<std::vector<MetricSample>()>> m_collectors;
+
+    Family& family(QString const& name, QString const& help, Type);
+
+public:
+    static MetricsRegistry& global();
+
+    Counter& counter(QString const& name,
+                     QString const& help,
+                     QString const& labels = {});
+
+    Gauge& gauge(QString const& name,
+                 QString const& help,
+                 QString const& labels = {});
+
+    Histogram& histogram(QString const&      name,
+                         QString const&      help,
+                         std::vector<double> bounds,
+                         QString const&      labels = {});
+
+    void add_collector(std::function<std::vector<MetricSample>()>);
+
+    /// Everything in the Prometheus text exposition format
+    QString expose() const;
+};
+
+/// Bucket bounds for import phases, from a millisecond to a few minutes
+std::vector<double> duration_buckets();
+
+/// Serves the registry over plain HTTP at /metrics
+class MetricsServer : public QObject {
+    Q_OBJECT
+
+    QTcpServer* m_server;
+
+public:
+    MetricsServer(quint16 port, QObject* parent = nullptr);
+
+    bool is_listening() const;
+
+private slots:
+    void on_connection();
+};
+
+/// Resident set size of this process, in bytes
+int64_t process_rss_bytes();
+
+/// Highest resident set size of this process since it started or since the
+/// last reset_peak_rss(), in bytes
+int64_t process_peak_rss_bytes();
+
+/// Start measuring a new peak. Returns false if the kernel does not allow
+/// it, in which case the peak keeps counting from process start.
+bool reset_peak_rss();
+
+// Metrics shared across the tree =============================================
+
+namespace metrics {
+
+/// What new buffer content holds, the label of buffer_bytes_created
+enum class BufferType { Geometry, Image, Points, Instances, Section, Count };
+
+/// The phases of an import, the label of import_phase
+enum class ImportPhase {
+    Parse,
+    Read,
+    Stream,
+    Points,
+    Textures,
+    Convert,
+    Stage,
+    Create,
+    Tree,
+    Isosurface,
+    Weld,
+    Normals,
+    Tangents,
+    Count,
+};
+
+/// The label of a phase, as it shows in the metrics and log
+char const* phase_name(ImportPhase);
+
+Counter& models_loaded();
+Counter& models_unloaded();
+Counter& models_evicted();
+Counter& meshes_converted();
+Counter& buffer_bytes_created(BufferType);
+Counter& texture_source_bytes();
+Counter& texture_encoded_bytes();
+Counter& transform_updates_received();
+Counter& transform_updates_sent();
+Counter& points_ingested();
+Counter& data_bytes_read();
+Histogram& import_phase(ImportPhase);
+Histogram& animation_tick();
+Gauge&     import_peak_rss();
+Gauge&     import_allocations();
+Gauge&     import_allocated_bytes();
+Gauge&     point_ingest_rate();
+Gauge&     data_read_rate();
+
+} // namespace metrics
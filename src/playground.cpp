@@ -1,63 +1,27 @@
 #include "playground.h"
 
-#include "xdmfimporter.h"
+#include "allocstats.h"
+#include "animation.h"
+#include "importer.h"
+#include "instanceset.h"
+#include "isosurface.h"
+#include "methods.h"
+#include "metrics.h"
+#include "pointplot.h"
+#include "publishqueue.h"
+#include "threadpool.h"
+#include "utility.h"
 
 #include "variant_tools.h"
 
 #include <glm/gtx/quaternion.hpp>
 
-#include <string>
-#include <string_view>
-
-#include <QBuffer>
-#include <QByteArray>
-#include <QColor>
 #include <QCommandLineParser>
 #include <QDebug>
 #include <QFileInfo>
-#include <QImageWriter>
-#include <QJsonArray>
-#include <QJsonDocument>
-#include <QJsonObject>
-#include <QMimeDatabase>
-#include <QVariantAnimation>
-
-#include <assimp/Importer.hpp>
-#include <assimp/postprocess.h>
-#include <assimp/scene.h>
-
-std::span<glm::vec3> convert_vec3(aiVector3D* src, size_t count) {
-    return { reinterpret_cast<glm::vec3*>(src), count };
-}
-
-glm::u8vec4 convert_col(aiColor4D const& src) {
-    return (glm::vec4(src[0], src[1], src[2], src[3]) * 255.0f);
-}
-
-glm::u16vec2 convert_tex(aiVector3D const& src) {
-    return (glm::vec2(src[0], src[1]) * 65535.0f);
-}
-
-QColor convert_qcol(aiColor4D const& src) {
-    return QColor::fromRgbF(src.r, src.g, src.b, src.a);
-}
-
-QDebug operator<<(QDebug debug, glm::vec4 const& c) {
-    QDebugStateSaver saver(debug);
-    debug.nospace() << '<' << c.x << ", " << c.y << ", " << c.z << ", " << c.w
-                    << '>';
-
-    return debug;
-}
-
-QDebug operator<<(QDebug debug, glm::mat4 const& c) {
-    QDebugStateSaver saver(debug);
-    debug.nospace() << "[\n " << c[0] << "\n " << c[1] << "\n " << c[2] << "\n "
-                    << c[3] << "\n]";
-
-    return debug;
-}
-
+#include <QFutureWatcher>
+#include <QPointer>
+#include <QtConcurrent>
 
 // =============================================================================
 
@@ -71,10 +35,19 @@ void ModelCallbacks::update_transform() {
     auto l = m_model.lock();
     if (!l) return;
 
+    auto tf = l->recompute_transform();
+
+    // the root record tracks what the root object shows
+    auto root = l->nodes.find(QString());
+    if (root != l->nodes.end()) root->transform = tf;
+
     noo::ObjectUpdateData update;
-    update.transform = l->recompute_transform();
+    update.transform = tf;
 
     noo::update_object(get_host(), update);
+    metrics::transform_updates_sent().add();
+
+    if (l->on_moved) l->on_moved();
 }
 
 ModelCallbacks::ModelCallbacks(noo::ObjectT* t, std::shared_ptr<Model> s)
@@ -82,23 +55,29 @@ ModelCallbacks::ModelCallbacks(noo::ObjectT* t, std::shared_ptr<Model> s)
 
 void ModelCallbacks::set_position(glm::vec3 p) {
     qDebug() << Q_FUNC_INFO << p.x << p.y << p.z;
+    metrics::transform_updates_received().add();
     if (auto sp = m_model.lock()) {
         sp->position = p;
         update_transform();
+        sp->touch();
     }
 }
 void ModelCallbacks::set_rotation(glm::quat q) {
     qDebug() << Q_FUNC_INFO << q.x << q.y << q.z << q.w;
+    metrics::transform_updates_received().add();
     if (auto sp = m_model.lock()) {
         sp->rotation = q;
         update_transform();
+        sp->touch();
     }
 }
 void ModelCallbacks::set_scale(glm::vec3 s) {
     qDebug() << Q_FUNC_INFO << s.x << s.y << s.z;
+    metrics::transform_updates_received().add();
     if (auto sp = m_model.lock()) {
         sp->scale = s;
         update_transform();
+        sp->touch();
     }
 }
 
@@ -118,536 +97,1010 @@ glm::mat4 Model::recompute_transform() {
     return ret;
 }
 
+Bounds Model::world_bounds() const {
+    Bounds local { min_bb, max_bb };
+
+    auto root = nodes.constFind(QString());
+    if (root == nodes.constEnd()) return local;
+
+    return local.transformed(root->transform);
+}
+
+void Model::touch() {
+    last_touched = std::chrono::steady_clock::now();
+    if (on_touched) on_touched();
+}
+
 
 // =============================================================================
 
-#define GET_MATKEY(MAT, KEY, TYPE)                                             \
-    ({                                                                         \
-        std::optional<TYPE> ret;                                               \
-        ret.emplace();                                                         \
-        if (AI_SUCCESS != MAT.Get(KEY, *ret)) { ret.reset(); }                 \
-        ret;                                                                   \
-    })
+/// Log and publish the peak RSS since the import of `path` started, and
+/// the heap allocations made since `start` where they are counted. Imports
+/// that overlap each see the figures of all of them.
+static void report_import(QString const& path, AllocationStats const& start) {
+    auto peak = process_peak_rss_bytes();
 
+    metrics::import_peak_rss().set(peak);
 
-struct Importer {
-    aiScene const&         scene;
-    noo::DocumentTPtrRef   doc;
-    noo::ObjectTPtr        root;
-    std::shared_ptr<Model> model_ref;
-    Model&                 thing;
-    ImportOptions          options;
+    qInfo() << "Peak RSS while importing" << path << ":"
+            << peak / (1024 * 1024) << "MiB";
 
-    std::unordered_map<unsigned, noo::MeshTPtr> converted_meshes;
-    QHash<QString, noo::TextureTPtr>            converted_textures;
+    if (!allocations_counted()) return;
 
-    noo::TextureTPtr find_texture_type(aiMaterial const&          m,
-                                       std::vector<aiTextureType> types) {
-        for (auto type : types) {
-            if (m.GetTextureCount(type) < 1) continue;
+    auto made = allocation_stats() - start;
 
-            aiString path;
-            m.GetTexture(type, 0, &path);
+    metrics::import_allocations().set(made.count);
+    metrics::import_allocated_bytes().set(made.bytes);
 
-            qDebug() << "Texture path at" << path.C_Str();
+    qInfo() << "Heap allocations while importing" << path << ":"
+            << (qint64)made.count << "totalling" << (qint64)made.bytes
+            << "bytes";
+}
 
-            return import_texture(QString::fromUtf8(path.C_Str(), path.length));
-        }
+void Playground::add_model(QString path, ImportOptions const& options) {
+    qInfo() << "Loading" << path;
+
+    reset_peak_rss();
+
+    auto allocations = allocation_stats();
+
+    auto result =
+        make_thing(m_id_counter, path, m_doc, m_collective_root, options);
+
+    report_import(path, allocations);
 
-        return {};
+    auto err = std::get_if<QString>(&result);
+
+    if (err) {
+        qWarning() << "Unable to import" << path << " | reason:" << *err;
+        return;
     }
 
-    noo::TextureTPtr import_texture(aiTexture const& tex) {
-        qDebug() << "TEX" << tex.achFormatHint << tex.mWidth << tex.mHeight
-                 << tex.mFilename.C_Str();
+    auto ptr = std::get<std::shared_ptr<Model>>(result);
 
-        if (tex.mHeight == 0) {
-            qDebug() << "Texture is compressed";
+    if (!ptr) {
+        qWarning() << "Unable to import, skipping";
+        return;
+    }
 
-            return import_texture(QByteArray((char*)tex.pcData, tex.mWidth),
-                                  "");
-        }
+    m_id_counter++;
 
-        qCritical() << "Image conversion is not yet supported";
+    insert_model(ptr);
 
-        return nullptr;
+    qInfo() << "Done adding model.";
+}
+
+void Playground::insert_model(ModelPtr ptr) {
+    m_thing_list[ptr->id] = ptr;
+
+    metrics::models_loaded().add();
+
+    ptr->on_touched = [this, id = ptr->id]() { touch_model(id); };
+
+    ptr->on_moved = [this, id = ptr->id]() {
+        auto model = m_thing_list.value(id);
+        if (!model) return;
+        place_model(*model);
+        update_root_tf();
+        slice_later(id);
+    };
+
+    if (m_watch_files and !ptr->source_path.isEmpty()) {
+        m_watcher.addPath(ptr->source_path);
     }
 
-    noo::TextureTPtr import_texture(QString path) {
-        if (converted_textures.contains(path)) return converted_textures[path];
+    place_model(*ptr);
+    slice_later(ptr->id);
+}
+
+void Playground::load_in_background(
+    QString                           path,
+    ImportOptions const&              options,
+    ModelPtr const&                   model,
+    bool                              changed,
+    std::function<void(LoadedScene&)> on_done,
+    std::function<void(QString)>      on_error) {
+    using Result = std::variant<LoadedScene, QString>;
 
-        qDebug() << "Loading texture from path:" << path;
+    auto* watcher = new QFutureWatcher<Result>(this);
 
-        if (path.startsWith("*")) {
-            qDebug() << "Appears to be path to builtin";
-            bool ok;
-            int  index = path.mid(1).toInt(&ok);
-            if (!ok or index >= scene.mNumTextures) {
-                qDebug() << "Apparently not. Bailing.";
-                return {};
-            }
+    bool const preview = !model;
+    auto       reuse   = model ? reusable_components(*model, changed)
+                               : ReusableComponents {};
+
+    auto on_loaded = [watcher,
+                      path,
+                      on_done,
+                      on_error,
+                      allocations = allocation_stats()]() {
+        watcher->deleteLater();
 
-            auto ret                 = import_texture(*scene.mTextures[index]);
-            converted_textures[path] = ret;
-            return ret;
+        auto result = watcher->result();
+
+        if (auto* err = std::get_if<QString>(&result)) {
+            on_error(*err);
+        } else {
+            on_done(std::get<LoadedScene>(result));
+            report_import(path, allocations);
         }
+    };
 
-        qDebug() << "Path is external, loading";
+    connect(watcher, &QFutureWatcherBase::finished, this, on_loaded);
 
-        QMimeDatabase db;
-        auto          type = db.mimeTypeForFile(path);
+    reset_peak_rss();
 
-        if (type.inherits("image/png") or type.inherits("image/jpeg")) {
-            // just use as is
-            QFile file(path);
-            file.open(QFile::ReadOnly);
+    watcher->setFuture(
+        QtConcurrent::run([path, options, changed, preview, reuse]() {
+            auto result = load_scene(path, options, changed);
 
-            auto ret                 = import_texture(file.readAll(), path);
-            converted_textures[path] = ret;
-            return ret;
-        }
+            if (auto* loaded = std::get_if<LoadedScene>(&result)) {
+                // large point clouds go out as a sparse preview first
+                loaded->preview = preview and loaded->has_preview();
+
+                stage_scene(*loaded, reuse);
+            }
+
+            return result;
+        }));
+}
+
+int Playground::load_model(QString path, ImportOptions const& options) {
+    auto id = m_id_counter++;
+
+    qInfo() << "Loading" << path << "as model" << id;
+
+    m_loads_in_flight << id;
+
+    auto on_done = [this, id, path](LoadedScene& loaded) {
+        // unloaded before it even arrived
+        if (!m_loads_in_flight.remove(id)) return;
 
-        QByteArray bytes;
-        {
-            QBuffer      out_stream(&bytes);
-            QImageWriter writer(&out_stream, "png");
-            QImage       img(path);
-            writer.write(img);
+        auto result = create_model(loaded,
+                                   m_doc,
+                                   m_collective_root,
+                                   id,
+                                   m_publisher,
+                                   m_scene_bounds.bounds());
+
+        if (auto* err = std::get_if<QString>(&result)) {
+            qWarning() << "Unable to import" << path << " | reason:" << *err;
+            return;
         }
 
-        auto ret                 = import_texture(bytes, path);
-        converted_textures[path] = ret;
-        return ret;
-    }
-
-    noo::TextureTPtr import_texture(QByteArray const& array, QString name) {
-        qDebug() << "Loading raw texture" << array.size() << "bytes";
-
-        auto new_buffer = noo::create_buffer(
-            doc,
-            noo::BufferData { .name   = "Buffer for" + name,
-                              .source = noo::BufferInlineSource {
-                                  .data = array,
-                              } });
-
-        auto new_buffer_view =
-            noo::create_buffer_view(doc,
-                                    noo::BufferViewData {
-                                        .source_buffer = new_buffer,
-                                        .type   = noo::ViewType::IMAGE_INFO,
-                                        .offset = 0,
-                                        .length = (uint64_t)array.length(),
-                                    });
-
-        auto new_image = noo::create_image(doc,
-                                           noo::ImageData {
-                                               .name   = name,
-                                               .source = new_buffer_view,
-                                           });
-
-        auto tex_data = noo::TextureData { .name = name, .image = new_image };
-
-        if (options.force_samplers_to_nearest) {
-            qDebug() << "Adding sampler hack";
-            noo::SamplerData sampler_data {
-                .mag_filter = noo::MagFilter::NEAREST,
-                .min_filter = noo::MinFilter::NEAREST,
-                .wrap_s     = noo::SamplerMode::CLAMP_TO_EDGE,
-                .wrap_t     = noo::SamplerMode::CLAMP_TO_EDGE,
-            };
+        auto model         = std::get<ModelPtr>(result);
+        model->source_path = QFileInfo(path).absoluteFilePath();
+
+        insert_model(model);
+        update_root_tf();
 
-            tex_data.sampler = noo::create_sampler(doc, sampler_data);
+        if (loaded.preview) {
+            qInfo() << "Published preview of model" << id;
+            refine_model(id, loaded);
+            return;
         }
 
-        auto new_texture = noo::create_texture(doc, tex_data);
+        enforce_memory_budget(id);
+
+        qInfo() << "Done adding model" << id;
+    };
+
+    auto on_error = [this, id, path](QString err) {
+        m_loads_in_flight.remove(id);
+        qWarning() << "Unable to import" << path << " | reason:" << err;
+    };
+
+    load_in_background(path, options, nullptr, false, on_done, on_error);
+
+    return id;
+}
 
-        return new_texture;
+bool Playground::unload_model(int id) {
+    if (m_loads_in_flight.remove(id)) {
+        qInfo() << "Cancelled load of model" << id;
+        return true;
     }
 
-    noo::MaterialTPtr import_material(aiMaterial const& m) {
-        qDebug() << "Adding new material";
+    auto model = m_thing_list.take(id);
 
-        noo::MaterialData mdata;
+    if (!model) return false;
 
-        auto& pbr = mdata.pbr_info.emplace();
+    qInfo() << "Unloading model" << id << model->source_path << "|"
+            << model->nodes.size() << "nodes," << model->meshes.size()
+            << "meshes," << model->materials.size() << "materials,"
+            << model->textures.size() << "textures";
 
-        {
-            auto base_color = GET_MATKEY(m, AI_MATKEY_BASE_COLOR, aiColor4D);
-            if (!base_color) {
-                base_color = GET_MATKEY(m, AI_MATKEY_COLOR_DIFFUSE, aiColor4D);
-            }
-            if (!base_color) { base_color = aiColor4D(1, 1, 1, 1); }
+    m_reload_again.remove(id);
+    m_file_changed.remove(id);
+    m_iso_again.remove(id);
 
-            pbr.base_color = convert_qcol(base_color.value());
-        }
+    if (m_publisher) m_publisher->cancel(id);
 
-        {
-            auto metallic = GET_MATKEY(m, AI_MATKEY_METALLIC_FACTOR, float);
-            if (!metallic) {
-                metallic = GET_MATKEY(m, AI_MATKEY_SPECULAR_FACTOR, float);
-            }
+    m_animator->forget(id);
+
+    metrics::models_unloaded().add();
+
+    bool path_in_use = false;
+    for (auto const& other : qAsConst(m_thing_list)) {
+        path_in_use |= other->source_path == model->source_path;
+    }
+
+    if (!path_in_use and !model->source_path.isEmpty()) {
+        m_watcher.removePath(model->source_path);
+    }
+
+    // Components are reference counted; once the model goes, every object,
+    // mesh, material, texture and the buffers and images behind them that
+    // nothing else uses are deleted from the document.
+    model.reset();
+
+    m_scene_bounds.remove(id);
+    update_root_tf();
+
+    return true;
+}
 
-            pbr.metallic = metallic.value_or(1);
+QList<ModelPtr> Playground::models() const { return m_thing_list.values(); }
+
+ModelPtr Playground::model(int id) const { return m_thing_list.value(id); }
+
+void Playground::on_file_changed(QString path) {
+    // editors tend to write in several steps, so wait for things to settle
+    m_changed_files << path;
+    m_reload_timer.start();
+}
+
+void Playground::reload_changed_files() {
+    auto changed = std::exchange(m_changed_files, {});
+
+    for (auto const& path : changed) {
+        // a save-by-rename drops the path from the watcher
+        if (QFileInfo::exists(path) and !m_watcher.files().contains(path)) {
+            m_watcher.addPath(path);
         }
 
-        {
-            auto roughness = GET_MATKEY(m, AI_MATKEY_ROUGHNESS_FACTOR, float);
-            if (!roughness) {
-                roughness = GET_MATKEY(m, AI_MATKEY_GLOSSINESS_FACTOR, float);
-            }
+        for (auto const& model : qAsConst(m_thing_list)) {
+            if (model->source_path != path) continue;
 
-            pbr.roughness = roughness.value_or(1);
+            m_file_changed << model->id;
+            reload_model(model->id);
         }
+    }
+}
+
+void Playground::reload_model(int id) {
+    auto model = m_thing_list.value(id);
+
+    if (!model) return;
+
+    if (m_reloads_in_flight.contains(id)) {
+        m_reload_again << id;
+        return;
+    }
+
+    m_reloads_in_flight << id;
 
-        mdata.double_sided = GET_MATKEY(m, AI_MATKEY_TWOSIDED, bool);
+    bool const changed = m_file_changed.remove(id);
 
-        if (options.double_sided) { mdata.double_sided = true; }
+    qInfo() << "Reloading" << model->source_path;
 
-        {
-            auto base = find_texture_type(
-                m, { aiTextureType_BASE_COLOR, aiTextureType_DIFFUSE });
+    auto finished = [this, id]() {
+        m_reloads_in_flight.remove(id);
+        if (m_reload_again.remove(id)) reload_model(id);
+    };
 
-            if (base) {
-                mdata.pbr_info->base_color_texture.emplace(noo::TextureRef {
-                    .source             = base,
-                    .transform          = glm::mat3(1),
-                    .texture_coord_slot = 0,
-                });
+    // An update that does not land leaves the model over what the file
+    // held, so the change still counts for the next load
+    auto on_done = [this, id, changed, finished](LoadedScene& loaded) {
+        if (auto model = m_thing_list.value(id)) {
+            if (apply_update(model, loaded)) {
+                qInfo() << "Reloaded" << model->source_path;
+            } else {
+                m_reload_again << id;
+                if (changed) m_file_changed << id;
             }
         }
 
-        return noo::create_material(doc, mdata);
+        finished();
+    };
+
+    auto on_error = [this, id, changed, finished](QString err) {
+        qWarning() << "Unable to reload | reason:" << err;
+        if (changed and m_thing_list.contains(id)) m_file_changed << id;
+        finished();
+    };
+
+    load_in_background(model->source_path,
+                       model->options,
+                       model,
+                       changed,
+                       on_done,
+                       on_error);
+}
+
+bool Playground::apply_update(ModelPtr const&    model,
+                              LoadedScene const& loaded) {
+    if (is_stale(loaded, *model)) {
+        qInfo() << "Model" << model->id << "changed while staging an update";
+        return false;
+    }
+
+    auto err = update_model(loaded,
+                            m_doc,
+                            m_collective_root,
+                            model,
+                            m_publisher,
+                            m_scene_bounds.bounds());
+
+    if (err) {
+        qWarning() << "Unable to update model" << model->id
+                   << "| reason:" << *err;
+        return true;
+    }
+
+    place_model(*model);
+    update_root_tf();
+    enforce_memory_budget(model->id);
+    slice_later(model->id);
+
+    return true;
+}
+
+void Playground::refine_model(int id, LoadedScene const& preview) {
+    // Counts as a reload, so the model is neither evicted nor reloaded
+    // underneath us. Waiting a turn of the event loop lets the preview
+    // messages go out before the full level is converted.
+    m_reloads_in_flight << id;
+
+    auto loaded    = preview;
+    loaded.preview = false;
+    loaded.staged.reset();
+
+    QTimer::singleShot(
+        0, this, [this, id, loaded]() { finish_refine(id, loaded); });
+}
+
+void Playground::finish_refine(int id, LoadedScene const& loaded) {
+    // the preview has to be out before the full level replaces it, and
+    // before staging, so that what it shares with the full level is reused
+    if (m_publisher and m_publisher->pending(id)) {
+        QTimer::singleShot(
+            10, this, [this, id, loaded]() { finish_refine(id, loaded); });
+        return;
     }
 
+    auto model = m_thing_list.value(id);
 
-    noo::MeshTPtr import_mesh(aiMesh const& mesh) {
-        qDebug() << "Adding new mesh from scene...";
+    if (!model) {
+        m_reloads_in_flight.remove(id);
+        return;
+    }
 
-        qDebug() << "Num Verts" << mesh.mNumVertices;
+    auto* watcher = new QFutureWatcher<LoadedScene>(this);
 
-        static_assert(sizeof(glm::vec3) == sizeof(aiVector3D));
+    auto on_staged = [this, watcher, id]() {
+        watcher->deleteLater();
 
-        qDebug() << "Adding positions";
+        auto full = watcher->result();
 
-        noo::MeshSource source;
-        source.positions = convert_vec3(mesh.mVertices, mesh.mNumVertices);
+        m_reloads_in_flight.remove(id);
 
-        for (auto const& v : source.positions) {
-            thing.min_bb = glm::min(thing.min_bb, v);
-            thing.max_bb = glm::max(thing.max_bb, v);
+        if (auto model = m_thing_list.value(id)) {
+            if (apply_update(model, full)) {
+                qInfo() << "Done adding model" << id;
+            } else {
+                m_reload_again << id;
+            }
         }
 
-        qDebug() << "Model BB Min" << thing.min_bb.x << thing.min_bb.y
-                 << thing.min_bb.z;
-        qDebug() << "Model BB Max" << thing.max_bb.x << thing.max_bb.y
-                 << thing.max_bb.z;
+        if (m_reload_again.remove(id)) reload_model(id);
+    };
+
+    connect(watcher, &QFutureWatcherBase::finished, this, on_staged);
+
+    watcher->setFuture(
+        QtConcurrent::run([loaded, reuse = reusable_components(*model)]() {
+            auto full = loaded;
+            stage_scene(full, reuse);
+            return full;
+        }));
+}
+
+bool Playground::set_iso_value(int id, float value) {
+    auto model = m_thing_list.value(id);
+
+    if (!model) return false;
+
+    // an evicted volume is read again, and comes back at the new value
+    if (!model->resident and QFileInfo(model->source_path).suffix() == "xmf") {
+        model->options.iso_value = value;
+        touch_model(id);
+        return true;
+    }
 
-        if (mesh.mNormals) {
-            qDebug() << "Adding normals";
-            source.normals = convert_vec3(mesh.mNormals, mesh.mNumVertices);
+    if (!model->volume) return false;
+
+    model->options.iso_value = value;
+
+    // dragging a slider sends values faster than surfaces come out; only
+    // the latest is extracted next
+    if (m_isos_in_flight.contains(id)) {
+        m_iso_again << id;
+        return true;
+    }
+
+    extract_isosurface(id);
+
+    return true;
+}
+
+void Playground::extract_isosurface(int id) {
+    auto model = m_thing_list.value(id);
+
+    if (!model or !model->volume) return;
+
+    qInfo() << "Extracting isosurface of model" << id << "at"
+            << model->options.iso_value.value_or(model->volume->middle());
+
+    m_isos_in_flight << id;
+
+    using Result = std::variant<LoadedScene, QString>;
+
+    auto* watcher = new QFutureWatcher<Result>(this);
+
+    auto on_extracted = [this, watcher, id, volume = model->volume]() {
+        watcher->deleteLater();
+
+        m_isos_in_flight.remove(id);
+
+        auto result = watcher->result();
+        auto model  = m_thing_list.value(id);
+
+        // evicted or reloaded meanwhile; the surface is of a stale volume
+        if (!model or model->volume != volume) {
+            m_iso_again.remove(id);
+            return;
         }
 
-        if (mesh.mTangents) {
-            qDebug() << "Adding tangents";
-            source.normals = convert_vec3(mesh.mTangents, mesh.mNumVertices);
+        if (auto* err = std::get_if<QString>(&result)) {
+            qWarning() << "Unable to extract isosurface of model" << id
+                       << "| reason:" << *err;
+        } else {
+            // keep the latest value asked for, not the one extracted
+            auto& loaded   = std::get<LoadedScene>(result);
+            loaded.options = model->options;
+
+            if (!apply_update(model, loaded)) m_iso_again << id;
         }
 
-        std::vector<glm::u8vec4> converted_colors;
+        if (m_iso_again.remove(id)) extract_isosurface(id);
+    };
 
-        if (mesh.mColors[0]) {
-            qDebug() << "Adding colors[0]";
-            auto channel = mesh.mColors[0];
+    connect(watcher, &QFutureWatcherBase::finished, this, on_extracted);
 
-            converted_colors.reserve(mesh.mNumVertices);
+    watcher->setFuture(QtConcurrent::run(
+        [volume = model->volume,
+         options = model->options,
+         reuse = reusable_components(*model)]() {
+            auto result = load_isosurface(volume, options);
 
-            for (size_t i = 0; i < mesh.mNumVertices; i++) {
-                converted_colors.push_back(convert_col(channel[i]));
+            if (auto* loaded = std::get_if<LoadedScene>(&result)) {
+                stage_scene(*loaded, reuse);
             }
 
-            source.colors = converted_colors;
-        }
+            return result;
+        }));
+}
 
-        std::vector<glm::u16vec2> converted_textures;
+bool Playground::set_model_visible(int id, bool visible) {
+    auto model = m_thing_list.value(id);
 
-        if (mesh.HasTextureCoords(0)) {
-            qDebug() << "Adding uv[0]";
-            auto channel = mesh.mTextureCoords[0];
+    if (!model) return false;
 
-            converted_textures.reserve(mesh.mNumVertices);
+    model->visible = visible;
 
-            for (size_t i = 0; i < mesh.mNumVertices; i++) {
-                converted_textures.push_back(convert_tex(channel[i]));
-            }
+    if (visible) {
+        model->touch();
+    } else {
+        enforce_memory_budget(-1);
+    }
 
-            source.textures = converted_textures;
-        }
+    return true;
+}
 
-        std::vector<uint32_t> indicies;
+qint64 Playground::resident_bytes() const {
+    qint64 ret = 0;
+    for (auto const& model : qAsConst(m_thing_list)) {
+        if (model->resident) ret += model->memory.total();
+    }
+    return ret;
+}
 
-        if (mesh.mPrimitiveTypes & aiPrimitiveType::aiPrimitiveType_LINE) {
-            qDebug() << "Adding LINE" << mesh.mNumFaces;
-            for (size_t i = 0; i < mesh.mNumFaces; i++) {
-                auto const& face = mesh.mFaces[i];
-                assert(face.mNumIndices >= 2);
-                indicies.emplace_back(face.mIndices[0]);
-                indicies.emplace_back(face.mIndices[1]);
-            }
-            source.type = noo::MeshSource::LINE;
-
-        } else if (mesh.mPrimitiveTypes &
-                   aiPrimitiveType::aiPrimitiveType_TRIANGLE) {
-            qDebug() << "Adding TRIANGLES" << mesh.mNumFaces;
-
-            for (size_t i = 0; i < mesh.mNumFaces; i++) {
-                auto const& face = mesh.mFaces[i];
-                assert(face.mNumIndices >= 3);
-                indicies.emplace_back(face.mIndices[0]);
-                indicies.emplace_back(face.mIndices[1]);
-                indicies.emplace_back(face.mIndices[2]);
-            }
-            source.type = noo::MeshSource::TRIANGLE;
+bool Playground::play_animation(int id, int clip) {
+    return m_animator->play(m_thing_list.value(id), clip);
+}
+
+bool Playground::pause_animation(int id) { return m_animator->pause(id); }
+
+bool Playground::seek_animation(int id, double seconds) {
+    return m_animator->seek(m_thing_list.value(id), seconds);
+}
+
+int Playground::create_instance_set(int model_id, size_t count) {
+    auto model = m_thing_list.value(model_id);
+
+    if (!model or !model->resident) return -1;
+
+    model->tree.update();
+
+    // every place a mesh is shown, so assemblies keep their layout
+    std::vector<InstanceSet::Part> parts;
+
+    size_t skewed = 0;
+
+    for (auto const& [node, key] : model->mesh_nodes) {
+        auto mesh = model->meshes.value(key);
+
+        // still in the publish queue
+        if (!mesh) continue;
+
+        auto placement = InstanceSet::Placement::of(model->tree.world(node));
+
+        if (!placement) {
+            skewed++;
+            continue;
         }
 
-        source.index_format = noo::Format::U32;
+        parts.push_back({
+            .mesh      = mesh,
+            .placement = *placement,
+            .backing   = model->component_sources.value(key),
+        });
+    }
+
+    if (skewed) {
+        qWarning() << "Instance set of model" << model_id << "leaves out"
+                   << (qint64)skewed
+                   << "parts with shear or non-uniform scale";
+    }
+
+    if (parts.empty()) return -1;
 
-        source.indices = std::as_writable_bytes(std::span(indicies));
+    int id = m_instance_set_counter++;
 
-        auto const& material = *scene.mMaterials[mesh.mMaterialIndex];
+    auto set = std::make_shared<InstanceSet>(
+        id, m_doc, m_collective_root, std::move(parts), count);
 
-        source.material = import_material(material);
+    qInfo() << "Created instance set" << id << "of model" << model_id << "|"
+            << (qint64)count << "instances";
 
-        return noo::create_mesh(doc, source);
+    m_instance_sets[id] = std::move(set);
+
+    flush_instances_later();
+
+    return id;
+}
+
+std::shared_ptr<InstanceSet> Playground::instance_set(int id) const {
+    return m_instance_sets.value(id);
+}
+
+bool Playground::delete_instance_set(int id) {
+    // the objects and buffers of the set go with it
+    return m_instance_sets.remove(id) > 0;
+}
+
+void Playground::flush_instances_later() {
+    if (m_instance_flush_queued) return;
+
+    m_instance_flush_queued = true;
+
+    QTimer::singleShot(0, this, &Playground::flush_instances);
+}
+
+void Playground::flush_instances() {
+    m_instance_flush_queued = false;
+
+    for (auto const& set : qAsConst(m_instance_sets)) {
+        set->flush();
     }
+}
 
+int Playground::create_point_plot(size_t capacity) {
+    if (!m_point_glyph) m_point_glyph = make_point_glyph(m_doc);
 
-    void process_import_tree(aiNode const& node, noo::ObjectTPtr parent) {
-        qDebug() << "Handling new node...";
+    int id = m_point_plot_counter++;
 
-        noo::ObjectData new_obj_data;
+    m_point_plots[id] = std::make_shared<PointPlot>(
+        id, m_doc, m_collective_root, m_point_glyph, capacity);
 
-        if (node.mName.length) new_obj_data.name = node.mName.C_Str();
+    qInfo() << "Created point plot" << id << "| capacity" << (qint64)capacity;
 
-        if (parent) new_obj_data.parent = parent;
+    return id;
+}
 
-        glm::mat4& transform = new_obj_data.transform.emplace();
+std::shared_ptr<PointPlot> Playground::point_plot(int id) const {
+    return m_point_plots.value(id);
+}
 
-        for (int i = 0; i < (4 * 4); i++) {
-            // from Row major to column major
-            glm::value_ptr(transform)[i] = (node.mTransformation[0])[i];
-        }
+bool Playground::delete_point_plot(int id) {
+    return m_point_plots.remove(id) > 0;
+}
 
-        qDebug() << "Transformation:" << transform;
+void Playground::flush_point_plots_later() {
+    if (m_plot_flush_queued) return;
 
-        // if this is the first object, we add some callbacks.
-        if (!thing.object) {
-            new_obj_data.create_callbacks = [=](noo::ObjectT* t) {
-                return std::make_unique<ModelCallbacks>(t, model_ref);
-            };
-        }
+    m_plot_flush_queued = true;
+
+    QTimer::singleShot(0, this, &Playground::flush_point_plots);
+}
 
-        auto this_node = noo::create_object(doc, new_obj_data);
+void Playground::flush_point_plots() {
+    m_plot_flush_queued = false;
 
-        if (thing.object) {
-            thing.other_objects.push_back(this_node);
-        } else {
-            thing.object = this_node;
-        }
+    for (auto const& plot : qAsConst(m_point_plots)) {
+        if (plot->dirty()) plot->flush();
+    }
+}
+
+/// Show new geometry as a part of `parent`, replacing the mesh of `object`
+/// if there is one. Without geometry the object goes.
+static void show_section(noo::DocumentTPtrRef       doc,
+                         noo::ObjectTPtr&           object,
+                         noo::ObjectTPtr const&     parent,
+                         QString                    name,
+                         noo::MaterialTPtr const&   material,
+                         std::span<glm::vec3 const> positions,
+                         std::vector<uint32_t>&     indices,
+                         bool                       lines) {
+    if (indices.empty()) {
+        object.reset();
+        return;
+    }
 
+    noo::MeshSource source;
+    source.material     = material;
+    source.positions    = positions;
+    source.indices      = std::as_writable_bytes(std::span(indices));
+    source.index_format = noo::Format::U32;
+    source.type = lines ? noo::MeshSource::LINE : noo::MeshSource::TRIANGLE;
 
-        if (node.mNumMeshes) {
-            qDebug() << "Adding sub-meshes:" << node.mNumMeshes;
+    auto mesh = noo::create_mesh(doc, source);
 
-            // create bits. we could pack this into patches...
-            // but for now, just create multiple objects
+    metrics::buffer_bytes_created(metrics::BufferType::Section)
+        .add(positions.size_bytes() + indices.size() * sizeof(uint32_t));
 
-            for (unsigned mi = 0; mi < node.mNumMeshes; mi++) {
-                noo::ObjectData sub_obj_data;
+    if (object) {
+        noo::ObjectUpdateData update {
+            .definition = noo::ObjectRenderableDefinition { .mesh = mesh },
+        };
 
-                auto src_mesh_id = node.mMeshes[mi];
+        noo::update_object(object, update);
+        return;
+    }
 
-                auto iter = converted_meshes.find(src_mesh_id);
+    noo::ObjectData data;
+    data.name       = name;
+    data.parent     = parent;
+    data.definition = noo::ObjectRenderableDefinition { .mesh = mesh };
+    data.tags       = QStringList() << noo::names::tag_user_hidden;
 
-                if (iter == converted_meshes.end()) {
+    object = noo::create_object(doc, data);
+}
 
-                    auto new_mesh = import_mesh(*scene.mMeshes[src_mesh_id]);
+namespace {
 
-                    bool ok;
-                    std::tie(iter, ok) =
-                        converted_meshes.try_emplace(src_mesh_id, new_mesh);
-                }
+/// What a model is cut from, taken on the main thread so that the cut can
+/// run on a worker: every mesh where a node shows it, and the planes
+struct SliceJob {
+    std::vector<std::pair<std::shared_ptr<MeshBVH const>, glm::mat4>> parts;
 
-                sub_obj_data.definition =
-                    noo::ObjectRenderableDefinition { .mesh = iter->second };
+    glm::mat4          to_scene;
+    std::vector<Plane> planes;
+    bool               caps = false;
+};
 
-                sub_obj_data.parent = this_node;
+/// A cut, as the lines and caps to show
+struct SliceResult {
+    std::vector<glm::vec3> points;
+    std::vector<uint32_t>  pairs;
+    std::vector<glm::vec3> cap_positions;
+    std::vector<uint32_t>  cap_indices;
+
+    size_t segments      = 0;
+    size_t lines         = 0;
+    size_t closed        = 0;
+    size_t cap_triangles = 0;
+    double milliseconds  = 0;
+};
 
-                sub_obj_data.tags = QStringList()
-                                    << noo::names::tag_user_hidden;
+SliceResult cut(SliceJob const& job) {
+    auto const start = std::chrono::steady_clock::now();
 
-                auto sub_obj = noo::create_object(doc, sub_obj_data);
+    auto const instances = job.parts.size();
 
-                thing.other_objects.push_back(sub_obj);
-            }
+    std::vector<Section> parts(job.planes.size() * instances);
+
+    // each mesh is cut in mesh space, then moved into root object space
+    ThreadPool::global().parallel_for(parts.size(), [&](size_t i) {
+        auto const& [bvh, world] = job.parts[i % instances];
+
+        auto plane =
+            job.planes[i / instances].pulled_back(job.to_scene * world);
+
+        parts[i] = bvh->slice(plane, world, job.caps);
+    });
+
+    Section section;
+
+    for (auto& part : parts) {
+        section.append(std::move(part));
+    }
+
+    SliceResult ret;
+
+    ret.points.reserve(section.point_count());
+
+    for (auto const& line : section.lines) {
+        auto const first = (uint32_t)ret.points.size();
+        auto const count = (uint32_t)line.points.size();
+
+        ret.points.insert(
+            ret.points.end(), line.points.begin(), line.points.end());
+
+        for (uint32_t i = 0; i + 1 < count; i++) {
+            ret.pairs.insert(ret.pairs.end(), { first + i, first + i + 1 });
         }
 
-        for (unsigned ci = 0; ci < node.mNumChildren; ci++) {
-            process_import_tree(*node.mChildren[ci], this_node);
+        if (line.closed and count > 2) {
+            ret.pairs.insert(ret.pairs.end(), { first + count - 1, first });
         }
     }
-};
 
+    ret.segments      = section.segment_count;
+    ret.lines         = section.lines.size();
+    ret.closed        = section.closed_count();
+    ret.cap_triangles = section.cap_indices.size() / 3;
 
-std::variant<ModelPtr, QString> import_ai_scene(aiScene const&       scene,
-                                                noo::DocumentTPtrRef doc,
-                                                noo::ObjectTPtr collective_root,
-                                                int             id,
-                                                ImportOptions const& options) {
-    auto new_model = std::make_shared<Model>();
-    new_model->id  = id;
-
-    Importer imp {
-        .scene     = scene,
-        .doc       = doc,
-        .root      = collective_root,
-        .model_ref = new_model,
-        .thing     = *new_model,
-        .options   = options,
-    };
+    ret.cap_positions = std::move(section.cap_positions);
+    ret.cap_indices   = std::move(section.cap_indices);
 
-    imp.process_import_tree(*(scene.mRootNode), collective_root);
+    ret.milliseconds = std::chrono::duration<double, std::milli>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
 
-    return new_model;
+    return ret;
 }
 
-bool needs_gltf_sampler_hack(QString path) {
-    auto check_json = [](QByteArray array) {
-        auto doc = QJsonDocument::fromJson(array).object();
+} // namespace
 
-        auto samplers = doc["samplers"].toArray();
+void Playground::slice_model(int id) {
+    auto model = m_thing_list.value(id);
 
-        for (auto const& sampler : samplers) {
-            auto so = sampler.toObject();
-            // check for nearest in any filter slot
-            if (so["magFilter"].toInt() == 9728) return true;
-            if (so["minFilter"].toInt() == 9728) return true;
-        }
+    if (!model) return;
 
-        return false;
+    if (m_section_planes.empty() or !model->resident or
+        model->bvhs.isEmpty()) {
+        model->section_lines.reset();
+        model->section_caps.reset();
+        return;
+    }
+
+    if (m_slices_in_flight.contains(id)) {
+        m_slice_again << id;
+        return;
+    }
+
+    model->tree.update();
+
+    SliceJob job {
+        // from the space of the root object to the one of the planes
+        .to_scene = m_root_tf * model->nodes.value(QString()).transform,
+        .planes   = m_section_planes,
+        .caps     = m_section_caps,
     };
 
-    qDebug() << Q_FUNC_INFO << path;
-    // THIS IS HORRIBLE AND ONLY HERE TO FIX THE FACT THAT ASSIMP HAS NO SAMPLER
-    // CONCEPT.
+    for (auto const& [node, key] : model->mesh_nodes) {
+        if (auto bvh = model->bvhs.value(key)) {
+            job.parts.emplace_back(std::move(bvh), model->tree.world(node));
+        }
+    }
 
-    if (!path.endsWith(".glb") and !path.endsWith(".gltf")) return false;
+    m_slices_in_flight << id;
 
-    // hacks for GLTF
-    QFile file(path);
-    if (!file.open(QFile::ReadOnly)) return false;
+    auto* watcher = new QFutureWatcher<SliceResult>(this);
 
-    std::array<uint32_t, 5> header_first_chunk;
-    file.read((char*)header_first_chunk.data(), sizeof(header_first_chunk));
+    auto on_cut = [this, watcher, id, generation = m_section_generation]() {
+        watcher->deleteLater();
 
-    // check if its really a binary gltf
-    if (header_first_chunk[0] != 0x46546C67) {
-        // assume just json
+        m_slices_in_flight.remove(id);
 
-        file.seek(0);
+        auto model = m_thing_list.value(id);
 
-        return check_json(file.readAll());
-    }
+        // removed, evicted or cut by other planes meanwhile
+        if (!model or !model->resident or
+            generation != m_section_generation) {
+            if (m_slice_again.remove(id)) slice_model(id);
+            return;
+        }
 
+        auto result = watcher->result();
 
-    // first chunk has to be json
+        if (!m_section_material) {
+            noo::MaterialData mat_data;
+            mat_data.pbr_info.emplace().base_color = QColor(255, 128, 0);
+            mat_data.double_sided                  = true;
 
-    auto chunk_len  = header_first_chunk[3];
-    auto chunk_type = header_first_chunk[4];
+            m_section_material = noo::create_material(m_doc, mat_data);
+        }
 
-    if (chunk_type != 0x4E4F534A) return false;
+        show_section(m_doc,
+                     model->section_lines,
+                     model->object,
+                     "Section",
+                     m_section_material,
+                     result.points,
+                     result.pairs,
+                     true);
+
+        show_section(m_doc,
+                     model->section_caps,
+                     model->object,
+                     "Section Caps",
+                     m_section_material,
+                     result.cap_positions,
+                     result.cap_indices,
+                     false);
+
+        qDebug() << "Sliced model" << id << "|" << (qint64)result.segments
+                 << "segments," << (qint64)result.lines << "lines,"
+                 << (qint64)result.closed << "closed,"
+                 << (qint64)result.cap_triangles << "cap triangles in"
+                 << result.milliseconds << "ms";
+
+        if (m_slice_again.remove(id)) slice_model(id);
+    };
 
-    auto json_payload = file.read(chunk_len);
+    connect(watcher, &QFutureWatcherBase::finished, this, on_cut);
 
-    return check_json(json_payload);
+    watcher->setFuture(QtConcurrent::run(
+        [job = std::move(job)]() { return cut(job); }));
 }
 
+void Playground::slice_later(int id) {
+    if (m_section_planes.empty()) return;
 
-std::variant<ModelPtr, QString> make_thing(int                  id,
-                                           QString              path,
-                                           noo::DocumentTPtrRef doc,
-                                           noo::ObjectTPtr      collective_root,
-                                           ImportOptions        options) {
-
-    QFileInfo info(path);
+    m_sections_dirty << id;
 
-    if (!info.exists(path)) return "File does not exist.";
+    if (m_section_flush_queued) return;
 
-    Assimp::Importer importer;
+    m_section_flush_queued = true;
 
-    importer.RegisterLoader(new XDMFAssimpImporter);
+    QTimer::singleShot(0, this, &Playground::flush_sections);
+}
 
-    auto path_str = path.toStdString();
+void Playground::flush_sections() {
+    m_section_flush_queued = false;
 
-    auto* scene = importer.ReadFile(
-        path_str,
-        // aiProcess_CalcTangentSpace |
-        aiProcess_Triangulate | aiProcess_GenNormals |
-            aiProcess_FixInfacingNormals | aiProcess_JoinIdenticalVertices |
-            aiProcess_SortByPType);
+    auto dirty = std::exchange(m_sections_dirty, {});
 
-    if (!scene) {
-        return QString("Unable to import file: ") + importer.GetErrorString();
+    for (auto id : dirty) {
+        slice_model(id);
     }
+}
+
+std::vector<int> Playground::set_section(std::vector<Plane> planes,
+                                         bool               caps) {
+    m_section_planes = std::move(planes);
+    m_section_caps   = caps;
+    m_section_generation++;
+    m_sections_dirty.clear();
 
-    options.force_samplers_to_nearest = needs_gltf_sampler_hack(path);
+    auto ids = m_thing_list.keys();
 
-    if (options.force_samplers_to_nearest) {
-        qDebug() << "Enabling sampler hack";
+    std::sort(ids.begin(), ids.end());
+
+    for (auto id : ids) {
+        slice_model(id);
     }
 
+    return { ids.begin(), ids.end() };
+}
+
+void Playground::touch_model(int id) {
+    auto model = m_thing_list.value(id);
 
-    return import_ai_scene(*scene, doc, collective_root, id, options);
+    if (!model or model->resident) return;
+
+    // bring the geometry back; the budget is enforced once it arrives
+    qInfo() << "Restoring evicted model" << id;
+    reload_model(id);
 }
 
-// =============================================================================
+void Playground::enforce_memory_budget(int keep_id) {
+    if (m_memory_budget <= 0) return;
 
-void Playground::add_model(QString path, ImportOptions const& options) {
-    qInfo() << "Loading" << path;
-    auto result =
-        make_thing(m_id_counter, path, m_doc, m_collective_root, options);
+    auto used = resident_bytes();
 
-    auto err = std::get_if<QString>(&result);
+    while (used > m_memory_budget) {
+        // hidden models go first, then the least recently touched
+        ModelPtr victim;
 
-    if (err) {
-        qWarning() << "Unable to import" << path << " | reason:" << *err;
-        return;
-    }
+        for (auto const& model : qAsConst(m_thing_list)) {
+            if (!model->resident or model->id == keep_id) continue;
+            if (model->source_path.isEmpty()) continue;
+            if (m_reloads_in_flight.contains(model->id)) continue;
 
-    auto ptr = std::get<std::shared_ptr<Model>>(result);
+            if (!victim) {
+                victim = model;
+                continue;
+            }
 
-    if (!ptr) {
-        qWarning() << "Unable to import, skipping";
-        return;
+            auto key = [](Model const& m) {
+                return std::pair(m.visible, m.last_touched);
+            };
+
+            if (key(*model) < key(*victim)) victim = model;
+        }
+
+        if (!victim) break;
+
+        used -= victim->memory.total();
+
+        evict_model(*victim);
     }
 
-    m_thing_list[m_id_counter] = ptr;
+    qDebug() << "Resident model bytes" << used << "of" << m_memory_budget;
+}
+
+void Playground::evict_model(Model& model) {
+    qInfo() << "Evicting model" << model.id << "to stay in budget, freeing"
+            << model.memory.total() << "bytes";
 
-    m_id_counter++;
+    if (m_publisher) m_publisher->cancel(model.id);
 
-    qInfo() << "Done adding model.";
+    auto root = model.nodes.take(QString());
+
+    model.nodes.clear();
+    model.meshes.clear();
+    model.materials.clear();
+    model.textures.clear();
+    model.component_bytes.clear();
+    model.component_chunks.clear();
+    model.component_sources.clear();
+    model.volume.reset();
+    model.bvhs.clear();
+    model.mesh_nodes.clear();
+    model.section_lines.reset();
+    model.section_caps.reset();
+
+    // a cheap stand in so users can still see and grab it
+    root.parts.clear();
+    root.queued_parts = 0;
+    root.parts.push_back(
+        make_bounds_proxy(m_doc, root.object, model.min_bb, model.max_bb));
+    root.mesh_key = "proxy";
+
+    model.nodes[QString()] = root;
+
+    model.memory   = ModelMemory {};
+    model.resident = false;
+
+    metrics::models_evicted().add();
+}
+
+void Playground::place_model(Model const& model) {
+    m_scene_bounds.set(model.id, model.world_bounds());
 }
 
 void Playground::update_root_tf() {
     // lets set up a simple scale
 
-    glm::vec3 total_min_bb = glm::vec3(std::numeric_limits<float>::max());
-    glm::vec3 total_max_bb = glm::vec3(std::numeric_limits<float>::lowest());
+    auto const scene = m_scene_bounds.bounds();
 
-    for (auto const& v : qAsConst(m_thing_list)) {
-        total_min_bb = glm::min(v->min_bb, total_min_bb);
-        total_max_bb = glm::max(v->max_bb, total_max_bb);
-    }
+    if (scene.empty()) return;
 
-    if (glm::any(glm::greaterThan(total_min_bb, total_max_bb))) { return; }
+    auto const& total_min_bb = scene.min;
+    auto const& total_max_bb = scene.max;
 
     qDebug() << "Total BB Min" << total_min_bb.x << total_min_bb.y
              << total_min_bb.z;
@@ -668,11 +1121,125 @@ void Playground::update_root_tf() {
     tf = glm::scale(tf, glm::vec3(1.0f / max_comp));
     tf = glm::translate(tf, -center);
 
+    if (tf == m_root_tf) return;
+
+    m_root_tf = tf;
+
     noo::ObjectUpdateData ob {
         .transform = tf,
     };
 
     noo::update_object(m_collective_root, ob);
+    metrics::transform_updates_sent().add();
+
+    // the planes stay put while every model moves under them
+    for (auto const& model : qAsConst(m_thing_list)) {
+        slice_later(model->id);
+    }
+}
+
+std::vector<MetricSample> Playground::collect_metrics() const {
+    std::vector<MetricSample> ret;
+
+    auto models = m_thing_list.values();
+
+    std::sort(models.begin(), models.end(), [](auto const& a, auto const& b) {
+        return a->id < b->id;
+    });
+
+    auto model_label = [](Model const& m) {
+        auto path = m.source_path;
+        path.replace('\\', "\\\\").replace('"', "\\\"");
+        return QString("model=\"%1\",path=\"%2\"").arg(m.id).arg(path);
+    };
+
+    // samples of one name have to be adjacent
+    for (auto const& m : models) {
+        ret.push_back({ "playground_model_vertices",
+                        "Vertices in the distinct meshes of a model",
+                        model_label(*m),
+                        (double)m->vertex_count });
+    }
+
+    for (auto const& m : models) {
+        ret.push_back({ "playground_model_triangles",
+                        "Triangles in the distinct meshes of a model",
+                        model_label(*m),
+                        (double)m->triangle_count });
+    }
+
+    ModelMemory total;
+    for (auto const& m : models) {
+        if (!m->resident) continue;
+        total.buffer_bytes += m->memory.buffer_bytes;
+        total.texture_bytes += m->memory.texture_bytes;
+        total.cpu_bytes += m->memory.cpu_bytes;
+    }
+
+    auto const bytes_help = "Bytes held by resident models, by kind";
+
+    ret.push_back({ "playground_resident_bytes",
+                    bytes_help,
+                    "type=\"buffer\"",
+                    (double)total.buffer_bytes });
+    ret.push_back({ "playground_resident_bytes",
+                    bytes_help,
+                    "type=\"texture\"",
+                    (double)total.texture_bytes });
+    ret.push_back({ "playground_resident_bytes",
+                    bytes_help,
+                    "type=\"cpu\"",
+                    (double)total.cpu_bytes });
+
+    ret.push_back({ "playground_models",
+                    "Models in the document",
+                    {},
+                    (double)models.size() });
+
+    {
+        qint64 instances = 0;
+        qint64 bytes     = 0;
+
+        for (auto const& set : m_instance_sets) {
+            instances += set->size();
+            bytes += set->byte_size();
+        }
+
+        ret.push_back({ "playground_instances",
+                        "Instances across all instance sets",
+                        {},
+                        (double)instances });
+        ret.push_back({ "playground_instance_bytes",
+                        "Bytes held by instance sets",
+                        {},
+                        (double)bytes });
+    }
+
+    {
+        qint64 points = 0;
+        qint64 bytes  = 0;
+
+        for (auto const& plot : m_point_plots) {
+            points += plot->size();
+            bytes += plot->byte_size();
+        }
+
+        ret.push_back({ "playground_plot_points",
+                        "Points across all point plots",
+                        {},
+                        (double)points });
+        ret.push_back({ "playground_plot_bytes",
+                        "Bytes held by point plots",
+                        {},
+                        (double)bytes });
+    }
+
+    ret.push_back({ "process_resident_memory_bytes",
+                    "Resident set size of the server process",
+                    {},
+                    (double)process_rss_bytes() });
+
+    return ret;
 }
 
 Playground::Playground() {
@@ -690,6 +1257,150 @@ Playground::Playground() {
 
     parser.addOption(double_sided);
 
+    auto no_native_gltf = QCommandLineOption(
+        "no-native-gltf", "Load glTF files through Assimp instead");
+
+    parser.addOption(no_native_gltf);
+
+    auto no_native_bulk = QCommandLineOption(
+        "no-native-bulk", "Load STL, OBJ and PLY files through Assimp instead");
+
+    parser.addOption(no_native_bulk);
+
+    auto no_mapped_io = QCommandLineOption(
+        "no-mapped-io", "Read files with buffered I/O instead of mapping them");
+
+    parser.addOption(no_mapped_io);
+
+    auto no_async_io = QCommandLineOption(
+        "no-async-io",
+        "Map the data items of XDMF files instead of reading them ahead in "
+        "batches");
+
+    parser.addOption(no_async_io);
+
+    auto xdmf_partitions = QCommandLineOption(
+        "xdmf-partitions",
+        "Keep the grids of XDMF spatial collections as separate meshes "
+        "instead of welding them together");
+
+    parser.addOption(xdmf_partitions);
+
+    auto iso_value = QCommandLineOption(
+        "iso-value",
+        "Show XDMF volumes with a scalar field as the isosurface at this "
+        "value instead of at the middle of the field range",
+        "value");
+
+    parser.addOption(iso_value);
+
+    auto low_memory = QCommandLineOption(
+        "low-memory",
+        "Convert meshes a few at a time and free source data as soon as it "
+        "is converted, for a lower peak at some cost in speed");
+
+    parser.addOption(low_memory);
+
+    auto no_native_weld = QCommandLineOption(
+        "no-native-weld",
+        "Join identical vertices with Assimp instead of the parallel weld");
+
+    auto weld_tolerance = QCommandLineOption(
+        "weld-tolerance",
+        "Merge vertices that share a grid cell this wide and agree on every "
+        "other attribute (0 for identical ones only)",
+        "distance",
+        "0");
+
+    auto no_native_normals = QCommandLineOption(
+        "no-native-normals",
+        "Generate missing normals with Assimp, faceted, instead of the "
+        "parallel smooth normals");
+
+    auto crease_angle = QCommandLineOption(
+        "crease-angle",
+        "Keep edges where faces meet at more than this angle sharp when "
+        "generating normals (180 to smooth everything)",
+        "degrees",
+        "60");
+
+    auto tangents = QCommandLineOption(
+        "tangents", "Generate tangents for meshes with texture coordinates");
+
+    parser.addOptions({ no_native_weld,
+                        weld_tolerance,
+                        no_native_normals,
+                        crease_angle,
+                        tangents });
+
+    auto no_slicing = QCommandLineOption(
+        "no-slicing",
+        "Do not keep the box hierarchies of triangle meshes that quick "
+        "cross-sections need, saving their memory");
+
+    parser.addOption(no_slicing);
+
+    auto no_watch = QCommandLineOption(
+        "no-watch", "Do not reload models when their files change on disk");
+
+    parser.addOption(no_watch);
+
+    auto memory_budget = QCommandLineOption(
+        "memory-budget",
+        "Evict the geometry of hidden or least recently used models when "
+        "they take more than this many MiB (0 for no limit)",
+        "MiB",
+        "0");
+
+    parser.addOption(memory_budget);
+
+    auto point_voxel_size = QCommandLineOption(
+        "point-voxel-size",
+        "Downsample point clouds to one point per voxel of this size",
+        "size",
+        "0");
+
+    auto point_budget = QCommandLineOption(
+        "point-budget",
+        "Downsample point clouds to at most this many points (0 for no limit)",
+        "count",
+        "0");
+
+    auto point_preview = QCommandLineOption(
+        "point-preview",
+        "Publish a preview of at most this many points before larger clouds "
+        "(0 to disable)",
+        "count",
+        "100000");
+
+    parser.addOptions({ point_voxel_size, point_budget, point_preview });
+
+    auto metrics_port = QCommandLineOption(
+        "metrics-port",
+        "Serve Prometheus metrics at http://localhost:<port>/metrics "
+        "(0 to disable)",
+        "port",
+        "0");
+
+    parser.addOption(metrics_port);
+
+    auto publish_budget = QCommandLineOption(
+        "publish-budget",
+        "Spend at most this many milliseconds of each event loop turn "
+        "publishing new meshes, largest first (0 to publish all at once)",
+        "ms",
+        "4");
+
+    parser.addOption(publish_budget);
+
+    auto animation_rate = QCommandLineOption(
+        "animation-rate",
+        "Ticks per second of server side node animation",
+        "hz",
+        "30");
+
+    parser.addOption(animation_rate);
+
     m_server = noo::create_server(parser);
 
     auto args = parser.positionalArguments();
@@ -702,14 +1413,28 @@ Playground::Playground() {
 
     noo::DocumentData docup;
 
-    //    {
-    //        QVector<noo::MethodTPtr> methods;
-
-    //        auto ptr = make_new_point_plot_method(*this);
-    //        methods.push_back(ptr);
-
-    //        docup.method_list = methods;
-    //    }
+    {
+        QVector<noo::MethodTPtr> methods;
+
+        methods.push_back(make_load_model_method(*this));
+        methods.push_back(make_unload_model_method(*this));
+        methods.push_back(make_list_models_method(*this));
+        methods.push_back(make_set_model_visible_method(*this));
+        methods.push_back(make_metrics_method(*this));
+        methods.push_back(make_play_animation_method(*this));
+        methods.push_back(make_pause_animation_method(*this));
+        methods.push_back(make_seek_animation_method(*this));
+        methods.push_back(make_set_iso_value_method(*this));
+        methods.push_back(make_slice_models_method(*this));
+        methods.push_back(make_create_instance_set_method(*this));
+        methods.push_back(make_edit_instances_method(*this));
+        methods.push_back(make_delete_instance_set_method(*this));
+        methods.push_back(make_create_point_plot_method(*this));
+        methods.push_back(make_append_points_method(*this));
+        methods.push_back(make_delete_point_plot_method(*this));
+
+        docup.method_list = methods;
+    }
 
     noo::update_document(m_doc, docup);
 
@@ -736,10 +1461,68 @@ Playground::Playground() {
 
     add_light({ 1, 0, 0 }, Qt::white, 4);
 
-    ImportOptions options {
-        .double_sided = parser.isSet(double_sided),
+    m_import_options = {
+        .double_sided     = parser.isSet(double_sided),
+        .native_gltf      = !parser.isSet(no_native_gltf),
+        .native_bulk      = !parser.isSet(no_native_bulk),
+        .mapped_io        = !parser.isSet(no_mapped_io),
+        .async_io         = !parser.isSet(no_async_io),
+        .xdmf_partitions  = parser.isSet(xdmf_partitions),
+        .low_memory       = parser.isSet(low_memory),
+        .native_weld      = !parser.isSet(no_native_weld),
+        .weld_tolerance   = parser.value(weld_tolerance).toFloat(),
+        .native_normals   = !parser.isSet(no_native_normals),
+        .crease_angle     = parser.value(crease_angle).toFloat(),
+        .tangents         = parser.isSet(tangents),
+        .slicing          = !parser.isSet(no_slicing),
+        .point_voxel_size = parser.value(point_voxel_size).toFloat(),
+        .point_budget     = parser.value(point_budget).toULongLong(),
+        .point_preview    = parser.value(point_preview).toULongLong(),
     };
 
+    if (parser.isSet(iso_value)) {
+        m_import_options.iso_value = parser.value(iso_value).toFloat();
+    }
+
+    m_watch_files = !parser.isSet(no_watch);
+
+    MetricsRegistry::global().add_collector(
+        [self = QPointer<Playground>(this)]() {
+            if (!self) return std::vector<MetricSample>();
+            return self->collect_metrics();
+        });
+
+    if (auto port = parser.value(metrics_port).toUShort()) {
+        m_metrics_server = new MetricsServer(port, this);
+    }
+
+    if (auto ms = parser.value(publish_budget).toDouble(); ms > 0) {
+        m_publisher = new PublishQueue(
+            std::chrono::microseconds((int64_t)(ms * 1000)), this);
+    }
+
+    {
+        auto rate = parser.value(animation_rate).toDouble();
+        m_animator = new AnimationEngine(rate > 0 ? rate : 30, this);
+    }
+
+    m_memory_budget = parser.value(memory_budget).toLongLong() * 1024 * 1024;
+
+    if (m_watch_files) {
+        m_reload_timer.setSingleShot(true);
+        m_reload_timer.setInterval(250);
+
+        connect(&m_watcher,
+                &QFileSystemWatcher::fileChanged,
+                this,
+                &Playground::on_file_changed);
+
+        connect(&m_reload_timer,
+                &QTimer::timeout,
+                this,
+                &Playground::reload_changed_files);
+    }
+
     auto start_time = std::chrono::high_resolution_clock::now();
 
     {
@@ -752,7 +1535,7 @@ Playground::Playground() {
     }
 
     for (auto const& fname : args) {
-        add_model(fname, options);
+        add_model(fname, m_import_options);
     }
 
     auto end_time = std::chrono::high_resolution_clock::now();
@@ -762,6 +1545,15 @@ Playground::Playground() {
             << "seconds";
 
     update_root_tf();
+    enforce_memory_budget(-1);
 }
 
 Playground::~Playground() { }
+
+std::shared_ptr<noo::DocumentT> Playground::document() { return m_doc; }
+
+noo::ObjectTPtr Playground::plot_root() { return m_collective_root; }
+
+ImportOptions const& Playground::import_options() const {
+    return m_import_options;
+}
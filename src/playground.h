@@ -1,15 +1,75 @@
 #pragma once
 
+#include "bufferarena.h"
+#include "crosssection.h"
+#include "transformtree.h"
+
 #include <noo_server_interface.h>
 
+#include <QFileSystemWatcher>
+#include <QSet>
+#include <QTimer>
+
+#include <chrono>
+#include <functional>
 #include <memory>
+#include <optional>
 
 struct ImportOptions {
     bool force_samplers_to_nearest = false;
     bool double_sided              = false;
+    bool native_gltf               = true;
+    bool native_bulk               = true; // STL, OBJ and PLY
+    bool mapped_io                 = true;
+
+    // read the data items of XDMF grids ahead in batches, through io_uring
+    // where the kernel allows, instead of mapping them
+    bool async_io = true;
+
+    // keep the grids of an XDMF spatial collection as separate meshes
+    // instead of welding them into one
+    bool xdmf_partitions = false;
+
+    // where to take the isosurface of XDMF volumes with a scalar field; the
+    // middle of the field range if not set
+    std::optional<float> iso_value;
+
+    // Convert a few meshes at a time and free the arrays of each source mesh
+    // once it is staged, trading some speed for a lower peak. The scene is
+    // hollowed out by the import, so point cloud previews are off.
+    bool low_memory = false;
+
+    // Join vertices, generate missing normals and generate tangents with the
+    // parallel in-house steps instead of Assimp's; see MeshProcessing.
+    // Tangents are off unless asked for.
+    bool  native_weld    = true;
+    float weld_tolerance = 0;
+    bool  native_normals = true;
+    float crease_angle   = 60; // degrees
+    bool  tangents       = false;
+
+    // Keep a copy of every triangle mesh, sorted into a box hierarchy, so
+    // that cross-sections come out without a scan of the whole model
+    bool slicing = true;
+
+    // Point clouds; zero disables each. A preview level is published first
+    // for clouds larger than the preview budget.
+    float  point_voxel_size = 0;
+    size_t point_budget     = 0;
+    size_t point_preview    = 100'000;
 };
 
+struct GLTFSource;
 struct Model;
+struct ModelAnimations;
+struct LoadedScene;
+class AnimationEngine;
+class InstanceSet;
+class MetricsServer;
+class PointPlot;
+class PublishQueue;
+struct MetricSample;
+struct ScalarVolume;
 
 class ModelCallbacks : public noo::EntityCallbacks {
 
@@ -25,21 +85,111 @@ public:
     void set_scale(glm::vec3) override;
 };
 
+/// Objects created for one node of the source file
+struct ModelNode {
+    noo::ObjectTPtr              object;
+    glm::mat4                    transform = glm::mat4(1);
+    QByteArray                   mesh_key;
+    std::vector<noo::ObjectTPtr> parts;
+
+    // parts still waiting in the publish queue
+    size_t queued_parts = 0;
+};
+
+/// What a model costs, in bytes
+struct ModelMemory {
+    qint64 buffer_bytes  = 0; // mesh attribute and index data
+    qint64 texture_bytes = 0; // encoded image data
+    qint64 cpu_bytes     = 0; // server side bookkeeping
+
+    qint64 total() const { return buffer_bytes + texture_bytes + cpu_bytes; }
+};
+
 struct Model {
     int id;
 
+    QString       source_path;
+    ImportOptions options;
+
     glm::vec3 position = glm::vec3(0);
     glm::quat rotation = glm::quat();
     glm::vec3 scale    = glm::vec3(1);
 
+    // bounds in the space of the root object, node transforms included
     glm::vec3 min_bb = glm::vec3(std::numeric_limits<float>::max());
     glm::vec3 max_bb = glm::vec3(std::numeric_limits<float>::lowest());
 
+    // node transforms and mesh bounds of the last import; its root is the
+    // root object, so its bounds are the ones above
+    TransformTree tree;
+
     glm::mat4 recompute_transform();
 
+    /// The bounds above, moved by the transform of the root object
+    Bounds world_bounds() const;
+
     noo::ObjectTPtr object;
 
-    std::vector<noo::ObjectTPtr> other_objects;
+    // every object of the model, keyed by node path. The root has an empty
+    // path and is the same as `object`.
+    QHash<QString, ModelNode> nodes;
+
+    // converted components by content hash, so that a re-import only
+    // replaces what actually changed
+    QHash<QByteArray, noo::MeshTPtr>     meshes;
+    QHash<QByteArray, noo::MaterialTPtr> materials;
+    QHash<QByteArray, noo::TextureTPtr>  textures;
+
+    // size of each of the above, by content hash
+    QHash<QByteArray, qint64> component_bytes;
+
+    // the arena chunks each component lies in, by content hash. A chunk
+    // lives while anything in it does, so memory is counted by chunk.
+    QHash<QByteArray, std::vector<BufferArena::ChunkUse>> component_chunks;
+
+    // the glTF file the buffers of each component point into, by content
+    // hash, kept mapped while anything made from it is around
+    QHash<QByteArray, std::shared_ptr<GLTFSource const>> component_sources;
+
+    ModelMemory memory;
+
+    // size of the distinct geometry, as of the last import
+    qint64 vertex_count   = 0;
+    qint64 triangle_count = 0;
+
+    // node animations of the last import, if any. Replaced, never changed,
+    // so players can tell when to look up their targets again.
+    std::shared_ptr<ModelAnimations const> animations;
+
+    // the scalar field of an XDMF volume, so its isosurface can be taken
+    // again at other values without reading the file
+    std::shared_ptr<ScalarVolume const> volume;
+
+    // triangle hierarchies for slicing, by content hash. Empty if slicing
+    // is off.
+    QHash<QByteArray, std::shared_ptr<MeshBVH const>> bvhs;
+
+    // the tree node and mesh content hash of every place a mesh is shown
+    std::vector<std::pair<uint32_t, QByteArray>> mesh_nodes;
+
+    // the cross-section shown, parented to the root object
+    noo::ObjectTPtr section_lines;
+    noo::ObjectTPtr section_caps;
+
+    // false while the geometry is evicted and only a bounds proxy is shown
+    bool resident = true;
+    bool visible  = true;
+
+    std::chrono::steady_clock::time_point last_touched =
+        std::chrono::steady_clock::now();
+
+    // called when a user interacts with the model
+    std::function<void()> on_touched;
+
+    // called when a user moves the root object
+    std::function<void()> on_moved;
+
+    void touch();
 };
 
 using ModelPtr = std::shared_ptr<Model>;
@@ -59,11 +209,107 @@ class Playground : public QObject {
 
     int                                m_id_counter = 0;
     QHash<int, std::shared_ptr<Model>> m_thing_list;
+    QSet<int>                          m_loads_in_flight;
+
+    // 0 for no limit
+    qint64 m_memory_budget = 0;
+
+    // from the command line; what load_model arguments start from
+    ImportOptions m_import_options;
+
+    // world bounds of every model, kept up to date as models come, go and
+    // move
+    BoundsSet m_scene_bounds;
+    glm::mat4 m_root_tf = glm::mat4(1);
+
+    // hot reload of files given on the command line
+    bool               m_watch_files = false;
+    QFileSystemWatcher m_watcher;
+    QTimer             m_reload_timer;
+    QSet<QString>      m_changed_files;
+    QSet<int>          m_reloads_in_flight;
+    QSet<int>          m_reload_again;
+
+    // models whose file changed since it was last loaded; the next load
+    // reads it rather than maps it
+    QSet<int> m_file_changed;
+
+    // isosurfaces being extracted, and models whose value changed meanwhile
+    QSet<int> m_isos_in_flight;
+    QSet<int> m_iso_again;
+
+    MetricsServer* m_metrics_server = nullptr;
+
+    // paces document creation; null to create everything at once
+    PublishQueue* m_publisher = nullptr;
+
+    AnimationEngine* m_animator = nullptr;
+
+    int                                      m_instance_set_counter = 0;
+    QHash<int, std::shared_ptr<InstanceSet>> m_instance_sets;
+    bool                                     m_instance_flush_queued = false;
+
+    void flush_instances();
+
+    int                                    m_point_plot_counter = 0;
+    QHash<int, std::shared_ptr<PointPlot>> m_point_plots;
+    noo::MeshTPtr                          m_point_glyph;
+    bool                                   m_plot_flush_queued = false;
+
+    void flush_point_plots();
+
+    // cross-section planes, in the space clients see the scene in, and the
+    // models to slice again on the next event loop turn. Cuts run on a
+    // worker; a model changed while its cut is in flight is cut again once
+    // it is done. New planes bump the generation, and older cuts are dropped.
+    std::vector<Plane> m_section_planes;
+    bool               m_section_caps = false;
+    uint64_t           m_section_generation = 0;
+    QSet<int>          m_sections_dirty;
+    bool               m_section_flush_queued = false;
+    QSet<int>          m_slices_in_flight;
+    QSet<int>          m_slice_again;
+    noo::MaterialTPtr  m_section_material;
+
+    void slice_model(int id);
+    void slice_later(int id);
+    void flush_sections();
 
     void add_model(QString, ImportOptions const&);
+    void insert_model(ModelPtr);
+
+    /// Read, convert and stage a file on a worker thread. Staging a reload
+    /// of `model` leaves out what it already holds; without a model, large
+    /// point clouds are staged as a preview first. With `changed`, the file
+    /// was just written; see load_scene.
+    void load_in_background(QString                           path,
+                            ImportOptions const&              options,
+                            ModelPtr const&                   model,
+                            bool                              changed,
+                            std::function<void(LoadedScene&)> on_done,
+                            std::function<void(QString)>      on_error);
+
+    void touch_model(int id);
+    void enforce_memory_budget(int keep_id);
+    void evict_model(Model&);
+
+    void place_model(Model const&);
 
     void update_root_tf();
 
+    void on_file_changed(QString path);
+    void reload_changed_files();
+    void reload_model(int id);
+    void refine_model(int id, LoadedScene const&);
+    void finish_refine(int id, LoadedScene const&);
+    void extract_isosurface(int id);
+
+    /// False if the update was staged against components the model has lost
+    /// since; it has to be loaded and staged again
+    bool apply_update(ModelPtr const&, LoadedScene const&);
+
+    std::vector<MetricSample> collect_metrics() const;
+
 public:
     Playground();
 
@@ -72,4 +318,72 @@ public:
     std::shared_ptr<noo::DocumentT> document();
 
     noo::ObjectTPtr plot_root();
+
+    /// The options given on the command line, which those of a model loaded
+    /// later override
+    ImportOptions const& import_options() const;
+
+    /// Import a file on a worker thread. Returns the id the model will have
+    /// once it arrives.
+    int load_model(QString path, ImportOptions const& options);
+
+    /// Remove a model and release everything only it was using
+    bool unload_model(int id);
+
+    QList<ModelPtr> models() const;
+
+    /// Null if there is no such model
+    ModelPtr model(int id) const;
+
+    /// Hidden models are the first to be evicted when over budget
+    bool set_model_visible(int id, bool visible);
+
+    /// Bytes of all models that currently have their geometry loaded
+    qint64 resident_bytes() const;
+
+    /// Play an animation clip of a model on the server, from where it was
+    /// paused if it is the same clip
+    bool play_animation(int id, int clip);
+    bool pause_animation(int id);
+
+    /// Jump to a time, in seconds, of the current clip of a model
+    bool seek_animation(int id, double seconds);
+
+    /// Show the isosurface of the scalar field of a volume model at another
+    /// value. The surface is extracted on a worker thread and replaces the
+    /// current one once done. False if the model has no scalar field.
+    bool set_iso_value(int id, float value);
+
+    /// Place `count` copies of the meshes of a resident model. Returns the id
+    /// of the new instance set, or -1 if the model has no meshes.
+    int create_instance_set(int model_id, size_t count);
+
+    /// Null if there is no such set
+    std::shared_ptr<InstanceSet> instance_set(int id) const;
+
+    bool delete_instance_set(int id);
+
+    /// Publish the dirty pages of every instance set on the next event loop
+    /// turn, so that edits arriving together go out together
+    void flush_instances_later();
+
+    /// A new, empty plot of points drawn as small glyphs. A capacity of 0
+    /// keeps every point; otherwise the oldest go first. Returns the id.
+    int create_point_plot(size_t capacity);
+
+    /// Null if there is no such plot
+    std::shared_ptr<PointPlot> point_plot(int id) const;
+
+    bool delete_point_plot(int id);
+
+    /// Publish the staged points of every plot on the next event loop turn,
+    /// so that appends arriving together go out in one chunk
+    void flush_point_plots_later();
+
+    /// Show where the planes, given in the space clients see the scene in,
+    /// cut every resident model, and keep the sections current as models
+    /// move and change. No planes removes them. With `caps` closed section
+    /// lines are filled. The cuts run in the background and show as they
+    /// finish; returns the ids of the models being cut.
+    std::vector<int> set_section(std::vector<Plane> planes, bool caps);
 };
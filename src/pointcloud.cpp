@@ -0,0 +1,307 @@
+#include "pointcloud.h"
+
+#include "playground.h"
+#include "threadpool.h"
+
+#include <assimp/scene.h>
+
+#include <QDebug>
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <mutex>
+
+namespace {
+
+// 21 bits per axis fills a 63 bit key
+constexpr int morton_bits = 21;
+
+uint64_t spread_bits(uint64_t v) {
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffff;
+    v = (v | v << 16) & 0x1f0000ff0000ff;
+    v = (v | v << 8) & 0x100f00f00f00f00f;
+    v = (v | v << 4) & 0x10c30c30c30c30c3;
+    v = (v | v << 2) & 0x1249249249249249;
+    return v;
+}
+
+uint64_t morton_code(glm::u32vec3 cell) {
+    return spread_bits(cell.x) | spread_bits(cell.y) << 1 |
+           spread_bits(cell.z) << 2;
+}
+
+struct KeyedPoint {
+    uint64_t key;
+    uint32_t index;
+
+    bool operator<(KeyedPoint const& o) const { return key < o.key; }
+};
+
+/// The source cloud, keyed on the finest octree level and sorted
+struct SortedCloud {
+    aiMesh const&           mesh;
+    std::vector<KeyedPoint> order;
+    float                   cell_size = 0;
+
+    // number of distinct cells at each octree level
+    std::array<size_t, morton_bits + 1> level_counts {};
+};
+
+SortedCloud sort_cloud(aiMesh const& mesh) {
+    SortedCloud ret { .mesh = mesh };
+
+    auto const count = mesh.mNumVertices;
+
+    glm::vec3 lmin(std::numeric_limits<float>::max());
+    glm::vec3 lmax(std::numeric_limits<float>::lowest());
+
+    std::mutex bounds_lock;
+
+    ThreadPool::global().parallel_chunks(count, [&](size_t b, size_t e) {
+        glm::vec3 cmin(std::numeric_limits<float>::max());
+        glm::vec3 cmax(std::numeric_limits<float>::lowest());
+
+        for (size_t i = b; i < e; i++) {
+            auto const& v = mesh.mVertices[i];
+            cmin          = glm::min(cmin, glm::vec3(v.x, v.y, v.z));
+            cmax          = glm::max(cmax, glm::vec3(v.x, v.y, v.z));
+        }
+
+        std::scoped_lock lock(bounds_lock);
+        lmin = glm::min(lmin, cmin);
+        lmax = glm::max(lmax, cmax);
+    });
+
+    auto extent   = lmax - lmin;
+    auto max_edge = std::max({ extent.x, extent.y, extent.z, 1e-6f });
+
+    ret.cell_size = max_edge / (1 << morton_bits);
+
+    ret.order.resize(count);
+
+    ThreadPool::global().parallel_chunks(count, [&](size_t b, size_t e) {
+        constexpr float top = (1 << morton_bits) - 1;
+
+        for (size_t i = b; i < e; i++) {
+            auto const& v = mesh.mVertices[i];
+
+            auto cell = glm::clamp(
+                (glm::vec3(v.x, v.y, v.z) - lmin) / ret.cell_size, 0.0f, top);
+
+            ret.order[i] = { morton_code(glm::u32vec3(cell)), (uint32_t)i };
+        }
+    });
+
+    parallel_sort(ret.order);
+
+    // Two neighbours fall in different cells on every level up to the
+    // highest bit they differ in, so a difference array gives all counts in
+    // one pass.
+    std::array<size_t, morton_bits + 2> starts {};
+
+    if (count) starts[morton_bits]++;
+
+    for (size_t i = 1; i < count; i++) {
+        auto diff = ret.order[i].key ^ ret.order[i - 1].key;
+        if (!diff) continue;
+        starts[(63 - std::countl_zero(diff)) / 3]++;
+    }
+
+    size_t running = 0;
+    for (int level = morton_bits; level >= 0; level--) {
+        running += starts[level];
+        ret.level_counts[level] = running;
+    }
+
+    return ret;
+}
+
+/// The finest level with no more than `budget` points
+int level_for_budget(SortedCloud const& cloud, size_t budget) {
+    for (int level = 0; level <= morton_bits; level++) {
+        if (cloud.level_counts[level] <= budget) return level;
+    }
+    return morton_bits;
+}
+
+int level_for_voxel(SortedCloud const& cloud, float voxel_size) {
+    if (voxel_size <= cloud.cell_size) return 0;
+
+    auto level = (int)std::ceil(std::log2(voxel_size / cloud.cell_size));
+
+    return std::clamp(level, 0, morton_bits);
+}
+
+/// Average every cell at the given octree level into one point. Level zero
+/// keeps every point and only reorders.
+std::shared_ptr<PointCloud> reduce(SortedCloud const& cloud, int level) {
+    auto const& mesh  = cloud.mesh;
+    auto const& order = cloud.order;
+    auto const  shift = 3 * level;
+
+    bool const has_normals = mesh.mNormals;
+    bool const has_colors  = mesh.mColors[0];
+
+    auto ret = std::make_shared<PointCloud>();
+
+    if (level == 0) {
+        ret->positions.resize(order.size());
+        if (has_normals) ret->normals.resize(order.size());
+        if (has_colors) ret->colors.resize(order.size());
+
+        auto& pool = ThreadPool::global();
+
+        pool.parallel_chunks(order.size(), [&](size_t b, size_t e) {
+            for (size_t i = b; i < e; i++) {
+                auto        src = order[i].index;
+                auto const& v   = mesh.mVertices[src];
+
+                ret->positions[i] = glm::vec3(v.x, v.y, v.z);
+
+                if (has_normals) {
+                    auto const& n   = mesh.mNormals[src];
+                    ret->normals[i] = glm::vec3(n.x, n.y, n.z);
+                }
+
+                if (has_colors) {
+                    auto const& c  = mesh.mColors[0][src];
+                    ret->colors[i] =
+                        glm::u8vec4(glm::vec4(c.r, c.g, c.b, c.a) * 255.0f);
+                }
+            }
+        });
+
+        return ret;
+    }
+
+    auto cell_of = [&](size_t i) { return order[i].key >> shift; };
+
+    // slices may not split a cell, so move every slice start to the start of
+    // the cell it lands in
+    size_t const slice_count = ThreadPool::global().size() * 4;
+
+    std::vector<size_t> bounds;
+
+    for (size_t s = 0; s < slice_count; s++) {
+        auto at = order.size() * s / slice_count;
+        while (at > 0 and at < order.size() and
+               cell_of(at) == cell_of(at - 1)) {
+            at++;
+        }
+        if (bounds.empty() or at > bounds.back()) bounds.push_back(at);
+    }
+
+    bounds.push_back(order.size());
+
+    std::vector<PointCloud> parts(bounds.size() - 1);
+
+    ThreadPool::global().parallel_for(parts.size(), [&](size_t s) {
+        auto& part = parts[s];
+
+        size_t i = bounds[s];
+
+        while (i < bounds[s + 1]) {
+            auto cell = cell_of(i);
+
+            glm::dvec3 position(0);
+            glm::vec3  normal(0);
+            glm::vec4  color(0);
+            size_t     n = 0;
+
+            for (; i < bounds[s + 1] and cell_of(i) == cell; i++, n++) {
+                auto        src = order[i].index;
+                auto const& v   = mesh.mVertices[src];
+                position += glm::dvec3(v.x, v.y, v.z);
+
+                if (has_normals) {
+                    auto const& nn = mesh.mNormals[src];
+                    normal += glm::vec3(nn.x, nn.y, nn.z);
+                }
+
+                if (has_colors) {
+                    auto const& c = mesh.mColors[0][src];
+                    color += glm::vec4(c.r, c.g, c.b, c.a);
+                }
+            }
+
+            part.positions.push_back(glm::vec3(position / (double)n));
+
+            if (has_normals) {
+                auto len = glm::length(normal);
+                part.normals.push_back(len > 0 ? normal / len : normal);
+            }
+
+            if (has_colors) {
+                part.colors.push_back(
+                    glm::u8vec4(color / (float)n * 255.0f));
+            }
+        }
+    });
+
+    for (auto& part : parts) {
+        auto append = [](auto& to, auto const& from) {
+            to.insert(to.end(), from.begin(), from.end());
+        };
+
+        append(ret->positions, part.positions);
+        append(ret->normals, part.normals);
+        append(ret->colors, part.colors);
+    }
+
+    return ret;
+}
+
+} // namespace
+
+bool is_point_mesh(aiMesh const& mesh) {
+    return mesh.mPrimitiveTypes == aiPrimitiveType_POINT;
+}
+
+std::shared_ptr<PreparedPoints> prepare_points(aiScene const&       scene,
+                                               ImportOptions const& options) {
+    auto ret = std::make_shared<PreparedPoints>();
+
+    for (unsigned mi = 0; mi < scene.mNumMeshes; mi++) {
+        auto const& mesh = *scene.mMeshes[mi];
+
+        if (!is_point_mesh(mesh) or !mesh.mNumVertices) continue;
+
+        QElapsedTimer timer;
+        timer.start();
+
+        auto sorted = sort_cloud(mesh);
+
+        int level = 0;
+
+        if (options.point_voxel_size > 0) {
+            level = level_for_voxel(sorted, options.point_voxel_size);
+        }
+
+        if (options.point_budget > 0) {
+            level = std::max(level,
+                             level_for_budget(sorted, options.point_budget));
+        }
+
+        ret->full[mi] = reduce(sorted, level);
+
+        if (options.point_preview > 0) {
+            auto preview_level =
+                level_for_budget(sorted, options.point_preview);
+
+            if (preview_level > level) {
+                ret->preview[mi] = reduce(sorted, preview_level);
+            }
+        }
+
+        qInfo() << "Point cloud" << mi << "|" << mesh.mNumVertices << "points"
+                << "->" << ret->full[mi]->positions.size() << "at level"
+                << level << "in" << timer.elapsed() << "ms";
+    }
+
+    return ret;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "noo_include_glm.h"
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+struct aiMesh;
+struct aiScene;
+struct ImportOptions;
+
+/// Points ready to publish. Normals and colors are either empty or one per
+/// point.
+struct PointCloud {
+    std::vector<glm::vec3>   positions;
+    std::vector<glm::vec3>   normals;
+    std::vector<glm::u8vec4> colors;
+};
+
+/// Point clouds of a scene, by mesh index, after ordering and downsampling.
+/// A mesh only has a preview if its full level is larger than the preview
+/// budget.
+struct PreparedPoints {
+    std::unordered_map<unsigned, std::shared_ptr<PointCloud const>> full;
+    std::unordered_map<unsigned, std::shared_ptr<PointCloud const>> preview;
+};
+
+/// Whether Assimp gave us this mesh as bare points
+bool is_point_mesh(aiMesh const&);
+
+/// Morton order and optionally downsample every point mesh of the scene.
+/// Downsampling merges points that share a cell of an octree over the cloud
+/// bounds, so voxel sizes are rounded up to the next octree level. Runs in
+/// parallel; safe to call off the main thread.
+std::shared_ptr<PreparedPoints> prepare_points(aiScene const&,
+                                               ImportOptions const&);
@@ -0,0 +1,300 @@
+#include "pointplot.h"
+
+#include "metrics.h"
+#include "threadpool.h"
+
+#include <QDebug>
+
+#include <algorithm>
+
+namespace {
+
+/// A point as clients read it, laid out like an instance of an InstanceSet:
+/// one matrix, its columns the position, color, rotation and scale
+glm::mat4 to_matrix(glm::vec3 position, glm::u8vec4 color, float size) {
+    glm::mat4 ret;
+    ret[0] = glm::vec4(position, 1);
+    ret[1] = glm::vec4(color) / 255.0f;
+    ret[2] = glm::vec4(0, 0, 0, 1);
+    ret[3] = glm::vec4(glm::vec3(size), 1);
+    return ret;
+}
+
+} // namespace
+
+PointPlot::PointPlot(int                  id,
+                     noo::DocumentTPtrRef doc,
+                     noo::ObjectTPtr      parent,
+                     noo::MeshTPtr        glyph,
+                     size_t               capacity)
+    : m_id(id), m_doc(doc), m_glyph(std::move(glyph)), m_capacity(capacity) {
+    noo::ObjectData data;
+    data.name   = QString("Point Plot %1").arg(id);
+    data.parent = parent;
+
+    m_root = noo::create_object(doc, data);
+}
+
+size_t PointPlot::size() const {
+    size_t ret = m_staged.size();
+    for (auto const& chunk : m_chunks) {
+        ret += chunk.count - chunk.dropped;
+    }
+    return ret;
+}
+
+void PointPlot::set_capacity(size_t capacity) {
+    m_capacity = capacity;
+    trim();
+}
+
+void PointPlot::trim() {
+    if (m_capacity == 0) return;
+
+    auto total = size();
+
+    if (total <= m_capacity) return;
+
+    size_t drop = total - m_capacity;
+
+    while (drop and !m_chunks.empty()) {
+        auto& oldest = m_chunks.front();
+        auto  live   = oldest.count - oldest.dropped;
+
+        if (drop >= live) {
+            // the object goes, and then its view and buffer
+            m_chunks.pop_front();
+            drop -= live;
+            continue;
+        }
+
+        oldest.dropped += drop;
+        oldest.trimmed = true;
+        drop           = 0;
+    }
+
+    // more new points than fit; the oldest of them never go out
+    m_staged.erase(m_staged.begin(), m_staged.begin() + drop);
+}
+
+std::optional<QString>
+PointPlot::append(std::span<glm::vec3 const>   positions,
+                  std::span<glm::u8vec4 const> colors,
+                  std::span<float const>       sizes) {
+    auto const count = positions.size();
+
+    if (colors.size() > 1 and colors.size() != count) {
+        return QString("Expected 1 or %1 colors, got %2")
+            .arg(count)
+            .arg(colors.size());
+    }
+
+    if (sizes.size() > 1 and sizes.size() != count) {
+        return QString("Expected 1 or %1 sizes, got %2")
+            .arg(count)
+            .arg(sizes.size());
+    }
+
+    // only the newest points of a batch larger than the ring can survive
+    size_t skip = 0;
+    if (m_capacity and count > m_capacity) skip = count - m_capacity;
+
+    auto const first = m_staged.size();
+
+    m_staged.resize(first + count - skip);
+
+    auto color_of = [&](size_t i) {
+        if (colors.empty()) return glm::u8vec4(255);
+        return colors[colors.size() == 1 ? 0 : i];
+    };
+
+    auto size_of = [&](size_t i) {
+        if (sizes.empty()) return 1.0f;
+        return sizes[sizes.size() == 1 ? 0 : i];
+    };
+
+    ThreadPool::global().parallel_chunks(
+        count - skip, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                auto s = i + skip;
+                m_staged[first + i] =
+                    to_matrix(positions[s], color_of(s), size_of(s));
+            }
+        });
+
+    trim();
+
+    return {};
+}
+
+bool PointPlot::dirty() const {
+    if (!m_staged.empty()) return true;
+
+    return std::any_of(m_chunks.begin(), m_chunks.end(), [](auto const& c) {
+        return c.trimmed;
+    });
+}
+
+void PointPlot::publish(std::vector<glm::mat4> points,
+                        noo::ObjectTPtr        object) {
+    auto bytes = points.size() * sizeof(glm::mat4);
+
+    Chunk chunk;
+    chunk.count = points.size();
+
+    chunk.buffer = noo::create_buffer(
+        m_doc,
+        noo::BufferData {
+            .source =
+                noo::BufferInlineSource {
+                    .data = QByteArray(
+                        reinterpret_cast<char const*>(points.data()), bytes),
+                },
+        });
+
+    chunk.view = noo::create_buffer_view(m_doc,
+                                         noo::BufferViewData {
+                                             .source_buffer = chunk.buffer,
+                                             .type   = noo::ViewType::UNKNOWN,
+                                             .offset = 0,
+                                             .length = (uint64_t)bytes,
+                                         });
+
+    auto definition = noo::ObjectRenderableDefinition {
+        .mesh      = m_glyph,
+        .instances = noo::InstanceInfo { .view = chunk.view, .stride = 0 },
+    };
+
+    if (object) {
+        noo::update_object(object, noo::ObjectUpdateData {
+                                       .definition = definition,
+                                   });
+
+        chunk.object = std::move(object);
+    } else {
+        noo::ObjectData data;
+        data.parent     = m_root;
+        data.definition = definition;
+
+        chunk.object = noo::create_object(m_doc, data);
+    }
+
+    if (chunk.count < chunk_size / 2) chunk.points = std::move(points);
+
+    m_chunks.push_back(std::move(chunk));
+
+    metrics::buffer_bytes_created(metrics::BufferType::Points).add(bytes);
+}
+
+size_t PointPlot::flush() {
+    size_t retargeted = 0;
+
+    for (auto& chunk : m_chunks) {
+        if (!chunk.trimmed) continue;
+
+        // same buffer, fewer points; nothing is sent but the view
+        auto const offset = chunk.dropped * sizeof(glm::mat4);
+        auto const length = (chunk.count - chunk.dropped) * sizeof(glm::mat4);
+
+        chunk.view = noo::create_buffer_view(m_doc,
+                                             noo::BufferViewData {
+                                                 .source_buffer = chunk.buffer,
+                                                 .type = noo::ViewType::UNKNOWN,
+                                                 .offset = (uint64_t)offset,
+                                                 .length = (uint64_t)length,
+                                             });
+
+        noo::ObjectUpdateData update {
+            .definition =
+                noo::ObjectRenderableDefinition {
+                    .mesh      = m_glyph,
+                    .instances = noo::InstanceInfo { .view   = chunk.view,
+                                                     .stride = 0 },
+                },
+        };
+
+        noo::update_object(chunk.object, update);
+
+        chunk.trimmed = false;
+        retargeted++;
+    }
+
+    auto const staged = m_staged.size();
+
+    size_t sent   = 0;
+    size_t merged = 0;
+
+    // live points of the open chunks, which are all at the end
+    size_t open = 0;
+    for (auto const& chunk : m_chunks) {
+        if (!chunk.points.empty()) open += chunk.count - chunk.dropped;
+    }
+
+    for (size_t i = 0; i < staged;) {
+        auto count = std::min(chunk_size, staged - i);
+
+        // enough for a full chunk: all open chunks go into it, with no more
+        // new points than fit
+        bool const close = open + count >= chunk_size / 2;
+        if (close) count = std::min(count, chunk_size - open);
+
+        auto begin = m_staged.begin() + i;
+        i += count;
+
+        std::vector<glm::mat4> points(begin, begin + count);
+        std::vector<Chunk>     folded;
+
+        // otherwise only those not twice the size of the new points, newest
+        // first
+        while (!m_chunks.empty() and !m_chunks.back().points.empty()) {
+            auto& last = m_chunks.back();
+            auto  live = last.count - last.dropped;
+
+            if (!close and live >= 2 * points.size()) break;
+
+            points.insert(points.begin(),
+                          last.points.begin() + last.dropped,
+                          last.points.end());
+
+            open -= live;
+
+            folded.push_back(std::move(last));
+            m_chunks.pop_back();
+        }
+
+        if (!close) open += points.size();
+
+        sent += points.size();
+        merged += folded.size();
+
+        // the oldest chunk folded shows the merged points
+        publish(std::move(points),
+                folded.empty() ? nullptr : folded.back().object);
+
+        // the others go, and then the old buffers
+        folded.clear();
+    }
+
+    m_staged.clear();
+
+    // a burst should not pin its peak
+    if (m_staged.capacity() > chunk_size) m_staged.shrink_to_fit();
+
+    if (sent or retargeted) {
+        qDebug() << "Point plot" << m_id << "sent" << (qint64)sent
+                 << "points, merged" << (qint64)merged << "chunks, trimmed"
+                 << (qint64)retargeted << "chunks |"
+                 << (qint64)m_chunks.size() << "chunks,"
+                 << (qint64)size() << "points";
+    }
+
+    return staged;
+}
+
+qint64 PointPlot::byte_size() const {
+    qint64 ret = m_staged.capacity() * sizeof(glm::mat4);
+    for (auto const& chunk : m_chunks) {
+        ret += (chunk.count + chunk.points.capacity()) * sizeof(glm::mat4);
+    }
+    return ret;
+}
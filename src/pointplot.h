@@ -0,0 +1,95 @@
+#pragma once
+
+#include "noo_include_glm.h"
+
+#include <noo_server_interface.h>
+
+#include <QString>
+
+#include <deque>
+#include <optional>
+#include <span>
+#include <vector>
+
+/// A stream of points drawn as instances of one glyph mesh. Appended points
+/// are staged and go out on flush() in chunks, each a buffer of its own shown
+/// by one object. A chunk of less than half of `chunk_size` is open: it keeps
+/// a copy of its points and is sent again, merged with newer points, when
+/// the newest open chunk has fewer than twice as many points as are new, or
+/// when the open chunks and the new points would fill half a chunk. Each
+/// open chunk thus holds at least twice the points of the next, so there are
+/// at most log2(chunk_size) of them, and a point is only sent again when its
+/// chunk grows by half, or once more as it closes. With a capacity the plot
+/// is a ring: the oldest points are dropped as new ones arrive. Chunks that
+/// are all dropped are deleted, and the oldest one left gets a new view into
+/// its buffer that starts past the dropped points.
+class PointPlot {
+public:
+    // 4 MiB of instance matrices
+    static constexpr size_t chunk_size = 65536;
+
+private:
+    struct Chunk {
+        noo::BufferTPtr     buffer;
+        noo::BufferViewTPtr view;
+        noo::ObjectTPtr     object;
+        size_t              count   = 0; // points in the buffer
+        size_t              dropped = 0; // of those, at the front
+        bool                trimmed = false; // view is out of date
+
+        // the points of the buffer while the chunk is open, to merge with
+        std::vector<glm::mat4> points;
+    };
+
+    int m_id;
+
+    noo::DocumentTPtr m_doc;
+    noo::ObjectTPtr   m_root;
+    noo::MeshTPtr     m_glyph;
+
+    size_t m_capacity = 0;
+
+    std::deque<Chunk>      m_chunks;
+    std::vector<glm::mat4> m_staged;
+
+    void trim();
+
+    /// Send points as the newest chunk, shown by `object` if there is one
+    void publish(std::vector<glm::mat4> points, noo::ObjectTPtr object);
+
+public:
+    /// An empty plot under a new object parented to `parent`. A capacity of
+    /// 0 keeps every point.
+    PointPlot(int                  id,
+              noo::DocumentTPtrRef doc,
+              noo::ObjectTPtr      parent,
+              noo::MeshTPtr        glyph,
+              size_t               capacity);
+
+    int id() const { return m_id; }
+
+    /// Points in the plot, sent or not
+    size_t size() const;
+
+    size_t capacity() const { return m_capacity; }
+
+    /// Drops the oldest points right away if there are more than `capacity`
+    void set_capacity(size_t capacity);
+
+    /// Stage points. Colors and sizes are given per point, once for all of
+    /// them, or not at all for white and 1. Returns an error, and stages
+    /// nothing, if their counts do not fit.
+    std::optional<QString> append(std::span<glm::vec3 const>   positions,
+                                  std::span<glm::u8vec4 const> colors,
+                                  std::span<float const>       sizes);
+
+    bool dirty() const;
+
+    /// Publish staged points and trimmed views. Returns the number of new
+    /// points sent.
+    size_t flush();
+
+    /// Bytes of the staged points, of the chunk buffers and of the copies of
+    /// open chunks
+    qint64 byte_size() const;
+};
@@ -0,0 +1,72 @@
+#include "publishqueue.h"
+
+#include <QDebug>
+
+#include <algorithm>
+
+PublishQueue::PublishQueue(std::chrono::microseconds budget, QObject* parent)
+    : QObject(parent), m_budget(budget) {
+    m_timer.setInterval(0);
+    connect(&m_timer, &QTimer::timeout, this, &PublishQueue::run_turn);
+}
+
+void PublishQueue::push(int owner, float priority, Task task) {
+    m_entries.push_back(Entry {
+        .priority = priority,
+        .sequence = m_sequence++,
+        .owner    = owner,
+        .task     = std::move(task),
+    });
+
+    std::push_heap(m_entries.begin(), m_entries.end());
+
+    if (!m_timer.isActive()) m_timer.start();
+}
+
+void PublishQueue::cancel(int owner) {
+    auto dropped = std::erase_if(
+        m_entries, [owner](Entry const& e) { return e.owner == owner; });
+
+    if (!dropped) return;
+
+    qDebug() << "Dropped" << (qint64)dropped << "queued tasks of" << owner;
+
+    std::make_heap(m_entries.begin(), m_entries.end());
+
+    if (m_entries.empty()) m_timer.stop();
+}
+
+size_t PublishQueue::pending(int owner) const {
+    return std::count_if(m_entries.begin(),
+                         m_entries.end(),
+                         [owner](Entry const& e) { return e.owner == owner; });
+}
+
+void PublishQueue::run_turn() {
+    using Clock = std::chrono::steady_clock;
+
+    auto const deadline = Clock::now() + m_budget;
+
+    size_t ran = 0;
+
+    // always make progress, even if a single task is over budget
+    do {
+        if (m_entries.empty()) break;
+
+        std::pop_heap(m_entries.begin(), m_entries.end());
+
+        auto task = std::move(m_entries.back().task);
+        m_entries.pop_back();
+
+        task();
+        ran++;
+    } while (Clock::now() < deadline);
+
+    qDebug() << "Published" << (qint64)ran << "tasks,"
+             << (qint64)m_entries.size() << "left";
+
+    if (m_entries.empty()) {
+        m_timer.stop();
+        emit idle();
+    }
+}
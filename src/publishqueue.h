@@ -0,0 +1,64 @@
+#pragma once
+
+#include <QObject>
+#include <QTimer>
+
+#include <chrono>
+#include <functional>
+#include <vector>
+
+/// Spreads document creations over event loop turns. Importers queue work
+/// with a priority, and every turn runs the most important tasks until the
+/// time budget is spent, so clients that are already connected keep getting
+/// their messages and the large structure of a model arrives first.
+class PublishQueue : public QObject {
+    Q_OBJECT
+
+public:
+    using Task = std::function<void()>;
+
+private:
+    struct Entry {
+        float    priority;
+        uint64_t sequence;
+        int      owner;
+        Task     task;
+
+        // highest priority first; equal priorities run in the order queued
+        bool operator<(Entry const& o) const {
+            if (priority != o.priority) return priority < o.priority;
+            return sequence > o.sequence;
+        }
+    };
+
+    // a max heap on Entry::operator<
+    std::vector<Entry> m_entries;
+    uint64_t           m_sequence = 0;
+
+    std::chrono::microseconds m_budget;
+    QTimer                    m_timer;
+
+    void run_turn();
+
+public:
+    explicit PublishQueue(std::chrono::microseconds budget,
+                          QObject*                  parent = nullptr);
+
+    /// Queue a task for a model. Tasks queued together with the same
+    /// priority run in order, so a task may rely on an earlier one.
+    void push(int owner, float priority, Task);
+
+    /// Drop every task of a model that has not run yet
+    void cancel(int owner);
+
+    size_t pending() const { return m_entries.size(); }
+
+    /// Tasks of one model that have not run yet
+    size_t pending(int owner) const;
+
+    std::chrono::microseconds budget() const { return m_budget; }
+
+signals:
+    /// Emitted when the last queued task has run
+    void idle();
+};
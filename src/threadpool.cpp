@@ -0,0 +1,192 @@
+#include "threadpool.h"
+
+#include <algorithm>
+#include <exception>
+
+namespace {
+
+thread_local ThreadPool const* t_pool   = nullptr;
+thread_local size_t            t_worker = 0;
+
+} // namespace
+
+ThreadPool::ThreadPool(unsigned threads) {
+    threads = std::max(1u, threads);
+
+    for (unsigned i = 0; i < threads; i++) {
+        m_queues.push_back(std::make_unique<Queue>());
+    }
+
+    for (unsigned i = 0; i < threads; i++) {
+        m_threads.emplace_back([this, i]() {
+            t_pool   = this;
+            t_worker = i;
+            work(i);
+        });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::scoped_lock lock(m_sleep_lock);
+        m_stop = true;
+    }
+
+    m_wake.notify_all();
+
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+}
+
+ThreadPool& ThreadPool::global() {
+    static ThreadPool pool;
+    return pool;
+}
+
+size_t ThreadPool::home_queue() {
+    if (t_pool == this) return t_worker;
+    return m_next++ % m_queues.size();
+}
+
+void ThreadPool::submit(Task task) {
+    auto& queue = *m_queues[home_queue()];
+
+    {
+        std::scoped_lock lock(queue.lock);
+        queue.tasks.push_back(std::move(task));
+    }
+
+    m_pending++;
+
+    {
+        // pairs with the predicate check in work(), so no wakeup is lost
+        std::scoped_lock lock(m_sleep_lock);
+    }
+
+    m_wake.notify_one();
+}
+
+bool ThreadPool::try_run_one(size_t home) {
+    Task task;
+
+    {
+        auto& own = *m_queues[home];
+
+        std::scoped_lock lock(own.lock);
+
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+        }
+    }
+
+    for (size_t k = 1; !task and k < m_queues.size(); k++) {
+        auto& victim = *m_queues[(home + k) % m_queues.size()];
+
+        std::scoped_lock lock(victim.lock);
+
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+
+    if (!task) return false;
+
+    m_pending--;
+
+    task();
+
+    return true;
+}
+
+void ThreadPool::work(size_t index) {
+    while (true) {
+        if (try_run_one(index)) continue;
+
+        std::unique_lock lock(m_sleep_lock);
+
+        m_wake.wait(lock, [this]() { return m_stop or m_pending > 0; });
+
+        if (m_stop and m_pending <= 0) return;
+    }
+}
+
+void ThreadPool::parallel_chunks(
+    size_t                                     count,
+    std::function<void(size_t, size_t)> const& f) {
+    if (count == 0) return;
+
+    // a few slices per worker, so claiming them evens out uneven work
+    size_t const slices = std::min<size_t>(count, size() * 4);
+
+    if (slices == 1) {
+        f(0, count);
+        return;
+    }
+
+    // Slices are claimed from a shared counter, by the tasks submitted here
+    // and by the caller, so the caller only ever runs slices of its own call
+    // and never an unrelated task that could keep it for long. A task left
+    // over once all slices are claimed returns at once, even after this call
+    // has, so the state is shared.
+    struct Call {
+        std::atomic<size_t>                        next = 0;
+        size_t                                     remaining;
+        std::exception_ptr                         error;
+        std::mutex                                 lock;
+        std::condition_variable                    done;
+        std::function<void(size_t, size_t)> const* f;
+    };
+
+    auto call       = std::make_shared<Call>();
+    call->remaining = slices;
+    call->f         = &f;
+
+    // false once every slice is claimed. `f` is only touched for a claimed
+    // slice, and the caller waits for those, so it is still alive then.
+    auto run_one = [count, slices](Call& call) {
+        auto s = call.next++;
+
+        if (s >= slices) return false;
+
+        std::exception_ptr error;
+
+        try {
+            (*call.f)(count * s / slices, count * (s + 1) / slices);
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        std::scoped_lock lock(call.lock);
+
+        if (error and !call.error) call.error = error;
+
+        if (--call.remaining == 0) call.done.notify_all();
+
+        return true;
+    };
+
+    // the caller takes one slice itself
+    for (size_t s = 1; s < slices; s++) {
+        submit([call, run_one]() { run_one(*call); });
+    }
+
+    while (run_one(*call)) { }
+
+    std::unique_lock lock(call->lock);
+
+    call->done.wait(lock, [&]() { return call->remaining == 0; });
+
+    if (call->error) std::rethrow_exception(call->error);
+}
+
+void ThreadPool::parallel_for(size_t                             count,
+                              std::function<void(size_t)> const& f) {
+    parallel_chunks(count, [&f](size_t b, size_t e) {
+        for (size_t i = b; i < e; i++) {
+            f(i);
+        }
+    });
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// A fixed set of workers, each with its own task deque. A worker runs the
+/// newest task of its own deque and, when that is empty, steals the oldest
+/// task of another. Tasks submitted from a worker stay on that worker, so
+/// nested parallel loops keep their data close.
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+private:
+    struct Queue {
+        std::mutex       lock;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread>            m_threads;
+
+    std::mutex              m_sleep_lock;
+    std::condition_variable m_wake;
+    std::atomic<int64_t>    m_pending = 0;
+    std::atomic<size_t>     m_next    = 0;
+    bool                    m_stop    = false;
+
+    bool try_run_one(size_t home);
+    void work(size_t index);
+    size_t home_queue();
+
+public:
+    explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(ThreadPool const&) = delete;
+    ThreadPool& operator=(ThreadPool const&) = delete;
+
+    /// The process wide pool, sized to the machine
+    static ThreadPool& global();
+
+    unsigned size() const { return m_threads.size(); }
+
+    void submit(Task);
+
+    /// Call `f(begin, end)` on slices of [0, count) and wait for all of
+    /// them. The calling thread works on slices of this call too, and on
+    /// nothing else, so this may be nested and may be called from any
+    /// thread. The first exception thrown by `f` is rethrown here once every
+    /// slice is done.
+    void parallel_chunks(size_t                                    count,
+                         std::function<void(size_t, size_t)> const& f);
+
+    /// Call `f(i)` for every i in [0, count) and wait
+    void parallel_for(size_t count, std::function<void(size_t)> const& f);
+};
+
+/// Sort slices in parallel, then merge neighbouring slices pairwise
+template <class T>
+void parallel_sort(std::vector<T>& values,
+                   ThreadPool&     pool = ThreadPool::global()) {
+    size_t const slices = std::bit_ceil<size_t>(pool.size());
+
+    std::vector<size_t> bounds(slices + 1);
+
+    for (size_t i = 0; i <= slices; i++) {
+        bounds[i] = values.size() * i / slices;
+    }
+
+    pool.parallel_for(slices, [&](size_t i) {
+        std::sort(values.begin() + bounds[i], values.begin() + bounds[i + 1]);
+    });
+
+    for (size_t width = 1; width < slices; width *= 2) {
+        std::vector<size_t> firsts;
+
+        for (size_t i = 0; i + width < slices; i += 2 * width) {
+            firsts.push_back(i);
+        }
+
+        pool.parallel_for(firsts.size(), [&](size_t f) {
+            auto i    = firsts[f];
+            auto last = std::min(i + 2 * width, slices);
+            std::inplace_merge(values.begin() + bounds[i],
+                               values.begin() + bounds[i + width],
+                               values.begin() + bounds[last]);
+        });
+    }
+}
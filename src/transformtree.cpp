@@ -0,0 +1,203 @@
+#include "transformtree.h"
+
+#include <glm/common.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+
+Bounds Bounds::transformed(glm::mat4 const& tf) const {
+    if (empty()) return {};
+
+    auto center = (min + max) * 0.5f;
+    auto half   = (max - min) * 0.5f;
+
+    glm::mat3 m(tf);
+
+    glm::vec3 new_center = glm::vec3(tf * glm::vec4(center, 1));
+    glm::vec3 new_half   = glm::abs(m[0]) * half.x + glm::abs(m[1]) * half.y +
+                         glm::abs(m[2]) * half.z;
+
+    return { new_center - new_half, new_center + new_half };
+}
+
+// =============================================================================
+
+void TransformTree::mark(uint32_t i) {
+    if (m_nodes[i].dirty) return;
+    m_nodes[i].dirty = true;
+    m_dirty.push_back(i);
+}
+
+void TransformTree::refresh_bounds(uint32_t i) {
+    auto& n = m_nodes[i];
+
+    n.subtree = n.own.transformed(n.world);
+
+    for (auto c = n.first_child; c != none; c = m_nodes[c].next_sibling) {
+        n.subtree.grow(m_nodes[c].subtree);
+    }
+}
+
+uint32_t TransformTree::add(uint32_t         parent,
+                            glm::mat4 const& local,
+                            Bounds const&    own) {
+    assert(parent == none or parent < m_nodes.size());
+
+    auto index = (uint32_t)m_nodes.size();
+
+    Node n;
+    n.parent = parent;
+    n.local  = local;
+    n.own    = own;
+
+    if (parent == none) {
+        m_roots.push_back(index);
+    } else {
+        // children end up in reverse order, which no box cares about
+        n.next_sibling              = m_nodes[parent].first_child;
+        m_nodes[parent].first_child = index;
+    }
+
+    m_nodes.push_back(n);
+    m_dirty.push_back(index);
+
+    return index;
+}
+
+void TransformTree::set_local(uint32_t i, glm::mat4 const& local) {
+    if (m_nodes[i].local == local) return;
+    m_nodes[i].local = local;
+    mark(i);
+}
+
+void TransformTree::set_bounds(uint32_t i, Bounds const& own) {
+    m_nodes[i].own = own;
+    mark(i);
+}
+
+size_t TransformTree::update() {
+    if (m_dirty.empty()) return 0;
+
+    // parents have the smaller index, so a dirty ancestor is redone first and
+    // takes the dirty nodes below it along
+    std::sort(m_dirty.begin(), m_dirty.end());
+
+    size_t recomputed = 0;
+
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> ancestors;
+
+    for (auto top : m_dirty) {
+        if (!m_nodes[top].dirty) continue;
+
+        // breadth first, so every parent is done before its children
+        order.assign(1, top);
+
+        for (size_t i = 0; i < order.size(); i++) {
+            auto c = m_nodes[order[i]].first_child;
+            for (; c != none; c = m_nodes[c].next_sibling) {
+                order.push_back(c);
+            }
+        }
+
+        for (auto i : order) {
+            auto& n = m_nodes[i];
+            n.world =
+                n.parent == none ? n.local : m_nodes[n.parent].world * n.local;
+            n.dirty = false;
+        }
+
+        std::for_each(order.rbegin(), order.rend(), [this](uint32_t i) {
+            refresh_bounds(i);
+        });
+
+        recomputed += order.size();
+
+        for (auto p = m_nodes[top].parent; p != none; p = m_nodes[p].parent) {
+            ancestors.push_back(p);
+        }
+    }
+
+    // deepest first, so each box is redone after those of its children
+    std::sort(ancestors.begin(), ancestors.end(), std::greater<>());
+    ancestors.erase(std::unique(ancestors.begin(), ancestors.end()),
+                    ancestors.end());
+
+    for (auto a : ancestors) {
+        refresh_bounds(a);
+    }
+
+    m_dirty.clear();
+
+    return recomputed;
+}
+
+Bounds TransformTree::bounds() const {
+    Bounds ret;
+    for (auto r : m_roots) {
+        ret.grow(m_nodes[r].subtree);
+    }
+    return ret;
+}
+
+void TransformTree::clear() {
+    m_nodes.clear();
+    m_roots.clear();
+    m_dirty.clear();
+}
+
+size_t TransformTree::byte_size() const {
+    return m_nodes.capacity() * sizeof(Node) +
+           (m_roots.capacity() + m_dirty.capacity()) * sizeof(uint32_t);
+}
+
+// =============================================================================
+
+void BoundsSet::insert(Bounds const& b) {
+    for (int a = 0; a < 3; a++) {
+        m_mins[a].insert(b.min[a]);
+        m_maxs[a].insert(b.max[a]);
+    }
+}
+
+void BoundsSet::erase(Bounds const& b) {
+    for (int a = 0; a < 3; a++) {
+        m_mins[a].erase(m_mins[a].find(b.min[a]));
+        m_maxs[a].erase(m_maxs[a].find(b.max[a]));
+    }
+}
+
+void BoundsSet::set(int key, Bounds const& b) {
+    remove(key);
+
+    // NaN would break the ordering of the sets
+    if (b.empty() or glm::any(glm::isnan(b.min)) or
+        glm::any(glm::isnan(b.max))) {
+        return;
+    }
+
+    m_members.emplace(key, b);
+    insert(b);
+}
+
+void BoundsSet::remove(int key) {
+    auto iter = m_members.find(key);
+    if (iter == m_members.end()) return;
+
+    erase(iter->second);
+    m_members.erase(iter);
+}
+
+Bounds BoundsSet::bounds() const {
+    Bounds ret;
+
+    if (m_members.empty()) return ret;
+
+    for (int a = 0; a < 3; a++) {
+        ret.min[a] = *m_mins[a].begin();
+        ret.max[a] = *m_maxs[a].rbegin();
+    }
+
+    return ret;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "noo_include_glm.h"
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+/// An axis aligned box; empty until something is added
+struct Bounds {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+
+    bool empty() const { return glm::any(glm::greaterThan(min, max)); }
+
+    glm::vec3 size() const { return empty() ? glm::vec3(0) : max - min; }
+
+    void grow(glm::vec3 p) {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+
+    void grow(Bounds const& b) {
+        min = glm::min(min, b.min);
+        max = glm::max(max, b.max);
+    }
+
+    /// The box around this box once transformed
+    Bounds transformed(glm::mat4 const&) const;
+};
+
+/// Node transforms of a model and the bounds of what each node shows. Each
+/// node caches its world transform and the box of its subtree; changing a
+/// node marks it dirty, and update() redoes only dirty subtrees and the boxes
+/// of their ancestors. Parents are added before their children.
+class TransformTree {
+public:
+    static constexpr uint32_t none = std::numeric_limits<uint32_t>::max();
+
+private:
+    struct Node {
+        uint32_t  parent       = none;
+        uint32_t  first_child  = none;
+        uint32_t  next_sibling = none;
+        glm::mat4 local        = glm::mat4(1);
+        glm::mat4 world        = glm::mat4(1);
+        Bounds    own;     // of the node's meshes, in node space
+        Bounds    subtree; // of the node and all below, in tree space
+        bool      dirty = true;
+    };
+
+    std::vector<Node>     m_nodes;
+    std::vector<uint32_t> m_roots;
+    std::vector<uint32_t> m_dirty;
+
+    void mark(uint32_t);
+    void refresh_bounds(uint32_t);
+
+public:
+    /// Returns the index of the new node
+    uint32_t add(uint32_t parent, glm::mat4 const& local, Bounds const& own);
+
+    void set_local(uint32_t, glm::mat4 const&);
+    void set_bounds(uint32_t, Bounds const&);
+
+    /// Bring world transforms and boxes up to date. Returns the number of
+    /// nodes whose world transform was recomputed.
+    size_t update();
+
+    size_t size() const { return m_nodes.size(); }
+
+    // as of the last update
+    glm::mat4 const& world(uint32_t i) const { return m_nodes[i].world; }
+    Bounds const&    subtree_bounds(uint32_t i) const {
+        return m_nodes[i].subtree;
+    }
+
+    /// Box of the whole tree, as of the last update
+    Bounds bounds() const;
+
+    void clear();
+
+    size_t byte_size() const;
+};
+
+/// The box around many keyed boxes. Each face of the box is the extreme of
+/// an ordered set of the faces of the members, so a member can be added,
+/// moved or removed in logarithmic time, without a rescan.
+class BoundsSet {
+    std::unordered_map<int, Bounds> m_members;
+
+    std::array<std::multiset<float>, 3> m_mins;
+    std::array<std::multiset<float>, 3> m_maxs;
+
+    void insert(Bounds const&);
+    void erase(Bounds const&);
+
+public:
+    /// Add a member, or move it if present. Empty boxes are dropped.
+    void set(int key, Bounds const&);
+
+    void remove(int key);
+
+    Bounds bounds() const;
+};
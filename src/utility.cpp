@@ -1,5 +1,9 @@
 #include "utility.h"
 
+#include <QColor>
+
+#include <array>
+
 std::pair<glm::vec3, glm::vec3> min_max_of(std::span<glm::vec3 const> v) {
 
     if (v.empty()) return { {}, {} };
@@ -32,35 +36,72 @@ std::pair<glm::vec3, glm::vec3> min_max_of(std::span<double const> x,
     return { lmin, lmax };
 }
 
-void update_instances(std::span<glm::mat4 const> instances,
-                      noo::DocumentTPtr          doc,
-                      noo::ObjectTPtr            object,
-                      noo::MeshTPtr              mesh) {
-    auto src_bytes = (const char*)instances.data();
-
-    QByteArray array(src_bytes, instances.size_bytes());
-
-    auto new_buffer = noo::create_buffer(
-        doc,
-        noo::BufferData {
-            .source = noo::BufferInlineSource { .data = array },
-        });
-
-    auto view = noo::create_buffer_view(doc,
-                                        noo::BufferViewData {
-                                            .source_buffer = new_buffer,
-                                            .type   = noo::ViewType::UNKNOWN,
-                                            .offset = 0,
-                                            .length = (uint64_t)array.size(),
-                                        });
-
-    noo::ObjectUpdateData update { .definition =
-                                       noo::ObjectRenderableDefinition {
-                                           .mesh      = mesh,
-                                           .instances = noo::InstanceInfo {
-                                               .view   = view,
-                                               .stride = 0,
-                                           } } };
-
-    noo::update_object(object, update);
+noo::ObjectTPtr make_bounds_proxy(noo::DocumentTPtrRef doc,
+                                  noo::ObjectTPtr      parent,
+                                  glm::vec3            min,
+                                  glm::vec3            max) {
+    if (glm::any(glm::greaterThan(min, max))) {
+        min = glm::vec3(0);
+        max = glm::vec3(0);
+    }
+
+    std::array<glm::vec3, 8> positions;
+
+    for (int i = 0; i < 8; i++) {
+        positions[i] = glm::vec3((i & 1) ? max.x : min.x,
+                                 (i & 2) ? max.y : min.y,
+                                 (i & 4) ? max.z : min.z);
+    }
+
+    std::array<uint32_t, 24> indices = {
+        0, 1, 2, 3, 4, 5, 6, 7, // along x
+        0, 2, 1, 3, 4, 6, 5, 7, // along y
+        0, 4, 1, 5, 2, 6, 3, 7, // along z
+    };
+
+    noo::MaterialData mat_data;
+    mat_data.pbr_info.emplace().base_color = QColor(Qt::gray);
+
+    noo::MeshSource source;
+    source.material     = noo::create_material(doc, mat_data);
+    source.positions    = positions;
+    source.indices      = std::as_writable_bytes(std::span(indices));
+    source.index_format = noo::Format::U32;
+    source.type         = noo::MeshSource::LINE;
+
+    noo::ObjectData obj_data;
+    obj_data.name       = "Bounds";
+    obj_data.parent     = parent;
+    obj_data.definition = noo::ObjectRenderableDefinition {
+        .mesh = noo::create_mesh(doc, source),
+    };
+    obj_data.tags = QStringList() << noo::names::tag_user_hidden;
+
+    return noo::create_object(doc, obj_data);
+}
+
+noo::MeshTPtr make_point_glyph(noo::DocumentTPtrRef doc) {
+    std::array<glm::vec3, 6> positions = {
+        glm::vec3(0.5, 0, 0),  glm::vec3(-0.5, 0, 0),
+        glm::vec3(0, 0.5, 0),  glm::vec3(0, -0.5, 0),
+        glm::vec3(0, 0, 0.5),  glm::vec3(0, 0, -0.5),
+    };
+
+    // counter clockwise seen from outside
+    std::array<uint32_t, 24> indices = {
+        0, 2, 4, 2, 1, 4, 1, 3, 4, 3, 0, 4, // around +z
+        2, 0, 5, 1, 2, 5, 3, 1, 5, 0, 3, 5, // around -z
+    };
+
+    noo::MaterialData mat_data;
+    mat_data.pbr_info.emplace().base_color = QColor(Qt::white);
+
+    noo::MeshSource source;
+    source.material     = noo::create_material(doc, mat_data);
+    source.positions    = positions;
+    source.indices      = std::as_writable_bytes(std::span(indices));
+    source.index_format = noo::Format::U32;
+    source.type         = noo::MeshSource::TRIANGLE;
+
+    return noo::create_mesh(doc, source);
 }
@@ -12,7 +12,12 @@ std::pair<glm::vec3, glm::vec3> min_max_of(std::span<double const> x,
                                            std::span<double const> y,
                                            std::span<double const> z);
 
-void update_instances(std::span<glm::mat4 const> instances,
-                      noo::DocumentTPtr          doc,
-                      noo::ObjectTPtr            object,
-                      noo::MeshTPtr              mesh);
+/// A wireframe box, parented to `parent`, that stands in for geometry that
+/// is not loaded.
+noo::ObjectTPtr make_bounds_proxy(noo::DocumentTPtrRef doc,
+                                  noo::ObjectTPtr      parent,
+                                  glm::vec3            min,
+                                  glm::vec3            max);
+
+/// An octahedron one unit across, for instances that stand for points
+noo::MeshTPtr make_point_glyph(noo::DocumentTPtrRef doc);
@@ -0,0 +1,313 @@
+#include "weld.h"
+
+#include "threadpool.h"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include <QDebug>
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <limits>
+#include <mutex>
+
+namespace {
+
+constexpr int cell_bits = 21;
+
+struct KeyedVertex {
+    uint64_t key;
+    uint64_t attributes;
+    uint32_t index;
+
+    // ties by index, so the first vertex of a cell leads its run
+    bool operator<(KeyedVertex const& o) const {
+        if (key != o.key) return key < o.key;
+        if (attributes != o.attributes) return attributes < o.attributes;
+        return index < o.index;
+    }
+
+    bool same_key(KeyedVertex const& o) const {
+        return key == o.key and attributes == o.attributes;
+    }
+};
+
+/// A vertex keyed on the bits of its position and of its normal, or of its
+/// attribute key
+struct ExactVertex {
+    std::array<uint32_t, 6> bits;
+    uint32_t                index;
+
+    bool operator<(ExactVertex const& o) const {
+        if (bits != o.bits) return bits < o.bits;
+        return index < o.index;
+    }
+
+    bool same_key(ExactVertex const& o) const { return bits == o.bits; }
+};
+
+// negative zero has to meet positive zero
+uint32_t bits_of(float f) { return std::bit_cast<uint32_t>(f + 0.0f); }
+
+/// Point every vertex at the first vertex of its run of equal keys in the
+/// sorted order. A chunk skips a run that started in the chunk before it.
+template <class Keyed>
+std::vector<uint32_t> find_leaders(std::vector<Keyed> const& order,
+                                   ThreadPool&               pool) {
+    size_t const count = order.size();
+
+    std::vector<uint32_t> leader(count);
+
+    pool.parallel_chunks(count, [&](size_t b, size_t e) {
+        size_t i = b;
+
+        while (i > 0 and i < e and order[i].same_key(order[i - 1])) i++;
+
+        while (i < e) {
+            size_t j = i + 1;
+            while (j < count and order[j].same_key(order[i])) j++;
+
+            for (size_t k = i; k < j; k++) {
+                leader[order[k].index] = order[i].index;
+            }
+
+            i = j;
+        }
+    });
+
+    return leader;
+}
+
+/// Number the leaders in their original order and give every vertex the
+/// number of its leader. Returns how many were kept.
+uint32_t remap_to_leaders(std::vector<uint32_t> const& leader,
+                          std::vector<uint32_t>&       remap,
+                          ThreadPool&                  pool) {
+    size_t const count = leader.size();
+
+    remap.resize(count);
+
+    uint32_t kept = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        if (leader[i] == i) remap[i] = kept++;
+    }
+
+    pool.parallel_chunks(count, [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; i++) {
+            if (leader[i] != i) remap[i] = remap[leader[i]];
+        }
+    });
+
+    return kept;
+}
+
+/// The leader behind every kept vertex
+std::vector<uint32_t> leader_sources(std::vector<uint32_t> const& leader,
+                                     std::vector<uint32_t> const& remap,
+                                     uint32_t                     kept,
+                                     ThreadPool&                  pool) {
+    std::vector<uint32_t> ret(kept);
+
+    pool.parallel_chunks(leader.size(), [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; i++) {
+            if (leader[i] == i) ret[remap[i]] = i;
+        }
+    });
+
+    return ret;
+}
+
+std::vector<glm::vec3> gather(std::span<glm::vec3 const>   values,
+                              std::vector<uint32_t> const& sources,
+                              ThreadPool&                  pool) {
+    std::vector<glm::vec3> ret(sources.size());
+
+    pool.parallel_chunks(sources.size(), [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; i++) {
+            ret[i] = values[sources[i]];
+        }
+    });
+
+    return ret;
+}
+
+/// Merge the vertices of equal keys into the first of them
+template <class Keyed>
+WeldResult weld_keyed(std::vector<Keyed>         order,
+                      std::span<glm::vec3 const> positions,
+                      ThreadPool&                pool) {
+    WeldResult ret;
+
+    parallel_sort(order, pool);
+
+    auto leader = find_leaders(order, pool);
+
+    order = {};
+
+    auto kept = remap_to_leaders(leader, ret.remap, pool);
+
+    ret.sources   = leader_sources(leader, ret.remap, kept, pool);
+    ret.positions = gather(positions, ret.sources, pool);
+
+    return ret;
+}
+
+} // namespace
+
+WeldResult weld_positions(std::span<glm::vec3 const> positions,
+                          float                      tolerance,
+                          std::span<uint64_t const>  attributes) {
+    QElapsedTimer timer;
+    timer.start();
+
+    auto& pool = ThreadPool::global();
+
+    size_t const count = positions.size();
+
+    WeldResult ret;
+
+    if (count == 0) return ret;
+
+    if (tolerance <= 0) {
+        std::vector<ExactVertex> order(count);
+
+        pool.parallel_chunks(count, [&](size_t b, size_t e) {
+            for (size_t i = b; i < e; i++) {
+                auto const& p = positions[i];
+                auto const  a = attributes.empty() ? 0 : attributes[i];
+
+                order[i] = { { bits_of(p.x),
+                               bits_of(p.y),
+                               bits_of(p.z),
+                               uint32_t(a),
+                               uint32_t(a >> 32),
+                               0 },
+                             (uint32_t)i };
+            }
+        });
+
+        ret = weld_keyed(std::move(order), positions, pool);
+
+        qDebug() << "Welded" << (qint64)count << "vertices into"
+                 << (qint64)ret.sources.size() << "exactly in"
+                 << timer.elapsed() << "ms";
+
+        return ret;
+    }
+
+    glm::vec3 lmin(std::numeric_limits<float>::max());
+    glm::vec3 lmax(std::numeric_limits<float>::lowest());
+
+    std::mutex bounds_lock;
+
+    pool.parallel_chunks(count, [&](size_t b, size_t e) {
+        glm::vec3 cmin(std::numeric_limits<float>::max());
+        glm::vec3 cmax(std::numeric_limits<float>::lowest());
+
+        for (size_t i = b; i < e; i++) {
+            cmin = glm::min(cmin, positions[i]);
+            cmax = glm::max(cmax, positions[i]);
+        }
+
+        std::scoped_lock lock(bounds_lock);
+        lmin = glm::min(lmin, cmin);
+        lmax = glm::max(lmax, cmax);
+    });
+
+    auto extent   = lmax - lmin;
+    auto max_edge = std::max({ extent.x, extent.y, extent.z, 1e-6f });
+
+    float const cell = std::max(tolerance, max_edge / (1 << cell_bits));
+
+    std::vector<KeyedVertex> order(count);
+
+    pool.parallel_chunks(count, [&](size_t b, size_t e) {
+        constexpr float top = (1 << cell_bits) - 1;
+
+        for (size_t i = b; i < e; i++) {
+            auto c = glm::u64vec3(
+                glm::clamp((positions[i] - lmin) / cell, 0.0f, top));
+
+            order[i] = { c.x | c.y << cell_bits | c.z << (2 * cell_bits),
+                         attributes.empty() ? 0 : attributes[i],
+                         (uint32_t)i };
+        }
+    });
+
+    ret = weld_keyed(std::move(order), positions, pool);
+
+    qDebug() << "Welded" << (qint64)count << "vertices into"
+             << (qint64)ret.sources.size() << "in" << timer.elapsed() << "ms";
+
+    return ret;
+}
+
+size_t remap_triangles(std::vector<uint32_t>&       indices,
+                       std::vector<uint32_t> const& remap) {
+    auto& pool = ThreadPool::global();
+
+    pool.parallel_chunks(indices.size(), [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; i++) {
+            indices[i] = remap[indices[i]];
+        }
+    });
+
+    size_t out = 0;
+
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        auto a = indices[t], b = indices[t + 1], c = indices[t + 2];
+
+        if (a == b or b == c or a == c) continue;
+
+        indices[out++] = a;
+        indices[out++] = b;
+        indices[out++] = c;
+    }
+
+    indices.resize(out);
+
+    return out;
+}
+
+WeldResult join_identical(std::span<glm::vec3 const> positions,
+                          std::span<glm::vec3 const> normals) {
+    QElapsedTimer timer;
+    timer.start();
+
+    auto& pool = ThreadPool::global();
+
+    size_t const count = positions.size();
+
+    WeldResult ret;
+
+    if (count == 0) return ret;
+
+    std::vector<ExactVertex> order(count);
+
+    pool.parallel_chunks(count, [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; i++) {
+            auto const& p = positions[i];
+            auto const& n = normals[i];
+
+            order[i] = { { bits_of(p.x),
+                           bits_of(p.y),
+                           bits_of(p.z),
+                           bits_of(n.x),
+                           bits_of(n.y),
+                           bits_of(n.z) },
+                         (uint32_t)i };
+        }
+    });
+
+    ret         = weld_keyed(std::move(order), positions, pool);
+    ret.normals = gather(normals, ret.sources, pool);
+
+    qDebug() << "Joined" << (qint64)count << "vertices into"
+             << (qint64)ret.sources.size() << "in" << timer.elapsed() << "ms";
+
+    return ret;
+}
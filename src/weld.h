@@ -0,0 +1,46 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/// Vertices merged by position
+struct WeldResult {
+    // the first of every group of merged vertices, in their original order
+    std::vector<glm::vec3> positions;
+
+    // normals of the kept vertices, if merging looked at normals
+    std::vector<glm::vec3> normals;
+
+    // new index of every input vertex
+    std::vector<uint32_t> remap;
+
+    // input vertex each kept vertex was taken from
+    std::vector<uint32_t> sources;
+};
+
+/// Merge vertices whose positions are bit for bit the same or, with a
+/// tolerance, that fall into the same cell of a grid `tolerance` wide. Keys,
+/// sorting and remapping all run on the thread pool. The grid is an
+/// approximation: neighbouring cells are never compared, so two vertices
+/// closer than the tolerance may straddle a cell edge and stay apart, while
+/// two in one cell merge up to the diagonal of a cell apart. The grid never
+/// gets finer than 2^21 cells across the bounds. If given, `attributes` holds
+/// a key per vertex, such as a hash of its normal and texture coordinates,
+/// that has to match as well.
+WeldResult weld_positions(std::span<glm::vec3 const> positions,
+                          float                      tolerance  = 0,
+                          std::span<uint64_t const>  attributes = {});
+
+/// Merge vertices whose position and normal are both bit for bit the same,
+/// as Assimp's JoinIdenticalVertices does for a triangle soup, on the thread
+/// pool.
+WeldResult join_identical(std::span<glm::vec3 const> positions,
+                          std::span<glm::vec3 const> normals);
+
+/// Apply a weld to triangle indices in place, dropping triangles that
+/// collapsed. Returns the new index count.
+size_t remap_triangles(std::vector<uint32_t>&       indices,
+                       std::vector<uint32_t> const& remap);
@@ -1,5 +1,10 @@
 #include "xdmfimporter.h"
 
+#include "mappediosystem.h"
+#include "metrics.h"
+#include "threadpool.h"
+#include "weld.h"
+
 #include <assimp/Importer.hpp>
 #include <assimp/cimport.h>
 #include <assimp/postprocess.h>
@@ -10,82 +15,26 @@
 #include <QDomDocument>
 #include <QFile>
 #include <QFileInfo>
+#include <QRegularExpression>
+#include <QSet>
 
 #include <QDebug>
 
-#include <span>
-
-using ReturnType = std::optional<QString>;
-
-struct MappedFile {
-    enum PType {
-        Float32,
-        Float64,
-        Int32,
-        Int64,
-    };
-
-    QFile                    file;
-    std::span<unsigned char> bytes;
-    PType                    type = PType::Float32;
-
-    void reset_span(size_t count) {
-        size_t bcount = count;
-
-        switch (type) {
-        case Float32:
-        case Int32: bcount *= 4; break;
-        case Float64:
-        case Int64: bcount *= 8; break;
-        }
-
-        assert(bcount < bytes.size());
-
-        bytes = bytes.subspan(0, bcount);
-    }
-
-    MappedFile(QString path, size_t offset, size_t span = 0) : file(path) {
-        if (!file.open(QFile::ReadOnly)) return;
-
-        qDebug() << "Mapping" << path << file.size();
-
-        offset = std::min<size_t>(offset, file.size());
-
-        if (span == 0) { span = file.size() - offset; }
-
-        auto mapped_bytes = file.map(offset, span);
-
-        if (!mapped_bytes) return;
-
-        bytes = std::span<unsigned char>(mapped_bytes, span);
-    }
-};
-
-class XDMFImporter {
-    QString m_file_path;
-    QDir    m_directory;
-
-    aiScene* m_scene;
-
-    QString resolve_path(QString path);
-
-    std::shared_ptr<MappedFile> get_data(QDomElement element);
-
-    std::shared_ptr<MappedFile> consume_conn(QDomElement element);
-    std::shared_ptr<MappedFile> consume_geom(QDomElement element);
-
-    void consume_grid(QDomElement element);
-    void consume_domain(QDomElement element);
-
-public:
-    XDMFImporter(QString file_path, aiScene* scene);
-
-    ReturnType parse(QFile& file);
-};
-
-
-XDMFImporter::XDMFImporter(QString file_path, aiScene* scene)
-    : m_file_path(file_path), m_scene(scene) {
+#include <algorithm>
+#include <limits>
+
+XDMFImporter::XDMFImporter(QString              file_path,
+                           aiScene*             scene,
+                           Assimp::IOSystem*    io,
+                           bool                 keep_partitions,
+                           std::optional<float> iso_value,
+                           bool                 async_io)
+    : m_file_path(file_path),
+      m_scene(scene),
+      m_io(io),
+      m_keep_partitions(keep_partitions),
+      m_async_io(async_io),
+      m_iso_value(iso_value) {
     QFileInfo info(file_path);
 
     Q_ASSERT(info.exists());
@@ -142,12 +91,49 @@ MappedFile::PType convert_data_type(QString format, int precision) {
     return MappedFile::Float32;
 }
 
-std::shared_ptr<MappedFile> XDMFImporter::get_data(QDomElement element) {
+// Map a data file through the importer's IOSystem. Returns null if the stream
+// cannot be used in place, so the caller can map it directly instead.
+static std::shared_ptr<MappedFile>
+map_through(Assimp::IOSystem& io, QString path, size_t offset) {
+    auto* raw = io.Open(path.toLocal8Bit().constData(), "rb");
+
+    if (!raw) return {};
+
+    auto stream = std::shared_ptr<Assimp::IOStream>(
+        raw, [&io](Assimp::IOStream* s) { io.Close(s); });
+
+    auto* mapped = dynamic_cast<MappedIOStream*>(raw);
+
+    if (!mapped) return {};
+
+    auto whole = mapped->mapping();
+
+    offset = std::min(offset, whole.size());
+
+    auto ret    = std::make_shared<MappedFile>();
+    ret->stream = stream;
+    ret->bytes  = std::span<unsigned char>(
+        const_cast<unsigned char*>(whole.data()) + offset,
+        whole.size() - offset);
+
+    return ret;
+}
+
+std::optional<XDMFImporter::DataSpec>
+XDMFImporter::data_spec(QDomElement element) {
     auto format    = element.attribute("Format");
     auto precision = element.attribute("Precision", "-1").toLong();
     auto data_type = element.attribute("DataType");
     auto seek      = element.attribute("Seek", "0").toLong();
-    auto dims      = element.attribute("Dimensions", "0").toLong();
+
+    // values in all, whatever the shape: "N 3" for points, "Z Y X" for a
+    // field over a structured grid
+    long dims = 0;
+
+    for (auto const& part :
+         element.attribute("Dimensions").split(' ', Qt::SkipEmptyParts)) {
+        dims = std::max(dims, 1L) * part.toLong();
+    }
 
     qInfo() << "Fetching data with format" << format << "precision" << precision
             << "data type" << data_type << "seek" << seek << "dims" << dims;
@@ -158,20 +144,128 @@ std::shared_ptr<MappedFile> XDMFImporter::get_data(QDomElement element) {
 
     if (data_file_path.isEmpty()) return {};
 
-    auto ret = std::make_shared<MappedFile>(data_file_path, seek);
+    return DataSpec {
+        .path  = data_file_path,
+        .type  = convert_data_type(data_type, precision),
+        .seek  = (size_t)seek,
+        .count = (size_t)dims,
+    };
+}
+
+std::shared_ptr<MappedFile> XDMFImporter::map_data(DataSpec const& spec) const {
+    // a failed read was reported when it was started; mapping may yet work
+    if (auto read = m_reads.value(read_key(spec))) {
+        auto bytes = read->wait();
+
+        if (!bytes.empty()) {
+            auto ret    = std::make_shared<MappedFile>();
+            ret->stream = read;
+            ret->bytes  = bytes;
+            ret->type   = spec.type;
+            return ret;
+        }
+    }
+
+    std::shared_ptr<MappedFile> ret;
+
+    if (m_io) ret = map_through(*m_io, spec.path, spec.seek);
+
+    if (!ret) ret = std::make_shared<MappedFile>(spec.path, spec.seek);
 
     if (ret->bytes.empty()) return {};
 
-    ret->type = convert_data_type(data_type, precision);
-    ret->reset_span(dims);
+    ret->type = spec.type;
+    ret->reset_span(spec.count);
     qDebug() << "Mapped:" << ret->bytes.size() << "as" << ret->type;
 
     return ret;
 }
 
-std::shared_ptr<MappedFile> XDMFImporter::consume_conn(QDomElement element) {
-    if (element.attribute("TopologyType") != "Triangle") {
-        qCritical() << "Topology type is not supported (Triangles only)";
+QString XDMFImporter::read_key(DataSpec const& spec) {
+    return QStringLiteral("%1@%2+%3")
+        .arg(spec.path)
+        .arg(spec.seek)
+        .arg(spec.count * MappedFile::type_size(spec.type));
+}
+
+void XDMFImporter::read_ahead(std::span<GridSpec const> grids) {
+    std::vector<AsyncReader::Request> requests;
+    std::vector<QString>              keys;
+
+    auto add = [&](DataSpec const& spec) {
+        if (spec.path.isEmpty() or spec.count == 0) return;
+
+        auto key = read_key(spec);
+
+        if (m_reads.contains(key)) return;
+
+        // claimed now so grids sharing the item read it once
+        m_reads.insert(key, nullptr);
+        keys.push_back(key);
+
+        requests.push_back({
+            .path   = spec.path,
+            .offset = spec.seek,
+            .length = spec.count * MappedFile::type_size(spec.type),
+        });
+    };
+
+    for (auto const& grid : grids) {
+        add(grid.conn);
+        add(grid.geom);
+        if (grid.attribute and grid.attribute->data) {
+            add(*grid.attribute->data);
+        }
+    }
+
+    if (requests.empty()) return;
+
+    auto reads = m_reader->submit(requests);
+
+    for (size_t i = 0; i < reads.size(); i++) {
+        m_reads[keys[i]] = std::move(reads[i]);
+    }
+}
+
+void XDMFImporter::forget_reads(std::span<GridSpec const> done,
+                                std::span<GridSpec const> next) {
+    auto keys_of = [](GridSpec const& grid) {
+        std::vector<QString> ret = { read_key(grid.conn), read_key(grid.geom) };
+        if (grid.attribute and grid.attribute->data) {
+            ret.push_back(read_key(*grid.attribute->data));
+        }
+        return ret;
+    };
+
+    QSet<QString> kept;
+
+    for (auto const& grid : next) {
+        for (auto const& key : keys_of(grid)) {
+            kept.insert(key);
+        }
+    }
+
+    for (auto const& grid : done) {
+        for (auto const& key : keys_of(grid)) {
+            if (!kept.contains(key)) m_reads.remove(key);
+        }
+    }
+}
+
+std::optional<XDMFImporter::DataSpec>
+XDMFImporter::consume_conn(QDomElement element, unsigned& cell_size) {
+    auto type = element.attribute("TopologyType");
+
+    if (type == "Triangle") {
+        cell_size = 3;
+    } else if (type == "Tetrahedron") {
+        cell_size = 4;
+    } else if (type == "Hexahedron") {
+        cell_size = 8;
+    } else {
+        qCritical() << "Topology type" << type
+                    << "is not supported (Triangle, Tetrahedron and "
+                       "Hexahedron only)";
         return {};
     }
 
@@ -193,7 +287,7 @@ std::shared_ptr<MappedFile> XDMFImporter::consume_conn(QDomElement element) {
         return {};
     }
 
-    auto data = get_data(data_elem);
+    auto data = data_spec(data_elem);
 
     if (!data) {
         qCritical() << "Missing connectivity data file";
@@ -203,7 +297,8 @@ std::shared_ptr<MappedFile> XDMFImporter::consume_conn(QDomElement element) {
     return data;
 }
 
-std::shared_ptr<MappedFile> XDMFImporter::consume_geom(QDomElement element) {
+std::optional<XDMFImporter::DataSpec>
+XDMFImporter::consume_geom(QDomElement element) {
     if (element.attribute("GeometryType") != "XYZ") {
         qCritical() << "Unknown geometry type";
         return {};
@@ -215,158 +310,574 @@ std::shared_ptr<MappedFile> XDMFImporter::consume_geom(QDomElement element) {
 
         if (node_elem.attribute("Name") != "Coord") { continue; }
 
-        auto data = get_data(node_elem);
+        return data_spec(node_elem);
+    }
+
+    return {};
+}
+
+std::optional<XDMFImporter::AttributeSpec>
+XDMFImporter::consume_attribute(QDomElement grid) {
+    auto element = grid.firstChildElement("Attribute");
+
+    // the first scalar is the field; vectors and tensors have no isosurface
+    for (; !element.isNull();
+         element = element.nextSiblingElement("Attribute")) {
+        auto name   = element.attribute("Name");
+        auto type   = element.attribute("AttributeType", "Scalar");
+        auto center = element.attribute("Center", "Node");
+
+        if (type != "Scalar" or (center != "Node" and center != "Cell")) {
+            qInfo() << "Skipping" << type << "attribute" << name
+                    << "centered on" << center;
+            continue;
+        }
+
+        auto item = element.firstChildElement("DataItem");
 
-        return data;
+        if (item.isNull()) continue;
+
+        AttributeSpec ret {
+            .name          = name,
+            .cell_centered = center == "Cell",
+        };
+
+        if (item.attribute("Format", "XML") == "XML") {
+            auto values = read_values(item);
+            if (!values) return {};
+            ret.values.assign(values->begin(), values->end());
+        } else if (!(ret.data = data_spec(item))) {
+            qCritical() << "Missing data of attribute" << name;
+            return {};
+        }
+
+        return ret;
     }
 
     return {};
 }
 
-template <class T, class U>
-std::span<T> span_as(std::span<U> other) {
-    static_assert(std::is_trivial_v<T> and std::is_trivial_v<U>);
+std::optional<std::vector<double>>
+XDMFImporter::read_values(QDomElement item) {
+    // XML is the default format; the values are the element text
+    if (item.attribute("Format", "XML") == "XML") {
+        auto parts = item.text().split(QRegularExpression("\\s+"),
+                                       Qt::SkipEmptyParts);
+
+        std::vector<double> ret;
+        ret.reserve(parts.size());
+
+        for (auto const& part : parts) {
+            bool ok;
+            ret.push_back(part.toDouble(&ok));
+            if (!ok) {
+                qCritical() << "Bad value in data item:" << part;
+                return {};
+            }
+        }
+
+        return ret;
+    }
+
+    auto spec = data_spec(item);
+    if (!spec) return {};
 
-    return { reinterpret_cast<T*>(other.data()), other.size() / sizeof(T) };
+    auto mapped = map_data(*spec);
+    if (!mapped) return {};
+
+    return interpret_mapped(*mapped, [](auto span) {
+        return std::vector<double>(span.begin(), span.end());
+    });
 }
 
-template <class Function>
-auto interpret_mapped(MappedFile& file, Function&& f) {
-    switch (file.type) {
-    case MappedFile::Float32: return f(span_as<float>(file.bytes));
-    case MappedFile::Float64: return f(span_as<double>(file.bytes));
-    case MappedFile::Int32: return f(span_as<int32_t>(file.bytes));
-    case MappedFile::Int64: return f(span_as<int64_t>(file.bytes));
+std::optional<XDMFImporter::GridSpec>
+XDMFImporter::structured_spec(QString     name,
+                              QDomElement topology,
+                              QDomElement geometry) {
+    auto type          = topology.attribute("TopologyType");
+    auto geometry_type = geometry.attribute("GeometryType");
+
+    bool const is_3d = type.startsWith("3D");
+
+    std::vector<std::vector<double>> items;
+
+    auto item = geometry.firstChildElement("DataItem");
+
+    for (; !item.isNull(); item = item.nextSiblingElement("DataItem")) {
+        auto values = read_values(item);
+        if (!values) return {};
+        items.push_back(std::move(*values));
+    }
+
+    // XDMF lists dimensions, origins and spacings slowest axis first: z y x
+    std::vector<size_t> dims;
+
+    for (auto const& part :
+         topology.attribute("Dimensions").split(' ', Qt::SkipEmptyParts)) {
+        dims.insert(dims.begin(), part.toULongLong());
+    }
+
+    GridSpec ret { .name = name };
+    auto&    axes = ret.axes.emplace();
+
+    size_t const axis_count = is_3d ? 3 : 2;
+
+    if (geometry_type.startsWith("ORIGIN_")) {
+        if (items.size() < 2 or items[0].size() < axis_count or
+            items[1].size() < axis_count or dims.size() < axis_count) {
+            qCritical() << "Origin and spacing geometry needs an origin, a "
+                           "spacing and grid dimensions";
+            return {};
+        }
+
+        for (size_t a = 0; a < axis_count; a++) {
+            auto origin  = items[0][axis_count - 1 - a];
+            auto spacing = items[1][axis_count - 1 - a];
+
+            axes[a].resize(dims[a]);
+            for (size_t i = 0; i < dims[a]; i++) {
+                axes[a][i] = origin + spacing * i;
+            }
+        }
+    } else if (geometry_type.startsWith("VX")) {
+        if (items.size() < axis_count) {
+            qCritical() << "Per axis geometry needs an array for every axis";
+            return {};
+        }
+
+        for (size_t a = 0; a < axis_count; a++) {
+            axes[a].assign(items[a].begin(), items[a].end());
+        }
+    } else {
+        qCritical() << "Geometry" << geometry_type << "does not fit a"
+                    << type;
+        return {};
+    }
+
+    // a 2D grid is a single sheet at z = 0
+    if (!is_3d) axes[2] = { 0.0f };
+
+    qInfo() << "Structured grid" << name << "of" << (qint64)axes[0].size()
+            << "x" << (qint64)axes[1].size() << "x" << (qint64)axes[2].size()
+            << "nodes";
+
+    return ret;
+}
+
+std::optional<XDMFImporter::GridSpec>
+XDMFImporter::grid_spec(QDomElement element) {
+    auto name = element.attribute("Name");
+
+    qDebug() << "Loading Grid" << name;
+
+    auto time_element = element.firstChildElement("Time");
+
+    auto topology_element = element.firstChildElement("Topology");
+
+    auto geometry_element = element.firstChildElement("Geometry");
+
+    if (topology_element.isNull() or geometry_element.isNull()) {
+        qWarning() << "Missing key elements from XDMF";
+        return {};
+    }
+
+    if (!time_element.isNull()) {
+        qInfo() << "Importing XDMF at time" << time_element.attribute("Value");
     }
+
+    auto topology_type = topology_element.attribute("TopologyType");
+
+    std::optional<GridSpec> ret;
+
+    // 2D/3DRectMesh and 2D/3DCoRectMesh
+    if (topology_type.endsWith("RectMesh")) {
+        ret = structured_spec(name, topology_element, geometry_element);
+    } else {
+        unsigned cell_size = 3;
+
+        auto conn = consume_conn(topology_element, cell_size);
+        auto geom = consume_geom(geometry_element);
+
+        if (!conn or !geom) {
+            qCritical() << "Unable to import grid" << name << ", skipping";
+            return {};
+        }
+
+        ret = GridSpec {
+            .name      = name,
+            .conn      = *conn,
+            .geom      = *geom,
+            .cell_size = cell_size,
+        };
+    }
+
+    if (ret) ret->attribute = consume_attribute(element);
+
+    return ret;
 }
 
-template <class T>
-constexpr int vector_length() {
-    static_assert("nope");
-    return 0;
+void XDMFImporter::collect_grids(QDomElement            element,
+                                 std::vector<GridSpec>& specs) {
+    if (element.attribute("GridType") != "Collection") {
+        if (auto spec = grid_spec(element)) specs.push_back(*spec);
+        return;
+    }
+
+    auto kind  = element.attribute("CollectionType", "Spatial");
+    auto child = element.firstChildElement("Grid");
+
+    qDebug() << "Loading" << kind << "collection"
+             << element.attribute("Name");
+
+    if (auto time = element.firstChildElement("Time"); !time.isNull()) {
+        qInfo() << "Importing XDMF at time" << time.attribute("Value");
+    }
+
+    // one mesh per step is not something we can show yet; take the first
+    if (kind == "Temporal") {
+        if (!child.isNull()) collect_grids(child, specs);
+        return;
+    }
+
+    for (; !child.isNull(); child = child.nextSiblingElement("Grid")) {
+        collect_grids(child, specs);
+    }
 }
 
-template <>
-constexpr int vector_length<aiVector3D>() {
-    return 3;
+std::optional<XDMFImporter::Partition>
+XDMFImporter::load_partition(GridSpec const& spec) const {
+    bool const solid = spec.axes ? spec.axes->at(2).size() > 1
+                                 : spec.cell_size > 3;
+
+    if (solid and spec.attribute) {
+        auto volume = load_volume(spec);
+        if (!volume) return {};
+        return Partition { .name = spec.name, .volume = std::move(volume) };
+    }
+
+    if (spec.axes) return load_structured(spec, m_scratch);
+
+    if (solid) {
+        qCritical() << "Grid" << spec.name
+                    << "of volume cells has no scalar field to show";
+        return {};
+    }
+
+    auto conn_data = map_data(spec.conn);
+    auto geom_data = map_data(spec.geom);
+
+    if (!conn_data or !geom_data) {
+        qCritical() << "Unable to map data of grid" << spec.name;
+        return {};
+    }
+
+    Partition ret { .name = spec.name };
+
+    std::tie(ret.positions, ret.position_count) =
+        pack_to<aiVector3D>(*geom_data);
+    ret.indices = pack_to<uint32_t>(*conn_data, m_scratch);
+
+    auto const out_of_range = std::any_of(
+        ret.indices.begin(),
+        ret.indices.end(),
+        [count = ret.position_count](uint32_t i) { return i >= count; });
+
+    if (out_of_range) {
+        qCritical() << "Grid" << spec.name << "indexes past its"
+                    << (qint64)ret.position_count << "nodes";
+        return {};
+    }
+
+    return ret;
 }
 
-template <class T>
-std::pair<std::unique_ptr<T[]>, size_t> pack_to(MappedFile& file) {
+XDMFImporter::Partition XDMFImporter::load_structured(GridSpec const& spec,
+                                                      ImportArena&    scratch) {
+    auto const& axes = *spec.axes;
 
-    qDebug() << Q_FUNC_INFO << file.type;
+    std::array<size_t, 3> const n = {
+        axes[0].size(),
+        axes[1].size(),
+        axes[2].size(),
+    };
 
-    if constexpr (std::is_fundamental_v<T>) {
-        // one to one, just copy
-        return interpret_mapped(file, [](auto span) {
-            std::unique_ptr<T[]> ret = std::make_unique<T[]>(span.size());
+    // Only the boundary is of any use to a viewer, so emit the six sides as
+    // sheets of their own and never touch the interior. Each side spans
+    // axes u and v, with u x v = k.
+    struct Side {
+        int    u, v, k;
+        bool   far; // at the last node along k, facing +k
+        size_t vertex_base;
+        size_t index_base;
+    };
 
-            std::copy(span.begin(), span.end(), ret.get());
+    std::vector<Side> sides;
 
-            return std::pair<std::unique_ptr<T[]>, size_t>(std::move(ret),
-                                                           span.size());
-        });
-    } else {
-        // GLM type
-        return interpret_mapped(file, [](auto span) {
-            auto vlen = vector_length<T>();
+    size_t vertex_count = 0;
+    size_t index_count  = 0;
+
+    for (int k = 0; k < 3; k++) {
+        int u = (k + 1) % 3;
+        int v = (k + 2) % 3;
+
+        if (n[u] < 2 or n[v] < 2) continue;
+
+        for (bool far : { false, true }) {
+            // a flat grid has one side along k, not two
+            if (far and n[k] < 2) continue;
+
+            sides.push_back({ u, v, k, far, vertex_count, index_count });
+
+            vertex_count += n[u] * n[v];
+            index_count += (n[u] - 1) * (n[v] - 1) * 6;
+        }
+    }
 
-            auto count = span.size() / vlen;
+    Partition ret { .name = spec.name };
 
-            std::unique_ptr<T[]> ret = std::make_unique<T[]>(count);
+    ret.positions      = std::make_unique<aiVector3D[]>(vertex_count);
+    ret.position_count = vertex_count;
+    ret.indices        = scratch.allocate_array<uint32_t>(index_count);
 
-            qDebug() << Q_FUNC_INFO << "Vector Type:" << count << vlen;
+    // slabs of rows, so even a single huge side spreads over the pool
+    constexpr size_t slab_rows = 64;
 
-            for (size_t v_i = 0; v_i < count; v_i++) {
-                size_t place = v_i * vlen;
-                T      t;
-                for (int i = 0; i < vlen; i++) {
-                    t[i] = span[place + i];
+    struct Slab {
+        size_t side;
+        size_t first_row;
+    };
+
+    std::vector<Slab> slabs;
+
+    for (size_t s = 0; s < sides.size(); s++) {
+        for (size_t row = 0; row < n[sides[s].v]; row += slab_rows) {
+            slabs.push_back({ s, row });
+        }
+    }
+
+    ThreadPool::global().parallel_for(slabs.size(), [&](size_t si) {
+        auto const& side = sides[slabs[si].side];
+
+        auto const nu = n[side.u];
+        auto const nv = n[side.v];
+
+        auto const first = slabs[si].first_row;
+        auto const last  = std::min(first + slab_rows, nv);
+
+        float const along = side.far ? axes[side.k].back()
+                                     : axes[side.k].front();
+
+        for (size_t j = first; j < last; j++) {
+            for (size_t i = 0; i < nu; i++) {
+                float p[3];
+                p[side.u] = axes[side.u][i];
+                p[side.v] = axes[side.v][j];
+                p[side.k] = along;
+
+                ret.positions[side.vertex_base + j * nu + i] =
+                    aiVector3D(p[0], p[1], p[2]);
+            }
+        }
+
+        for (size_t j = first; j < std::min(last, nv - 1); j++) {
+            for (size_t i = 0; i + 1 < nu; i++) {
+                uint32_t a = side.vertex_base + j * nu + i;
+                uint32_t b = a + 1;
+                uint32_t c = a + nu;
+                uint32_t d = c + 1;
+
+                auto* out =
+                    &ret.indices[side.index_base + (j * (nu - 1) + i) * 6];
+
+                // u x v faces +k; the near side has to face the other way
+                if (side.far) {
+                    std::array<uint32_t, 6> tris = { a, b, c, b, d, c };
+                    std::copy(tris.begin(), tris.end(), out);
+                } else {
+                    std::array<uint32_t, 6> tris = { a, c, b, b, c, d };
+                    std::copy(tris.begin(), tris.end(), out);
                 }
-                // qDebug() << t.x << t.y << t.z;
-                ret[v_i] = t;
             }
+        }
+    });
 
-            return std::pair<std::unique_ptr<T[]>, size_t>(std::move(ret),
-                                                           count);
-        });
+    qInfo() << "Structured grid" << spec.name << "has"
+            << (qint64)vertex_count << "boundary nodes and"
+            << (qint64)(index_count / 3) << "triangles";
+
+    return ret;
+}
+
+std::optional<std::vector<float>>
+XDMFImporter::load_values(AttributeSpec const& spec) const {
+    if (!spec.data) return spec.values;
+
+    auto mapped = map_data(*spec.data);
+
+    if (!mapped) {
+        qCritical() << "Unable to map attribute" << spec.name;
+        return {};
     }
+
+    return interpret_mapped(*mapped, [](auto span) {
+        std::vector<float> ret(span.size());
+
+        ThreadPool::global().parallel_chunks(
+            span.size(), [&](size_t b, size_t e) {
+                std::copy(span.begin() + b, span.begin() + e, ret.begin() + b);
+            });
+
+        return ret;
+    });
 }
 
-void XDMFImporter::consume_grid(QDomElement element) {
-    qDebug() << "Loading Grid...";
+std::shared_ptr<ScalarVolume>
+XDMFImporter::load_volume(GridSpec const& spec) const {
+    auto const& attribute = *spec.attribute;
 
-    auto time_element = element.elementsByTagName("Time").at(0).toElement();
+    auto values = load_values(attribute);
+    if (!values) return {};
 
-    auto topology_element =
-        element.elementsByTagName("Topology").at(0).toElement();
+    auto ret  = std::make_shared<ScalarVolume>();
+    ret->name = attribute.name;
 
-    auto geometry_element =
-        element.elementsByTagName("Geometry").at(0).toElement();
+    // how many values the field should have, and which they are
+    auto take = [&](size_t expected) -> std::optional<std::span<float const>> {
+        if (values->size() < expected) {
+            qCritical() << "Attribute" << attribute.name << "of grid"
+                        << spec.name << "has" << (qint64)values->size()
+                        << "values, expected" << (qint64)expected;
+            return {};
+        }
+        return std::span<float const>(*values).first(expected);
+    };
 
-    if (time_element.isNull() or topology_element.isNull() or
-        geometry_element.isNull()) {
-        qWarning() << "Missing key elements from XDMF";
-        return;
-    }
+    if (spec.axes) {
+        auto const& axes = *spec.axes;
+
+        std::array<size_t, 3> const n = {
+            axes[0].size(),
+            axes[1].size(),
+            axes[2].size(),
+        };
+
+        size_t const nodes = n[0] * n[1] * n[2];
+
+        if (nodes > std::numeric_limits<uint32_t>::max()) {
+            qCritical() << "Grid" << spec.name << "has too many nodes";
+            return {};
+        }
+
+        ret->structured = true;
+        ret->axes       = axes;
 
-    qInfo() << "Importing XDMF at time" << time_element.attribute("Value");
+        if (attribute.cell_centered) {
+            size_t cells = 1;
+            for (auto count : n) {
+                cells *= std::max<size_t>(count, 2) - 1;
+            }
+
+            auto field = take(cells);
+            if (!field) return {};
 
-    auto conn_data = consume_conn(topology_element);
-    auto geom_data = consume_geom(geometry_element);
+            ret->values = structured_cell_to_node(n, *field);
+        } else {
+            if (!take(nodes)) return {};
+
+            values->resize(nodes);
+            ret->values = std::move(*values);
+        }
+
+        ret->update_range();
+
+        return ret;
+    }
 
+    auto conn_data = map_data(spec.conn);
+    auto geom_data = map_data(spec.geom);
 
     if (!conn_data or !geom_data) {
-        qCritical() << "Unable to import, bailing";
-        return;
+        qCritical() << "Unable to map data of grid" << spec.name;
+        return {};
     }
 
-    // interpret data
+    auto& pool = ThreadPool::global();
 
-    auto [positions, positions_size] = pack_to<aiVector3D>(*geom_data);
-    auto [indices, indices_size]     = pack_to<uint32_t>(*conn_data);
+    ret->positions = interpret_mapped(*geom_data, [&pool](auto span) {
+        std::vector<glm::vec3> out(span.size() / 3);
 
-    //    auto source = noo::MeshSource {
-    //        .material     = material,
-    //        .positions    = positions,
-    //        .indices      = std::as_bytes(std::span(indices)),
-    //        .index_format = noo::Format::U32,
-    //        .type         = noo::MeshSource::TRIANGLE,
-    //    };
+        pool.parallel_chunks(out.size(), [&](size_t b, size_t e) {
+            for (size_t i = b; i < e; i++) {
+                auto const* p = &span[i * 3];
+                out[i]        = glm::vec3(p[0], p[1], p[2]);
+            }
+        });
 
+        return out;
+    });
 
-    // create model
-    auto& model = *m_scene;
+    auto cells = interpret_mapped(*conn_data, [](auto span) {
+        return std::vector<uint32_t>(span.begin(), span.end());
+    });
 
-    model.mRootNode = new aiNode;
+    auto const nodes = ret->positions.size();
 
-    model.mMaterials    = new aiMaterial*[1];
-    model.mNumMaterials = 1;
+    if (nodes > std::numeric_limits<uint32_t>::max()) {
+        qCritical() << "Grid" << spec.name << "has too many nodes";
+        return {};
+    }
 
-    auto new_mat        = new aiMaterial;
-    model.mMaterials[0] = new_mat;
+    cells.resize(cells.size() - cells.size() % spec.cell_size);
 
-    model.mMeshes    = new aiMesh*[1];
-    model.mNumMeshes = 1;
+    auto const out_of_range = std::any_of(
+        cells.begin(), cells.end(), [nodes](uint32_t i) { return i >= nodes; });
 
-    auto new_mesh = new aiMesh;
+    if (out_of_range) {
+        qCritical() << "Grid" << spec.name << "indexes past its"
+                    << (qint64)nodes << "nodes";
+        return {};
+    }
 
-    model.mMeshes[0] = new_mesh;
+    auto const cell_count = cells.size() / spec.cell_size;
 
-    new_mesh->mMaterialIndex = 0;
+    auto field = take(attribute.cell_centered ? cell_count : nodes);
+    if (!field) return {};
 
-    model.mRootNode->mMeshes    = new unsigned int[1];
-    model.mRootNode->mMeshes[0] = 0;
-    model.mRootNode->mNumMeshes = 1;
+    if (attribute.cell_centered) {
+        ret->values = cell_to_node(cells, spec.cell_size, *field, nodes);
+    } else {
+        values->resize(nodes);
+        ret->values = std::move(*values);
+    }
 
+    if (spec.cell_size == 8) {
+        append_hexahedra(cells, ret->tetrahedra);
+    } else {
+        ret->tetrahedra = std::move(cells);
+    }
 
-    new_mesh->mVertices    = positions.release();
-    new_mesh->mNumVertices = positions_size;
+    ret->update_range();
 
-    new_mesh->mName = "imported";
+    qInfo() << "Volume grid" << spec.name << "has" << (qint64)nodes
+            << "nodes and" << (qint64)cell_count << "cells";
 
+    return ret;
+}
+
+static aiMesh* make_mesh(QString const&                name,
+                         std::unique_ptr<aiVector3D[]> positions,
+                         size_t                        position_count,
+                         std::span<uint32_t const>     indices) {
+    auto new_mesh = new aiMesh;
+
+    new_mesh->mMaterialIndex = 0;
+
+    new_mesh->mVertices    = positions.release();
+    new_mesh->mNumVertices = position_count;
 
-    auto num_tris       = indices_size / 3;
+    new_mesh->mName = name.isEmpty() ? "imported" : name.toStdString();
+
+    auto num_tris       = indices.size() / 3;
     new_mesh->mNumFaces = num_tris;
     new_mesh->mFaces    = new aiFace[num_tris];
 
@@ -376,6 +887,8 @@ void XDMFImporter::consume_grid(QDomElement element) {
         auto& f       = new_mesh->mFaces[i];
         f.mNumIndices = 3;
 
+        // faces free their indices with delete[], so these cannot come
+        // from an arena
         f.mIndices = new unsigned int[3];
 
         f.mIndices[0] = indices[cursor];
@@ -385,23 +898,343 @@ void XDMFImporter::consume_grid(QDomElement element) {
         f.mIndices[2] = indices[cursor];
         cursor++;
     }
+
+    return new_mesh;
+}
+
+void XDMFImporter::build_scene(std::vector<Partition>& partitions) {
+    auto& pool = ThreadPool::global();
+
+    std::vector<aiMesh*> meshes;
+
+    if (partitions.size() == 1 or m_keep_partitions) {
+        meshes.resize(partitions.size());
+
+        pool.parallel_for(partitions.size(), [&](size_t i) {
+            auto& p   = partitions[i];
+            meshes[i] = make_mesh(p.name,
+                                  std::move(p.positions),
+                                  p.position_count,
+                                  p.indices);
+        });
+    } else {
+        // stitch: concatenate, then merge the nodes partitions share. Shared
+        // nodes are copies of the same coordinates, so only exact matches
+        // merge, and nearby nodes of thin features stay apart.
+        std::vector<size_t> vertex_base(partitions.size() + 1);
+        std::vector<size_t> index_base(partitions.size() + 1);
+
+        for (size_t i = 0; i < partitions.size(); i++) {
+            vertex_base[i + 1] = vertex_base[i] + partitions[i].position_count;
+            index_base[i + 1]  = index_base[i] + partitions[i].indices.size();
+        }
+
+        std::vector<glm::vec3> positions(vertex_base.back());
+        std::vector<uint32_t>  indices(index_base.back());
+
+        pool.parallel_for(partitions.size(), [&](size_t i) {
+            auto& p = partitions[i];
+
+            std::transform(p.positions.get(),
+                           p.positions.get() + p.position_count,
+                           positions.begin() + vertex_base[i],
+                           [](aiVector3D const& v) {
+                               return glm::vec3(v.x, v.y, v.z);
+                           });
+
+            std::transform(p.indices.begin(),
+                           p.indices.end(),
+                           indices.begin() + index_base[i],
+                           [base = vertex_base[i]](uint32_t v) {
+                               return uint32_t(v + base);
+                           });
+
+            p = Partition {};
+        });
+
+        auto welded = weld_positions(positions, 0);
+
+        positions = {};
+
+        remap_triangles(indices, welded.remap);
+
+        auto count  = welded.positions.size();
+        auto packed = std::make_unique<aiVector3D[]>(count);
+
+        std::transform(welded.positions.begin(),
+                       welded.positions.end(),
+                       packed.get(),
+                       [](glm::vec3 const& v) {
+                           return aiVector3D(v.x, v.y, v.z);
+                       });
+
+        meshes.push_back(
+            make_mesh(QString(), std::move(packed), count, indices));
+
+        indices = {};
+    }
+
+    // create model
+    auto& model = *m_scene;
+
+    model.mRootNode = new aiNode;
+
+    model.mMaterials    = new aiMaterial*[1];
+    model.mNumMaterials = 1;
+
+    auto new_mat        = new aiMaterial;
+    model.mMaterials[0] = new_mat;
+
+    model.mMeshes    = new aiMesh*[meshes.size()];
+    model.mNumMeshes = meshes.size();
+
+    std::copy(meshes.begin(), meshes.end(), model.mMeshes);
+
+    if (meshes.size() == 1) {
+        model.mRootNode->mMeshes    = new unsigned int[1];
+        model.mRootNode->mMeshes[0] = 0;
+        model.mRootNode->mNumMeshes = 1;
+        return;
+    }
+
+    // one child per partition, so they can be told apart
+    auto& root = *model.mRootNode;
+
+    root.mChildren    = new aiNode*[meshes.size()];
+    root.mNumChildren = meshes.size();
+
+    for (unsigned i = 0; i < meshes.size(); i++) {
+        auto child        = new aiNode(meshes[i]->mName.C_Str());
+        child->mParent    = &root;
+        child->mMeshes    = new unsigned int[1];
+        child->mMeshes[0] = i;
+        child->mNumMeshes = 1;
+
+        root.mChildren[i] = child;
+    }
+}
+
+std::optional<XDMFImporter::Partition>
+XDMFImporter::extract_partition(std::vector<Partition>& volumes) {
+    std::shared_ptr<ScalarVolume> merged;
+
+    // grids that repeat the nodes they share give the same vertex twice
+    bool weld = false;
+
+    auto structured = std::find_if(
+        volumes.begin(), volumes.end(), [](Partition const& p) {
+            return p.volume->structured;
+        });
+
+    if (structured != volumes.end()) {
+        // structured grids do not concatenate; one has to do
+        if (volumes.size() > 1) {
+            qWarning() << "Only the structured grid" << structured->name
+                       << "of" << (qint64)volumes.size()
+                       << "volume grids is used";
+        }
+
+        merged = structured->volume;
+    } else if (volumes.size() == 1) {
+        merged = volumes.front().volume;
+    } else {
+        merged       = std::make_shared<ScalarVolume>();
+        merged->name = volumes.front().volume->name;
+
+        size_t nodes = 0;
+
+        for (auto const& p : volumes) {
+            auto const& v = *p.volume;
+
+            if (nodes + v.node_count() >
+                std::numeric_limits<uint32_t>::max()) {
+                qCritical() << "Volume grids have too many nodes together";
+                return {};
+            }
+
+            auto& positions = merged->positions;
+            auto& values    = merged->values;
+
+            positions.insert(
+                positions.end(), v.positions.begin(), v.positions.end());
+            values.insert(values.end(), v.values.begin(), v.values.end());
+
+            std::transform(v.tetrahedra.begin(),
+                           v.tetrahedra.end(),
+                           std::back_inserter(merged->tetrahedra),
+                           [base = uint32_t(nodes)](uint32_t n) {
+                               return n + base;
+                           });
+
+            nodes += v.node_count();
+        }
+
+        merged->update_range();
+
+        weld = true;
+    }
+
+    volumes.clear();
+
+    m_volume = merged;
+
+    auto iso = m_iso_value.value_or(merged->middle());
+
+    qInfo() << "Field" << merged->name << "ranges over" << merged->min_value
+            << "to" << merged->max_value << "| extracting at" << iso;
+
+    auto surface = extract_isosurface(*merged, iso);
+
+    if (surface.indices.empty()) {
+        qWarning() << "No isosurface of" << merged->name << "at" << iso;
+        return {};
+    }
+
+    if (weld) {
+        // where partitions meet, both cut the same edges the same way, so
+        // their copies of a surface vertex match bit for bit
+        auto welded = weld_positions(surface.positions, 0);
+
+        remap_triangles(surface.indices, welded.remap);
+
+        surface.positions = std::move(welded.positions);
+    }
+
+    Partition ret { .name = merged->name };
+
+    ret.position_count = surface.positions.size();
+    ret.positions      = std::make_unique<aiVector3D[]>(ret.position_count);
+
+    std::transform(surface.positions.begin(),
+                   surface.positions.end(),
+                   ret.positions.get(),
+                   [](glm::vec3 const& v) {
+                       return aiVector3D(v.x, v.y, v.z);
+                   });
+
+    ret.indices = m_scratch.allocate_array<uint32_t>(surface.indices.size());
+
+    std::copy(
+        surface.indices.begin(), surface.indices.end(), ret.indices.begin());
+
+    return ret;
+}
+
+void XDMFImporter::consume_grids(std::vector<GridSpec> const& specs) {
+    if (specs.empty()) {
+        qCritical() << "Unable to import, bailing";
+        return;
+    }
+
+    qInfo() << "Loading" << (qint64)specs.size() << "grids";
+
+    std::vector<std::optional<Partition>> loaded(specs.size());
+
+    auto& pool = ThreadPool::global();
+
+    if (m_async_io) m_reader = std::make_unique<AsyncReader>();
+
+    // Without reads ahead, every grid goes at once. With them, grids go a
+    // wave of one per worker at a time, and the data of the next wave is
+    // read while this one converts; only two waves of data are held.
+    size_t const count = specs.size();
+    size_t const wave  = m_reader ? std::max<size_t>(pool.size(), 1) : count;
+
+    std::span<GridSpec const> const all(specs);
+
+    auto wave_at = [&](size_t first) {
+        first = std::min(first, count);
+        return all.subspan(first, std::min(wave, count - first));
+    };
+
+    if (m_reader) read_ahead(wave_at(0));
+
+    for (size_t first = 0; first < count; first += wave) {
+        auto const current = wave_at(first);
+        auto const next    = wave_at(first + wave);
+
+        if (m_reader) read_ahead(next);
+
+        pool.parallel_for(current.size(), [&](size_t i) {
+            loaded[first + i] = load_partition(current[i]);
+        });
+
+        if (m_reader) forget_reads(current, next);
+    }
+
+    if (m_reader) {
+        m_reads.clear();
+
+        auto const bytes   = m_reader->bytes_read();
+        auto const seconds = m_reader->busy_seconds();
+        auto const rate    = seconds > 0 ? bytes / seconds : 0.0;
+
+        metrics::data_bytes_read().add(bytes);
+        metrics::data_read_rate().set((int64_t)rate);
+
+        qInfo() << "Read" << bytes / double(1 << 20) << "MiB of data items in"
+                << seconds * 1000 << "ms," << rate / 1e6 << "MB/s through"
+                << (m_reader->uses_io_uring() ? "io_uring" : "pread");
+
+        m_reader.reset();
+    }
+
+    std::vector<Partition> partitions;
+    std::vector<Partition> volumes;
+
+    for (auto& p : loaded) {
+        if (!p) continue;
+        (p->volume ? volumes : partitions).push_back(std::move(*p));
+    }
+
+    if (!volumes.empty()) {
+        if (auto surface = extract_partition(volumes)) {
+            partitions.push_back(std::move(*surface));
+        }
+    }
+
+    if (partitions.empty()) {
+        qCritical() << "Unable to import, bailing";
+        return;
+    }
+
+    build_scene(partitions);
+
+    qInfo() << "Grid scratch served" << m_scratch.allocations()
+            << "allocations," << m_scratch.allocated_bytes() << "bytes";
+
+    partitions.clear();
+    m_scratch.reset();
+}
+
+void XDMFImporter::consume_grid(QDomElement element) {
+    std::vector<GridSpec> specs;
+    collect_grids(element, specs);
+    consume_grids(specs);
 }
 
 void XDMFImporter::consume_domain(QDomElement element) {
     qDebug() << "Loading Domain...";
 
+    std::vector<GridSpec> specs;
+
+    // sibling grids are pieces of one scene, just like a spatial collection
     auto node = element.firstChildElement("Grid");
 
     while (!node.isNull()) {
-        consume_grid(node.toElement());
+        collect_grids(node, specs);
         node = node.nextSiblingElement("Grid");
     }
+
+    consume_grids(specs);
 }
 
-ReturnType XDMFImporter::parse(QFile& file) {
+ReturnType XDMFImporter::parse(QFile& file) { return parse(file.readAll()); }
+
+ReturnType XDMFImporter::parse(QByteArray const& xml) {
     QDomDocument document("XDMFDocument");
 
-    if (!document.setContent(&file)) { return "Unable to read XML document"; }
+    if (!document.setContent(xml)) { return "Unable to read XML document"; }
 
     auto doc_elem = document.documentElement();
 
@@ -420,7 +1253,13 @@ ReturnType XDMFImporter::parse(QFile& file) {
     return std::nullopt;
 }
 
-XDMFAssimpImporter::XDMFAssimpImporter()  = default;
+XDMFAssimpImporter::XDMFAssimpImporter(bool                 keep_partitions,
+                                       std::optional<float> iso_value,
+                                       bool                 async_io)
+    : m_keep_partitions(keep_partitions),
+      m_iso_value(iso_value),
+      m_async_io(async_io) { }
+
 XDMFAssimpImporter::~XDMFAssimpImporter() = default;
 
 bool XDMFAssimpImporter::CanRead(std::string const& pFile,
@@ -450,16 +1289,36 @@ void XDMFAssimpImporter::InternReadFile(std::string const& pFile,
                                         aiScene*           pScene,
                                         Assimp::IOSystem*  pIOHandler) {
     qDebug() << "Loading XMF...";
-    auto  file_path = QString::fromStdString(pFile);
-    QFile file(file_path);
+    auto file_path = QString::fromStdString(pFile);
 
-    if (!file.open(QFile::ReadOnly)) {
-        throw DeadlyExportError("Unreadable file");
+    std::unique_ptr<Assimp::IOStream> stream(pIOHandler->Open(pFile, "rb"));
+
+    if (!stream) { throw DeadlyExportError("Unreadable file"); }
+
+    // parse straight out of the mapping if we have one
+    QByteArray xml;
+
+    if (auto* mapped = dynamic_cast<MappedIOStream*>(stream.get())) {
+        auto bytes = mapped->mapping();
+        xml        = QByteArray::fromRawData(
+            reinterpret_cast<char const*>(bytes.data()), bytes.size());
+    } else {
+        xml.resize(stream->FileSize());
+        xml.resize(stream->Read(xml.data(), 1, xml.size()));
     }
 
-    XDMFImporter importer(file_path, pScene);
+    XDMFImporter importer(file_path,
+                          pScene,
+                          pIOHandler,
+                          m_keep_partitions,
+                          m_iso_value,
+                          m_async_io);
+
+    auto ret = importer.parse(xml);
+
+    m_volume = importer.volume();
 
-    auto ret = importer.parse(file);
+    pIOHandler->Close(stream.release());
 
     if (ret) { throw DeadlyExportError(ret.value().toStdString()); }
 }
@@ -1,15 +1,46 @@
 #pragma once
 
+#include "asyncread.h"
+#include "importarena.h"
+#include "isosurface.h"
+
 #include <assimp/BaseImporter.h>
 #include <assimp/scene.h>
 
+#include <QDebug>
+#include <QDir>
+#include <QDomElement>
+#include <QFile>
+#include <QHash>
 #include <QString>
 
+#include <array>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
 class XDMFAssimpImporter : public Assimp::BaseImporter {
+    bool                 m_keep_partitions;
+    std::optional<float> m_iso_value;
+    bool                 m_async_io;
+
+    std::shared_ptr<ScalarVolume> m_volume;
+
 public:
-    XDMFAssimpImporter();
+    /// With `keep_partitions`, every grid of a spatial collection becomes a
+    /// mesh of its own instead of being welded into one. Volumes with a
+    /// scalar field are shown as their isosurface at `iso_value`, or at the
+    /// middle of the field range if not given. With `async_io`, data items
+    /// are read ahead in batches instead of mapped; see XDMFImporter.
+    explicit XDMFAssimpImporter(bool                 keep_partitions = false,
+                                std::optional<float> iso_value       = {},
+                                bool                 async_io        = false);
     virtual ~XDMFAssimpImporter();
 
+    /// The volume of the last file read, if it had one
+    std::shared_ptr<ScalarVolume> volume() const { return m_volume; }
+
 public:
     bool CanRead(std::string const& pFile,
                  Assimp::IOSystem*  pIOHandler,
@@ -22,3 +53,287 @@ protected:
                         aiScene*           pScene,
                         Assimp::IOSystem*  pIOHandler);
 };
+
+// =============================================================================
+
+using ReturnType = std::optional<QString>;
+
+struct MappedFile {
+    enum PType {
+        Float32,
+        Float64,
+        Int32,
+        Int64,
+    };
+
+    QFile                    file;
+    std::shared_ptr<void>    stream; // keeps an IOSystem mapping alive
+    std::span<unsigned char> bytes;
+    PType                    type = PType::Float32;
+
+    static size_t type_size(PType type) {
+        switch (type) {
+        case Float32:
+        case Int32: return 4;
+        case Float64:
+        case Int64: return 8;
+        }
+        return 0;
+    }
+
+    void reset_span(size_t count) {
+        size_t bcount = count * type_size(type);
+
+        assert(bcount <= bytes.size());
+
+        bytes = bytes.subspan(0, bcount);
+    }
+
+    MappedFile() = default;
+
+    MappedFile(QString path, size_t offset, size_t span = 0) : file(path) {
+        if (!file.open(QFile::ReadOnly)) return;
+
+        qDebug() << "Mapping" << path << file.size();
+
+        offset = std::min<size_t>(offset, file.size());
+
+        if (span == 0) { span = file.size() - offset; }
+
+        auto mapped_bytes = file.map(offset, span);
+
+        if (!mapped_bytes) return;
+
+        bytes = std::span<unsigned char>(mapped_bytes, span);
+    }
+};
+
+/// Converts an XDMF document into an Assimp scene. The document is walked
+/// on the calling thread, as QDom is not safe to share; what it yields are
+/// plain descriptions of the data, which are then mapped and converted on
+/// the thread pool, one grid per task.
+class XDMFImporter {
+    /// Where a binary data item lives
+    struct DataSpec {
+        QString           path;
+        MappedFile::PType type  = MappedFile::Float32;
+        size_t            seek  = 0;
+        size_t            count = 0;
+    };
+
+    /// A scalar field over a grid, in a file or given inline
+    struct AttributeSpec {
+        QString                 name;
+        bool                    cell_centered = false;
+        std::optional<DataSpec> data;
+        std::vector<float>      values; // if not in a file
+    };
+
+    /// One uniform grid; a partition of the whole if it came from a spatial
+    /// collection
+    struct GridSpec {
+        QString  name;
+        DataSpec conn;
+        DataSpec geom;
+
+        // nodes per cell: 3 for triangles, 4 for tetrahedra, 8 for hexahedra
+        unsigned cell_size = 3;
+
+        // Set for structured grids instead of conn and geom: the node
+        // coordinates along x, y and z, whose product is the grid
+        std::optional<std::array<std::vector<float>, 3>> axes;
+
+        std::optional<AttributeSpec> attribute;
+    };
+
+    /// Positions end up owned by the scene; indices are copied into faces,
+    /// so they live in the scratch arena. A grid with a scalar field over
+    /// volume cells yields only the volume; its surface is extracted once
+    /// all grids are in.
+    struct Partition {
+        QString                       name;
+        std::unique_ptr<aiVector3D[]> positions;
+        size_t                        position_count = 0;
+        std::span<uint32_t>           indices;
+        std::shared_ptr<ScalarVolume> volume;
+    };
+
+    QString m_file_path;
+    QDir    m_directory;
+
+    aiScene*          m_scene;
+    Assimp::IOSystem* m_io              = nullptr;
+    bool              m_keep_partitions = false;
+    bool              m_async_io        = false;
+
+    std::optional<float>          m_iso_value;
+    std::shared_ptr<ScalarVolume> m_volume;
+
+    // grids load in parallel and allocate from here; emptied once the
+    // scene is built
+    mutable ImportArena m_scratch;
+
+    // data items being read ahead, by file, offset and size; only changed
+    // between waves of grids, so loading grids may look them up freely
+    std::unique_ptr<AsyncReader>         m_reader;
+    QHash<QString, AsyncReader::ReadPtr> m_reads;
+
+    QString resolve_path(QString path);
+
+    std::optional<DataSpec> data_spec(QDomElement element);
+
+    std::shared_ptr<MappedFile> map_data(DataSpec const&) const;
+
+    static QString read_key(DataSpec const&);
+
+    /// Start reading every data item of these grids
+    void read_ahead(std::span<GridSpec const>);
+
+    /// Drop the reads of grids that are done, but for those the next grids
+    /// share
+    void forget_reads(std::span<GridSpec const> done,
+                      std::span<GridSpec const> next);
+
+    std::optional<DataSpec> consume_conn(QDomElement element,
+                                         unsigned&   cell_size);
+    std::optional<DataSpec> consume_geom(QDomElement element);
+
+    std::optional<AttributeSpec> consume_attribute(QDomElement grid);
+
+    std::optional<std::vector<double>> read_values(QDomElement item);
+
+    std::optional<GridSpec> structured_spec(QString     name,
+                                            QDomElement topology,
+                                            QDomElement geometry);
+
+    std::optional<GridSpec> grid_spec(QDomElement element);
+
+    void collect_grids(QDomElement element, std::vector<GridSpec>&);
+
+    std::optional<Partition> load_partition(GridSpec const&) const;
+
+    static Partition load_structured(GridSpec const&, ImportArena&);
+
+    std::optional<std::vector<float>> load_values(AttributeSpec const&) const;
+
+    std::shared_ptr<ScalarVolume> load_volume(GridSpec const&) const;
+
+    std::optional<Partition> extract_partition(std::vector<Partition>&);
+
+    void build_scene(std::vector<Partition>&);
+
+    void consume_grids(std::vector<GridSpec> const&);
+
+    void consume_domain(QDomElement element);
+
+public:
+    /// If an IOSystem is given, data files are mapped through it when it
+    /// supports in-place access. The partitions of a spatial collection are
+    /// welded into one mesh unless `keep_partitions` is set. Grids of
+    /// tetrahedra or hexahedra, and 3D structured grids, that carry a scalar
+    /// attribute are shown as the isosurface at `iso_value`, the middle of
+    /// the field range by default.
+    ///
+    /// With `async_io`, the data items of grids are not mapped but read into
+    /// memory, a wave of grids at a time: all reads of the next wave go out
+    /// as one batch while the current one converts.
+    XDMFImporter(QString              file_path,
+                 aiScene*             scene,
+                 Assimp::IOSystem*    io              = nullptr,
+                 bool                 keep_partitions = false,
+                 std::optional<float> iso_value       = {},
+                 bool                 async_io        = false);
+
+    ReturnType parse(QFile& file);
+    ReturnType parse(QByteArray const& xml);
+
+    /// The scalar field of the volume grids read, merged into one, so the
+    /// surface can be extracted again at other values
+    std::shared_ptr<ScalarVolume> volume() const { return m_volume; }
+
+    /// Convert a single grid element, which may be a collection, into the
+    /// scene. Public so the benchmark suite can time it in isolation.
+    void consume_grid(QDomElement element);
+};
+
+template <class T, class U>
+std::span<T> span_as(std::span<U> other) {
+    static_assert(std::is_trivial_v<T> and std::is_trivial_v<U>);
+
+    return { reinterpret_cast<T*>(other.data()), other.size() / sizeof(T) };
+}
+
+template <class Function>
+auto interpret_mapped(MappedFile& file, Function&& f) {
+    switch (file.type) {
+    case MappedFile::Float32: return f(span_as<float>(file.bytes));
+    case MappedFile::Float64: return f(span_as<double>(file.bytes));
+    case MappedFile::Int32: return f(span_as<int32_t>(file.bytes));
+    case MappedFile::Int64: return f(span_as<int64_t>(file.bytes));
+    }
+}
+
+template <class T>
+constexpr int vector_length() {
+    static_assert("nope");
+    return 0;
+}
+
+template <>
+constexpr int vector_length<aiVector3D>() {
+    return 3;
+}
+
+/// Copy and convert mapped scalars into arena memory
+template <class T>
+std::span<T> pack_to(MappedFile& file, ImportArena& arena) {
+    static_assert(std::is_fundamental_v<T>);
+
+    return interpret_mapped(file, [&arena](auto span) {
+        auto ret = arena.allocate_array<T>(span.size());
+        std::copy(span.begin(), span.end(), ret.begin());
+        return ret;
+    });
+}
+
+template <class T>
+std::pair<std::unique_ptr<T[]>, size_t> pack_to(MappedFile& file) {
+
+    qDebug() << Q_FUNC_INFO << file.type;
+
+    if constexpr (std::is_fundamental_v<T>) {
+        // one to one, just copy
+        return interpret_mapped(file, [](auto span) {
+            std::unique_ptr<T[]> ret = std::make_unique<T[]>(span.size());
+
+            std::copy(span.begin(), span.end(), ret.get());
+
+            return std::pair<std::unique_ptr<T[]>, size_t>(std::move(ret),
+                                                           span.size());
+        });
+    } else {
+        // GLM type
+        return interpret_mapped(file, [](auto span) {
+            auto vlen = vector_length<T>();
+
+            auto count = span.size() / vlen;
+
+            std::unique_ptr<T[]> ret = std::make_unique<T[]>(count);
+
+            qDebug() << Q_FUNC_INFO << "Vector Type:" << count << vlen;
+
+            for (size_t v_i = 0; v_i < count; v_i++) {
+                size_t place = v_i * vlen;
+                T      t;
+                for (int i = 0; i < vlen; i++) {
+                    t[i] = span[place + i];
+                }
+                // qDebug() << t.x << t.y << t.z;
+                ret[v_i] = t;
+            }
+
+            return std::pair<std::unique_ptr<T[]>, size_t>(std::move(ret),
+                                                           count);
+        });
+    }
+}